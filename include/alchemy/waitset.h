@@ -0,0 +1,82 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef _XENOMAI_ALCHEMY_WAITSET_H
+#define _XENOMAI_ALCHEMY_WAITSET_H
+
+#include <stdint.h>
+#include <alchemy/timer.h>
+#include <alchemy/sem.h>
+#include <alchemy/event.h>
+
+/* Creation flags. */
+#define WS_PRIO  0x1	/* Pend by task priority order. */
+#define WS_FIFO  0x0	/* Pend by FIFO order. */
+
+struct RT_WAITSET {
+	uintptr_t handle;
+};
+
+typedef struct RT_WAITSET RT_WAITSET;
+
+struct RT_WAITSET_INFO {
+	int nwatch;
+	int nwaiters;
+	char name[32];
+};
+
+typedef struct RT_WAITSET_INFO RT_WAITSET_INFO;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int rt_waitset_create(RT_WAITSET *ws,
+		      const char *name,
+		      int mode);
+
+int rt_waitset_delete(RT_WAITSET *ws);
+
+int rt_waitset_add_sem(RT_WAITSET *ws,
+		       RT_SEM *sem,
+		       void *cookie);
+
+int rt_waitset_add_event(RT_WAITSET *ws,
+			 RT_EVENT *event,
+			 unsigned long mask,
+			 void *cookie);
+
+int rt_waitset_remove(RT_WAITSET *ws,
+		      void *cookie);
+
+int rt_waitset_wait(RT_WAITSET *ws,
+		    void **cookies,
+		    int nr,
+		    RTIME timeout);
+
+int rt_waitset_wait_until(RT_WAITSET *ws,
+			  void **cookies,
+			  int nr,
+			  RTIME timeout);
+
+int rt_waitset_inquire(RT_WAITSET *ws,
+		       RT_WAITSET_INFO *info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _XENOMAI_ALCHEMY_WAITSET_H */
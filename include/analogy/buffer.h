@@ -94,6 +94,23 @@ struct a4l_buffer {
 };
 typedef struct a4l_buffer a4l_buf_t;
 
+/* Scatter-gather segment describing a window of the buffer */
+struct a4l_buffer_sg {
+
+	/* Kernel virtual address of the segment */
+	void *vaddr;
+
+	/* Physical address of the segment */
+	unsigned long paddr;
+
+	/* Segment size in bytes */
+	unsigned long size;
+};
+typedef struct a4l_buffer_sg a4l_bufsg_t;
+
+/* Maximum count of segments a window of count bytes may span */
+#define A4L_BUF_SG_MAXNR(count) (((count) >> PAGE_SHIFT) + 2)
+
 /* --- Static inline functions related with
    user<->kernel data transfers --- */
 
@@ -187,6 +204,51 @@ static inline void __munge(struct a4l_subdevice * subd,
 	}
 }
 
+/* The function __sg_window is an inline function which describes
+   the window [start, start + count[ of the buffer as a list of
+   physically contiguous segments; the segments are split at page
+   boundaries unless the underlying pages happen to be adjacent, and
+   at the end of the ring. It returns the number of segments filled,
+   or -ENOSPC if nr_sg entries are not enough */
+static inline int __sg_window(a4l_buf_t *buf,
+			      unsigned long start, unsigned long count,
+			      a4l_bufsg_t *sg, int nr_sg)
+{
+	unsigned long start_ptr = (start % buf->size);
+	unsigned long tmp_cnt = count;
+	int nr = 0;
+
+	while (tmp_cnt != 0) {
+		unsigned long pg_off = start_ptr & ~PAGE_MASK;
+		unsigned long blk_size = PAGE_SIZE - pg_off;
+		unsigned long paddr =
+			buf->pg_list[start_ptr >> PAGE_SHIFT] + pg_off;
+
+		if (blk_size > tmp_cnt)
+			blk_size = tmp_cnt;
+
+		/* Extend the previous segment if both are contiguous,
+		   which can never be the case across the ring end */
+		if (nr > 0 && start_ptr != 0 &&
+		    sg[nr - 1].paddr + sg[nr - 1].size == paddr)
+			sg[nr - 1].size += blk_size;
+		else {
+			if (nr == nr_sg)
+				return -ENOSPC;
+			sg[nr].vaddr = buf->buf + start_ptr;
+			sg[nr].paddr = paddr;
+			sg[nr].size = blk_size;
+			nr++;
+		}
+
+		/* Update the start pointer and the count */
+		tmp_cnt -= blk_size;
+		start_ptr = (start_ptr + blk_size) % buf->size;
+	}
+
+	return nr;
+}
+
 /* The function __handle_event can only be called from process context
    (not interrupt service routine). It allows the client process to
    retrieve the buffer status which has been updated by the driver */
@@ -414,6 +476,9 @@ int a4l_buf_commit_put(struct a4l_subdevice *subd,
 int a4l_buf_put(struct a4l_subdevice *subd,
 		void *bufdata, unsigned long count);
 
+int a4l_buf_prepare_sgput(struct a4l_subdevice *subd, unsigned long count,
+			  a4l_bufsg_t *sg, int nr_sg);
+
 int a4l_buf_prepare_absget(struct a4l_subdevice *subd,
 			   unsigned long count);
 
@@ -429,6 +494,9 @@ int a4l_buf_commit_get(struct a4l_subdevice *subd,
 int a4l_buf_get(struct a4l_subdevice *subd,
 		void *bufdata, unsigned long count);
 
+int a4l_buf_prepare_sgget(struct a4l_subdevice *subd, unsigned long count,
+			  a4l_bufsg_t *sg, int nr_sg);
+
 int a4l_buf_evt(struct a4l_subdevice *subd, unsigned long evts);
 
 unsigned long a4l_buf_count(struct a4l_subdevice *subd);
@@ -25,7 +25,24 @@
 /* debug support */
 #include <nucleus/assert.h>
 
-/* Priority queue implementation, using a binary heap. */
+/*
+ * Priority queue implementation, using a 4-ary heap. Having four
+ * children per node halves the tree depth compared to a binary heap,
+ * and the children of any node share a cache line on most
+ * architectures, which makes sifting down cheaper.
+ *
+ * The element array starts with the static storage provided by the
+ * container, then grows by doubling its size whenever it is full,
+ * using the bheap_alloc()/bheap_free() helpers. Users may override
+ * these helpers before including this file.
+ */
+#ifndef bheap_alloc
+#include <nucleus/heap.h>
+#define bheap_alloc(size)	xnmalloc(size)
+#define bheap_free(ptr)		xnfree(ptr)
+#endif /* !bheap_alloc */
+
+#define BHEAP_ARITY 4
 
 typedef unsigned long long bheap_key_t;
 
@@ -46,7 +63,8 @@ typedef struct bheaph {
 typedef struct bheap {
 	unsigned sz;
 	unsigned last;
-	bheaph_t *elems[1]; /* only padding, indexing starts at 1 */
+	bheaph_t **elems;
+	bheaph_t **initial;
 } bheap_t;
 
 #define DECLARE_BHEAP_CONTAINER(name, sz)       \
@@ -55,12 +73,15 @@ typedef struct bheap {
 		bheaph_t *elems[sz];		\
 	} name
 
-/* Check the binary heap invariant. */
+#define bheap_parent_pos(pos)	(((pos) - 1) / BHEAP_ARITY)
+#define bheap_child_pos(pos)	((pos) * BHEAP_ARITY + 1)
+
+/* Check the heap invariant. */
 static inline int bheap_ordered(bheap_t *heap)
 {
 	unsigned i;
-	for (i = 2; i < heap->last; i++)
-		if (bheaph_lt(heap->elems[i], heap->elems[i / 2]))
+	for (i = 1; i < heap->last; i++)
+		if (bheaph_lt(heap->elems[i], heap->elems[bheap_parent_pos(i)]))
 			return 0;
 	return 1;
 }
@@ -77,10 +98,16 @@ static inline int bheap_ordered(bheap_t *heap)
 
 static inline bheaph_t *__internal_bheap_gethead(bheap_t *heap)
 {
-	if (heap->last == 1)
+	if (heap->last == 0)
 		return NULL;
 
-	return heap->elems[1];
+	return heap->elems[0];
+}
+
+static inline int bheaph_valid(bheap_t *heap, bheaph_t *holder)
+{
+	return likely(bheaph_pos(holder) < heap->last
+		      && heap->elems[bheaph_pos(holder)] == holder);
 }
 
 #define bheap_next(heap, holder)			\
@@ -94,8 +121,7 @@ static inline bheaph_t *__internal_bheap_next(bheap_t *heap, bheaph_t *holder)
 {
 	unsigned pos;
 
-	if (unlikely(bheaph_pos(holder) >= heap->last
-		     || heap->elems[bheaph_pos(holder)] != holder))
+	if (unlikely(!bheaph_valid(heap, holder)))
 		return (bheaph_t *) ERR_PTR(-EINVAL);
 
 	pos = bheaph_pos(holder) + 1;
@@ -103,72 +129,117 @@ static inline bheaph_t *__internal_bheap_next(bheap_t *heap, bheaph_t *holder)
 	return likely(pos < heap->last) ? heap->elems[pos] : NULL;
 }
 
-static inline bheaph_t *bheaph_parent(bheap_t *heap, bheaph_t *holder)
-{
-	const unsigned pos = holder->pos;
-
-	return likely(pos > 1) ? heap->elems[pos / 2] : NULL;
-}
-
-static inline bheaph_t *bheaph_child(bheap_t *heap, bheaph_t *holder, int side)
-{
-	const unsigned pos = 2 * holder->pos + side;
-
-	return likely(pos < heap->last) ? heap->elems[pos] : NULL;
-}
-
-#define bheap_init(heap, sz) __internal_bheap_init(&(heap)->bheap, sz)
+#define bheap_init(heap, sz) \
+	__internal_bheap_init(&(heap)->bheap, (heap)->elems, sz)
 
-static inline void __internal_bheap_init(bheap_t *heap, unsigned sz)
+static inline void __internal_bheap_init(bheap_t *heap,
+					 bheaph_t **elems, unsigned sz)
 {
 	heap->sz = sz;
-	heap->last = 1;
+	heap->last = 0;
+	heap->elems = heap->initial = elems;
 }
 
 #define bheap_destroy(heap) __internal_bheap_destroy(&(heap)->bheap)
 
 static inline void __internal_bheap_destroy(bheap_t *heap)
 {
+	if (heap->elems != heap->initial)
+		bheap_free(heap->elems);
+	heap->elems = heap->initial;
 	heap->sz = 0;
-	heap->last = 1;
+	heap->last = 0;
 }
 
-static inline void bheap_swap(bheap_t *heap, bheaph_t *h1, bheaph_t *h2)
+static inline int __internal_bheap_grow(bheap_t *heap)
 {
-	const unsigned pos2 = bheaph_pos(h2);
+	unsigned sz = heap->sz * 2;
+	bheaph_t **elems;
 
-	heap->elems[bheaph_pos(h1)] = h2;
-	bheaph_pos(h2) = bheaph_pos(h1);
-	heap->elems[pos2] = h1;
-	bheaph_pos(h1) = pos2;
+	elems = bheap_alloc(sz * sizeof(*elems));
+	if (elems == NULL)
+		return ENOMEM;
+
+	memcpy(elems, heap->elems, heap->last * sizeof(*elems));
+	if (heap->elems != heap->initial)
+		bheap_free(heap->elems);
+
+	heap->elems = elems;
+	heap->sz = sz;
+
+	return 0;
+}
+
+/*
+ * Make room for @a nr elements, so that inserting up to that many of
+ * them cannot fail. A heap which is not initialized is left alone.
+ */
+#define bheap_reserve(heap, nr) \
+	__internal_bheap_reserve(&(heap)->bheap, nr)
+
+static inline int __internal_bheap_reserve(bheap_t *heap, unsigned long nr)
+{
+	while (heap->sz > 0 && heap->sz < nr)
+		if (__internal_bheap_grow(heap))
+			return ENOMEM;
+
+	return 0;
 }
 
+/*
+ * Both sifting routines move the hole rather than swapping elements,
+ * so that each step only costs a single store in the element array.
+ */
 static inline void bheap_up(bheap_t *heap, bheaph_t *holder)
 {
+	unsigned pos = bheaph_pos(holder), ppos;
 	bheaph_t *parent;
 
-	while ((parent = bheaph_parent(heap, holder)) && bheaph_lt(holder, parent))
-		bheap_swap(heap, holder, parent);
+	while (pos > 0) {
+		ppos = bheap_parent_pos(pos);
+		parent = heap->elems[ppos];
+		if (!bheaph_lt(holder, parent))
+			break;
+		heap->elems[pos] = parent;
+		bheaph_pos(parent) = pos;
+		pos = ppos;
+	}
+
+	heap->elems[pos] = holder;
+	bheaph_pos(holder) = pos;
 }
 
 static inline void bheap_down(bheap_t *heap, bheaph_t *holder)
 {
-	bheaph_t *left, *right, *minchild;
+	unsigned pos = bheaph_pos(holder), child, end, n;
+	bheaph_t *minchild;
 
 	for (;;) {
-		left = bheaph_child(heap, holder, 0);
-		right = bheaph_child(heap, holder, 1);
+		child = bheap_child_pos(pos);
+		if (child >= heap->last)
+			break;
 
-		if (left && right)
-			minchild = bheaph_lt(left, right) ? left : right;
-		else
-			minchild = left ?: right;
+		end = child + BHEAP_ARITY;
+		if (end > heap->last)
+			end = heap->last;
+
+		minchild = heap->elems[child];
+		for (n = child + 1; n < end; n++)
+			if (bheaph_lt(heap->elems[n], minchild)) {
+				minchild = heap->elems[n];
+				child = n;
+			}
 
-		if (!minchild || bheaph_lt(holder, minchild))
+		if (!bheaph_lt(minchild, holder))
 			break;
 
-		bheap_swap(heap, minchild, holder);
+		heap->elems[pos] = minchild;
+		bheaph_pos(minchild) = pos;
+		pos = child;
 	}
+
+	heap->elems[pos] = holder;
+	bheaph_pos(holder) = pos;
 }
 
 #define bheap_insert(heap, holder)				\
@@ -180,10 +251,9 @@ static inline void bheap_down(bheap_t *heap, bheaph_t *holder)
 
 static inline int __internal_bheap_insert(bheap_t *heap, bheaph_t *holder)
 {
-	if (heap->last == heap->sz + 1)
-		return EBUSY;
+	if (unlikely(heap->last == heap->sz) && __internal_bheap_grow(heap))
+		return ENOMEM;
 
-	heap->elems[heap->last] = holder;
 	bheaph_pos(holder) = heap->last;
 	++heap->last;
 	bheap_up(heap, holder);
@@ -201,17 +271,15 @@ static inline int __internal_bheap_delete(bheap_t *heap, bheaph_t *holder)
 {
 	bheaph_t *lasth;
 
-	if (unlikely(bheaph_pos(holder) >= heap->last
-		     || heap->elems[bheaph_pos(holder)] != holder))
+	if (unlikely(!bheaph_valid(heap, holder)))
 		return EINVAL;
 
 	--heap->last;
 	if (heap->last != bheaph_pos(holder)) {
-		bheaph_t *parent;
 		lasth = heap->elems[heap->last];
-		heap->elems[bheaph_pos(holder)] = lasth;
 		bheaph_pos(lasth) = bheaph_pos(holder);
-		if ((parent = bheaph_parent(heap, lasth)) && bheaph_lt(lasth, parent))
+		if (bheaph_pos(lasth) > 0 &&
+		    bheaph_lt(lasth, heap->elems[bheap_parent_pos(bheaph_pos(lasth))]))
 			bheap_up(heap, lasth);
 		else
 			bheap_down(heap, lasth);
@@ -224,7 +292,7 @@ static inline int __internal_bheap_delete(bheap_t *heap, bheaph_t *holder)
 	({                                              \
 		bheap_t *_bheap = &(heap)->bheap;	\
 		BHEAP_CHECK(_bheap);			\
-		__internal_bheap_get(_bheap, holder);	\
+		__internal_bheap_get(_bheap);		\
 	})
 
 static inline bheaph_t *__internal_bheap_get(bheap_t *heap)
@@ -239,4 +307,69 @@ static inline bheaph_t *__internal_bheap_get(bheap_t *heap)
 	return holder;
 }
 
+/*
+ * Change the key of a queued element in place, e.g. when reloading a
+ * periodic timer. This is cheaper than removing then inserting the
+ * element anew, since only one sifting pass is needed.
+ */
+#define bheap_rekey(heap, holder, key)				\
+	({							\
+		bheap_t *_bheap = &(heap)->bheap;		\
+		BHEAP_CHECK(_bheap);				\
+		__internal_bheap_rekey(_bheap, holder, key);	\
+	})
+
+static inline int __internal_bheap_rekey(bheap_t *heap,
+					 bheaph_t *holder, bheap_key_t key)
+{
+	bheap_key_t oldkey;
+
+	if (unlikely(!bheaph_valid(heap, holder)))
+		return EINVAL;
+
+	oldkey = bheaph_key(holder);
+	bheaph_key(holder) = key;
+	if ((long long)(key - oldkey) < 0)
+		bheap_up(heap, holder);
+	else
+		bheap_down(heap, holder);
+
+	return 0;
+}
+
+/*
+ * Remove all elements which keys are lower or equal to @a date, up to
+ * @a max of them, storing them by increasing key order into @a out.
+ * Returns the number of elements removed.
+ */
+#define bheap_pop_due(heap, date, out, max)				\
+	({								\
+		bheap_t *_bheap = &(heap)->bheap;			\
+		BHEAP_CHECK(_bheap);					\
+		__internal_bheap_pop_due(_bheap, date, out, max);	\
+	})
+
+static inline unsigned __internal_bheap_pop_due(bheap_t *heap,
+						bheap_key_t date,
+						bheaph_t **out, unsigned max)
+{
+	bheaph_t *holder, *lasth;
+	unsigned n = 0;
+
+	while (n < max && heap->last > 0) {
+		holder = heap->elems[0];
+		if ((long long)(bheaph_key(holder) - date) > 0)
+			break;
+		out[n++] = holder;
+		/* Pop the head: move the last element up there, sift it down. */
+		if (--heap->last > 0) {
+			lasth = heap->elems[heap->last];
+			bheaph_pos(lasth) = 0;
+			bheap_down(heap, lasth);
+		}
+	}
+
+	return n;
+}
+
 #endif /* _XENO_NUCLEUS_BHEAP_H */
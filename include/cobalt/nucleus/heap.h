@@ -63,6 +63,25 @@
 
 #define XNHEAP_GFP_NONCACHED (1 << __GFP_BITS_SHIFT)
 
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+
+/*
+ * Per-CPU caches of free blocks, for the bucketed sizes from
+ * XNHEAP_MINALLOCSZ up to 2 ** (XNHEAP_MINLOG2 + XNHEAP_MAG_NBUCKETS - 1).
+ */
+#define XNHEAP_MAG_NBUCKETS	8
+#define XNHEAP_MAG_SIZE		CONFIG_XENO_OPT_HEAP_MAGAZINE_SIZE
+#define XNHEAP_MAG_BATCH	(XNHEAP_MAG_SIZE / 2)
+
+struct xnheap_magazine {
+	struct {
+		caddr_t freelist;
+		int fcount;
+	} buckets[XNHEAP_MAG_NBUCKETS];
+} ____cacheline_aligned_in_smp;
+
+#endif /* CONFIG_XENO_OPT_HEAP_MAGAZINES */
+
 struct xnpagemap {
 	unsigned int type : 8;	  /* PFREE, PCONT, PLIST or log2 */
 	unsigned int bcount : 24; /* Number of active blocks. */
@@ -107,6 +126,10 @@ typedef struct xnheap {
 
 	xnholder_t *idleq[XNARCH_NR_CPUS];
 
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+	struct xnheap_magazine *magazines; /* Per-CPU, NULL if disabled. */
+#endif
+
 	xnarch_heapcb_t archdep;
 
 	XNARCH_DECL_DISPLAY_CONTEXT();
@@ -272,6 +295,10 @@ static inline void xnheap_finalize_free(xnheap_t *heap)
 int xnheap_check_block(xnheap_t *heap,
 		       void *block);
 
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+int xnheap_enable_magazines(xnheap_t *heap);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
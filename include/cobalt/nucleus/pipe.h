@@ -29,6 +29,7 @@
 #define XNPIPEIOC_OFLUSH	_IO(XNPIPE_IOCTL_BASE,2)
 #define XNPIPEIOC_FLUSH		XNPIPEIOC_OFLUSH
 #define XNPIPEIOC_SETSIG	_IO(XNPIPE_IOCTL_BASE,3)
+#define XNPIPEIOC_SETRING	_IO(XNPIPE_IOCTL_BASE,4)
 
 #define XNPIPE_NORMAL  0x0
 #define XNPIPE_URGENT  0x1
@@ -38,6 +39,54 @@
 
 #define XNPIPE_MINOR_AUTO  -1
 
+/*
+ * Mapped output ring. Once XNPIPEIOC_SETRING has been issued on a
+ * minor, messages sent from the Xenomai side are copied to a ring
+ * the reader maps with mmap(), instead of being queued for read().
+ *
+ * The RT side appends records at @head, the reader consumes them
+ * from @tail; both are free-running byte offsets into the data area
+ * which follows the ring header, wrapped by masking with size - 1.
+ * Each record starts with a struct xnpipe_rec header, and spans
+ * xnpipe_rec_span(rec->size) bytes. Records never wrap; padding
+ * records flagged XNPIPE_REC_PAD fill the end of the data area when
+ * needed, and must be skipped. The reader issues a read barrier
+ * after loading @head, and a full barrier before storing @tail.
+ *
+ * Records are copied with interrupts off, so their payload may not
+ * exceed XNPIPE_REC_MAXSZ bytes; larger messages are rejected with
+ * -EMSGSIZE, whatever the ring size.
+ */
+struct xnpipe_ring {
+	volatile unsigned int head;	/* Producer offset (RT side) */
+	volatile unsigned int tail;	/* Consumer offset (reader) */
+	unsigned int size;		/* Size of the data area, power of two */
+	unsigned int dropped;		/* Records dropped on overflow */
+};
+
+struct xnpipe_rec {
+	unsigned int size;		/* Payload size */
+	unsigned int flags;
+};
+
+#define XNPIPE_REC_PAD    0x1
+
+#define XNPIPE_REC_ALIGN  8
+
+#define XNPIPE_REC_MAXSZ  4096
+
+#define xnpipe_rec_span(size)						\
+	(sizeof(struct xnpipe_rec) +					\
+	 (((size) + XNPIPE_REC_ALIGN - 1) & ~(XNPIPE_REC_ALIGN - 1)))
+
+#define xnpipe_ring_data(ring)	((char *)((ring) + 1))
+
+#define xnpipe_ring_rec(ring, off)					\
+	((struct xnpipe_rec *)(xnpipe_ring_data(ring) +			\
+			       ((off) & ((ring)->size - 1))))
+
+#define xnpipe_rec_data(rec)	((char *)((rec) + 1))
+
 #ifdef __KERNEL__
 
 #include <nucleus/queue.h>
@@ -93,6 +142,11 @@ struct xnpipe_state {
 
 	struct xnqueue inq;		/* From user-space to kernel */
 	struct xnqueue outq;		/* From kernel to user-space */
+	struct xnqueue relq;		/* Sent to the ring, pending release */
+	struct xnholder rlink;		/* Link on release queue */
+	struct xnpipe_ring *ring;	/* Mapped output ring, if any */
+	unsigned int rsize;		/* Private copy of the ring size */
+	unsigned int rhead;		/* Private copy of the ring head */
 	struct xnsynch synchbase;
 	struct xnpipe_operations ops;
 	void *xstate;		/* Extra state managed by caller */
@@ -73,6 +73,7 @@ struct xnpod {
 	xnqueue_t threadq;	/*!< All existing threads. */
 #ifdef CONFIG_XENO_OPT_VFILE
 	struct xnvfile_rev_tag threadlist_tag;
+	struct xnvfile_rmlog threadlist_rmlog;
 #endif
 	xnqueue_t tstartq,	/*!< Thread start hook queue. */
 	 tswitchq,		/*!< Thread switch hook queue. */
@@ -33,13 +33,43 @@
 #include <nucleus/synch.h>
 #include <nucleus/vfile.h>
 
+#include <asm/xenomai/atomic.h>
+
 struct xnpnode;
 
+/*
+ * Registry handles carry the slot index in their low bits, and a
+ * generation number bumped each time the slot is released above
+ * it. A stale handle therefore never resolves to the next object
+ * occupying the same slot. The spare bits are left alone.
+ */
+#define XNOBJECT_SLOT_BITS	16
+#define XNOBJECT_SLOT_MASK	((1 << XNOBJECT_SLOT_BITS) - 1)
+#define XNOBJECT_GEN_MASK	(~XN_HANDLE_SPARE_MASK & ~XNOBJECT_SLOT_MASK)
+
+#if CONFIG_XENO_OPT_REGISTRY_NRSLOTS > XNOBJECT_SLOT_MASK
+#error "CONFIG_XENO_OPT_REGISTRY_NRSLOTS is too large"
+#endif
+
+#define xnobject_slot(handle)	((handle) & XNOBJECT_SLOT_MASK)
+
+/*
+ * The safe lock word of a slot holds the generation of the current
+ * incarnation in the same bits as the handle does, and the lock
+ * count in the slot bits. Both being updated at once, a lock taken
+ * or dropped through a stale handle fails instead of hitting the
+ * count of the next incarnation.
+ */
+#define XNOBJECT_LOCK_MASK	XNOBJECT_SLOT_MASK
+#define xnobject_lock_count(lockw)	((lockw) & XNOBJECT_LOCK_MASK)
+#define xnobject_lock_gen(lockw)	((lockw) & XNOBJECT_GEN_MASK)
+
 typedef struct xnobject {
 	void *objaddr;
+	xnhandle_t handle;	  /* !< Handle of current/next incarnation. */
 	const char *key;	  /* !< Hash key. */
 	struct xnsynch safesynch; /* !< Safe synchronization object. */
-	u_long safelock;	  /* !< Safe lock count. */
+	xnarch_atomic_t safelock; /* !< Generation + safe lock count. */
 	u_long cstamp;		  /* !< Creation stamp. */
 #ifdef CONFIG_XENO_OPT_VFILE
 	struct xnpnode *pnode;	/* !< v-file information class. */
@@ -140,32 +170,61 @@ struct xnpnode_link {
 
 #endif /* !CONFIG_XENO_OPT_VFILE */
 
-extern struct xnobject *registry_obj_slots;
-
 /* Public interface. */
 
 extern struct xnobject *registry_obj_slots;
 
-static inline struct xnobject *xnregistry_validate(xnhandle_t handle)
+/*
+ * Lockless handle resolution. xnregistry_remove() bumps the slot
+ * generation before clearing objaddr, so reading objaddr between two
+ * matching reads of the slot handle guarantees that the address
+ * belongs to the incarnation @a handle refers to, at the time of the
+ * read. Keeping the object alive past that point is up to the
+ * caller, i.e. holding nklock or a reference from xnregistry_get().
+ */
+static inline void *__xnregistry_resolve(xnhandle_t handle,
+					 struct xnobject **objectp)
 {
 	struct xnobject *object;
+	unsigned int slot;
+	void *objaddr;
+
+	slot = xnobject_slot(handle);
+	if (unlikely(slot == 0 || slot >= CONFIG_XENO_OPT_REGISTRY_NRSLOTS))
+		return NULL;
+
+	object = &registry_obj_slots[slot];
+	if (object->handle != handle)
+		return NULL;
+
+	xnarch_read_memory_barrier();
+	objaddr = object->objaddr;
+	xnarch_read_memory_barrier();
 	/*
 	 * Careful: a removed object which is still in flight to be
 	 * unexported carries a NULL objaddr, so we have to check this
 	 * as well.
 	 */
-	if (likely(handle && handle < CONFIG_XENO_OPT_REGISTRY_NRSLOTS)) {
-		object = &registry_obj_slots[handle];
-		return object->objaddr ? object : NULL;
-	}
+	if (objaddr == NULL || object->handle != handle)
+		return NULL;
 
-	return NULL;
+	*objectp = object;
+
+	return objaddr;
+}
+
+static inline struct xnobject *xnregistry_validate(xnhandle_t handle)
+{
+	struct xnobject *object;
+
+	return __xnregistry_resolve(handle, &object) ? object : NULL;
 }
 
 static inline void *xnregistry_lookup(xnhandle_t handle)
 {
-	struct xnobject *object = xnregistry_validate(handle);
-	return object ? object->objaddr : NULL;
+	struct xnobject *object;
+
+	return __xnregistry_resolve(handle, &object);
 }
 
 int xnregistry_enter(const char *key,
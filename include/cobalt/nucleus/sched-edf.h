@@ -0,0 +1,60 @@
+/*!\file sched-edf.h
+ * \brief Definitions for the earliest-deadline-first scheduling class.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _XENO_NUCLEUS_SCHED_EDF_H
+#define _XENO_NUCLEUS_SCHED_EDF_H
+
+#ifndef _XENO_NUCLEUS_SCHED_H
+#error "please don't include nucleus/sched-edf.h directly"
+#endif
+
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+
+extern struct xnsched_class xnsched_class_edf;
+
+struct xnsched_edf_data {
+	xnticks_t deadline;		/* !< Absolute deadline of current job (ns) */
+	xnticks_t budget;		/* !< CBS budget per period (ns), 0 if none */
+	xnticks_t run_budget;		/* !< CBS budget left for current job */
+	unsigned long overruns;		/* !< Deadline miss count */
+	unsigned long postponed;	/* !< CBS deadline postponement count */
+	struct xnthread *thread;
+};
+
+struct xnsched_edf {
+	DECLARE_BHEAP_CONTAINER(runnable, CONFIG_XENO_OPT_SCHED_EDF_CAPACITY);
+	struct xnsched_edf_data *curr;	/* !< Thread charged for CBS budget */
+	xnticks_t run_start;		/* !< Start of current charge */
+	struct xntimer budget_timer;	/* !< CBS budget exhaustion timer */
+};
+
+static inline int xnsched_edf_init_tcb(struct xnthread *thread)
+{
+	thread->edf = NULL;
+
+	return 0;
+}
+
+void xnsched_edf_release(struct xnthread *thread);
+
+void xnsched_edf_switch(struct xnsched *sched, struct xnthread *next);
+
+#endif /* !CONFIG_XENO_OPT_SCHED_EDF */
+
+#endif /* !_XENO_NUCLEUS_SCHED_EDF_H */
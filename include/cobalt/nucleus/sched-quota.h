@@ -0,0 +1,69 @@
+/*!\file sched-quota.h
+ * \brief Definitions for the quota scheduling class.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _XENO_NUCLEUS_SCHED_QUOTA_H
+#define _XENO_NUCLEUS_SCHED_QUOTA_H
+
+#ifndef _XENO_NUCLEUS_SCHED_H
+#error "please don't include nucleus/sched-quota.h directly"
+#endif
+
+#ifdef CONFIG_XENO_OPT_SCHED_QUOTA
+
+extern struct xnsched_class xnsched_class_quota;
+
+struct xnsched_quota_group {
+	struct xnsched *sched;
+	int tgid;			/* !< Group identifier */
+	xnticks_t budget;		/* !< Run time per period (ns) */
+	xnticks_t period;		/* !< Replenishment period (ns) */
+	xnticks_t run_budget;		/* !< Run time left in period */
+	unsigned long throttled;	/* !< Budget exhaustion count */
+	struct xntimer refill_timer;	/* !< Replenishment timer */
+	xnsched_queue_t expired;	/* !< Throttled threads */
+	struct xnqueue members;		/* !< Threads in the group */
+	struct xnholder next;		/* !< Link in group queue */
+};
+
+struct xnsched_quota {
+	xnsched_queue_t runnable;	/* !< Runnable thread queue. */
+	struct xnqueue groups;		/* !< Groups defined on this CPU */
+	struct xnsched_quota_group *curr_group; /* !< Charged group */
+	xnticks_t run_start;		/* !< Start of current charge */
+	struct xntimer limit_timer;	/* !< Budget exhaustion timer */
+};
+
+static inline int xnsched_quota_init_tcb(struct xnthread *thread)
+{
+	inith(&thread->quota_link);
+	thread->quota = NULL;
+
+	return 0;
+}
+
+int xnsched_quota_set_group(struct xnsched *sched, int tgid,
+			    xnticks_t budget, xnticks_t period);
+
+int xnsched_quota_destroy_group(struct xnsched *sched, int tgid);
+
+void xnsched_quota_switch(struct xnsched *sched, struct xnthread *next);
+
+#endif /* !CONFIG_XENO_OPT_SCHED_QUOTA */
+
+#endif /* !_XENO_NUCLEUS_SCHED_QUOTA_H */
@@ -35,6 +35,8 @@
 #include <nucleus/schedqueue.h>
 #include <nucleus/sched-tp.h>
 #include <nucleus/sched-sporadic.h>
+#include <nucleus/sched-quota.h>
+#include <nucleus/sched-edf.h>
 #include <nucleus/vfile.h>
 
 /* Sched status flags */
@@ -64,6 +66,10 @@ typedef struct xnsched {
 	struct xnthread *curr;		/*!< Current thread. */
 #ifdef CONFIG_SMP
 	xnarch_cpumask_t resched;	/*!< Mask of CPUs needing rescheduling. */
+	xnarch_cpumask_t rshots;	/*!< Mask of CPUs pending a timer shot. */
+	int tbatch;			/*!< Timer shot batching depth. */
+	xnstat_counter_t rshot_reqs;	/*!< Remote shots requested to this CPU. */
+	xnstat_counter_t rshot_ipis;	/*!< Timer IPIs received by this CPU. */
 #endif
 
 	struct xnsched_rt rt;		/*!< Context of built-in real-time class. */
@@ -73,8 +79,15 @@ typedef struct xnsched {
 #ifdef CONFIG_XENO_OPT_SCHED_SPORADIC
 	struct xnsched_sporadic pss;	/*!< Context of sporadic scheduling class. */
 #endif
+#ifdef CONFIG_XENO_OPT_SCHED_QUOTA
+	struct xnsched_quota quota;	/*!< Context of quota scheduling class. */
+#endif
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	struct xnsched_edf edf;		/*!< Context of EDF scheduling class. */
+#endif
 
 	xntimerq_t timerqueue;		/* !< Core timer queue. */
+	xnstat_counter_t tslack_saved;	/* !< Shots saved by timer slack. */
 	volatile unsigned inesting;	/*!< Interrupt nesting level. */
 	struct xntimer htimer;		/*!< Host timer. */
 	struct xnthread *zombie;
@@ -316,6 +329,16 @@ static inline int xnsched_init_tcb(struct xnthread *thread)
 	if (ret)
 		return ret;
 #endif /* CONFIG_XENO_OPT_SCHED_SPORADIC */
+#ifdef CONFIG_XENO_OPT_SCHED_QUOTA
+	ret = xnsched_quota_init_tcb(thread);
+	if (ret)
+		return ret;
+#endif /* CONFIG_XENO_OPT_SCHED_QUOTA */
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	ret = xnsched_edf_init_tcb(thread);
+	if (ret)
+		return ret;
+#endif /* CONFIG_XENO_OPT_SCHED_EDF */
 	return ret;
 }
 
@@ -42,6 +42,17 @@ struct xnsched_sporadic_param {
 	int current_prio;
 };
 
+struct xnsched_quota_param {
+	int prio;
+	int tgid;	/* thread group id. */
+};
+
+struct xnsched_edf_param {
+	int prio;
+	xnticks_t budget;	/* CBS budget (ns), 0 if none. */
+	xnticks_t deadline;	/* absolute deadline, output only. */
+};
+
 union xnsched_policy_param {
 	struct xnsched_idle_param idle;
 	struct xnsched_rt_param rt;
@@ -51,6 +62,12 @@ union xnsched_policy_param {
 #ifdef CONFIG_XENO_OPT_SCHED_SPORADIC
 	struct xnsched_sporadic_param pss;
 #endif
+#ifdef CONFIG_XENO_OPT_SCHED_QUOTA
+	struct xnsched_quota_param quota;
+#endif
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	struct xnsched_edf_param edf;
+#endif
 };
 
 #endif /* !_XENO_NUCLEUS_SCHEDPARAM_H */
@@ -154,6 +154,9 @@ typedef struct xnthread_info {
 #include <nucleus/timer.h>
 #include <nucleus/registry.h>
 #include <nucleus/schedparam.h>
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+#include <nucleus/bheap.h>
+#endif
 
 #ifdef __XENO_SIM__
 /* Pseudo-status (must not conflict with other bits) */
@@ -169,8 +172,11 @@ struct xnsched;
 struct xnselector;
 struct xnsched_class;
 struct xnsched_tpslot;
+struct xnsched_quota_group;
+struct xnsched_edf_data;
 union xnsched_policy_param;
 struct xnbufd;
+struct xnvdso_thread_stat;
 
 struct xnthread_operations {
 	int (*get_denormalized_prio)(struct xnthread *, int coreprio);
@@ -220,6 +226,14 @@ typedef struct xnthread {
 #ifdef CONFIG_XENO_OPT_SCHED_SPORADIC
 	struct xnsched_sporadic_data *pss; /* Sporadic scheduling data. */
 #endif
+#ifdef CONFIG_XENO_OPT_SCHED_QUOTA
+	struct xnsched_quota_group *quota; /* Quota scheduling group. */
+	struct xnholder quota_link;	/* Link in quota group member queue */
+#endif
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	struct xnsched_edf_data *edf;	/* EDF scheduling data. */
+	bheaph_t edf_link;		/* Thread holder in EDF runqueue */
+#endif
 
 	unsigned idtag;			/* Unique ID tag */
 
@@ -280,6 +294,7 @@ typedef struct xnthread {
 		xnstat_counter_t pf;	/* Number of page faults */
 		xnstat_exectime_t account; /* Execution time accounting entity */
 		xnstat_exectime_t lastperiod; /* Interval marker for execution time reports */
+		struct xnvdso_thread_stat *shm; /* Slot exported to user-space, if any */
 	} stat;
 
 #ifdef CONFIG_XENO_OPT_SELECT
@@ -364,6 +379,7 @@ typedef struct xnhook {
 #define xnthread_asr_level(thread)         ((thread)->asrlevel)
 #define xnthread_pending_signals(thread)  ((thread)->signals)
 #define xnthread_timeout(thread)           xntimer_get_timeout(&(thread)->rtimer)
+#define xnthread_set_slack(thread, ns)     xntimer_set_slack(&(thread)->rtimer, ns)
 #define xnthread_stack_size(thread)        xnarch_stack_size(xnthread_archtcb(thread))
 #define xnthread_stack_base(thread)        xnarch_stack_base(xnthread_archtcb(thread))
 #define xnthread_stack_end(thread)         xnarch_stack_end(xnthread_archtcb(thread))
@@ -0,0 +1,87 @@
+#ifndef _XENO_NUCLEUS_THREADSTAT_H
+#define _XENO_NUCLEUS_THREADSTAT_H
+
+/*!\file threadstat.h
+ * \brief Per-thread statistics exported through the global semaphore heap
+ *
+ * Xenomai is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#include <nucleus/types.h>
+#include <nucleus/seqlock.h>
+
+/* Slot is attached to a live thread. */
+#define XNSTAT_SHM_USED		0x1
+/* Thread is currently running, exectime excludes the current slice. */
+#define XNSTAT_SHM_RUNNING	0x2
+
+/*
+ * Snapshot of the runtime statistics of a thread, updated by the
+ * nucleus on each context switch. Readers shall retry whenever the
+ * sequence count changed while they were copying the slot.
+ */
+struct xnvdso_thread_stat {
+	xnseqcount_t seqcount;
+	unsigned int flags;
+	int cpu;
+	int pid;
+	unsigned long state;	/* Thread state flags */
+	unsigned long ssw;	/* Primary -> secondary mode switches */
+	unsigned long csw;	/* Context switches */
+	unsigned long pf;	/* Page faults */
+	unsigned long long exectime;	/* Accumulated exec time (TSC) */
+	unsigned long long lastswitch;	/* Last switch date (TSC) */
+	char name[XNOBJECT_NAME_LEN];
+};
+
+/* Descriptor of the slot table, part of struct xnvdso. */
+struct xnvdso_thread_stats {
+	/* Offset of the slot table in the global sem heap. */
+	unsigned long offset;
+	/* Number of slots in the table. */
+	unsigned int nr;
+};
+
+#if defined(__KERNEL__) || defined(__XENO_SIM__)
+
+#if defined(CONFIG_XENO_OPT_STATS_SHM) && CONFIG_XENO_OPT_STATS_SHM > 0 \
+	&& !defined(__XENO_SIM__)
+
+#define XNSTAT_SHM_NR		CONFIG_XENO_OPT_STATS_SHM
+
+/* Extra room reserved in the global sem heap for the slot table. */
+#define XNSTAT_SHM_HEAPSZ \
+	(XNSTAT_SHM_NR * sizeof(struct xnvdso_thread_stat) + PAGE_SIZE)
+
+struct xnthread;
+
+void xnstat_shm_attach(struct xnthread *thread);
+
+void xnstat_shm_detach(struct xnthread *thread);
+
+#else /* !CONFIG_XENO_OPT_STATS_SHM */
+
+#define XNSTAT_SHM_NR		0
+#define XNSTAT_SHM_HEAPSZ	0
+
+#define xnstat_shm_attach(thread)	do { (void)(thread); } while (0)
+#define xnstat_shm_detach(thread)	do { (void)(thread); } while (0)
+
+#endif /* !CONFIG_XENO_OPT_STATS_SHM */
+
+#endif /* __KERNEL__ || __XENO_SIM__ */
+
+#endif /* !_XENO_NUCLEUS_THREADSTAT_H */
@@ -45,7 +45,7 @@ typedef struct xntbops {
 	xnticks_t (*get_timer_timeout)(struct xntimer *timer);
 	xnticks_t (*get_timer_interval)(struct xntimer *timer);
 	xnticks_t (*get_timer_raw_expiry)(struct xntimer *timer);
-	void (*move_timer)(struct xntimer *timer);
+	int (*move_timer)(struct xntimer *timer);
 
 } xntbops_t;
 
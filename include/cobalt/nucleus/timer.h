@@ -28,13 +28,12 @@
 
 #if defined(__KERNEL__) || defined(__XENO_SIM__)
 
+#include <nucleus/timerq.h>
+
 #ifndef CONFIG_XENO_OPT_DEBUG_TIMERS
 #define CONFIG_XENO_OPT_DEBUG_TIMERS  0
 #endif
 
-#define XNTIMER_WHEELSIZE 64
-#define XNTIMER_WHEELMASK (XNTIMER_WHEELSIZE - 1)
-
 /* Timer status */
 #define XNTIMER_DEQUEUED  0x00000001
 #define XNTIMER_KILLED    0x00000002
@@ -42,6 +41,8 @@
 #define XNTIMER_REALTIME  0x00000008
 #define XNTIMER_FIRED     0x00000010
 #define XNTIMER_NOBLCK	  0x00000020
+#define XNTIMER_COALESCED 0x00000040
+#define XNTIMER_EXPIRING  0x00000080
 
 /* These flags are available to the real-time interfaces */
 #define XNTIMER_SPARE0  0x01000000
@@ -60,214 +61,6 @@
 
 #define XNTIMER_KEEPER_ID 0
 
-typedef struct {
-	xnholder_t link;
-	xnticks_t key;
-	int prio;
-
-#define link2tlholder(ln)	container_of(ln, xntlholder_t, link)
-
-} xntlholder_t;
-
-#define xntlholder_date(h)	((h)->key)
-#define xntlholder_prio(h)	((h)->prio)
-#define xntlholder_init(h)	inith(&(h)->link)
-#define xntlist_init(q)	initq(q)
-#define xntlist_head(q)			\
-	({ xnholder_t *_h = getheadq(q);	\
-		!_h ? NULL : link2tlholder(_h);	\
-	})
-
-#define xntlist_next(q, h) \
-	({ xnholder_t *_h = nextq(q, &(h)->link);	\
-		!_h ? NULL : link2tlholder(_h);		\
-	})
-
-static inline void xntlist_insert(xnqueue_t *q, xntlholder_t *holder)
-{
-	xnholder_t *p;
-
-	/* Insert the new timer at the proper place in the single
-	   queue managed when running in aperiodic mode. O(N) here,
-	   but users of the aperiodic mode need to pay a price for the
-	   increased flexibility... */
-
-	for (p = q->head.last; p != &q->head; p = p->last)
-		if ((xnsticks_t) (holder->key - link2tlholder(p)->key) > 0 ||
-		    (holder->key == link2tlholder(p)->key &&
-		     holder->prio <= link2tlholder(p)->prio))
-			break;
-
-	insertq(q,p->next,&holder->link);
-}
-
-#define xntlist_remove(q, h)  removeq((q),&(h)->link)
-
-#if defined(CONFIG_XENO_OPT_TIMER_HEAP)
-
-#include <nucleus/bheap.h>
-
-typedef bheaph_t xntimerh_t;
-
-#define xntimerh_date(h)          bheaph_key(h)
-#define xntimerh_prio(h)          bheaph_prio(h)
-#define xntimerh_init(h)          bheaph_init(h)
-
-typedef DECLARE_BHEAP_CONTAINER(xntimerq_t, CONFIG_XENO_OPT_TIMER_HEAP_CAPACITY);
-
-#define xntimerq_init(q)          bheap_init((q), CONFIG_XENO_OPT_TIMER_HEAP_CAPACITY)
-#define xntimerq_destroy(q)       bheap_destroy(q)
-#define xntimerq_head(q)          bheap_gethead(q)
-#define xntimerq_insert(q, h)     bheap_insert((q),(h))
-#define xntimerq_remove(q, h)     bheap_delete((q),(h))
-
-typedef struct {} xntimerq_it_t;
-
-#define xntimerq_it_begin(q, i)   ((void) (i), bheap_gethead(q))
-#define xntimerq_it_next(q, i, h) ((void) (i), bheap_next((q),(h)))
-
-#elif defined(CONFIG_XENO_OPT_TIMER_WHEEL)
-
-typedef xntlholder_t xntimerh_t;
-
-#define xntimerh_date(h)       xntlholder_date(h)
-#define xntimerh_prio(h)       xntlholder_prio(h)
-#define xntimerh_init(h)       xntlholder_init(h)
-
-typedef struct xntimerq {
-	unsigned date_shift;
-	unsigned long long next_shot;
-	unsigned long long shot_wrap;
-	xnqueue_t bucket[XNTIMER_WHEELSIZE];
-} xntimerq_t;
-
-typedef struct xntimerq_it {
-	unsigned bucket;
-} xntimerq_it_t;
-
-static inline void xntimerq_init(xntimerq_t *q)
-{
-	unsigned long long step_tsc;
-	unsigned i;
-
-	step_tsc = xnarch_ns_to_tsc(CONFIG_XENO_OPT_TIMER_WHEEL_STEP);
-	/* q->date_shift = fls(step_tsc); */
-	for (q->date_shift = 0; (1 << q->date_shift) < step_tsc; q->date_shift++)
-		;
-	q->next_shot = q->shot_wrap = ((~0ULL) >> q->date_shift) + 1;
-	for (i = 0; i < sizeof(q->bucket)/sizeof(xnqueue_t); i++)
-		xntlist_init(&q->bucket[i]);
-}
-
-#define xntimerq_destroy(q)    do { } while (0)
-
-static inline xntlholder_t *xntimerq_head(xntimerq_t *q)
-{
-	unsigned bucket = ((unsigned) q->next_shot) & XNTIMER_WHEELMASK;
-	xntlholder_t *result;
-	unsigned i;
-
-	if (q->next_shot == q->shot_wrap)
-		return NULL;
-
-	result = xntlist_head(&q->bucket[bucket]);
-
-	if (result && (xntlholder_date(result) >> q->date_shift) == q->next_shot)
-		return result;
-
-	/* We could not find the next timer in the first bucket, iterate over
-	   the other buckets. */
-	for (i = (bucket + 1) & XNTIMER_WHEELMASK ;
-	     i != bucket; i = (i + 1) & XNTIMER_WHEELMASK) {
-		xntlholder_t *candidate = xntlist_head(&q->bucket[i]);
-
-		if(++q->next_shot == q->shot_wrap)
-			q->next_shot = 0;
-
-		if (!candidate)
-			continue;
-
-		if ((xntlholder_date(candidate) >> q->date_shift) == q->next_shot)
-			return candidate;
-
-		if (!result || (xnsticks_t) (xntlholder_date(candidate)
-					     - xntlholder_date(result)) < 0)
-			result = candidate;
-	}
-
-	if (result)
-		q->next_shot = (xntlholder_date(result) >> q->date_shift);
-	else
-		q->next_shot = q->shot_wrap;
-	return result;
-}
-
-static inline void xntimerq_insert(xntimerq_t *q, xntimerh_t *h)
-{
-	unsigned long long shifted_date = xntlholder_date(h) >> q->date_shift;
-	unsigned bucket = ((unsigned) shifted_date) & XNTIMER_WHEELMASK;
-
-	if ((long long) (shifted_date - q->next_shot) < 0)
-		q->next_shot = shifted_date;
-	xntlist_insert(&q->bucket[bucket], h);
-}
-
-static inline void xntimerq_remove(xntimerq_t *q, xntimerh_t *h)
-{
-	unsigned long long shifted_date = xntlholder_date(h) >> q->date_shift;
-	unsigned bucket = ((unsigned) shifted_date) & XNTIMER_WHEELMASK;
-
-	xntlist_remove(&q->bucket[bucket], h);
-	/* Do not attempt to update q->next_shot, xntimerq_head will recover. */
-}
-
-static inline xntimerh_t *xntimerq_it_begin(xntimerq_t *q, xntimerq_it_t *it)
-{
-	xntimerh_t *holder = NULL;
-
-	for (it->bucket = 0; it->bucket < XNTIMER_WHEELSIZE; it->bucket++)
-		if ((holder = xntlist_head(&q->bucket[it->bucket])))
-			break;
-
-	return holder;
-}
-
-static inline xntimerh_t *
-xntimerq_it_next(xntimerq_t *q, xntimerq_it_t *it, xntimerh_t *holder)
-{
-	xntimerh_t *next = xntlist_next(&q->bucket[it->bucket], holder);
-
-	if (!next)
-		for(it->bucket++; it->bucket < XNTIMER_WHEELSIZE; it->bucket++)
-			if ((next = xntlist_head(&q->bucket[it->bucket])))
-				break;
-
-	return next;
-}
-
-#else /* CONFIG_XENO_OPT_TIMER_LIST */
-
-typedef xntlholder_t xntimerh_t;
-
-#define xntimerh_date(h)        xntlholder_date(h)
-#define xntimerh_prio(h)        xntlholder_prio(h)
-#define xntimerh_init(h)        xntlholder_init(h)
-
-typedef xnqueue_t xntimerq_t;
-
-#define xntimerq_init(q)        xntlist_init(q)
-#define xntimerq_destroy(q)     do { } while (0)
-#define xntimerq_head(q)        xntlist_head(q)
-#define xntimerq_insert(q,h)    xntlist_insert((q),(h))
-#define xntimerq_remove(q, h)   xntlist_remove((q),(h))
-
-typedef struct {} xntimerq_it_t;
-
-#define xntimerq_it_begin(q,i)  ((void) (i), xntlist_head(q))
-#define xntimerq_it_next(q,i,h) ((void) (i), xntlist_next((q),(h)))
-
-#endif /* CONFIG_XENO_OPT_TIMER_LIST */
-
 struct xnsched;
 
 typedef struct xntimer {
@@ -294,6 +87,10 @@ typedef struct xntimer {
 
 	xnticks_t pexpect;	/* !< Date of next periodic release point (raw ticks). */
 
+	xnticks_t slack;	/* !< Tolerated expiry delay (raw ticks). */
+
+	xnticks_t slack_mask;	/* !< Expiry rounding mask (raw ticks). */
+
 	struct xnsched *sched;	/* !< Sched structure to which the timer is
 				   attached. */
 
@@ -382,24 +179,30 @@ extern xntbops_t nktimer_ops_aperiodic,
 		 nktimer_ops_periodic;
 
 #ifdef CONFIG_XENO_OPT_STATS
-#define xntimer_init(timer, base, handler)		\
-	do {						\
-		__xntimer_init(timer, base, handler);	\
-		(timer)->handler_name = #handler;	\
-	} while (0)
+#define xntimer_init(timer, base, handler)				\
+	({								\
+		int __iret = __xntimer_init(timer, base, handler);	\
+		(timer)->handler_name = #handler;			\
+		__iret;							\
+	})
 #else /* !CONFIG_XENO_OPT_STATS */
 #define xntimer_init	__xntimer_init
 #endif /* !CONFIG_XENO_OPT_STATS */
 
-#define xntimer_init_noblock(timer, base, handler)	\
-	do {						\
-		xntimer_init(timer, base, handler);	\
-		(timer)->status |= XNTIMER_NOBLCK;	\
-	} while(0)
+#define xntimer_init_noblock(timer, base, handler)			\
+	({								\
+		int __ret = xntimer_init(timer, base, handler);		\
+		(timer)->status |= XNTIMER_NOBLCK;			\
+		__ret;							\
+	})
+
+void xntimer_set_slack(struct xntimer *timer, xnticks_t ns);
 
-void __xntimer_init(struct xntimer *timer,
-		    struct xntbase *base,
-		    void (*handler)(struct xntimer *timer));
+int __xntimer_init(struct xntimer *timer,
+		   struct xntbase *base,
+		   void (*handler)(struct xntimer *timer));
+
+int xntimer_reserve_queues(void);
 
 void xntimer_destroy(xntimer_t *timer);
 
@@ -450,6 +253,9 @@ void xntimer_next_local_shot(struct xnsched *sched);
  * @return 0 is returned upon success, or -ETIMEDOUT if an absolute
  * date in the past has been given.
  *
+ * Queuing the timer never allocates memory, since room for it was
+ * reserved by xntimer_init().
+ *
  * Environments:
  *
  * This service can be called from:
@@ -640,7 +446,7 @@ static inline xnticks_t xntimer_get_raw_expiry (xntimer_t *timer)
 	return timer->base->ops->get_timer_raw_expiry(timer);
 }
 
-void xntslave_init(xntslave_t *slave);
+int xntslave_init(xntslave_t *slave);
 
 void xntslave_destroy(xntslave_t *slave);
 
@@ -739,8 +545,18 @@ void xntimer_adjust_all_aperiodic(xnsticks_t delta);
 #ifdef CONFIG_SMP
 int xntimer_migrate(xntimer_t *timer,
 		    struct xnsched *sched);
+
+int xntimer_migrate_batch(xntimer_t **timers, int nr,
+			  struct xnsched *sched);
+
+void xntimer_batch_begin(void);
+
+void xntimer_batch_end(void);
 #else /* ! CONFIG_SMP */
 #define xntimer_migrate(timer, sched)		do { } while(0)
+#define xntimer_migrate_batch(timers, nr, sched) do { } while(0)
+#define xntimer_batch_begin()			do { } while(0)
+#define xntimer_batch_end()			do { } while(0)
 #endif /* CONFIG_SMP */
 
 #define xntimer_set_sched(timer, sched)	xntimer_migrate(timer, sched)
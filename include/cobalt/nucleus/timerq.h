@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2001,2002,2003 Philippe Gerum <rpm@xenomai.org>.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ */
+
+#ifndef _XENO_NUCLEUS_TIMERQ_H
+#define _XENO_NUCLEUS_TIMERQ_H
+
+/*
+ * Timer queues, in the flavour selected by the
+ * CONFIG_XENO_OPT_TIMER_{HEAP,WHEEL,LIST} options. This code only
+ * depends on the generic queue and heap support, so that it may be
+ * exercised from user-space as well (see
+ * testsuite/unit/timerq-torture).
+ */
+#include <nucleus/queue.h>
+
+#define XNTIMER_WHEELSIZE 64
+#define XNTIMER_WHEELMASK (XNTIMER_WHEELSIZE - 1)
+
+typedef struct {
+	xnholder_t link;
+	xnticks_t key;
+	int prio;
+
+#define link2tlholder(ln)	container_of(ln, xntlholder_t, link)
+
+} xntlholder_t;
+
+#define xntlholder_date(h)	((h)->key)
+#define xntlholder_prio(h)	((h)->prio)
+#define xntlholder_init(h)	inith(&(h)->link)
+#define xntlist_init(q)	initq(q)
+#define xntlist_head(q)			\
+	({ xnholder_t *_h = getheadq(q);	\
+		!_h ? NULL : link2tlholder(_h);	\
+	})
+
+#define xntlist_next(q, h) \
+	({ xnholder_t *_h = nextq(q, &(h)->link);	\
+		!_h ? NULL : link2tlholder(_h);		\
+	})
+
+static inline void xntlist_insert(xnqueue_t *q, xntlholder_t *holder)
+{
+	xnholder_t *p;
+
+	/* Insert the new timer at the proper place in the single
+	   queue managed when running in aperiodic mode. O(N) here,
+	   but users of the aperiodic mode need to pay a price for the
+	   increased flexibility... */
+
+	for (p = q->head.last; p != &q->head; p = p->last)
+		if ((xnsticks_t) (holder->key - link2tlholder(p)->key) > 0 ||
+		    (holder->key == link2tlholder(p)->key &&
+		     holder->prio <= link2tlholder(p)->prio))
+			break;
+
+	insertq(q,p->next,&holder->link);
+}
+
+#define xntlist_remove(q, h)  removeq((q),&(h)->link)
+
+#if defined(CONFIG_XENO_OPT_TIMER_HEAP)
+
+#include <nucleus/bheap.h>
+
+typedef bheaph_t xntimerh_t;
+
+#define xntimerh_date(h)          bheaph_key(h)
+#define xntimerh_prio(h)          bheaph_prio(h)
+#define xntimerh_init(h)          bheaph_init(h)
+
+typedef DECLARE_BHEAP_CONTAINER(xntimerq_t, CONFIG_XENO_OPT_TIMER_HEAP_CAPACITY);
+
+#define xntimerq_init(q)          bheap_init((q), CONFIG_XENO_OPT_TIMER_HEAP_CAPACITY)
+#define xntimerq_destroy(q)       bheap_destroy(q)
+#define xntimerq_head(q)          bheap_gethead(q)
+#define xntimerq_insert(q, h)     bheap_insert((q),(h))
+#define xntimerq_remove(q, h)     bheap_delete((q),(h))
+#define xntimerq_rekey(q, h, d)   bheap_rekey((q),(h),(d))
+#define xntimerq_reserve(q, nr)   bheap_reserve((q),(nr))
+#define xntimerq_pop_due(q, d, out, max) \
+	bheap_pop_due((q),(d),(out),(max))
+
+typedef struct {} xntimerq_it_t;
+
+#define xntimerq_it_begin(q, i)   ((void) (i), bheap_gethead(q))
+#define xntimerq_it_next(q, i, h) ((void) (i), bheap_next((q),(h)))
+
+#elif defined(CONFIG_XENO_OPT_TIMER_WHEEL)
+
+typedef xntlholder_t xntimerh_t;
+
+#define xntimerh_date(h)       xntlholder_date(h)
+#define xntimerh_prio(h)       xntlholder_prio(h)
+#define xntimerh_init(h)       xntlholder_init(h)
+
+typedef struct xntimerq {
+	unsigned date_shift;
+	unsigned long long next_shot;
+	unsigned long long shot_wrap;
+	xnqueue_t bucket[XNTIMER_WHEELSIZE];
+} xntimerq_t;
+
+typedef struct xntimerq_it {
+	unsigned bucket;
+} xntimerq_it_t;
+
+static inline void xntimerq_init(xntimerq_t *q)
+{
+	unsigned long long step_tsc;
+	unsigned i;
+
+	step_tsc = xnarch_ns_to_tsc(CONFIG_XENO_OPT_TIMER_WHEEL_STEP);
+	/* q->date_shift = fls(step_tsc); */
+	for (q->date_shift = 0; (1 << q->date_shift) < step_tsc; q->date_shift++)
+		;
+	q->next_shot = q->shot_wrap = ((~0ULL) >> q->date_shift) + 1;
+	for (i = 0; i < sizeof(q->bucket)/sizeof(xnqueue_t); i++)
+		xntlist_init(&q->bucket[i]);
+}
+
+#define xntimerq_destroy(q)    do { } while (0)
+
+static inline xntlholder_t *xntimerq_head(xntimerq_t *q)
+{
+	unsigned bucket = ((unsigned) q->next_shot) & XNTIMER_WHEELMASK;
+	xntlholder_t *result;
+	unsigned i;
+
+	if (q->next_shot == q->shot_wrap)
+		return NULL;
+
+	result = xntlist_head(&q->bucket[bucket]);
+
+	if (result && (xntlholder_date(result) >> q->date_shift) == q->next_shot)
+		return result;
+
+	/* We could not find the next timer in the first bucket, iterate over
+	   the other buckets. */
+	for (i = (bucket + 1) & XNTIMER_WHEELMASK ;
+	     i != bucket; i = (i + 1) & XNTIMER_WHEELMASK) {
+		xntlholder_t *candidate = xntlist_head(&q->bucket[i]);
+
+		if(++q->next_shot == q->shot_wrap)
+			q->next_shot = 0;
+
+		if (!candidate)
+			continue;
+
+		if ((xntlholder_date(candidate) >> q->date_shift) == q->next_shot)
+			return candidate;
+
+		if (!result || (xnsticks_t) (xntlholder_date(candidate)
+					     - xntlholder_date(result)) < 0)
+			result = candidate;
+	}
+
+	if (result)
+		q->next_shot = (xntlholder_date(result) >> q->date_shift);
+	else
+		q->next_shot = q->shot_wrap;
+	return result;
+}
+
+static inline int xntimerq_insert(xntimerq_t *q, xntimerh_t *h)
+{
+	unsigned long long shifted_date = xntlholder_date(h) >> q->date_shift;
+	unsigned bucket = ((unsigned) shifted_date) & XNTIMER_WHEELMASK;
+
+	if ((long long) (shifted_date - q->next_shot) < 0)
+		q->next_shot = shifted_date;
+	xntlist_insert(&q->bucket[bucket], h);
+
+	return 0;
+}
+
+static inline void xntimerq_remove(xntimerq_t *q, xntimerh_t *h)
+{
+	unsigned long long shifted_date = xntlholder_date(h) >> q->date_shift;
+	unsigned bucket = ((unsigned) shifted_date) & XNTIMER_WHEELMASK;
+
+	xntlist_remove(&q->bucket[bucket], h);
+	/* Do not attempt to update q->next_shot, xntimerq_head will recover. */
+}
+
+static inline void xntimerq_rekey(xntimerq_t *q, xntimerh_t *h,
+				  xnticks_t date)
+{
+	xntimerq_remove(q, h);
+	xntlholder_date(h) = date;
+	xntimerq_insert(q, h);
+}
+
+#define xntimerq_reserve(q, nr)  ({ (void) (q); (void) (nr); 0; })
+
+static inline xntimerh_t *xntimerq_it_begin(xntimerq_t *q, xntimerq_it_t *it)
+{
+	xntimerh_t *holder = NULL;
+
+	for (it->bucket = 0; it->bucket < XNTIMER_WHEELSIZE; it->bucket++)
+		if ((holder = xntlist_head(&q->bucket[it->bucket])))
+			break;
+
+	return holder;
+}
+
+static inline xntimerh_t *
+xntimerq_it_next(xntimerq_t *q, xntimerq_it_t *it, xntimerh_t *holder)
+{
+	xntimerh_t *next = xntlist_next(&q->bucket[it->bucket], holder);
+
+	if (!next)
+		for(it->bucket++; it->bucket < XNTIMER_WHEELSIZE; it->bucket++)
+			if ((next = xntlist_head(&q->bucket[it->bucket])))
+				break;
+
+	return next;
+}
+
+#else /* CONFIG_XENO_OPT_TIMER_LIST */
+
+typedef xntlholder_t xntimerh_t;
+
+#define xntimerh_date(h)        xntlholder_date(h)
+#define xntimerh_prio(h)        xntlholder_prio(h)
+#define xntimerh_init(h)        xntlholder_init(h)
+
+typedef xnqueue_t xntimerq_t;
+
+#define xntimerq_init(q)        xntlist_init(q)
+#define xntimerq_destroy(q)     do { } while (0)
+#define xntimerq_head(q)        xntlist_head(q)
+#define xntimerq_insert(q,h)    ({ xntlist_insert((q),(h)); 0; })
+#define xntimerq_remove(q, h)   xntlist_remove((q),(h))
+
+static inline void xntimerq_rekey(xntimerq_t *q, xntimerh_t *h,
+				  xnticks_t date)
+{
+	xntlist_remove(q, h);
+	xntlholder_date(h) = date;
+	xntlist_insert(q, h);
+}
+
+#define xntimerq_reserve(q, nr)  ({ (void) (q); (void) (nr); 0; })
+
+typedef struct {} xntimerq_it_t;
+
+#define xntimerq_it_begin(q,i)  ((void) (i), xntlist_head(q))
+#define xntimerq_it_next(q,i,h) ((void) (i), xntlist_next((q),(h)))
+
+#endif /* CONFIG_XENO_OPT_TIMER_LIST */
+
+#ifndef CONFIG_XENO_OPT_TIMER_HEAP
+
+/*
+ * Remove all timers due at @a date or earlier, up to @a max of them,
+ * storing them by increasing date order into @a out. Returns the
+ * number of timers removed.
+ */
+static inline unsigned xntimerq_pop_due(xntimerq_t *q, xnticks_t date,
+					xntimerh_t **out, unsigned max)
+{
+	xntimerh_t *holder;
+	unsigned n = 0;
+
+	while (n < max && (holder = xntimerq_head(q)) != NULL) {
+		if ((xnsticks_t)(xntimerh_date(holder) - date) > 0)
+			break;
+		xntimerq_remove(q, holder);
+		out[n++] = holder;
+	}
+
+	return n;
+}
+
+#endif /* !CONFIG_XENO_OPT_TIMER_HEAP */
+
+#endif /* !_XENO_NUCLEUS_TIMERQ_H */
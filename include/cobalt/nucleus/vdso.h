@@ -25,9 +25,20 @@
 
 #include <nucleus/types.h>
 #include <nucleus/hostrt.h>
+#include <nucleus/threadstat.h>
 
 #ifndef __XENO_SIM__
 
+/*
+ * Offset of the nucleus wallclock from the monotonic time, in
+ * nanoseconds, i.e. CLOCK_REALTIME = CLOCK_MONOTONIC + offset, as
+ * maintained by xntbase_adjust_time() for the master time base.
+ */
+struct xnvdso_wallclock_data {
+	xnseqcount_t seqcount;
+	unsigned long long offset;
+};
+
 /*
  * Data shared between Xenomai kernel/userland and the Linux kernel/userland
  * on the global semaphore heap. The features element indicates which data are
@@ -37,6 +48,8 @@ struct xnvdso {
 	unsigned long long features;
 
 	struct xnvdso_hostrt_data hostrt_data;
+	struct xnvdso_thread_stats thread_stats;
+	struct xnvdso_wallclock_data wallclock;
 	/*
 	 * Embed further domain specific structures that
 	 * describe the shared data here
@@ -54,6 +67,10 @@ struct xnvdso {
 #define XNVDSO_FEATURES	(XNVDSO_FEAT_A | XNVDSO_FEAT_B | XVDSO_FEAT_C)
 */
 #define XNVDSO_FEAT_HOST_REALTIME	0x0000000000000001ULL
+/* Set at runtime, when the thread statistics table could be allocated. */
+#define XNVDSO_FEAT_THREAD_STATS	0x0000000000000002ULL
+/* Set at runtime, once the master time base has been started. */
+#define XNVDSO_FEAT_WALLCLOCK		0x0000000000000004ULL
 #ifdef CONFIG_XENO_OPT_HOSTRT
 #define XNVDSO_FEATURES XNVDSO_FEAT_HOST_REALTIME
 #else
@@ -74,10 +91,23 @@ static inline int xnvdso_test_feature(unsigned long long feature)
 
 void xnheap_init_vdso(void);
 
+#ifdef __KERNEL__
+/* Must be called nklock locked, interrupts off. */
+static inline void xnvdso_update_wallclock(unsigned long long offset)
+{
+	xnwrite_seqcount_begin(&nkvdso->wallclock.seqcount);
+	nkvdso->wallclock.offset = offset;
+	xnwrite_seqcount_end(&nkvdso->wallclock.seqcount);
+	__setbits(nkvdso->features, XNVDSO_FEAT_WALLCLOCK);
+}
+#endif /* __KERNEL__ */
+
 #else /* __XENO_SIM__ */
 
 static inline void xnheap_init_vdso(void) { }
 
+static inline void xnvdso_update_wallclock(unsigned long long offset) { }
+
 #endif /* __XENO_SIM__ */
 
 #endif /* _XENO_NUCLEUS_VDSO_H */
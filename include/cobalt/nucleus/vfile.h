@@ -32,6 +32,7 @@
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <nucleus/types.h>
+#include <nucleus/queue.h>
 
 struct xnvfile_directory;
 struct xnvfile_regular_iterator;
@@ -301,7 +302,9 @@ struct xnvfile_snapshot_ops {
 	 * the seek pointer at the first record. When the file
 	 * revision tag is touched while collecting data, the current
 	 * reading is aborted, all collected data dropped, and the
-	 * vfile is eventually rewound.
+	 * vfile is eventually rewound, unless the @ref
+	 * snapshot_resume "resume() handler" can pick up the
+	 * collection where it stopped.
 	 *
 	 * @param it A pointer to the current snapshot iterator. Two
 	 * useful information can be retrieved from this iterator in
@@ -406,15 +409,53 @@ struct xnvfile_snapshot_ops {
 	 * the @ref snapshot_next "next() handler" is called anew.
 	 *
 	 * @note This handler is called with the vfile lock
-	 * held. Before each invocation of this handler, the vfile
-	 * core checks whether the revision tag has been touched, in
-	 * which case the data collection is restarted from scratch. A
-	 * data collection phase succeeds whenever all records can be
-	 * fetched via the @ref snapshot_next "next() handler", while
-	 * the revision tag remains unchanged, which indicates that a
-	 * consistent snapshot of the object state was taken.
+	 * held. Records are collected by chunks of at most
+	 * vfile->chunksz records per lock hold (a single record if
+	 * zero). Before each chunk is collected, the vfile core
+	 * checks whether the revision tag has been touched, in which
+	 * case the data collection is either resumed via the @ref
+	 * snapshot_resume "resume() handler" if present, or restarted
+	 * from scratch. A data collection phase succeeds whenever all
+	 * records can be fetched via the @ref snapshot_next "next()
+	 * handler", while the revision tag remains unchanged, which
+	 * indicates that a consistent snapshot of the object state
+	 * was taken.
 	 */
 	int (*next)(struct xnvfile_snapshot_iterator *it, void *data);
+	/**
+	 * @anchor snapshot_resume
+	 * This handler should re-establish the collection cursor
+	 * after the revision tag was touched between two chunks of
+	 * records, so that the data collection may go on from where
+	 * it stopped instead of being restarted from scratch. A
+	 * @ref removal_log "removal log" helps doing so in constant
+	 * time.
+	 *
+	 * @param it A pointer to the current snapshot iterator. The
+	 * private data area still holds the cursor state left by the
+	 * last call to the @ref snapshot_next "next() handler".
+	 *
+	 * @return zero if the cursor could be re-established, in
+	 * which case the records collected so far are kept, and the
+	 * data collection proceeds with the new revision. Otherwise:
+	 *
+	 * - -ESTALE, a special value indicating that the cursor is
+	 * lost, in which case the data collection is restarted from
+	 * scratch.
+	 *
+	 * - Any other negative error code aborts the data
+	 * collection, and is returned to the reader.
+	 *
+	 * @note This handler is optional; a NULL value means that
+	 * the data collection must be restarted when the revision
+	 * tag changes. It is called with the vfile lock held, and
+	 * only when the @ref snapshot_rewind "rewind() handler"
+	 * returned a strictly positive record count, and no @ref
+	 * snapshot_begin "begin() handler" is given. If the resumed
+	 * collection returns more records than this count, it is
+	 * restarted from scratch.
+	 */
+	int (*resume)(struct xnvfile_snapshot_iterator *it);
 	/**
 	 * @anchor snapshot_show
 	 * This handler should format and output a record from the
@@ -488,9 +529,36 @@ struct xnvfile_rev_tag {
 	int rev;
 };
 
+#define XNVFILE_RMLOG_SIZE  8
+
+/**
+ * @brief Removal log
+ * @anchor removal_log
+ *
+ * This structure logs the latest removals from a list which @ref
+ * snapshot_vfile "snapshot-driven vfiles" scan by chunks. A @ref
+ * snapshot_resume "resume() handler" cannot tell whether the last
+ * element it reported was removed meanwhile by looking at it, since
+ * its memory may have been released. Instead, it replays the
+ * removals logged since the previous chunk with
+ * xnvfile_rmlog_resume(), in constant time.
+ *
+ * This only works for lists which elements are always added at the
+ * tail.
+ */
+struct xnvfile_rmlog {
+	/** Count of removals logged so far. */
+	unsigned long seq;
+	struct {
+		struct xnholder *holder;
+		struct xnholder *prev;
+	} entries[XNVFILE_RMLOG_SIZE];
+};
+
 struct xnvfile_snapshot_template {
 	size_t privsz;
 	size_t datasz;
+	int chunksz;
 	struct xnvfile_rev_tag *tag;
 	struct xnvfile_snapshot_ops *ops;
 	struct xnvfile_lock_ops *lockops;
@@ -511,6 +579,8 @@ struct xnvfile_snapshot {
 	struct xnvfile entry;
 	size_t privsz;
 	size_t datasz;
+	/** Max. number of records collected per lock hold. */
+	int chunksz;
 	struct xnvfile_rev_tag *tag;
 	struct xnvfile_snapshot_ops *ops;
 };
@@ -569,6 +639,47 @@ static inline void xnvfile_touch(struct xnvfile_snapshot *vfile)
 	xnvfile_touch_tag(vfile->tag);
 }
 
+/*
+ * Log the removal of @a holder from @a q, which must be done before
+ * the holder is actually unlinked.
+ */
+static inline void xnvfile_rmlog_add(struct xnvfile_rmlog *log,
+				     struct xnqueue *q,
+				     struct xnholder *holder)
+{
+	unsigned long n = log->seq++ % XNVFILE_RMLOG_SIZE;
+
+	log->entries[n].holder = holder;
+	log->entries[n].prev = holder->last == &q->head ? NULL : holder->last;
+}
+
+/*
+ * Replay the removals logged since *@a seq on *@a lastp, the last
+ * element reported from the list: whenever removed, it is replaced
+ * by the element which preceded it, NULL standing for the list
+ * head. Returns -ESTALE if more removals than the log holds
+ * happened since *@a seq.
+ */
+static inline int xnvfile_rmlog_resume(struct xnvfile_rmlog *log,
+				       unsigned long *seq,
+				       struct xnholder **lastp)
+{
+	struct xnholder *last = *lastp;
+	unsigned long n;
+
+	if (log->seq - *seq > XNVFILE_RMLOG_SIZE)
+		return -ESTALE;
+
+	for (n = *seq; n != log->seq; n++)
+		if (log->entries[n % XNVFILE_RMLOG_SIZE].holder == last)
+			last = log->entries[n % XNVFILE_RMLOG_SIZE].prev;
+
+	*lastp = last;
+	*seq = log->seq;
+
+	return 0;
+}
+
 static inline int xnvfile_reg_p(struct xnvfile *entry)
 {
 	return S_ISREG(entry->pde->mode);
@@ -689,6 +800,8 @@ void xnvfile_destroy_link(struct xnvfile_link *vlink)
 
 #define xnvfile_touch(vfile)	do { } while (0)
 
+#define xnvfile_rmlog_add(log, q, holder)	do { } while (0)
+
 #endif /* !CONFIG_XENO_OPT_VFILE */
 
 /*@}*/
@@ -88,6 +88,7 @@ typedef struct pse51_threadattr {
 	char *name;
 	int fp;
 	xnarch_cpumask_t affinity;
+	struct timespec slack;
 
 } pthread_attr_t;
 
@@ -181,6 +182,10 @@ union __xeno_cond {
 	struct __shadow_cond {
 		unsigned magic;
 		struct pse51_cond *cond;
+		/* Offset of the waiter count in the (global if pshared)
+		   sem heap. */
+		unsigned pending_offset;
+		int pshared;
 	} shadow_cond;
 };
 
@@ -263,6 +268,12 @@ int pthread_attr_getaffinity_np (const pthread_attr_t *attr,
 int pthread_attr_setaffinity_np (pthread_attr_t *attr,
 				 xnarch_cpumask_t mask);
 
+int pthread_attr_getslack_np(const pthread_attr_t *attr,
+			     struct timespec *slack);
+
+int pthread_attr_setslack_np(pthread_attr_t *attr,
+			     const struct timespec *slack);
+
 int pthread_create(pthread_t *tid,
 		   const pthread_attr_t *attr,
 		   void *(*start) (void *),
@@ -77,6 +77,14 @@ COBALT_DECL(int, sched_get_priority_max(int policy));
 #define sched_ss_max_repl	u.ss.__sched_max_repl
 #endif	/* !SCHED_SPORADIC */
 
+#define SCHED_QUOTA		12
+#define sched_quota_group	u.quota.__sched_group
+#define sched_quota_budget	u.quota.__sched_budget
+#define sched_quota_period	u.quota.__sched_period
+
+#define SCHED_EDF		13
+#define sched_edf_budget	u.edf.__sched_budget
+
 #define SCHED_COBALT		42
 
 #define sched_rr_quantum	u.rr.__sched_rr_quantum
@@ -92,11 +100,23 @@ struct __sched_rr_param {
 	struct timespec __sched_rr_quantum;
 };
 
+struct __sched_quota_param {
+	int __sched_group;
+	struct timespec __sched_budget;
+	struct timespec __sched_period;
+};
+
+struct __sched_edf_param {
+	struct timespec __sched_budget;
+};
+
 struct sched_param_ex {
 	int sched_priority;
 	union {
 		struct __sched_ss_param ss;
 		struct __sched_rr_param rr;
+		struct __sched_quota_param quota;
+		struct __sched_edf_param edf;
 	} u;
 };
 
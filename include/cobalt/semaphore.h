@@ -66,6 +66,9 @@ union __xeno_sem {
     struct __shadow_sem {
 	unsigned magic;
 	struct pse51_sem *sem;
+	/* Offset of the count word in the (global if pshared) sem heap. */
+	unsigned value_offset;
+	int pshared;
     } shadow_sem;
 };
 
@@ -51,7 +51,17 @@ struct clockobj {
 #ifndef CONFIG_XENO_LORES_CLOCK_DISABLED
 	unsigned int resolution;
 	unsigned int frequency;
+	/* ns / resolution ~= (ns * scale_mult) >> scale_shift */
+	unsigned int scale_mult;
+	unsigned int scale_shift;
 #endif
+	/*
+	 * Lock-free readers of the date fetch offset_ns and the
+	 * scaling factors under this sequence count, updaters hold
+	 * the clock lock.
+	 */
+	unsigned int seq;
+	sticks_t offset_ns;
 	const char *name;	/* __ref FIXME */
 };
 
@@ -179,6 +189,16 @@ static inline sticks_t clockobj_ticks_to_ns(struct clockobj *clkobj,
 	return ticks;
 }
 
+static inline void __clockobj_init_scaling(struct clockobj *clkobj)
+{
+}
+
+static inline ticks_t __clockobj_ns_to_ticks(struct clockobj *clkobj,
+					     ticks_t ns)
+{
+	return ns;
+}
+
 #else /* !CONFIG_XENO_LORES_CLOCK_DISABLED */
 
 static inline
@@ -212,6 +232,59 @@ static inline sticks_t clockobj_ticks_to_ns(struct clockobj *clkobj,
 	return ticks * clkobj->resolution;
 }
 
+/*
+ * Pick the largest shift keeping the multiplier on 32 bits, the
+ * approximation error is then below 2^-31.
+ */
+static inline void __clockobj_init_scaling(struct clockobj *clkobj)
+{
+	unsigned int res = clkobj->resolution, shift = 31;
+
+	while (res >>= 1)
+		shift++;
+
+	clkobj->scale_shift = shift;
+	clkobj->scale_mult = (1ULL << shift) / clkobj->resolution;
+}
+
+static inline ticks_t __clockobj_scale_down(struct clockobj *clkobj,
+					    ticks_t ns)
+{
+	unsigned long long hi, lo;
+
+	/* scale_shift >= 32 since resolution >= 2. */
+	hi = (ns >> 32) * clkobj->scale_mult;
+	lo = ((ns & 0xffffffffULL) * clkobj->scale_mult) >> 32;
+
+	return (hi + lo) >> (clkobj->scale_shift - 32);
+}
+
+/*
+ * Divide a count of nanoseconds by the clock resolution, without
+ * division. The multiply-shift estimate is never above the exact
+ * quotient, and its relative error is below 2^-31, so scaling the
+ * remainder again converges in a couple of rounds.
+ */
+static inline ticks_t __clockobj_ns_to_ticks(struct clockobj *clkobj,
+					     ticks_t ns)
+{
+	unsigned int res = clkobj->resolution;
+	ticks_t q, r, d;
+
+	if (res == 1)
+		return ns;
+
+	q = __clockobj_scale_down(clkobj, ns);
+	r = ns - q * res;
+	while (r >= res) {
+		d = __clockobj_scale_down(clkobj, r) ?: 1;
+		q += d;
+		r -= d * res;
+	}
+
+	return q;
+}
+
 #endif /* !CONFIG_XENO_LORES_CLOCK_DISABLED */
 
 #ifdef CONFIG_XENO_COBALT
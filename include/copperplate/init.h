@@ -31,13 +31,14 @@ struct coppernode {
 	char *registry_mountpt;
 	const char *session_label;
 	cpu_set_t cpu_affinity;
+	unsigned int lock_spin;
 	/* No bitfield below, we have to take address of thoses. */
 	int no_mlock;
 	int no_registry;
 	int reset_session;
 };
 
-struct timespec __init_date;
+extern struct timespec __init_date;
 
 extern struct coppernode __this_node;
 
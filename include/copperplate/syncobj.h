@@ -20,12 +20,15 @@
 #define _COPPERPLATE_SYNCOBJ_H
 
 #include <pthread.h>
+#include <sched.h>
+#include <errno.h>
 #include <copperplate/list.h>
 #include <copperplate/lock.h>
 
 /* syncobj->flags */
 #define SYNCOBJ_FIFO	0x0
 #define SYNCOBJ_PRIO	0x1
+#define SYNCOBJ_DEFUNCT	0x100	/* Destroyed, finalization pending. */
 
 /* threadobj->wait_status */
 #define SYNCOBJ_DELETED		0x1
@@ -46,15 +49,23 @@ struct syncstate {
 	int state;
 };
 
+struct syncobj_stats {
+	unsigned long contended;
+	unsigned long spun;
+	unsigned long blocked;
+};
+
 struct syncobj {
 	int flags;
 	int release_count;
 	pthread_mutex_t lock;
+	int owner_cpu;
 	pthread_cond_t post_sync;
 	struct list pend_list;
 	int pend_count;
 	struct list drain_list;
 	int drain_count;
+	struct list watch_list;
 	fnref_type(void (*)(struct syncobj *sobj)) finalizer;
 };
 
@@ -66,6 +77,10 @@ struct syncobj {
 
 void __syncobj_cleanup_wait(struct syncobj *sobj,
 			    struct threadobj *thobj);
+
+extern unsigned int syncobj_spin;
+
+extern struct syncobj_stats syncobj_stats;
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -80,15 +95,45 @@ struct threadobj *syncobj_post(struct syncobj *sobj);
 
 struct threadobj *syncobj_peek(struct syncobj *sobj);
 
+int __syncobj_lock_contended(struct syncobj *sobj,
+			     struct syncstate *syns);
+
+/*
+ * The CPU the lock holder runs on is only tracked in adaptive mode,
+ * so that contenders do not spin for an owner which cannot make
+ * progress until they block. It reads as -1 while the lock is free,
+ * which lets contenders poll it instead of hammering the mutex.
+ */
+static inline void __syncobj_tag_owner(struct syncobj *sobj)
+{
+	if (syncobj_spin)
+		sobj->owner_cpu = sched_getcpu();
+}
+
+static inline void __syncobj_untag_owner(struct syncobj *sobj)
+{
+	if (syncobj_spin)
+		sobj->owner_cpu = -1;
+}
+
 static inline int syncobj_lock(struct syncobj *sobj,
 			       struct syncstate *syns)
 {
-	return write_lock_safe(&sobj->lock, syns->state);
+	int ret;
+
+	ret = write_trylock_safe(&sobj->lock, syns->state);
+	if (ret == -EBUSY)
+		ret = __syncobj_lock_contended(sobj, syns);
+	if (ret == 0)
+		__syncobj_tag_owner(sobj);
+
+	return ret;
 }
 
 static inline void syncobj_unlock(struct syncobj *sobj,
 				  struct syncstate *syns)
 {
+	__syncobj_untag_owner(sobj);
 	write_unlock_safe(&sobj->lock, syns->state);
 }
 
@@ -107,6 +152,26 @@ static inline int syncobj_pend_count(struct syncobj *sobj)
 	return sobj->pend_count;
 }
 
+static inline int syncobj_watched_p(struct syncobj *sobj)
+{
+	return !list_empty(&sobj->watch_list);
+}
+
+/*
+ * Pinning prevents the object from being finalized while its lock
+ * is temporarily dropped; syncobj_unpin() returns -EIDRM, with the
+ * lock released, if the object was destroyed meanwhile.
+ */
+static inline void syncobj_pin(struct syncobj *sobj)
+{
+	sobj->release_count++;
+}
+
+int syncobj_unpin(struct syncobj *sobj, struct syncstate *syns);
+
+void syncobj_drop_watch(struct syncobj *sobj, struct holder *link,
+			struct syncstate *syns);
+
 void syncobj_requeue_waiter(struct syncobj *sobj, struct threadobj *thobj);
 
 void syncobj_wakeup_waiter(struct syncobj *sobj, struct threadobj *thobj);
@@ -116,6 +181,8 @@ int syncobj_flush(struct syncobj *sobj, int reason);
 int syncobj_destroy(struct syncobj *sobj,
 		    struct syncstate *syns);
 
+int syncobj_pkg_init(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -197,15 +197,38 @@ static inline int threadobj_unlock(struct threadobj *thobj)
 	return write_unlock_safe(&thobj->lock, thobj->lock_state);
 }
 
+#ifdef HAVE___THREAD
+
+extern __thread __attribute__ ((tls_model ("initial-exec")))
+struct threadobj *__threadobj_current;
+
+static inline void threadobj_set_current(struct threadobj *thobj)
+{
+	__threadobj_current = thobj;
+}
+
+static inline struct threadobj *threadobj_current(void)
+{
+	return __threadobj_current;
+}
+
+#else /* !HAVE___THREAD */
+
+static inline void threadobj_set_current(struct threadobj *thobj)
+{
+	pthread_setspecific(threadobj_tskey, thobj);
+}
+
 static inline struct threadobj *threadobj_current(void)
 {
 	return pthread_getspecific(threadobj_tskey);
 }
 
+#endif /* !HAVE___THREAD */
+
 static inline int threadobj_async_p(void)
 {
-	struct threadobj *thobj = threadobj_current();
-	return thobj == THREADOBJ_IRQCONTEXT;
+	return threadobj_current() == THREADOBJ_IRQCONTEXT;
 }
 
 static inline int threadobj_lock_sched_once(struct threadobj *thobj)
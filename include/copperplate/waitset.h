@@ -0,0 +1,89 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef _COPPERPLATE_WAITSET_H
+#define _COPPERPLATE_WAITSET_H
+
+#include <stdint.h>
+#include <copperplate/list.h>
+#include <copperplate/syncobj.h>
+
+/* waitwatch->status */
+#define WAITWATCH_READY		0x1
+#define WAITWATCH_DELETED	0x2
+
+struct waitset {
+	struct syncobj sobj;
+	struct list watch_list;
+	int nwatch;
+	int dead;
+};
+
+/*
+ * A watch links a sync object to a waitset. The object owner tells
+ * the watch whether the object is ready each time its state changes,
+ * with the object lock held; the waitset lock nests inside it.
+ */
+struct waitwatch {
+	struct holder wset_link;
+	struct holder sobj_link;
+	struct waitset *wset;
+	/*
+	 * Stays valid until the watch is dropped, a deleted object
+	 * has WAITWATCH_DELETED set in the status.
+	 */
+	struct syncobj *sobj;
+	int status;
+	unsigned long arg;
+	uintptr_t cookie;
+};
+
+#define syncobj_for_each_watch(sobj, pos)		\
+	list_for_each_entry(pos, &(sobj)->watch_list, sobj_link)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void waitset_init(struct waitset *wset, int flags,
+		  fnref_type(void (*)(struct syncobj *sobj)) finalizer);
+
+int waitset_watch(struct waitset *wset, struct syncobj *sobj,
+		  uintptr_t cookie, unsigned long arg, int ready);
+
+int waitset_unwatch(struct waitset *wset, uintptr_t cookie,
+		    struct syncstate *syns);
+
+void waitset_hold(struct waitset *wset, struct syncstate *syns);
+
+int waitset_release(struct waitset *wset, struct syncstate *syns);
+
+void waitwatch_signal(struct waitwatch *watch, int ready);
+
+int waitset_poll(struct waitset *wset, uintptr_t *cookies, int nr);
+
+int waitset_wait(struct waitset *wset, uintptr_t *cookies, int nr,
+		 struct timespec *timeout, struct syncstate *syns);
+
+int waitset_destroy(struct waitset *wset, struct syncstate *syns);
+
+void __waitset_flush_watches(struct syncobj *sobj);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _COPPERPLATE_WAITSET_H */
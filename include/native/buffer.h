@@ -23,10 +23,12 @@
 #define _XENO_BUFFER_H
 
 #include <native/types.h>
+#include <asm/xenomai/atomic.h>
 
 /* Creation flags. */
 #define B_PRIO   XNSYNCH_PRIO	/* Pend by task priority order. */
 #define B_FIFO   XNSYNCH_FIFO	/* Pend by FIFO order. */
+#define B_MAPPED 0x100		/* Map the ring into user-space. */
 
 typedef struct rt_buffer_info {
 
@@ -40,8 +42,54 @@ typedef struct rt_buffer_info {
 
 typedef struct rt_buffer_placeholder {
 	xnhandle_t opaque;
+	void *opaque2;
+	caddr_t mapbase;
+	size_t mapsize;
+	unsigned long area;
+	unsigned long ringoff;
 } RT_BUFFER_PLACEHOLDER;
 
+/*
+ * Control block heading the ring memory of mapped buffers, which
+ * user-space may read from and write to directly when a single
+ * reader and a single writer use the buffer. The read and write
+ * counts run modulo twice the ring size, so that a full ring can be
+ * told from an empty one; each of them is only updated by its own
+ * side. The waiter counts are maintained by the kernel under nklock,
+ * telling user-space whether it has to enter the kernel to wake up
+ * a peer after moving data.
+ */
+struct rt_buffer_ring {
+	unsigned long size;
+	xnarch_atomic_t wrcount;
+	xnarch_atomic_t rdcount;
+	xnarch_atomic_t iwaiters;
+	xnarch_atomic_t owaiters;
+};
+
+static inline unsigned long rt_buffer_ring_fill(unsigned long wrcount,
+						unsigned long rdcount,
+						unsigned long size)
+{
+	return wrcount >= rdcount ?
+		wrcount - rdcount : wrcount + 2 * size - rdcount;
+}
+
+static inline unsigned long rt_buffer_ring_offset(unsigned long count,
+						  unsigned long size)
+{
+	return count < size ? count : count - size;
+}
+
+static inline unsigned long rt_buffer_ring_advance(unsigned long count,
+						   unsigned long len,
+						   unsigned long size)
+{
+	count += len;
+
+	return count < 2 * size ? count : count - 2 * size;
+}
+
 #if (defined(__KERNEL__) || defined(__XENO_SIM__)) && !defined(DOXYGEN_CPP)
 
 #include <nucleus/synch.h>
@@ -70,6 +118,9 @@ typedef struct rt_buffer {
 	size_t bufsz;		/* !< Buffer size. */
 	caddr_t bufmem;		/* !< Buffer space. */
 
+	xnheap_t *bufpool;	/* !< Mapped ring memory (B_MAPPED). */
+	struct rt_buffer_ring *ring; /* !< Ring control block (B_MAPPED). */
+
 #ifndef __XENO_SIM__
 	pid_t cpid;			/* !< Creator's pid. */
 #endif
@@ -102,6 +153,10 @@ ssize_t rt_buffer_read_inner(RT_BUFFER *bf, struct xnbufd *bufd,
 ssize_t rt_buffer_write_inner(RT_BUFFER *bf, struct xnbufd *bufd,
 			      xntmode_t timeout_mode, RTIME timeout);
 
+int rt_buffer_delete_inner(RT_BUFFER *bf, void __user *mapaddr);
+
+int rt_buffer_wakeup_inner(RT_BUFFER *bf);
+
 #else /* !CONFIG_XENO_OPT_NATIVE_BUFFER */
 
 #define __native_buffer_pkg_init()		({ 0; })
@@ -126,11 +181,7 @@ int rt_buffer_bind(RT_BUFFER *bf,
 		   const char *name,
 		   RTIME timeout);
 
-static inline int rt_buffer_unbind(RT_BUFFER *bf)
-{
-	bf->opaque = XN_NO_HANDLE;
-	return 0;
-}
+int rt_buffer_unbind(RT_BUFFER *bf);
 
 #ifdef __cplusplus
 }
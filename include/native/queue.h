@@ -25,6 +25,7 @@
 #include <nucleus/synch.h>
 #include <nucleus/heap.h>
 #include <native/types.h>
+#include <asm/xenomai/atomic.h>
 
 /* Creation flags. */
 #define Q_PRIO   XNSYNCH_PRIO	/* Pend by task priority order. */
@@ -63,8 +64,55 @@ typedef struct rt_queue_placeholder {
 	caddr_t mapbase;
 	size_t mapsize;
 	unsigned long area;
+	unsigned long cacheoff;
 } RT_QUEUE_PLACEHOLDER;
 
+/*
+ * Cache of free message blocks, living in the pool memory of shared
+ * queues, so that user-space may allocate and release buffers
+ * without issuing any system call. Blocks are sorted by size class,
+ * from Q_CACHE_MINSIZE to Q_CACHE_MINSIZE << (Q_CACHE_CLASSES - 1)
+ * bytes, header included. Each slot holds the offset of a free block
+ * in the pool, or zero if empty; slots are claimed and filled using
+ * atomic compare-and-swap operations only.
+ */
+#define Q_CACHE_MINSHIFT 5
+#define Q_CACHE_MINSIZE  (1 << Q_CACHE_MINSHIFT)
+#define Q_CACHE_CLASSES  8
+#define Q_CACHE_DEPTH    8
+
+struct rt_queue_cache {
+	xnarch_atomic_t slots[Q_CACHE_CLASSES][Q_CACHE_DEPTH];
+};
+
+typedef struct rt_queue_msg {
+
+    size_t size;
+
+    volatile unsigned refcount;
+
+    unsigned bclass;	/* Cache class + 1, zero if not cacheable. */
+
+    xnholder_t link;
+
+#define link2rtmsg(ln)		container_of(ln, rt_queue_msg_t, link)
+
+} rt_queue_msg_t;
+
+static inline int rt_queue_cache_class(size_t size)
+{
+	size_t bsize = Q_CACHE_MINSIZE;
+	int n;
+
+	size += sizeof(rt_queue_msg_t);
+
+	for (n = 0; n < Q_CACHE_CLASSES; n++, bsize <<= 1)
+		if (size <= bsize)
+			return n;
+
+	return -1;
+}
+
 #if defined(__KERNEL__) || defined(__XENO_SIM__)
 
 #include <native/ppd.h>
@@ -99,19 +147,9 @@ typedef struct rt_queue {
 
     xnqueue_t *rqueue;		/* !< Backpointer to resource queue. */
 
-} RT_QUEUE;
-
-typedef struct rt_queue_msg {
-
-    size_t size;
+    struct rt_queue_cache *cache; /* !< Free block cache (shared queues). */
 
-    volatile unsigned refcount;
-
-    xnholder_t link;
-
-#define link2rtmsg(ln)		container_of(ln, rt_queue_msg_t, link)
-
-} rt_queue_msg_t;
+} RT_QUEUE;
 
 #ifdef __cplusplus
 extern "C" {
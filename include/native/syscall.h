@@ -128,6 +128,8 @@
 #define __native_buffer_inquire     102
 #define __native_queue_flush        103
 #define __native_cond_wait_epilogue 104
+#define __native_buffer_wakeup      105
+#define __native_task_set_slack     106
 
 struct native_hidden_desc {
 	u_long opaque_handle;
@@ -296,6 +296,9 @@ RT_TASK *rt_task_self(void);
 int rt_task_slice(RT_TASK *task,
 		  RTIME quantum);
 
+int rt_task_set_slack(RT_TASK *task,
+		      RTIME slack);
+
 ssize_t rt_task_send(RT_TASK *task,
 		     RT_TASK_MCB *mcb_s,
 		     RT_TASK_MCB *mcb_r,
@@ -996,11 +996,11 @@ enum rtdm_timer_mode {
 /** @} rtdmtimer */
 
 #ifndef DOXYGEN_CPP /* Avoid broken doxygen output */
-#define rtdm_timer_init(timer, handler, name)		\
-({							\
-	xntimer_init((timer), rtdm_tbase, handler);	\
-	xntimer_set_name((timer), (name));		\
-	0;						\
+#define rtdm_timer_init(timer, handler, name)			\
+({								\
+	int __ret = xntimer_init((timer), rtdm_tbase, handler);	\
+	xntimer_set_name((timer), (name));			\
+	__ret;							\
 })
 #endif /* !DOXYGEN_CPP */
 
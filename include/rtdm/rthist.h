@@ -0,0 +1,359 @@
+/**
+ * @file
+ * Log-linear latency histograms, shared by kernel and user-space
+ * benchmarks.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ *
+ * @ingroup rttesting
+ */
+
+#ifndef _RTHIST_H
+#define _RTHIST_H
+
+/*
+ * Values below 2^sub_bits get a bucket of their own. Beyond, each
+ * power of two range is split into 2^sub_bits buckets, so that the
+ * relative error on any recorded value stays below 2^-sub_bits.
+ * Values up to 2^range_bits - 1 are bucketed; larger ones are only
+ * counted as overflows, but still contribute to the exact minimum,
+ * maximum and sum.
+ */
+
+#ifdef __KERNEL__
+#include <linux/types.h>
+#include <linux/string.h>
+#include <linux/bitops.h>
+#include <linux/errno.h>
+#else /* !__KERNEL__ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#endif /* !__KERNEL__ */
+
+#define RTTST_HIST_MAGIC	0x31524448	/* "HDR1" */
+
+#define RTTST_HIST_SUB_BITS	7	/* < 1% error */
+#define RTTST_HIST_MAX_SUB_BITS	14
+#define RTTST_HIST_RANGE_BITS	32	/* ~4.3 s in nanoseconds */
+
+struct rttst_hist {
+	unsigned int magic;
+	unsigned short sub_bits;
+	unsigned short range_bits;
+	unsigned int nr_buckets;
+	unsigned int __padding;
+	unsigned long long count;	/* Recorded values */
+	unsigned long long overflows;	/* Values beyond range */
+	unsigned long long min;
+	unsigned long long max;
+	unsigned long long sum;
+	unsigned long long buckets[0];
+};
+
+static inline unsigned int rttst_hist_nr_buckets(unsigned int sub_bits,
+						 unsigned int range_bits)
+{
+	return (range_bits - sub_bits + 1) << sub_bits;
+}
+
+static inline size_t rttst_hist_size(unsigned int sub_bits,
+				     unsigned int range_bits)
+{
+	return sizeof(struct rttst_hist) +
+		rttst_hist_nr_buckets(sub_bits, range_bits) *
+		sizeof(unsigned long long);
+}
+
+static inline int rttst_hist_valid_p(unsigned int sub_bits,
+				     unsigned int range_bits)
+{
+	return sub_bits >= 1 && sub_bits <= RTTST_HIST_MAX_SUB_BITS &&
+		range_bits > sub_bits && range_bits <= 63;
+}
+
+static inline int rttst_hist_init(struct rttst_hist *h,
+				  unsigned int sub_bits,
+				  unsigned int range_bits)
+{
+	if (!rttst_hist_valid_p(sub_bits, range_bits))
+		return -EINVAL;
+
+	memset(h, 0, rttst_hist_size(sub_bits, range_bits));
+	h->magic = RTTST_HIST_MAGIC;
+	h->sub_bits = sub_bits;
+	h->range_bits = range_bits;
+	h->nr_buckets = rttst_hist_nr_buckets(sub_bits, range_bits);
+	h->min = ~0ULL;
+
+	return 0;
+}
+
+static inline int __rttst_hist_fls(unsigned long long v)
+{
+#ifdef __KERNEL__
+	return fls64(v);
+#else /* !__KERNEL__ */
+	return v ? 64 - __builtin_clzll(v) : 0;
+#endif /* !__KERNEL__ */
+}
+
+static inline unsigned int rttst_hist_index(const struct rttst_hist *h,
+					    unsigned long long v)
+{
+	unsigned int shift;
+
+	if (v < (1ULL << h->sub_bits))
+		return (unsigned int)v;
+
+	shift = __rttst_hist_fls(v) - 1 - h->sub_bits;
+
+	return (shift << h->sub_bits) + (unsigned int)(v >> shift);
+}
+
+/* Lowest value falling into bucket @n. */
+static inline unsigned long long
+rttst_hist_lowest(const struct rttst_hist *h, unsigned int n)
+{
+	unsigned int shift = n >> h->sub_bits;
+
+	if (shift == 0)
+		return n;
+
+	shift--;
+
+	return (unsigned long long)(n - (shift << h->sub_bits)) << shift;
+}
+
+/* Highest value falling into bucket @n. */
+static inline unsigned long long
+rttst_hist_highest(const struct rttst_hist *h, unsigned int n)
+{
+	return rttst_hist_lowest(h, n + 1) - 1;
+}
+
+static inline void rttst_hist_add(struct rttst_hist *h,
+				  unsigned long long v)
+{
+	h->count++;
+	h->sum += v;
+
+	if (v < h->min)
+		h->min = v;
+	if (v > h->max)
+		h->max = v;
+
+	if (v >> h->range_bits)
+		h->overflows++;
+	else
+		h->buckets[rttst_hist_index(h, v)]++;
+}
+
+static inline int rttst_hist_merge(struct rttst_hist *dst,
+				   const struct rttst_hist *src)
+{
+	unsigned int n;
+
+	if (dst->sub_bits != src->sub_bits ||
+	    dst->range_bits != src->range_bits)
+		return -EINVAL;
+
+	if (src->count == 0)
+		return 0;
+
+	for (n = 0; n < dst->nr_buckets; n++)
+		dst->buckets[n] += src->buckets[n];
+
+	dst->count += src->count;
+	dst->overflows += src->overflows;
+	dst->sum += src->sum;
+
+	if (src->min < dst->min)
+		dst->min = src->min;
+	if (src->max > dst->max)
+		dst->max = src->max;
+
+	return 0;
+}
+
+#ifndef __KERNEL__
+
+/*
+ * Smallest value which is greater or equal to @ppm parts per
+ * million of the recorded values, e.g. 999900 for the 99.99th
+ * percentile. The result is the upper bound of the matching bucket,
+ * capped to the exact maximum.
+ */
+static inline unsigned long long
+rttst_hist_percentile(const struct rttst_hist *h, unsigned long ppm)
+{
+	unsigned long long rank, seen = 0, v;
+	unsigned int n;
+
+	if (h->count == 0)
+		return 0;
+
+	rank = (h->count * ppm + 999999) / 1000000;
+	if (rank == 0)
+		rank = 1;
+
+	for (n = 0; n < h->nr_buckets; n++) {
+		seen += h->buckets[n];
+		if (seen >= rank) {
+			v = rttst_hist_highest(h, n);
+			return v < h->max ? v : h->max;
+		}
+	}
+
+	return h->max;		/* Among overflows. */
+}
+
+static inline struct rttst_hist *rttst_hist_alloc(unsigned int sub_bits,
+						  unsigned int range_bits)
+{
+	struct rttst_hist *h;
+
+	if (!rttst_hist_valid_p(sub_bits, range_bits))
+		return NULL;
+
+	h = malloc(rttst_hist_size(sub_bits, range_bits));
+	if (h)
+		rttst_hist_init(h, sub_bits, range_bits);
+
+	return h;
+}
+
+/*
+ * Binary dump format: a stream of records, each made of a header
+ * giving the geometry and the totals, followed by the non-empty
+ * buckets as (index, count) pairs. All fields are little-endian;
+ * 16 bit for the geometry, 32 bit for the magic and pair count, 64
+ * bit otherwise. Records may be concatenated from any number of runs
+ * or machines, then merged back with rttst_hist_load() and
+ * rttst_hist_merge().
+ */
+
+static inline int __rttst_hist_put(FILE *fp, unsigned long long v, int len)
+{
+	unsigned char b[8];
+	int n;
+
+	for (n = 0; n < len; n++, v >>= 8)
+		b[n] = v & 0xff;
+
+	return fwrite(b, len, 1, fp) == 1 ? 0 : -EIO;
+}
+
+static inline int __rttst_hist_get(FILE *fp, unsigned long long *v, int len)
+{
+	unsigned char b[8];
+	int n;
+
+	if (fread(b, len, 1, fp) != 1)
+		return feof(fp) ? -ENODATA : -EIO;
+
+	for (n = len - 1, *v = 0; n >= 0; n--)
+		*v = (*v << 8) | b[n];
+
+	return 0;
+}
+
+static inline int rttst_hist_dump(const struct rttst_hist *h, FILE *fp)
+{
+	unsigned int n, nz = 0;
+	int ret;
+
+	for (n = 0; n < h->nr_buckets; n++)
+		if (h->buckets[n])
+			nz++;
+
+	ret = __rttst_hist_put(fp, RTTST_HIST_MAGIC, 4);
+	ret = ret ?: __rttst_hist_put(fp, h->sub_bits, 2);
+	ret = ret ?: __rttst_hist_put(fp, h->range_bits, 2);
+	ret = ret ?: __rttst_hist_put(fp, nz, 4);
+	ret = ret ?: __rttst_hist_put(fp, h->count, 8);
+	ret = ret ?: __rttst_hist_put(fp, h->overflows, 8);
+	ret = ret ?: __rttst_hist_put(fp, h->min, 8);
+	ret = ret ?: __rttst_hist_put(fp, h->max, 8);
+	ret = ret ?: __rttst_hist_put(fp, h->sum, 8);
+
+	for (n = 0; ret == 0 && n < h->nr_buckets; n++) {
+		if (h->buckets[n] == 0)
+			continue;
+		ret = __rttst_hist_put(fp, n, 4);
+		ret = ret ?: __rttst_hist_put(fp, h->buckets[n], 8);
+	}
+
+	return ret;
+}
+
+/*
+ * Read the next record from @fp into a newly allocated histogram.
+ * Returns -ENODATA at the end of the stream, -EINVAL on a malformed
+ * record.
+ */
+static inline int rttst_hist_load(FILE *fp, struct rttst_hist **hp)
+{
+	unsigned long long magic, sub_bits, range_bits, nz, n, v;
+	struct rttst_hist *h;
+	int ret;
+
+	ret = __rttst_hist_get(fp, &magic, 4);
+	if (ret)
+		return ret;
+
+	ret = __rttst_hist_get(fp, &sub_bits, 2);
+	ret = ret ?: __rttst_hist_get(fp, &range_bits, 2);
+	ret = ret ?: __rttst_hist_get(fp, &nz, 4);
+	if (ret)
+		return ret == -ENODATA ? -EINVAL : ret;
+
+	if (magic != RTTST_HIST_MAGIC ||
+	    !rttst_hist_valid_p(sub_bits, range_bits))
+		return -EINVAL;
+
+	h = rttst_hist_alloc(sub_bits, range_bits);
+	if (h == NULL)
+		return -ENOMEM;
+
+	ret = __rttst_hist_get(fp, &h->count, 8);
+	ret = ret ?: __rttst_hist_get(fp, &h->overflows, 8);
+	ret = ret ?: __rttst_hist_get(fp, &h->min, 8);
+	ret = ret ?: __rttst_hist_get(fp, &h->max, 8);
+	ret = ret ?: __rttst_hist_get(fp, &h->sum, 8);
+
+	while (ret == 0 && nz-- > 0) {
+		ret = __rttst_hist_get(fp, &n, 4);
+		ret = ret ?: __rttst_hist_get(fp, &v, 8);
+		if (ret == 0 && n >= h->nr_buckets)
+			ret = -EINVAL;
+		if (ret == 0)
+			h->buckets[n] = v;
+	}
+
+	if (ret) {
+		free(h);
+		return ret == -ENODATA ? -EINVAL : ret;
+	}
+
+	*hp = h;
+
+	return 0;
+}
+
+#endif /* !__KERNEL__ */
+
+#endif /* !_RTHIST_H */
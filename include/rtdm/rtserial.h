@@ -29,7 +29,7 @@
  * Feel free to comment on this profile via the Xenomai mailing list
  * (Xenomai-core@gna.org) or directly to the author (jan.kiszka@web.de).
  *
- * @b Profile @b Revision: 3
+ * @b Profile @b Revision: 4
  * @n
  * @n
  * @par Device Characteristics
@@ -79,7 +79,7 @@
 
 #include <rtdm/rtdm.h>
 
-#define RTSER_PROFILE_VER		3
+#define RTSER_PROFILE_VER		4
 
 /*!
  * @anchor RTSER_DEF_BAUD   @name RTSER_DEF_BAUD
@@ -168,6 +168,17 @@
 #define RTSER_DEF_EVENT_MASK		0x00
 /** @} */
 
+/*!
+ * @anchor RTSER_RX_BLOCK_xxx   @name RTSER_RX_BLOCK_xxx
+ * Block-mode reception defaults
+ * @{ */
+/** block mode disabled, readers are woken per request */
+#define RTSER_RX_BLOCK_OFF		0
+#define RTSER_DEF_RX_BLOCK_SIZE		RTSER_RX_BLOCK_OFF
+/** no inter-character timeout */
+#define RTSER_DEF_RX_IDLE_TIMEOUT	RTDM_TIMEOUT_INFINITE
+/** @} */
+
 
 /*!
  * @anchor RTSER_SET_xxx   @name RTSER_SET_xxx
@@ -312,6 +323,44 @@ typedef struct rtser_event {
 	nanosecs_abs_t	rxpend_timestamp;
 } rtser_event_t;
 
+/**
+ * Block-mode reception settings
+ */
+typedef struct rtser_rx_block {
+	/** wake up readers once that many bytes are pending, @ref
+	 *  RTSER_RX_BLOCK_OFF disables block mode */
+	int		block_size;
+
+	int		reserved;
+
+	/** inter-character timeout, wakes up readers once no byte was
+	 *  received for this period after a partial block,
+	 *  @ref RTSER_TIMEOUT_INFINITE disables it */
+	nanosecs_rel_t	idle_timeout;
+} rtser_rx_block_t;
+
+/**
+ * Burst of received characters
+ */
+typedef struct rtser_burst {
+	/** [in] buffer receiving the characters */
+	void		*buf;
+
+	/** [in] size of the buffer, [out] number of characters received */
+	size_t		size;
+
+	/** [out] number of FIFO bursts collected into the buffer */
+	int		bursts;
+
+	int		reserved;
+
+	/** [out] reception timestamp of the first burst */
+	nanosecs_abs_t	timestamp;
+
+	/** [out] reception timestamp of the last burst */
+	nanosecs_abs_t	last_timestamp;
+} rtser_burst_t;
+
 
 #define RTIOC_TYPE_SERIAL		RTDM_CLASS_SERIAL
 
@@ -493,6 +542,67 @@ typedef struct rtser_event {
  */
 #define RTSER_RTIOC_BREAK_CTL	\
 	_IOR(RTIOC_TYPE_SERIAL, 0x06, int)
+
+/**
+ * Set block-mode reception parameters
+ *
+ * In block mode, received characters are drained from the hardware FIFO
+ * in bulk and timestamped once per FIFO burst instead of once per
+ * character. Readers are only woken up when either @c block_size
+ * characters are pending or the inter-character timeout elapsed after a
+ * partial block was received. The per-character timestamp history is not
+ * maintained while block mode is enabled.
+ *
+ * @param[in] arg Pointer to block-mode settings (struct rtser_rx_block)
+ *
+ * @return 0 on success, otherwise:
+ *
+ * - -EINVAL is returned if @c block_size exceeds the reception buffer or
+ * @c idle_timeout is negative.
+ *
+ * Environments:
+ *
+ * This service can be called from:
+ *
+ * - Kernel module initialization/cleanup code
+ * - Kernel-based task
+ * - User-space task (RT, non-RT)
+ *
+ * Rescheduling: never.
+ */
+#define RTSER_RTIOC_SET_RX_BLOCK	\
+	_IOW(RTIOC_TYPE_SERIAL, 0x07, struct rtser_rx_block)
+
+/**
+ * Receive whole FIFO bursts along with their timestamps
+ *
+ * Waits according to the block-mode rules and the reception timeout, then
+ * returns as many complete bursts as fit into the supplied buffer. A burst
+ * larger than the buffer is returned partially, the remaining characters
+ * keep the burst timestamp.
+ *
+ * @param[in,out] arg Pointer to burst descriptor (struct rtser_burst)
+ *
+ * @return 0 on success, otherwise:
+ *
+ * - -EINVAL is returned if block mode is disabled or the buffer size is
+ * zero.
+ *
+ * - -EBUSY is returned if another task is already reading from the device.
+ *
+ * - -ETIMEDOUT, -EINTR, -EAGAIN, -EBADF, -EIO and -EPIPE as for read().
+ *
+ * Environments:
+ *
+ * This service can be called from:
+ *
+ * - Kernel-based task
+ * - User-space task (RT)
+ *
+ * Rescheduling: possible.
+ */
+#define RTSER_RTIOC_READ_BURST	\
+	_IOWR(RTIOC_TYPE_SERIAL, 0x08, struct rtser_burst)
 /** @} */
 
 /*!
@@ -29,7 +29,7 @@
  * Feel free to comment on this profile via the Xenomai mailing list
  * (xenomai-core@gna.org) or directly to the author (jan.kiszka@web.de).
  *
- * @b Profile @b Revision: 2
+ * @b Profile @b Revision: 4
  * @n
  * @n
  * @par Device Characteristics
@@ -61,8 +61,15 @@
 #define _RTTESTING_H
 
 #include <rtdm/rtdm.h>
+#include <rtdm/rthist.h>
 
-#define RTTST_PROFILE_VER		2
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#else /* !__KERNEL__ */
+#include <limits.h>
+#endif /* !__KERNEL__ */
+
+#define RTTST_PROFILE_VER		4
 
 typedef struct rttst_bench_res {
 	long long avg;
@@ -79,9 +86,10 @@ typedef struct rttst_interm_bench_res {
 
 typedef struct rttst_overall_bench_res {
 	struct rttst_bench_res result;
-	long *histogram_avg;
-	long *histogram_min;
-	long *histogram_max;
+	/* rttst_hist_size(histogram_bits, RTTST_HIST_RANGE_BITS) each */
+	struct rttst_hist *histogram_avg;
+	struct rttst_hist *histogram_min;
+	struct rttst_hist *histogram_max;
 	void *__padding;	/* align to dwords on 32-bit archs */
 } rttst_overall_bench_res_t;
 
@@ -94,11 +102,59 @@ typedef struct rttst_tmbench_config {
 	int priority;
 	nanosecs_rel_t period;
 	int warmup_loops;
-	int histogram_size;
-	int histogram_bucketsize;
+	int histogram_bits;	/* Histogram precision, 0 to disable */
 	int freeze_max;
+	int outliers;		/* Worst samples to keep, 0 to disable */
+	int outlier_threshold;	/* Trace capture threshold (ns) */
 } rttst_tmbench_config_t;
 
+#define RTTST_OUTLIERS_MAX		256
+
+typedef struct rttst_outlier {
+	long long timestamp;	/* Release date, relative to start (ns) */
+	long latency;		/* ns */
+	long __padding;
+} rttst_outlier_t;
+
+typedef struct rttst_tmbench_outliers {
+	unsigned int nr;	/* In: capacity of buf, out: entries copied */
+	unsigned int crossings;	/* Threshold crossings so far */
+	struct rttst_outlier last; /* Sample of the last crossing */
+	struct rttst_outlier *buf; /* Worst samples, unordered */
+	void *__padding;	/* align to dwords on 32-bit archs */
+} rttst_tmbench_outliers_t;
+
+/*
+ * Record a sample into the table of the @cap worst ones, evicting the
+ * mildest entry when full. Returns the latency a sample must exceed
+ * to enter the table from now on.
+ */
+static inline long rttst_outlier_add(struct rttst_outlier *tab,
+				     unsigned int *nr, unsigned int cap,
+				     long long timestamp, long latency)
+{
+	unsigned int n, low = 0;
+
+	if (*nr < cap)
+		low = (*nr)++;
+	else
+		for (n = 1; n < cap; n++)
+			if (tab[n].latency < tab[low].latency)
+				low = n;
+
+	tab[low].timestamp = timestamp;
+	tab[low].latency = latency;
+
+	if (*nr < cap)
+		return LONG_MIN;
+
+	for (n = 1, low = 0; n < cap; n++)
+		if (tab[n].latency < tab[low].latency)
+			low = n;
+
+	return tab[low].latency;
+}
+
 #define RTTST_IRQBENCH_USER_TASK	0
 #define RTTST_IRQBENCH_KERNEL_TASK	1
 #define RTTST_IRQBENCH_HANDLER		2
@@ -173,6 +229,9 @@ struct rttst_swtest_error {
 #define RTTST_RTIOC_TMBENCH_STOP \
 	_IOWR(RTIOC_TYPE_TESTING, 0x11, struct rttst_overall_bench_res)
 
+#define RTTST_RTIOC_TMBENCH_OUTLIERS \
+	_IOWR(RTIOC_TYPE_TESTING, 0x12, struct rttst_tmbench_outliers)
+
 #define RTTST_RTIOC_IRQBENCH_START \
 	_IOW(RTIOC_TYPE_TESTING, 0x20, struct rttst_irqbench_config)
 
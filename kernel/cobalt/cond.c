@@ -45,8 +45,14 @@
  * variable, using the static initializer @a PTHREAD_COND_INITIALIZER is
  * not supported.
  *
+ * When the architecture supports fast synchronization, the number of threads
+ * waiting on a condition variable is published in the semaphore heap, so that
+ * pthread_cond_signal() and pthread_cond_broadcast() return from user-space
+ * without issuing any system call when there is nobody to wake up.
+ *
  *@{*/
 
+#include <nucleus/sys_ppd.h>
 #include "mutex.h"
 #include "cond.h"
 
@@ -61,10 +67,24 @@ typedef struct pse51_cond {
 	pthread_condattr_t attr;
 	struct pse51_mutex *mutex;
 	pse51_kqueues_t *owningq;
+#ifdef CONFIG_XENO_FASTSYNCH
+	/* Count of waiters, only updated under nklock. */
+	xnarch_atomic_t *pending;
+#endif /* CONFIG_XENO_FASTSYNCH */
 } pse51_cond_t;
 
 static pthread_condattr_t default_cond_attr;
 
+#ifdef CONFIG_XENO_FASTSYNCH
+static inline void cond_pending_add(pse51_cond_t *cond, int n)
+{
+	xnarch_atomic_set(cond->pending,
+			  xnarch_atomic_get(cond->pending) + n);
+}
+#else /* !CONFIG_XENO_FASTSYNCH */
+#define cond_pending_add(cond, n)	do { } while (0)
+#endif /* !CONFIG_XENO_FASTSYNCH */
+
 static void cond_destroy_internal(pse51_cond_t * cond, pse51_kqueues_t *q)
 {
 	spl_t s;
@@ -76,6 +96,10 @@ static void cond_destroy_internal(pse51_cond_t * cond, pse51_kqueues_t *q)
 	   xnpod_schedule(). */
 	xnsynch_destroy(&cond->synchbase);
 	xnlock_put_irqrestore(&nklock, s);
+#ifdef CONFIG_XENO_FASTSYNCH
+	xnheap_free(&xnsys_ppd_get(cond->attr.pshared)->sem_heap,
+		    cond->pending);
+#endif /* CONFIG_XENO_FASTSYNCH */
 	xnfree(cond);
 }
 
@@ -98,6 +122,10 @@ static void cond_destroy_internal(pse51_cond_t * cond, pse51_kqueues_t *q)
  * - EBUSY, the condition variable @a cnd was already initialized;
  * - ENOMEM, insufficient memory exists in the system heap to initialize the
  *   condition variable, increase CONFIG_XENO_OPT_SYS_HEAPSZ.
+ * - EAGAIN, insufficient memory exists in the semaphore heap to initialize the
+ *   condition variable, increase CONFIG_XENO_OPT_GLOBAL_SEM_HEAPSZ for a
+ *   process-shared condition variable, or CONFIG_XENO_OPT_SEM_HEAPSZ for a
+ *   process-private condition variable.
  *
  * @see
  * <a href="http://www.opengroup.org/onlinepubs/000095399/functions/pthread_cond_init.html">
@@ -108,6 +136,9 @@ int pthread_cond_init(pthread_cond_t * cnd, const pthread_condattr_t * attr)
 {
 	struct __shadow_cond *shadow = &((union __xeno_cond *)cnd)->shadow_cond;
 	xnflags_t synch_flags = XNSYNCH_PRIO | XNSYNCH_NOPIP;
+#ifdef CONFIG_XENO_FASTSYNCH
+	struct xnsys_ppd *sys_ppd;
+#endif /* CONFIG_XENO_FASTSYNCH */
 	pse51_cond_t *cond;
 	xnqueue_t *condq;
 	spl_t s;
@@ -120,6 +151,18 @@ int pthread_cond_init(pthread_cond_t * cnd, const pthread_condattr_t * attr)
 	if (!cond)
 		return ENOMEM;
 
+#ifdef CONFIG_XENO_FASTSYNCH
+	sys_ppd = xnsys_ppd_get(attr->magic == PSE51_COND_ATTR_MAGIC
+				&& attr->pshared);
+	cond->pending = (xnarch_atomic_t *)
+		xnheap_alloc(&sys_ppd->sem_heap, sizeof(xnarch_atomic_t));
+	if (!cond->pending) {
+		xnfree(cond);
+		return EAGAIN;
+	}
+	xnarch_atomic_set(cond->pending, 0);
+#endif /* CONFIG_XENO_FASTSYNCH */
+
 	xnlock_get_irqsave(&nklock, s);
 
 	if (attr->magic != PSE51_COND_ATTR_MAGIC) {
@@ -142,6 +185,11 @@ int pthread_cond_init(pthread_cond_t * cnd, const pthread_condattr_t * attr)
 
 	shadow->magic = PSE51_COND_MAGIC;
 	shadow->cond = cond;
+#ifdef CONFIG_XENO_FASTSYNCH
+	shadow->pending_offset =
+		xnheap_mapped_offset(&sys_ppd->sem_heap, cond->pending);
+	shadow->pshared = attr->pshared;
+#endif /* CONFIG_XENO_FASTSYNCH */
 
 	cond->magic = PSE51_COND_MAGIC;
 	xnsynch_init(&cond->synchbase, synch_flags, NULL);
@@ -158,6 +206,10 @@ int pthread_cond_init(pthread_cond_t * cnd, const pthread_condattr_t * attr)
 
   error:
 	xnlock_put_irqrestore(&nklock, s);
+#ifdef CONFIG_XENO_FASTSYNCH
+	xnheap_free(&sys_ppd->sem_heap, cond->pending);
+#endif /* CONFIG_XENO_FASTSYNCH */
+	xnfree(cond);
 	return err;
 }
 
@@ -282,11 +334,20 @@ int pse51_cond_timedwait_prologue(xnthread_t *cur,
 		goto unlock_and_return;
 	}
 
+	/*
+	 * Publish ourselves as a waiter before releasing the mutex,
+	 * which may be grabbed from user-space without nklock by a
+	 * thread about to signal the condition.
+	 */
+	cond_pending_add(cond, 1);
+
 	/* Unlock mutex, with its previous recursive lock count stored
 	   in "*count_ptr". */
 	err = mutex_save_count(cur, mutex, count_ptr);
-	if (err)
+	if (err) {
+		cond_pending_add(cond, -1);
 		goto unlock_and_return;
+	}
 
 	/* Bind mutex to cond. */
 	if (cond->mutex == NULL)
@@ -299,6 +360,8 @@ int pse51_cond_timedwait_prologue(xnthread_t *cur,
 	else
 		xnsynch_sleep_on(&cond->synchbase, XN_INFINITE, XN_RELATIVE);
 
+	cond_pending_add(cond, -1);
+
 	/* There are four possible wakeup conditions :
 	   - cond_signal / cond_broadcast, no status bit is set, and the function
 	     should return 0 ;
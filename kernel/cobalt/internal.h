@@ -152,6 +152,19 @@ static inline xnticks_t ts2ticks_ceil(const struct timespec *ts)
 	return rem ? ticks+1 : ticks;
 }
 
+static inline xnticks_t ts2ns(const struct timespec *ts)
+{
+	xnticks_t nsecs = ts->tv_nsec;
+	if(ts->tv_sec)
+		nsecs += (xnticks_t) ts->tv_sec * ONE_BILLION;
+	return nsecs;
+}
+
+static inline void ns2ts(struct timespec *ts, xnticks_t nsecs)
+{
+	ts->tv_sec = xnarch_divrem_billion(nsecs, &ts->tv_nsec);
+}
+
 static inline xnticks_t tv2ticks_ceil(const struct timeval *tv)
 {
 	xntime_t nsecs = tv->tv_usec * 1000;
@@ -189,7 +189,7 @@ static void __alarm_trampoline(xntimer_t *timer)
  *
  * - -ENOMEM is returned if the system fails to get enough dynamic
  * memory from the global real-time heap in order to register the
- * alarm.
+ * alarm, or to make room for its timer.
  *
  * - -EEXIST is returned if the @a name is already in use by some
  * registered object.
@@ -224,7 +224,11 @@ int rt_alarm_create(RT_ALARM *alarm,
 	if (xnpod_asynch_p())
 		return -EPERM;
 
-	xntimer_init(&alarm->timer_base, __native_tbase, __alarm_trampoline);
+	err = xntimer_init(&alarm->timer_base, __native_tbase,
+			   __alarm_trampoline);
+	if (err)
+		return err;
+
 	alarm->handle = 0;	/* i.e. (still) unregistered alarm. */
 	alarm->magic = XENO_ALARM_MAGIC;
 	alarm->expiries = 0;
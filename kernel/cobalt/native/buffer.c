@@ -48,6 +48,67 @@
 #include <native/buffer.h>
 #include <native/timer.h>
 
+/*
+ * With B_MAPPED buffers, user-space may move data through the ring
+ * behind our back, so we have to resync our view of the ring state
+ * from the shared control block each time we look at it, and publish
+ * our own moves there.
+ *
+ * User-space may write anything to the counts, so they have to be
+ * checked before we derive any offset into the buffer memory from
+ * them. Our view is left untouched if they do not make sense.
+ */
+static inline int buffer_check_counts(RT_BUFFER *bf,
+				      unsigned long wrcount,
+				      unsigned long rdcount)
+{
+	if (wrcount >= 2 * bf->bufsz || rdcount >= 2 * bf->bufsz ||
+	    rt_buffer_ring_fill(wrcount, rdcount, bf->bufsz) > bf->bufsz)
+		return -EINVAL;
+
+	return 0;
+}
+
+static inline int buffer_sync(RT_BUFFER *bf)
+{
+	unsigned long wrcount, rdcount;
+
+	if (bf->ring == NULL)
+		return 0;
+
+	wrcount = xnarch_atomic_get(&bf->ring->wrcount);
+	rdcount = xnarch_atomic_get(&bf->ring->rdcount);
+	/* Order the data accesses after the count reads. */
+	xnarch_memory_barrier();
+
+	if (buffer_check_counts(bf, wrcount, rdcount))
+		return -EINVAL;
+
+	bf->fillsz = rt_buffer_ring_fill(wrcount, rdcount, bf->bufsz);
+	bf->wroff = rt_buffer_ring_offset(wrcount, bf->bufsz);
+	bf->rdoff = rt_buffer_ring_offset(rdcount, bf->bufsz);
+
+	return 0;
+}
+
+static inline void buffer_publish(RT_BUFFER *bf,
+				  xnarch_atomic_t *count, size_t len)
+{
+	/* Data must be accessed before the peer may see the move. */
+	xnarch_memory_barrier();
+	xnarch_atomic_set(count,
+			  rt_buffer_ring_advance(xnarch_atomic_get(count),
+						 len, bf->bufsz));
+}
+
+/* Must be called nklock locked, interrupts off. */
+static inline void buffer_count_waiter(xnarch_atomic_t *count, int n)
+{
+	xnarch_atomic_set(count, xnarch_atomic_get(count) + n);
+	/* Make sure user-space sees us before we recheck the ring. */
+	xnarch_memory_barrier();
+}
+
 #ifdef CONFIG_XENO_OPT_VFILE
 
 struct vfile_priv {
@@ -76,6 +137,8 @@ static int vfile_rewind(struct xnvfile_snapshot_iterator *it)
 	priv->curr = getheadpq(xnsynch_wait_queue(&bf->isynch_base));
 	priv->mode = bf->mode;
 	priv->bufsz = bf->bufsz;
+	if (buffer_sync(bf))
+		return -EINVAL;
 	priv->fillsz = bf->fillsz;
 	priv->input = 1;
 
@@ -201,6 +264,13 @@ static struct xnpnode_snapshot __buffer_pnode = {
  * - B_PRIO makes tasks pend in priority order for reading data from
  *   the buffer.
  *
+ * - B_MAPPED obtains the buffer space from a memory pool which is
+ *   mapped into the address space of the user-space callers. As long
+ *   as there is at most one reader and one writer at any point in
+ *   time, data is then transferred from user-space without issuing
+ *   any system call, unless the caller has to wait, or has to wake
+ *   up its peer.
+ *
  * This parameter also applies to tasks blocked on the buffer's output
  * queue (see rt_buffer_write()).
  *
@@ -237,9 +307,47 @@ int rt_buffer_create(RT_BUFFER *bf, const char *name, size_t bufsz, int mode)
 	if (bufsz == 0)
 		return -EINVAL;
 
-	bf->bufmem = xnarch_alloc_host_mem(bufsz);
-	if (bf->bufmem == NULL)
-		return -ENOMEM;
+	if (mode & B_MAPPED) {
+#ifdef __KERNEL__
+		size_t poolsz;
+
+		bf->bufpool = xnmalloc(sizeof(*bf->bufpool));
+		if (bf->bufpool == NULL)
+			return -ENOMEM;
+
+		poolsz = xnheap_rounded_size(sizeof(*bf->ring) + bufsz,
+					     PAGE_SIZE);
+		ret = xnheap_init_mapped(bf->bufpool, poolsz,
+					 XNARCH_SHARED_HEAP_FLAGS);
+		if (ret) {
+			xnfree(bf->bufpool);
+			return ret;
+		}
+		xnheap_set_label(bf->bufpool, "rt_buffer: %s", name);
+
+		bf->ring = xnheap_alloc(bf->bufpool,
+					sizeof(*bf->ring) + bufsz);
+		if (bf->ring == NULL) {
+			xnheap_destroy_mapped(bf->bufpool, NULL, NULL);
+			xnfree(bf->bufpool);
+			return -ENOMEM;
+		}
+		bf->ring->size = bufsz;
+		xnarch_atomic_set(&bf->ring->wrcount, 0);
+		xnarch_atomic_set(&bf->ring->rdcount, 0);
+		xnarch_atomic_set(&bf->ring->iwaiters, 0);
+		xnarch_atomic_set(&bf->ring->owaiters, 0);
+		bf->bufmem = (caddr_t)(bf->ring + 1);
+#else /* !__KERNEL__ */
+		return -EINVAL;
+#endif /* !__KERNEL__ */
+	} else {
+		bf->bufpool = NULL;
+		bf->ring = NULL;
+		bf->bufmem = xnarch_alloc_host_mem(bufsz);
+		if (bf->bufmem == NULL)
+			return -ENOMEM;
+	}
 
 	xnsynch_init(&bf->isynch_base, mode & B_PRIO, NULL);
 	xnsynch_init(&bf->osynch_base, mode & B_PRIO, NULL);
@@ -311,8 +419,18 @@ int rt_buffer_create(RT_BUFFER *bf, const char *name, size_t bufsz, int mode)
  * Rescheduling: possible.
  */
 
-int rt_buffer_delete(RT_BUFFER *bf)
+#ifdef __KERNEL__
+
+static void __buffer_release_pool(struct xnheap *heap)
 {
+	xnfree(heap);
+}
+
+#endif /* __KERNEL__ */
+
+int rt_buffer_delete_inner(RT_BUFFER *bf, void __user *mapaddr)
+{
+	xnheap_t *bufpool = NULL;
 	int ret = 0, resched;
 	spl_t s;
 
@@ -327,7 +445,14 @@ int rt_buffer_delete(RT_BUFFER *bf)
 		goto unlock_and_exit;
 	}
 
-	xnarch_free_host_mem(bf->bufmem, bf->bufsz);
+	/*
+	 * The ring memory of mapped buffers may only be released
+	 * once we dropped the superlock, since we have to invoke
+	 * Linux kernel services for this.
+	 */
+	bufpool = bf->bufpool;
+	if (bufpool == NULL)
+		xnarch_free_host_mem(bf->bufmem, bf->bufsz);
 	removeq(bf->rqueue, &bf->rlink);
 	resched = xnsynch_destroy(&bf->isynch_base) == XNSYNCH_RESCHED;
 	resched += xnsynch_destroy(&bf->osynch_base) == XNSYNCH_RESCHED;
@@ -348,9 +473,19 @@ int rt_buffer_delete(RT_BUFFER *bf)
 
 	xnlock_put_irqrestore(&nklock, s);
 
+#ifdef __KERNEL__
+	if (bufpool)
+		xnheap_destroy_mapped(bufpool, __buffer_release_pool, mapaddr);
+#endif /* __KERNEL__ */
+
 	return ret;
 }
 
+int rt_buffer_delete(RT_BUFFER *bf)
+{
+	return rt_buffer_delete_inner(bf, NULL);
+}
+
 ssize_t rt_buffer_write_inner(RT_BUFFER *bf,
 			      struct xnbufd *bufd,
 			      xntmode_t timeout_mode, RTIME timeout)
@@ -400,6 +535,9 @@ ssize_t rt_buffer_write_inner(RT_BUFFER *bf,
 
 redo:
 	for (;;) {
+		ret = buffer_sync(bf);
+		if (ret)
+			break;
 		/*
 		 * We should be able to write the entire message at
 		 * once, or block.
@@ -449,6 +587,8 @@ redo:
 
 		bf->fillsz += len;
 		bf->wroff = wroff;
+		if (bf->ring)
+			buffer_publish(bf, &bf->ring->wrcount, len);
 		ret = (ssize_t)len;
 
 		/*
@@ -480,10 +620,26 @@ redo:
 			break;
 		}
 
+		/*
+		 * A user-space reader might have made room in a
+		 * mapped ring meanwhile; recheck once we are visible
+		 * as a waiter, so that it cannot miss us.
+		 */
+		if (bf->ring) {
+			buffer_count_waiter(&bf->ring->owaiters, 1);
+			ret = buffer_sync(bf);
+			if (ret || bf->fillsz + len <= bf->bufsz) {
+				buffer_count_waiter(&bf->ring->owaiters, -1);
+				continue;
+			}
+		}
+
 		thread = xnpod_current_thread();
 		thread->wait_u.size = len;
 		info = xnsynch_sleep_on(&bf->osynch_base,
 					timeout, timeout_mode);
+		if (bf->ring)
+			buffer_count_waiter(&bf->ring->owaiters, -1);
 		if (info & XNRMID) {
 			ret = -EIDRM;	/* Buffer deleted while pending. */
 			break;
@@ -558,6 +714,9 @@ ssize_t rt_buffer_read_inner(RT_BUFFER *bf,
 
 redo:
 	for (;;) {
+		ret = buffer_sync(bf);
+		if (ret)
+			break;
 		/*
 		 * We should be able to read a complete message of the
 		 * requested length, or block.
@@ -608,6 +767,8 @@ redo:
 
 		bf->fillsz -= len;
 		bf->rdoff = rdoff;
+		if (bf->ring)
+			buffer_publish(bf, &bf->ring->rdcount, len);
 		ret = (ssize_t)len;
 
 		/*
@@ -652,10 +813,25 @@ redo:
 			goto redo;
 		}
 
+		/*
+		 * Same as for writers, a user-space writer might have
+		 * filled a mapped ring meanwhile.
+		 */
+		if (bf->ring) {
+			buffer_count_waiter(&bf->ring->iwaiters, 1);
+			ret = buffer_sync(bf);
+			if (ret || bf->fillsz >= len) {
+				buffer_count_waiter(&bf->ring->iwaiters, -1);
+				continue;
+			}
+		}
+
 		thread = xnpod_current_thread();
 		thread->wait_u.bufd =  bufd;
 		info = xnsynch_sleep_on(&bf->isynch_base,
 					timeout, timeout_mode);
+		if (bf->ring)
+			buffer_count_waiter(&bf->ring->iwaiters, -1);
 		if (info & XNRMID) {
 			ret = -EIDRM;	/* Buffer deleted while pending. */
 			break;
@@ -675,6 +851,50 @@ redo:
 	return ret;
 }
 
+/*
+ * Called on behalf of user-space after it moved data through a
+ * mapped ring while some peer was waiting on the other side.
+ */
+int rt_buffer_wakeup_inner(RT_BUFFER *bf)
+{
+	xnthread_t *waiter;
+	int ret = 0;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	bf = xeno_h2obj_validate(bf, XENO_BUFFER_MAGIC, RT_BUFFER);
+	if (bf == NULL) {
+		ret = xeno_handle_error(bf, XENO_BUFFER_MAGIC, RT_BUFFER);
+		goto unlock_and_exit;
+	}
+
+	if (bf->ring == NULL) {
+		ret = -EINVAL;
+		goto unlock_and_exit;
+	}
+
+	ret = buffer_sync(bf);
+	if (ret)
+		goto unlock_and_exit;
+
+	waiter = xnsynch_peek_pendq(&bf->isynch_base);
+	if (waiter && waiter->wait_u.bufd->b_len <= bf->fillsz)
+		xnsynch_flush(&bf->isynch_base, 0);
+
+	waiter = xnsynch_peek_pendq(&bf->osynch_base);
+	if (waiter && waiter->wait_u.size + bf->fillsz <= bf->bufsz)
+		xnsynch_flush(&bf->osynch_base, 0);
+
+	xnpod_schedule();
+
+      unlock_and_exit:
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	return ret;
+}
+
 /**
  * @fn ssize_t rt_buffer_write(RT_BUFFER *bf, const void *ptr, size_t len, RTIME timeout)
  * @brief Write to a buffer.
@@ -718,7 +938,8 @@ redo:
  * the message.
  *
  * - -EINVAL is returned if @a bf is not a buffer descriptor, or @a
- * len is greater than the actual buffer length.
+ * len is greater than the actual buffer length, or the shared ring
+ * state of a B_MAPPED buffer is corrupted.
  *
  * - -EIDRM is returned if @a bf is a deleted buffer descriptor.
  *
@@ -799,7 +1020,8 @@ ssize_t rt_buffer_write(RT_BUFFER *bf, const void *ptr, size_t len, RTIME timeou
  * the message.
  *
  * - -EINVAL is returned if @a bf is not a buffer descriptor, or @a
- * len is greater than the actual buffer length.
+ * len is greater than the actual buffer length, or the shared ring
+ * state of a B_MAPPED buffer is corrupted.
  *
  * - -EIDRM is returned if @a bf is a deleted buffer descriptor.
  *
@@ -883,7 +1105,8 @@ ssize_t rt_buffer_write_until(RT_BUFFER *bf, const void *ptr, size_t len, RTIME
  * message.
  *
  * - -EINVAL is returned if @a bf is not a buffer descriptor, or @a
- * len is greater than the actual buffer length.
+ * len is greater than the actual buffer length, or the shared ring
+ * state of a B_MAPPED buffer is corrupted.
  *
  * - -EIDRM is returned if @a bf is a deleted buffer descriptor.
  *
@@ -987,7 +1210,8 @@ ssize_t rt_buffer_read(RT_BUFFER *bf, void *ptr, size_t len, RTIME timeout)
  * message.
  *
  * - -EINVAL is returned if @a bf is not a buffer descriptor, or @a
- * len is greater than the actual buffer length.
+ * len is greater than the actual buffer length, or the shared ring
+ * state of a B_MAPPED buffer is corrupted.
  *
  * - -EIDRM is returned if @a bf is a deleted buffer descriptor.
  *
@@ -1061,7 +1285,8 @@ ssize_t rt_buffer_read_until(RT_BUFFER *bf, void *ptr, size_t len, RTIME timeout
  *
  * @return 0 is returned upon success. Otherwise:
  *
- * - -EINVAL is returned if @a bf is not a buffer descriptor.
+ * - -EINVAL is returned if @a bf is not a buffer descriptor, or the
+ * shared ring state of a B_MAPPED buffer is corrupted.
  *
  * - -EIDRM is returned if @a bf is a deleted buffer descriptor.
  *
@@ -1080,6 +1305,7 @@ ssize_t rt_buffer_read_until(RT_BUFFER *bf, void *ptr, size_t len, RTIME timeout
 
 int rt_buffer_clear(RT_BUFFER *bf)
 {
+	unsigned long wrcount, rdcount;
 	int ret = 0;
 	spl_t s;
 
@@ -1091,9 +1317,30 @@ int rt_buffer_clear(RT_BUFFER *bf)
 		goto unlock_and_exit;
 	}
 
-	bf->wroff = 0;
-	bf->rdoff = 0;
-	bf->fillsz = 0;
+	if (bf->ring) {
+		/*
+		 * Consume everything on behalf of the reader, by
+		 * moving the read count up to the write count. A
+		 * user-space reader may move the read count
+		 * concurrently, so only publish if it did not.
+		 */
+		do {
+			wrcount = xnarch_atomic_get(&bf->ring->wrcount);
+			rdcount = xnarch_atomic_get(&bf->ring->rdcount);
+			if (buffer_check_counts(bf, wrcount, rdcount)) {
+				ret = -EINVAL;
+				goto unlock_and_exit;
+			}
+		} while (xnarch_atomic_cmpxchg(&bf->ring->rdcount,
+					       rdcount, wrcount) != rdcount);
+		ret = buffer_sync(bf);
+		if (ret)
+			goto unlock_and_exit;
+	} else {
+		bf->wroff = 0;
+		bf->rdoff = 0;
+		bf->fillsz = 0;
+	}
 
 	if (xnsynch_flush(&bf->osynch_base, 0) == XNSYNCH_RESCHED)
 		xnpod_schedule();
@@ -1153,6 +1400,9 @@ int rt_buffer_inquire(RT_BUFFER *bf, RT_BUFFER_INFO *info)
 	info->iwaiters = xnsynch_nsleepers(&bf->isynch_base);
 	info->owaiters = xnsynch_nsleepers(&bf->osynch_base);
 	info->totalmem = bf->bufsz;
+	ret = buffer_sync(bf);
+	if (ret)
+		goto unlock_and_exit;
 	info->availmem = bf->bufsz - bf->fillsz;
 
       unlock_and_exit:
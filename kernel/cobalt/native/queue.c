@@ -163,6 +163,61 @@ static void __queue_flush_private(xnheap_t *heap,
 	xnarch_free_host_mem(poolmem, poolsize);
 }
 
+#if defined(__KERNEL__) && defined(CONFIG_XENO_FASTSYNCH)
+
+static void __queue_init_cache(RT_QUEUE *q)
+{
+	/*
+	 * The free block cache is optional; user-space only falls
+	 * back to issuing syscalls if we could not get it.
+	 */
+	q->cache = xnheap_alloc(&q->bufpool, sizeof(*q->cache));
+	if (q->cache)
+		memset(q->cache, 0, sizeof(*q->cache));
+}
+
+/*
+ * Release all blocks parked in the free block cache to the pool, so
+ * that they may be merged into larger ones. User-space may compete
+ * with us for the cached blocks, so we claim each of them atomically.
+ * Since user-space fills the slots, offsets which do not lead to a
+ * block of the right class in the pool are dropped.
+ */
+static int __queue_drain_cache(RT_QUEUE *q)
+{
+	rt_queue_msg_t *msg;
+	unsigned long off;
+	xnarch_atomic_t *slot;
+	int c, n, count = 0;
+
+	if (q->cache == NULL)
+		return 0;
+
+	for (c = 0; c < Q_CACHE_CLASSES; c++)
+		for (n = 0; n < Q_CACHE_DEPTH; n++) {
+			slot = &q->cache->slots[c][n];
+			off = xnarch_atomic_get(slot);
+			if (off == 0 || xnarch_atomic_cmpxchg(slot, off, 0) != off)
+				continue;
+			msg = (rt_queue_msg_t *)
+				xnheap_mapped_address(&q->bufpool, off);
+			if (xnheap_check_block(&q->bufpool, msg) ||
+			    msg->bclass != c + 1)
+				continue;
+			xnheap_free(&q->bufpool, msg);
+			count++;
+		}
+
+	return count;
+}
+
+#else /* !(__KERNEL__ && CONFIG_XENO_FASTSYNCH) */
+
+#define __queue_init_cache(q)	do { (q)->cache = NULL; } while (0)
+#define __queue_drain_cache(q)	({ 0; })
+
+#endif /* !(__KERNEL__ && CONFIG_XENO_FASTSYNCH) */
+
 /**
  * @fn int rt_queue_create(RT_QUEUE *q,const char *name,size_t poolsize,size_t qlimit,int mode)
  *
@@ -274,11 +329,13 @@ int rt_queue_create(RT_QUEUE *q,
 			return err;
 
 		q->cpid = 0;
+		__queue_init_cache(q);
 	} else
 #endif /* __KERNEL__ */
 	{
 		void *poolmem;
 
+		q->cache = NULL;
 		poolsize = xnheap_rounded_size(poolsize, XNHEAP_PAGE_SIZE);
 
 		poolmem = xnarch_alloc_host_mem(poolsize);
@@ -449,6 +506,13 @@ int rt_queue_delete(RT_QUEUE *q)
  * @return The address of the allocated message buffer upon success,
  * or NULL if the allocation fails.
  *
+ * @note Small buffers released from user-space to a shared queue are
+ * parked in a per-queue cache, from which subsequent user-space
+ * allocations are served without issuing any system call. Those
+ * buffers are still accounted for as used memory by
+ * rt_queue_inquire(), until the kernel reclaims them when the pool
+ * runs short of memory.
+ *
  * Environments:
  *
  * This service can be called from:
@@ -464,6 +528,8 @@ int rt_queue_delete(RT_QUEUE *q)
 void *rt_queue_alloc(RT_QUEUE *q, size_t size)
 {
 	rt_queue_msg_t *msg;
+	size_t bsize;
+	int cclass;
 	spl_t s;
 
 	xnlock_get_irqsave(&nklock, s);
@@ -475,14 +541,25 @@ void *rt_queue_alloc(RT_QUEUE *q, size_t size)
 		return NULL;
 	}
 
-	msg =
-	    (rt_queue_msg_t *) xnheap_alloc(&q->bufpool,
-					    size + sizeof(rt_queue_msg_t));
+	/*
+	 * Small blocks from shared queues are rounded up to their
+	 * cache class, so that user-space may recycle them.
+	 */
+	cclass = q->cache ? rt_queue_cache_class(size) : -1;
+	if (cclass >= 0)
+		bsize = Q_CACHE_MINSIZE << cclass;
+	else
+		bsize = size + sizeof(rt_queue_msg_t);
+
+	msg = (rt_queue_msg_t *) xnheap_alloc(&q->bufpool, bsize);
+	if (msg == NULL && __queue_drain_cache(q) > 0)
+		msg = (rt_queue_msg_t *) xnheap_alloc(&q->bufpool, bsize);
 
 	if (msg) {
 		inith(&msg->link);
 		msg->size = size;	/* Zero is ok. */
 		msg->refcount = 1;
+		msg->bclass = cclass + 1;
 		++msg;
 	}
 
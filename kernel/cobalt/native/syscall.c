@@ -530,6 +530,30 @@ static int __rt_task_slice(RT_TASK_PLACEHOLDER __user *u_ph,
 	return rt_task_slice(task, quantum);
 }
 
+static int __rt_task_set_slack(RT_TASK_PLACEHOLDER __user *u_ph,
+			       RTIME __user *u_slack)
+{
+	RT_TASK_PLACEHOLDER ph;
+	RT_TASK *task;
+	RTIME slack;
+
+	if (u_ph) {
+		if (__xn_safe_copy_from_user(&ph, u_ph, sizeof(ph)))
+			return -EFAULT;
+
+		task = __rt_task_lookup(ph.opaque);
+	} else
+		task = __rt_task_current(current);
+
+	if (task == NULL)
+		return -ESRCH;
+
+	if (__xn_safe_copy_from_user(&slack, u_slack, sizeof(slack)))
+		return -EFAULT;
+
+	return rt_task_set_slack(task, slack);
+}
+
 #ifdef CONFIG_XENO_OPT_NATIVE_MPS
 
 static int __rt_task_send(RT_TASK_PLACEHOLDER __user *u_ph,
@@ -1578,6 +1602,8 @@ static int __rt_queue_create(RT_QUEUE_PLACEHOLDER __user *u_ph,
 	ph.opaque2 = &q->bufpool;
 	ph.mapsize = xnheap_extentsize(&q->bufpool);
 	ph.area = xnheap_base_memory(&q->bufpool);
+	ph.cacheoff = q->cache ?
+		xnheap_mapped_offset(&q->bufpool, q->cache) : 0;
 
 	return __xn_safe_copy_to_user(u_ph, &ph, sizeof(ph));
 
@@ -1609,6 +1635,8 @@ static int __rt_queue_bind(RT_QUEUE_PLACEHOLDER __user *u_ph,
 	ph.opaque2 = &q->bufpool;
 	ph.mapsize = xnheap_extentsize(&q->bufpool);
 	ph.area = xnheap_base_memory(&q->bufpool);
+	ph.cacheoff = q->cache ?
+		xnheap_mapped_offset(&q->bufpool, q->cache) : 0;
 	xnlock_put_irqrestore(&nklock, s);
 
 	if (__xn_safe_copy_to_user(u_ph, &ph, sizeof(ph)))
@@ -2346,6 +2374,23 @@ static int __rt_alarm_inquire(RT_ALARM_PLACEHOLDER __user *u_ph,
 
 #ifdef CONFIG_XENO_OPT_NATIVE_BUFFER
 
+static void __rt_buffer_fill_ph(RT_BUFFER_PLACEHOLDER *ph, RT_BUFFER *bf)
+{
+	/* Describe the ring memory to be mapped, if any. */
+	if (bf->bufpool) {
+		ph->opaque2 = bf->bufpool;
+		ph->mapsize = xnheap_extentsize(bf->bufpool);
+		ph->area = xnheap_base_memory(bf->bufpool);
+		ph->ringoff = xnheap_mapped_offset(bf->bufpool, bf->ring);
+	} else {
+		ph->opaque2 = NULL;
+		ph->mapsize = 0;
+		ph->area = 0;
+		ph->ringoff = 0;
+	}
+	ph->mapbase = NULL;
+}
+
 static int __rt_buffer_create(RT_BUFFER_PLACEHOLDER __user *u_ph,
 			      const char __user *u_name,
 			      size_t bufsz,
@@ -2373,6 +2418,7 @@ static int __rt_buffer_create(RT_BUFFER_PLACEHOLDER __user *u_ph,
 		bf->cpid = current->pid;
 		/* Copy back the registry handle to the ph struct. */
 		ph.opaque = bf->handle;
+		__rt_buffer_fill_ph(&ph, bf);
 		if (__xn_safe_copy_to_user(u_ph, &ph, sizeof(ph)))
 			ret = -EFAULT;
 	} else
@@ -2386,15 +2432,40 @@ static int __rt_buffer_bind(RT_BUFFER_PLACEHOLDER __user *u_ph,
 			    RTIME __user *u_timeout)
 {
 	RT_BUFFER_PLACEHOLDER ph;
+	RT_BUFFER *bf;
 	int ret;
+	spl_t s;
 
 	ret = __rt_bind_helper(u_name, u_timeout,
 			       &ph.opaque, XENO_BUFFER_MAGIC,
-			       NULL, 0);
+			       (void **)&bf, 0);
 	if (ret)
 		return ret;
 
-	return __xn_safe_copy_to_user(u_ph, &ph, sizeof(ph));
+	xnlock_get_irqsave(&nklock, s);
+
+	bf = xeno_h2obj_validate(bf, XENO_BUFFER_MAGIC, RT_BUFFER);
+	if (bf == NULL) {
+		xnlock_put_irqrestore(&nklock, s);
+		return -EIDRM;
+	}
+
+	__rt_buffer_fill_ph(&ph, bf);
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (__xn_safe_copy_to_user(u_ph, &ph, sizeof(ph)))
+		return -EFAULT;
+
+	/*
+	 * We might need to migrate to secondary mode now for mapping
+	 * the ring memory to user-space; since this syscall is
+	 * conforming, we might have entered it in primary mode.
+	 */
+	if (ph.mapsize && xnpod_primary_p())
+		xnshadow_relax(0, 0);
+
+	return 0;
 }
 
 static int __rt_buffer_delete(RT_BUFFER_PLACEHOLDER __user *u_ph)
@@ -2410,13 +2481,28 @@ static int __rt_buffer_delete(RT_BUFFER_PLACEHOLDER __user *u_ph)
 	if (bf == NULL)
 		return -ESRCH;
 
-	ret = rt_buffer_delete(bf);
+	ret = rt_buffer_delete_inner(bf, (void __user *)ph.mapbase);
 	if (ret == 0 && bf->cpid)
 		xnfree(bf);
 
 	return ret;
 }
 
+static int __rt_buffer_wakeup(RT_BUFFER_PLACEHOLDER __user *u_ph)
+{
+	RT_BUFFER_PLACEHOLDER ph;
+	RT_BUFFER *bf;
+
+	if (__xn_safe_copy_from_user(&ph, u_ph, sizeof(ph)))
+		return -EFAULT;
+
+	bf = xnregistry_fetch(ph.opaque);
+	if (bf == NULL)
+		return -ESRCH;
+
+	return rt_buffer_wakeup_inner(bf);
+}
+
 static int __rt_buffer_write(RT_BUFFER_PLACEHOLDER __user *u_ph,
 			     const void __user *u_buf,
 			     size_t size,
@@ -2521,6 +2607,7 @@ static int __rt_buffer_inquire(RT_BUFFER_PLACEHOLDER __user *u_ph,
 #define __rt_buffer_write    __rt_call_not_available
 #define __rt_buffer_clear    __rt_call_not_available
 #define __rt_buffer_inquire  __rt_call_not_available
+#define __rt_buffer_wakeup   __rt_call_not_available
 
 #endif /* !CONFIG_XENO_OPT_NATIVE_BUFFER */
 
@@ -2671,6 +2758,8 @@ static struct xnsysent __systab[] = {
  	SKINCALL_DEF(__native_buffer_write, __rt_buffer_write, conforming),
  	SKINCALL_DEF(__native_buffer_clear, __rt_buffer_clear, any),
  	SKINCALL_DEF(__native_buffer_inquire, __rt_buffer_inquire, any),
+	SKINCALL_DEF(__native_buffer_wakeup, __rt_buffer_wakeup, any),
+	SKINCALL_DEF(__native_task_set_slack, __rt_task_set_slack, any),
 };
 
 static struct xnskin_props __props = {
@@ -1637,6 +1637,78 @@ int rt_task_slice(RT_TASK *task, RTIME quantum)
 	return ret;
 }
 
+/**
+ * @fn int rt_task_set_slack(RT_TASK *task, RTIME slack)
+ * @brief Set a task's timer slack.
+ *
+ * Allow the timeouts of a task to elapse up to @a slack late, so that
+ * the nucleus may fire them along with the timers of other tasks
+ * instead of programming a separate hardware shot. This is meant for
+ * housekeeping tasks, watchdogs or protocol timeouts which do not
+ * need exact wakeups. The periodic timer of the task is not affected.
+ *
+ * @param task The descriptor address of the affected task. If @a task
+ * is NULL, the current task is considered.
+ *
+ * @param slack The tolerated delay expressed in ticks (see note). A
+ * null value, which is the default, requests exact timeouts.
+ *
+ * @return 0 is returned upon success. Otherwise:
+ *
+ * - -EINVAL is returned if @a task is not a task descriptor.
+ *
+ * - -EPERM is returned if @a task is NULL but not called from a task
+ * context.
+ *
+ * Environments:
+ *
+ * This service can be called from:
+ *
+ * - Kernel module initialization/cleanup code
+ * - Interrupt service routine
+ * only if @a task is non-NULL.
+ *
+ * - Kernel-based task
+ * - User-space task
+ *
+ * Rescheduling: never.
+ *
+ * @note The @a slack value is always interpreted as a count of
+ * ticks. If the task undergoes aperiodic timing, the tick duration is
+ * defined by CONFIG_XENO_OPT_TIMING_VIRTICK.
+ */
+
+int rt_task_set_slack(RT_TASK *task, RTIME slack)
+{
+	int ret = 0;
+	spl_t s;
+
+	if (task == NULL) {
+		if (!xnpod_primary_p())
+			return -EPERM;
+
+		task = xeno_current_task();
+	}
+
+	xnlock_get_irqsave(&nklock, s);
+
+	task = xeno_h2obj_validate(task, XENO_TASK_MAGIC, RT_TASK);
+
+	if (!task) {
+		ret = xeno_handle_error(task, XENO_TASK_MAGIC, RT_TASK);
+		goto unlock_and_exit;
+	}
+
+	xnthread_set_slack(&task->thread_base,
+			   xntbase_ticks2ns(__native_tbase, slack));
+
+      unlock_and_exit:
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	return ret;
+}
+
 #ifdef CONFIG_XENO_OPT_NATIVE_MPS
 
 /**
@@ -2542,6 +2614,7 @@ EXPORT_SYMBOL_GPL(rt_task_notify);
 EXPORT_SYMBOL_GPL(rt_task_set_mode);
 EXPORT_SYMBOL_GPL(rt_task_self);
 EXPORT_SYMBOL_GPL(rt_task_slice);
+EXPORT_SYMBOL_GPL(rt_task_set_slack);
 #ifdef CONFIG_XENO_OPT_NATIVE_MPS
 EXPORT_SYMBOL_GPL(rt_task_send);
 EXPORT_SYMBOL_GPL(rt_task_receive);
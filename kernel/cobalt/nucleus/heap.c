@@ -84,10 +84,14 @@ static DEFINE_XNQUEUE(heapq);	/* Heap list for v-file dump */
 
 static struct xnvfile_rev_tag vfile_tag;
 
+static struct xnvfile_rmlog vfile_rmlog;
+
 static struct xnvfile_snapshot_ops vfile_ops;
 
 struct vfile_priv {
 	struct xnholder *curr;
+	struct xnholder *last;
+	unsigned long rmseq;
 };
 
 struct vfile_data {
@@ -100,6 +104,7 @@ struct vfile_data {
 static struct xnvfile_snapshot vfile = {
 	.privsz = sizeof(struct vfile_priv),
 	.datasz = sizeof(struct vfile_data),
+	.chunksz = 16,
 	.tag = &vfile_tag,
 	.ops = &vfile_ops,
 };
@@ -109,10 +114,31 @@ static int vfile_rewind(struct xnvfile_snapshot_iterator *it)
 	struct vfile_priv *priv = xnvfile_iterator_priv(it);
 
 	priv->curr = getheadq(&heapq);
+	priv->last = NULL;
+	priv->rmseq = vfile_rmlog.seq;
 
 	return countq(&heapq);
 }
 
+static int vfile_resume(struct xnvfile_snapshot_iterator *it)
+{
+	struct vfile_priv *priv = xnvfile_iterator_priv(it);
+	int ret;
+
+	/*
+	 * Heaps were added or removed since the last chunk; pick up
+	 * after the last heap we reported, or the closest one before
+	 * it which still exists.
+	 */
+	ret = xnvfile_rmlog_resume(&vfile_rmlog, &priv->rmseq, &priv->last);
+	if (ret)
+		return ret;
+
+	priv->curr = priv->last ? nextq(&heapq, priv->last) : getheadq(&heapq);
+
+	return 0;
+}
+
 static int vfile_next(struct xnvfile_snapshot_iterator *it, void *data)
 {
 	struct vfile_priv *priv = xnvfile_iterator_priv(it);
@@ -123,6 +149,7 @@ static int vfile_next(struct xnvfile_snapshot_iterator *it, void *data)
 		return 0;	/* We are done. */
 
 	heap = container_of(priv->curr, struct xnheap, stat_link);
+	priv->last = priv->curr;
 	priv->curr = nextq(&heapq, priv->curr);
 
 	p->usable_mem = xnheap_usable_mem(heap);
@@ -153,6 +180,7 @@ static int vfile_show(struct xnvfile_snapshot_iterator *it, void *data)
 static struct xnvfile_snapshot_ops vfile_ops = {
 	.rewind = vfile_rewind,
 	.next = vfile_next,
+	.resume = vfile_resume,
 	.show = vfile_show,
 };
 
@@ -315,6 +343,9 @@ int xnheap_init(xnheap_t *heap,
 	heap->maxcont = heap->npages * pagesize;
 	for (cpu = 0; cpu < nr_cpus; cpu++)
 		heap->idleq[cpu] = NULL;
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+	heap->magazines = NULL;
+#endif
 	inith(&heap->link);
 	inith(&heap->stat_link);
 	initq(&heap->extents);
@@ -413,10 +444,19 @@ void xnheap_destroy(xnheap_t *heap,
 	spl_t s;
 
 	xnlock_get_irqsave(&nklock, s);
+	xnvfile_rmlog_add(&vfile_rmlog, &heapq, &heap->stat_link);
 	removeq(&heapq, &heap->stat_link);
 	xnvfile_touch_tag(&vfile_tag);
 	xnlock_put_irqrestore(&nklock, s);
 
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+	if (heap->magazines) {
+		xnarch_free_host_mem(heap->magazines,
+				     sizeof(*heap->magazines) * XNARCH_NR_CPUS);
+		heap->magazines = NULL;
+	}
+#endif /* CONFIG_XENO_OPT_HEAP_MAGAZINES */
+
 	if (!flushfn)
 		return;
 
@@ -535,6 +575,211 @@ static caddr_t get_free_range(xnheap_t *heap, u_long bsize, int log2size)
 	return headpage;
 }
 
+/*
+ * get_bucket_block() -- Obtain a block of 2 ** log2size bytes from
+ * the matching bucket, refilling it from the free page list if
+ * empty. The caller must have acquired the heap lock.
+ */
+static caddr_t get_bucket_block(xnheap_t *heap, u_long bsize, int log2size)
+{
+	int ilog = log2size - XNHEAP_MINLOG2;
+	xnholder_t *holder;
+	xnextent_t *extent;
+	u_long pagenum;
+	caddr_t block;
+
+	block = heap->buckets[ilog].freelist;
+
+	if (block == NULL) {
+		block = get_free_range(heap, bsize, log2size);
+		if (block == NULL)
+			return NULL;
+		if (bsize <= heap->pagesize)
+			heap->buckets[ilog].fcount += (heap->pagesize >> log2size) - 1;
+	} else {
+		if (bsize <= heap->pagesize)
+			--heap->buckets[ilog].fcount;
+
+		for (holder = getheadq(&heap->extents), extent = NULL;
+		     holder != NULL; holder = nextq(&heap->extents, holder)) {
+			extent = link2extent(holder);
+			if ((caddr_t) block >= extent->membase &&
+			    (caddr_t) block < extent->memlim)
+				break;
+		}
+		XENO_ASSERT(NUCLEUS, extent != NULL,
+			    xnpod_fatal("Cannot determine source extent for block %p (heap %p)?!",
+					block, heap);
+			);
+		pagenum = ((caddr_t) block - extent->membase) >> heap->pageshift;
+		++extent->pagemap[pagenum].bcount;
+	}
+
+	heap->buckets[ilog].freelist = *((caddr_t *) block);
+	heap->ubytes += bsize;
+
+	return block;
+}
+
+static int free_block(xnheap_t *heap, void *block, int (*ckfn) (void *block));
+
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+
+/*
+ * The per-CPU magazines are only ever touched by their owner CPU
+ * with hw interrupts off, so they need no lock. They hold blocks the
+ * shared heap considers as busy; we only go back to the heap lock
+ * for refilling an empty magazine or draining a full one, moving
+ * XNHEAP_MAG_BATCH blocks at once.
+ */
+static caddr_t magazine_alloc(xnheap_t *heap, u_long bsize, int log2size)
+{
+	int ilog = log2size - XNHEAP_MINLOG2, n;
+	struct xnheap_magazine *mag;
+	caddr_t block, next, batch;
+	spl_t s;
+
+	splhigh(s);
+
+	mag = heap->magazines + xnarch_current_cpu();
+	block = mag->buckets[ilog].freelist;
+	if (likely(block != NULL)) {
+		mag->buckets[ilog].freelist = *((caddr_t *) block);
+		--mag->buckets[ilog].fcount;
+		splexit(s);
+		return block;
+	}
+
+	/* Refill: the first block goes to the caller. */
+	xnlock_get(&heap->lock);
+
+	block = get_bucket_block(heap, bsize, log2size);
+	for (n = 0, batch = NULL; block && n < XNHEAP_MAG_BATCH; n++) {
+		next = get_bucket_block(heap, bsize, log2size);
+		if (next == NULL)
+			break;
+		*((caddr_t *) next) = batch;
+		batch = next;
+	}
+
+	xnlock_put(&heap->lock);
+
+	mag->buckets[ilog].freelist = batch;
+	mag->buckets[ilog].fcount = n;
+
+	splexit(s);
+
+	return block;
+}
+
+/*
+ * Returns -EAGAIN if @block cannot be cached, in which case the
+ * caller should release it to the shared heap. We only cache blocks
+ * from the initial extent, so that the page map lookup can be done
+ * locklessly: this extent stays first in the queue until the heap is
+ * destroyed, and the page map entry for a busy block is stable.
+ */
+static int magazine_free(xnheap_t *heap, void *block)
+{
+	struct xnheap_magazine *mag;
+	caddr_t drain, next, *tailp;
+	u_long pagenum, boffset;
+	xnextent_t *extent;
+	int log2size, ilog, n;
+	spl_t s;
+
+	extent = link2extent(getheadq(&heap->extents));
+	if ((caddr_t) block < extent->membase ||
+	    (caddr_t) block >= extent->memlim)
+		return -EAGAIN;
+
+	pagenum = ((caddr_t) block - extent->membase) >> heap->pageshift;
+	boffset = ((caddr_t) block -
+		   (extent->membase + (pagenum << heap->pageshift)));
+	log2size = extent->pagemap[pagenum].type;
+	ilog = log2size - XNHEAP_MINLOG2;
+
+	/* Let the slow path report bad blocks. */
+	if (log2size < XNHEAP_MINLOG2 || ilog >= XNHEAP_MAG_NBUCKETS ||
+	    (boffset & ((1 << log2size) - 1)) != 0)
+		return -EAGAIN;
+
+	splhigh(s);
+
+	mag = heap->magazines + xnarch_current_cpu();
+	*((caddr_t *) block) = mag->buckets[ilog].freelist;
+	mag->buckets[ilog].freelist = block;
+	if (likely(++mag->buckets[ilog].fcount <= XNHEAP_MAG_SIZE)) {
+		splexit(s);
+		return 0;
+	}
+
+	/* Keep the most recently released blocks, drain the others. */
+	n = mag->buckets[ilog].fcount - XNHEAP_MAG_BATCH;
+	mag->buckets[ilog].fcount = n;
+	for (tailp = &mag->buckets[ilog].freelist; n > 0; n--)
+		tailp = (caddr_t *)*tailp;
+	drain = *tailp;
+	*tailp = NULL;
+
+	xnlock_get(&heap->lock);
+
+	for (; drain; drain = next) {
+		next = *((caddr_t *) drain);
+		free_block(heap, drain, NULL);
+	}
+
+	xnlock_put(&heap->lock);
+
+	splexit(s);
+
+	return 0;
+}
+
+/*!
+ * \fn int xnheap_enable_magazines(xnheap_t *heap)
+ * \brief Enable per-CPU block caches on a memory heap.
+ *
+ * Once enabled, allocations and releases of small blocks are served
+ * from a cache private to the current CPU whenever possible,
+ * reducing contention on the heap lock. Blocks cached this way are
+ * accounted as used memory. The caches are dropped along with the
+ * heap by xnheap_destroy().
+ *
+ * @param heap The descriptor address of the heap.
+ *
+ * @return 0 is returned upon success, or -ENOMEM if the caches
+ * cannot be allocated.
+ *
+ * Environments:
+ *
+ * This service can be called from:
+ *
+ * - Kernel module initialization/cleanup code
+ *
+ * Rescheduling: never.
+ */
+
+int xnheap_enable_magazines(xnheap_t *heap)
+{
+	struct xnheap_magazine *mags;
+	size_t size;
+
+	size = sizeof(*mags) * XNARCH_NR_CPUS;
+	mags = xnarch_alloc_host_mem(size);
+	if (mags == NULL)
+		return -ENOMEM;
+
+	memset(mags, 0, size);
+	xnarch_memory_barrier();
+	heap->magazines = mags;
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(xnheap_enable_magazines);
+
+#endif /* CONFIG_XENO_OPT_HEAP_MAGAZINES */
+
 /*!
  * \fn void *xnheap_alloc(xnheap_t *heap, u_long size)
  * \brief Allocate a memory block from a memory heap.
@@ -569,12 +814,9 @@ static caddr_t get_free_range(xnheap_t *heap, u_long bsize, int log2size)
 
 void *xnheap_alloc(xnheap_t *heap, u_long size)
 {
-	xnholder_t *holder;
-	xnextent_t *extent;
-	int log2size, ilog;
-	u_long pagenum;
 	caddr_t block;
 	u_long bsize;
+	int log2size;
 	spl_t s;
 
 	if (size == 0)
@@ -614,39 +856,14 @@ void *xnheap_alloc(xnheap_t *heap, u_long size)
 		     bsize < size; bsize <<= 1, log2size++)
 			;	/* Loop */
 
-		ilog = log2size - XNHEAP_MINLOG2;
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+		if (heap->magazines &&
+		    log2size - XNHEAP_MINLOG2 < XNHEAP_MAG_NBUCKETS)
+			return magazine_alloc(heap, bsize, log2size);
+#endif /* CONFIG_XENO_OPT_HEAP_MAGAZINES */
 
 		xnlock_get_irqsave(&heap->lock, s);
-
-		block = heap->buckets[ilog].freelist;
-
-		if (block == NULL) {
-			block = get_free_range(heap, bsize, log2size);
-			if (block == NULL)
-				goto release_and_exit;
-			if (bsize <= heap->pagesize)
-				heap->buckets[ilog].fcount += (heap->pagesize >> log2size) - 1;
-		} else {
-			if (bsize <= heap->pagesize)
-				--heap->buckets[ilog].fcount;
-
-			for (holder = getheadq(&heap->extents), extent = NULL;
-			     holder != NULL; holder = nextq(&heap->extents, holder)) {
-				extent = link2extent(holder);
-				if ((caddr_t) block >= extent->membase &&
-				    (caddr_t) block < extent->memlim)
-					break;
-			}
-			XENO_ASSERT(NUCLEUS, extent != NULL,
-				    xnpod_fatal("Cannot determine source extent for block %p (heap %p)?!",
-						block, heap);
-				);
-			pagenum = ((caddr_t) block - extent->membase) >> heap->pageshift;
-			++extent->pagemap[pagenum].bcount;
-		}
-
-		heap->buckets[ilog].freelist = *((caddr_t *) block);
-		heap->ubytes += bsize;
+		block = get_bucket_block(heap, bsize, log2size);
 	} else {
 		if (size > heap->maxcont)
 			return NULL;
@@ -660,8 +877,6 @@ void *xnheap_alloc(xnheap_t *heap, u_long size)
 			heap->ubytes += size;
 	}
 
-      release_and_exit:
-
 	xnlock_put_irqrestore(&heap->lock, s);
 
 	return block;
@@ -709,15 +924,35 @@ EXPORT_SYMBOL_GPL(xnheap_alloc);
  */
 
 int xnheap_test_and_free(xnheap_t *heap, void *block, int (*ckfn) (void *block))
+{
+	spl_t s;
+	int err;
+
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+	if (heap->magazines && ckfn == NULL &&
+	    magazine_free(heap, block) == 0)
+		return 0;
+#endif /* CONFIG_XENO_OPT_HEAP_MAGAZINES */
+
+	xnlock_get_irqsave(&heap->lock, s);
+	err = free_block(heap, block, ckfn);
+	xnlock_put_irqrestore(&heap->lock, s);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(xnheap_test_and_free);
+
+/*
+ * free_block() -- Release a block to the shared heap. The caller
+ * must have acquired the heap lock.
+ */
+static int free_block(xnheap_t *heap, void *block, int (*ckfn) (void *block))
 {
 	caddr_t freepage, lastpage, nextpage, tailpage, freeptr, *tailptr;
 	int log2size, npages, err, nblocks, xpage, ilog;
 	u_long pagenum, pagecont, boffset, bsize;
 	xnextent_t *extent = NULL;
 	xnholder_t *holder;
-	spl_t s;
-
-	xnlock_get_irqsave(&heap->lock, s);
 
 	/* Find the extent from which the returned block is
 	   originating. */
@@ -730,10 +965,8 @@ int xnheap_test_and_free(xnheap_t *heap, void *block, int (*ckfn) (void *block))
 			break;
 	}
 
-	if (!holder) {
-		err = -EFAULT;
-		goto unlock_and_fail;
-	}
+	if (!holder)
+		return -EFAULT;
 
 	/* Compute the heading page number in the page map. */
 	pagenum = ((caddr_t) block - extent->membase) >> heap->pageshift;
@@ -746,17 +979,12 @@ int xnheap_test_and_free(xnheap_t *heap, void *block, int (*ckfn) (void *block))
 	case XNHEAP_PCONT:	/* Not a range heading page? */
 
 	      bad_block:
-		err = -EINVAL;
-
-	      unlock_and_fail:
-
-		xnlock_put_irqrestore(&heap->lock, s);
-		return err;
+		return -EINVAL;
 
 	case XNHEAP_PLIST:
 
 		if (ckfn && (err = ckfn(block)) != 0)
-			goto unlock_and_fail;
+			return err;
 
 		npages = 1;
 
@@ -807,7 +1035,7 @@ int xnheap_test_and_free(xnheap_t *heap, void *block, int (*ckfn) (void *block))
 			goto bad_block;
 
 		if (ckfn && (err = ckfn(block)) != 0)
-			goto unlock_and_fail;
+			return err;
 
 		/*
 		 * Return the page to the free list if we've just
@@ -889,11 +1117,8 @@ int xnheap_test_and_free(xnheap_t *heap, void *block, int (*ckfn) (void *block))
 
 	heap->ubytes -= bsize;
 
-	xnlock_put_irqrestore(&heap->lock, s);
-
 	return 0;
 }
-EXPORT_SYMBOL_GPL(xnheap_test_and_free);
 
 /*!
  * \fn int xnheap_free(xnheap_t *heap, void *block)
@@ -1018,7 +1243,14 @@ void xnheap_schedule_free(xnheap_t *heap, void *block, xnholder_t *link)
 	unsigned cpu;
 	spl_t s;
 
-	xnlock_get_irqsave(&heap->lock, s);
+	/*
+	 * Idle queues are per-CPU and only accessed by their owner
+	 * with hw interrupts off, so the heap lock is not needed
+	 * here. xnheap_finalize_free() later releases the blocks
+	 * from the same CPU, which refills its local cache if
+	 * enabled.
+	 */
+	splhigh(s);
 	/* Hack: we only need a one-way linked list for remembering the
 	   idle objects through the 'next' field, so the 'last' field of
 	   the link is used to point at the beginning of the freed
@@ -1027,7 +1259,7 @@ void xnheap_schedule_free(xnheap_t *heap, void *block, xnholder_t *link)
 	link->last = (xnholder_t *)block;
 	link->next = heap->idleq[cpu];
 	heap->idleq[cpu] = link;
-	xnlock_put_irqrestore(&heap->lock, s);
+	splexit(s);
 }
 EXPORT_SYMBOL_GPL(xnheap_schedule_free);
 
@@ -1401,6 +1633,7 @@ void xnheap_destroy_mapped(xnheap_t *heap,
 		       heap->label, heap->ubytes);
 
 	xnlock_get_irqsave(&nklock, s);
+	xnvfile_rmlog_add(&vfile_rmlog, &heapq, &heap->stat_link);
 	removeq(&heapq, &heap->stat_link);
 	xnvfile_touch_tag(&vfile_tag);
 	xnlock_put_irqrestore(&nklock, s);
@@ -137,7 +137,8 @@ int __init __xeno_sys_init(void)
 
 #ifndef __XENO_SIM__
 	ret = xnheap_init_mapped(&__xnsys_global_ppd.sem_heap,
-				 CONFIG_XENO_OPT_GLOBAL_SEM_HEAPSZ * 1024,
+				 CONFIG_XENO_OPT_GLOBAL_SEM_HEAPSZ * 1024 +
+				 XNSTAT_SHM_HEAPSZ,
 				 XNARCH_SHARED_HEAP_FLAGS);
 	if (ret)
 		goto cleanup_arch;
@@ -27,6 +27,8 @@
 #include <linux/termios.h>
 #include <linux/spinlock.h>
 #include <linux/device.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
 #include <asm/io.h>
 #include <asm/uaccess.h>
 #include <asm/system.h>
@@ -41,7 +43,11 @@ struct xnpipe_state xnpipe_states[XNPIPE_NDEVS];
 #define XNPIPE_BITMAP_SIZE	((XNPIPE_NDEVS + BITS_PER_LONG - 1) / BITS_PER_LONG)
 static unsigned long xnpipe_bitmap[XNPIPE_BITMAP_SIZE];
 
-struct xnqueue xnpipe_sleepq, xnpipe_asyncq;
+struct xnqueue xnpipe_sleepq, xnpipe_asyncq, xnpipe_relq;
+
+#define XNPIPE_RING_MAXSZ	(1 << 24)
+
+#define xnpipe_ring_mapsz(size)	PAGE_ALIGN(sizeof(struct xnpipe_ring) + (size))
 
 int xnpipe_wakeup_apc;
 
@@ -88,12 +94,18 @@ static inline void xnpipe_enqueue_wait(struct xnpipe_state *state, int mask)
 	__setbits(state->status, mask);
 }
 
+/*
+ * Once off the sleep queue, pending ready bits would never be
+ * consumed by the wakeup APC, and xnpipe_notify_reader() would keep
+ * assuming that a wakeup is in flight. Drop them along with the
+ * wait bits.
+ */
 static inline void xnpipe_dequeue_wait(struct xnpipe_state *state, int mask)
 {
 	if (testbits(state->status, mask))
 		if (--state->wcount == 0) {
 			removeq(&xnpipe_sleepq, &state->slink);
-			__clrbits(state->status, mask);
+			__clrbits(state->status, mask | XNPIPE_USER_ALL_READY);
 		}
 }
 
@@ -103,7 +115,7 @@ static inline void xnpipe_dequeue_all(struct xnpipe_state *state, int mask)
 		if (state->wcount) {
 			state->wcount = 0;
 			removeq(&xnpipe_sleepq, &state->slink);
-			__clrbits(state->status, mask);
+			__clrbits(state->status, mask | XNPIPE_USER_ALL_READY);
 		}
 	}
 }
@@ -138,6 +150,45 @@ static inline void xnpipe_dequeue_all(struct xnpipe_state *state, int mask)
 	__sigpending;							\
 })
 
+static inline ssize_t xnpipe_flush_bufq(void (*fn)(void *buf, void *xstate),
+					struct xnqueue *q,
+					void *xstate)
+{
+	struct xnpipe_mh *mh;
+	struct xnholder *h;
+	ssize_t n = 0;
+
+	/* Queue is private, no locking is required. */
+	while ((h = getq(q)) != NULL) {
+		mh = link2mh(h);
+		n += xnpipe_m_size(mh);
+		fn(mh, xstate);
+	}
+
+	/* We must return the overall count of bytes flushed. */
+	return n;
+}
+
+/*
+ * Move the specified queue contents to a private queue, then call the
+ * flush handler to purge it. The latter is run without locking.
+ * Returns the number of bytes flushed. Must be entered with nklock
+ * held, interrupts off.
+ */
+#define xnpipe_flushq(__state, __q, __f, __s)				\
+({									\
+	struct xnqueue __privq;						\
+	ssize_t n;							\
+									\
+	initq(&__privq);						\
+	moveq(&__privq, &(state)->__q);					\
+	xnlock_put_irqrestore(&nklock, (__s));				\
+	n = xnpipe_flush_bufq((__state)->ops.__f, &__privq, (__state)->xstate);	\
+	xnlock_get_irqsave(&nklock, (__s));				\
+									\
+	n;								\
+})
+
 static void xnpipe_wakeup_proc(void *cookie)
 {
 	struct xnpipe_state *state;
@@ -147,6 +198,15 @@ static void xnpipe_wakeup_proc(void *cookie)
 
 	xnlock_get_irqsave(&nklock, s);
 
+	/*
+	 * Release the messages the Xenomai side copied to mapped
+	 * rings since we last ran, all at once.
+	 */
+	while ((h = getq(&xnpipe_relq)) != NULL) {
+		state = link2xnpipe(h, rlink);
+		xnpipe_flushq(state, relq, free_obuf, s);
+	}
+
 	nh = getheadq(&xnpipe_sleepq);
 	while ((h = nh) != NULL) {
 		nh = nextq(&xnpipe_sleepq, h);
@@ -214,44 +274,169 @@ static inline void xnpipe_schedule_request(void) /* hw IRQs off */
 	__rthal_apc_schedule(xnpipe_wakeup_apc);
 }
 
-static inline ssize_t xnpipe_flush_bufq(void (*fn)(void *buf, void *xstate),
-					struct xnqueue *q,
-					void *xstate)
+/*
+ * Tell whether the reader should be kicked for new output. The
+ * wakeup APC being already pending once the ready bits are raised,
+ * back-to-back sends only request it once. Must be entered with
+ * nklock held, interrupts off.
+ */
+static inline int xnpipe_notify_reader(struct xnpipe_state *state)
 {
-	struct xnpipe_mh *mh;
-	struct xnholder *h;
-	ssize_t n = 0;
+	int need_sched = 0;
 
-	/* Queue is private, no locking is required. */
-	while ((h = getq(q)) != NULL) {
-		mh = link2mh(h);
-		n += xnpipe_m_size(mh);
-		fn(mh, xstate);
+	if (testbits(state->status, XNPIPE_USER_WREAD) &&
+	    !testbits(state->status, XNPIPE_USER_WREAD_READY)) {
+		/*
+		 * Wake up the regular Linux task waiting for input
+		 * from the Xenomai side.
+		 */
+		__setbits(state->status, XNPIPE_USER_WREAD_READY);
+		need_sched = 1;
 	}
 
-	/* We must return the overall count of bytes flushed. */
-	return n;
+	if (state->asyncq &&	/* Schedule asynch sig. */
+	    !testbits(state->status, XNPIPE_USER_SIGIO)) {
+		__setbits(state->status, XNPIPE_USER_SIGIO);
+		need_sched = 1;
+	}
+
+	return need_sched;
 }
 
 /*
- * Move the specified queue contents to a private queue, then call the
- * flush handler to purge it. The latter is run without locking.
- * Returns the number of bytes flushed. Must be entered with nklock
- * held, interrupts off.
+ * Append a record to the mapped output ring. We keep our own copy
+ * of the size and head offset, so that the reader may not fool us;
+ * the tail offset it updates is only used to compute the free room,
+ * which may be wrong but never leads us out of the ring. Must be
+ * entered with nklock held, interrupts off, which is why the record
+ * size is capped to XNPIPE_REC_MAXSZ: we copy the payload there.
  */
-#define xnpipe_flushq(__state, __q, __f, __s)				\
-({									\
-	struct xnqueue __privq;						\
-	ssize_t n;							\
-									\
-	initq(&__privq);						\
-	moveq(&__privq, &(state)->__q);					\
-	xnlock_put_irqrestore(&nklock, (__s));				\
-	n = xnpipe_flush_bufq((__state)->ops.__f, &__privq, (__state)->xstate);	\
-	xnlock_get_irqsave(&nklock, (__s));				\
-									\
-	n;								\
-})
+static int xnpipe_ring_put(struct xnpipe_state *state,
+			   const void *data, size_t size)
+{
+	struct xnpipe_ring *ring = state->ring;
+	unsigned int head = state->rhead, off, len, pad;
+	struct xnpipe_rec *rec;
+
+	if (size > XNPIPE_REC_MAXSZ)
+		return -EMSGSIZE;
+
+	len = xnpipe_rec_span(size);
+	if (len > state->rsize)
+		return -EMSGSIZE;
+
+	off = head & (state->rsize - 1);
+	pad = state->rsize - off;
+	if (pad >= len)
+		pad = 0;
+
+	if (len + pad > state->rsize - (head - ring->tail)) {
+		ring->dropped++;
+		return -ENOBUFS;
+	}
+
+	/* Make sure we don't overwrite data the reader still uses. */
+	xnarch_memory_barrier();
+
+	if (pad) {
+		rec = (struct xnpipe_rec *)(xnpipe_ring_data(ring) + off);
+		rec->size = pad - sizeof(*rec);
+		rec->flags = XNPIPE_REC_PAD;
+		head += pad;
+		off = 0;
+	}
+
+	rec = (struct xnpipe_rec *)(xnpipe_ring_data(ring) + off);
+	rec->size = size;
+	rec->flags = 0;
+	memcpy(xnpipe_rec_data(rec), data, size);
+	head += len;
+
+	xnarch_write_memory_barrier();
+	ring->head = head;
+	state->rhead = head;
+
+	return 0;
+}
+
+static inline void xnpipe_free_ring(struct xnpipe_ring *ring, size_t size)
+{
+	unsigned long vaddr, vabase = (unsigned long)ring;
+
+	for (vaddr = vabase; vaddr < vabase + size; vaddr += PAGE_SIZE)
+		ClearPageReserved(vmalloc_to_page((void *)vaddr));
+
+	vfree(ring);
+}
+
+static int xnpipe_set_ring(struct xnpipe_state *state, unsigned long size)
+{
+	unsigned long vaddr, vabase;
+	struct xnpipe_ring *ring;
+	size_t mapsz;
+	spl_t s;
+
+	if (size < PAGE_SIZE || size > XNPIPE_RING_MAXSZ ||
+	    (size & (size - 1)) != 0)
+		return -EINVAL;
+
+	mapsz = xnpipe_ring_mapsz(size);
+	ring = vmalloc(mapsz);
+	if (ring == NULL)
+		return -ENOMEM;
+
+	memset(ring, 0, mapsz);
+	ring->size = size;
+
+	vabase = (unsigned long)ring;
+	for (vaddr = vabase; vaddr < vabase + mapsz; vaddr += PAGE_SIZE)
+		SetPageReserved(vmalloc_to_page((void *)vaddr));
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if (state->ring) {
+		xnlock_put_irqrestore(&nklock, s);
+		xnpipe_free_ring(ring, mapsz);
+		return -EBUSY;
+	}
+
+	state->ring = ring;
+	state->rsize = size;
+	state->rhead = 0;
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	return 0;
+}
+
+/*
+ * Copy a message to the mapped ring. The message buffer is released
+ * later on by the wakeup APC, since the caller may hold locks the
+ * free_obuf handler needs. Must be entered with nklock held,
+ * interrupts off.
+ */
+static int xnpipe_ring_send(struct xnpipe_state *state, struct xnpipe_mh *mh)
+{
+	int ret;
+
+	ret = xnpipe_ring_put(state, xnpipe_m_data(mh), xnpipe_m_size(mh));
+	if (ret)
+		return ret;
+
+	/* rdoff == size marks a message which went to the ring. */
+	xnpipe_m_rdoff(mh) = xnpipe_m_size(mh);
+
+	if (state->ops.output)
+		state->ops.output(mh, state->xstate);
+
+	appendq(&state->relq, xnpipe_m_link(mh));
+	if (countq(&state->relq) > 1)
+		return 0;	/* Release already pending. */
+
+	appendq(&xnpipe_relq, &state->rlink);
+
+	return 1;
+}
 
 static void *xnpipe_default_alloc_ibuf(size_t size, void *xstate)
 {
@@ -372,6 +557,11 @@ int xnpipe_disconnect(int minor)
 
 	state->ionrd -= xnpipe_flushq(state, outq, free_obuf, s);
 
+	if (!emptyq_p(&state->relq)) {
+		removeq(&xnpipe_relq, &state->rlink);
+		xnpipe_flushq(state, relq, free_obuf, s);
+	}
+
 	if (!testbits(state->status, XNPIPE_USER_CONN))
 		goto cleanup;
 
@@ -422,7 +612,7 @@ EXPORT_SYMBOL_GPL(xnpipe_disconnect);
 ssize_t xnpipe_send(int minor, struct xnpipe_mh *mh, size_t size, int flags)
 {
 	struct xnpipe_state *state;
-	int need_sched = 0;
+	int need_sched = 0, ret;
 	spl_t s;
 
 	if (minor < 0 || minor >= XNPIPE_NDEVS)
@@ -443,6 +633,21 @@ ssize_t xnpipe_send(int minor, struct xnpipe_mh *mh, size_t size, int flags)
 	inith(xnpipe_m_link(mh));
 	xnpipe_m_size(mh) = size - sizeof(*mh);
 	xnpipe_m_rdoff(mh) = 0;
+
+	/*
+	 * Output goes to the mapped ring if the reader set one up;
+	 * urgent messages cannot jump the queue there.
+	 */
+	if (state->ring) {
+		ret = xnpipe_ring_send(state, mh);
+		if (ret < 0) {
+			xnlock_put_irqrestore(&nklock, s);
+			return ret;
+		}
+		need_sched = ret;
+		goto kick;
+	}
+
 	state->ionrd += xnpipe_m_size(mh);
 
 	if (flags & XNPIPE_URGENT)
@@ -454,20 +659,8 @@ ssize_t xnpipe_send(int minor, struct xnpipe_mh *mh, size_t size, int flags)
 		xnlock_put_irqrestore(&nklock, s);
 		return (ssize_t) size;
 	}
-
-	if (testbits(state->status, XNPIPE_USER_WREAD)) {
-		/*
-		 * Wake up the regular Linux task waiting for input
-		 * from the Xenomai side.
-		 */
-		__setbits(state->status, XNPIPE_USER_WREAD_READY);
-		need_sched = 1;
-	}
-
-	if (state->asyncq) {	/* Schedule asynch sig. */
-		__setbits(state->status, XNPIPE_USER_SIGIO);
-		need_sched = 1;
-	}
+kick:
+	need_sched |= xnpipe_notify_reader(state);
 
 	if (need_sched)
 		xnpipe_schedule_request();
@@ -481,6 +674,7 @@ EXPORT_SYMBOL_GPL(xnpipe_send);
 ssize_t xnpipe_mfixup(int minor, struct xnpipe_mh *mh, ssize_t size)
 {
 	struct xnpipe_state *state;
+	int ret;
 	spl_t s;
 
 	if (minor < 0 || minor >= XNPIPE_NDEVS)
@@ -498,8 +692,22 @@ ssize_t xnpipe_mfixup(int minor, struct xnpipe_mh *mh, ssize_t size)
 		return -EBADF;
 	}
 
-	xnpipe_m_size(mh) += size;
-	state->ionrd += size;
+	if (state->ring && xnpipe_m_rdoff(mh) == xnpipe_m_size(mh)) {
+		/* Already sent to the ring, push the extra data there. */
+		ret = xnpipe_ring_put(state, xnpipe_m_data(mh) +
+				      xnpipe_m_size(mh), size);
+		if (ret) {
+			xnlock_put_irqrestore(&nklock, s);
+			return ret;
+		}
+		xnpipe_m_size(mh) += size;
+		xnpipe_m_rdoff(mh) += size;
+		if (xnpipe_notify_reader(state))
+			xnpipe_schedule_request();
+	} else {
+		xnpipe_m_size(mh) += size;
+		state->ionrd += size;
+	}
 
 	xnlock_put_irqrestore(&nklock, s);
 
@@ -691,6 +899,8 @@ static int xnpipe_open(struct inode *inode, struct file *file)
 static int xnpipe_release(struct inode *inode, struct file *file)
 {
 	struct xnpipe_state *state = file->private_data;
+	struct xnpipe_ring *ring;
+	unsigned int rsize;
 	spl_t s;
 
 	xnlock_get_irqsave(&nklock, s);
@@ -717,6 +927,14 @@ static int xnpipe_release(struct inode *inode, struct file *file)
 		xnlock_get_irqsave(&nklock, s);
 	}
 
+	/*
+	 * No mapping may exist anymore at this point, since any of
+	 * them would hold a reference on the file.
+	 */
+	ring = state->ring;
+	rsize = state->rsize;
+	state->ring = NULL;
+
 	xnpipe_cleanup_user_conn(state, s);
 	/*
 	 * The extra state may not be available from now on, if
@@ -726,6 +944,9 @@ static int xnpipe_release(struct inode *inode, struct file *file)
 	 */
 	xnlock_put_irqrestore(&nklock, s);
 
+	if (ring)
+		xnpipe_free_ring(ring, xnpipe_ring_mapsz(rsize));
+
 	return 0;
 }
 
@@ -975,6 +1196,11 @@ static DECLARE_IOCTL_HANDLER(xnpipe_ioctl, file, cmd, arg)
 		xnpipe_asyncsig = arg;
 		break;
 
+	case XNPIPEIOC_SETRING:
+
+		ret = xnpipe_set_ring(state, arg);
+		break;
+
 	case FIONREAD:
 
 		n = testbits(state->status,
@@ -1015,6 +1241,8 @@ static int xnpipe_fasync(int fd, struct file *file, int on)
 	} else if (queued) {
 		xnlock_get_irqsave(&nklock, s);
 		removeq(&xnpipe_asyncq, &state->alink);
+		/* Same as for the ready bits, see xnpipe_dequeue_wait(). */
+		__clrbits(state->status, XNPIPE_USER_SIGIO);
 		xnlock_put_irqrestore(&nklock, s);
 	}
 
@@ -1034,7 +1262,8 @@ static unsigned xnpipe_poll(struct file *file, poll_table *pt)
 	if (testbits(state->status, XNPIPE_KERN_CONN))
 		w_mask |= (POLLOUT | POLLWRNORM);
 
-	if (!emptyq_p(&state->outq))
+	if (!emptyq_p(&state->outq) ||
+	    (state->ring && state->ring->tail != state->rhead))
 		r_mask |= (POLLIN | POLLRDNORM);
 	else
 		/*
@@ -1056,6 +1285,45 @@ static unsigned xnpipe_poll(struct file *file, poll_table *pt)
 	return r_mask | w_mask;
 }
 
+#ifdef CONFIG_MMU
+
+static int xnpipe_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct xnpipe_state *state = file->private_data;
+	unsigned long maddr, vaddr;
+	size_t size;
+	spl_t s;
+
+	if (vma->vm_pgoff != 0)
+		return -EINVAL;
+
+	if ((vma->vm_flags & VM_WRITE) && !(vma->vm_flags & VM_SHARED))
+		return -EINVAL;	/* COW unsupported. */
+
+	/* The ring may only go away when the file is released. */
+	xnlock_get_irqsave(&nklock, s);
+	vaddr = (unsigned long)state->ring;
+	size = xnpipe_ring_mapsz(state->rsize);
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (vaddr == 0)
+		return -ENXIO;	/* XNPIPEIOC_SETRING first. */
+
+	if (vma->vm_end - vma->vm_start > size)
+		return -EINVAL;
+
+	for (maddr = vma->vm_start; maddr < vma->vm_end;
+	     maddr += PAGE_SIZE, vaddr += PAGE_SIZE)
+		if (xnarch_remap_vm_page(vma, maddr, vaddr))
+			return -EAGAIN;
+
+	xnarch_fault_range(vma);
+
+	return 0;
+}
+
+#endif /* CONFIG_MMU */
+
 static struct file_operations xnpipe_fops = {
 	.owner = THIS_MODULE,
 	.read = xnpipe_read,
@@ -1064,7 +1332,10 @@ static struct file_operations xnpipe_fops = {
 	.unlocked_ioctl = xnpipe_ioctl,
 	.open = xnpipe_open,
 	.release = xnpipe_release,
-	.fasync = xnpipe_fasync
+	.fasync = xnpipe_fasync,
+#ifdef CONFIG_MMU
+	.mmap = xnpipe_mmap,
+#endif /* CONFIG_MMU */
 };
 
 int xnpipe_mount(void)
@@ -1077,14 +1348,18 @@ int xnpipe_mount(void)
 	     state < &xnpipe_states[XNPIPE_NDEVS]; state++) {
 		inith(&state->slink);
 		inith(&state->alink);
+		inith(&state->rlink);
 		state->status = 0;
 		state->asyncq = NULL;
+		state->ring = NULL;
 		initq(&state->inq);
 		initq(&state->outq);
+		initq(&state->relq);
 	}
 
 	initq(&xnpipe_sleepq);
 	initq(&xnpipe_asyncq);
+	initq(&xnpipe_relq);
 
 	xnpipe_class = class_create(THIS_MODULE, "rtpipe");
 	if (IS_ERR(xnpipe_class)) {
@@ -44,6 +44,8 @@
 #include <nucleus/stat.h>
 #include <nucleus/assert.h>
 #include <nucleus/select.h>
+#include <nucleus/threadstat.h>
+#include <nucleus/vdso.h>
 #include <asm/xenomai/bits/pod.h>
 
 /*
@@ -194,6 +196,38 @@ static inline int __xnpod_fault_init_fpu(struct xnthread *thread)
 
 #endif /* !CONFIG_XENO_HW_FPU */
 
+#if XNSTAT_SHM_NR > 0
+
+static inline void xnpod_publish_stat(struct xnsched *sched,
+				      struct xnthread *thread, int running)
+{
+	struct xnvdso_thread_stat *p = thread->stat.shm;
+
+	if (p == NULL)
+		return;
+
+	xnwrite_seqcount_begin(&p->seqcount);
+	p->flags = XNSTAT_SHM_USED | running;
+	p->cpu = xnsched_cpu(sched);
+	p->pid = xnthread_user_pid(thread);
+	p->state = xnthread_state_flags(thread);
+	p->ssw = xnstat_counter_get(&thread->stat.ssw);
+	p->csw = xnstat_counter_get(&thread->stat.csw);
+	p->pf = xnstat_counter_get(&thread->stat.pf);
+	p->exectime = xnstat_exectime_get_total(&thread->stat.account);
+	p->lastswitch = xnstat_exectime_get_last_switch(sched);
+	xnwrite_seqcount_end(&p->seqcount);
+}
+
+#else /* XNSTAT_SHM_NR == 0 */
+
+static inline void xnpod_publish_stat(struct xnsched *sched,
+				      struct xnthread *thread, int running)
+{
+}
+
+#endif /* XNSTAT_SHM_NR == 0 */
+
 void xnpod_fatal_helper(const char *format, ...)
 {
 	static char msg_buf[1024];
@@ -313,7 +347,8 @@ static void xnpod_flush_stackpool(xnheap_t *heap,
  *
  * @return 0 is returned on success. Otherwise:
  *
- * - -ENOMEM is returned if the memory manager fails to initialize.
+ * - -ENOMEM is returned if the memory manager fails to initialize,
+ * or the timer queues cannot grow.
  *
  * Environments:
  *
@@ -371,6 +406,10 @@ int xnpod_init(void)
 		return -ENOMEM;
 	}
 	xnheap_set_label(&kheap, "main heap");
+#ifdef CONFIG_XENO_OPT_HEAP_MAGAZINES
+	/* Best effort, the shared heap works fine without caches. */
+	xnheap_enable_magazines(&kheap);
+#endif
 
 #if CONFIG_XENO_OPT_SYS_STACKPOOLSZ > 0
 	/*
@@ -398,8 +437,10 @@ int xnpod_init(void)
 	for (cpu = 0; cpu < nr_cpus; ++cpu) {
 		sched = &pod->sched[cpu];
 		xnsched_init(sched, cpu);
-		if (xnarch_cpu_supported(cpu))
+		if (xnarch_cpu_supported(cpu)) {
 			appendq(&pod->threadq, &sched->rootcb.glink);
+			xnstat_shm_attach(&sched->rootcb);
+		}
 	}
 
 	xnarch_hook_ipi(&xnpod_schedule_handler);
@@ -410,7 +451,10 @@ int xnpod_init(void)
 	xnarch_memory_barrier();
 	xnarch_notify_ready();
 
-	ret = xnpod_enable_timesource();
+	/* Now that all timer queues exist, make room for the timers. */
+	ret = xntimer_reserve_queues();
+	if (ret == 0)
+		ret = xnpod_enable_timesource();
 	if (ret) {
 		xnpod_shutdown(XNPOD_FATAL_EXIT);
 		return ret;
@@ -490,6 +534,7 @@ void xnpod_shutdown(int xtype)
 
 	for (cpu = 0; cpu < xnarch_num_online_cpus(); cpu++) {
 		sched = xnpod_sched_slot(cpu);
+		xnstat_shm_detach(&sched->rootcb);
 		xnsched_destroy(sched);
 	}
 
@@ -639,6 +684,7 @@ int xnpod_init_thread(struct xnthread *thread,
 	xnlock_get_irqsave(&nklock, s);
 	appendq(&nkpod->threadq, &thread->glink);
 	xnvfile_touch_tag(&nkpod->threadlist_tag);
+	xnstat_shm_attach(thread);
 	xnpod_suspend_thread(thread, XNDORMANT | (attr->flags & XNSUSP), XN_INFINITE,
 			     XN_RELATIVE, NULL);
 	xnlock_put_irqrestore(&nklock, s);
@@ -1093,8 +1139,11 @@ void xnpod_delete_thread(xnthread_t *thread)
 	trace_mark(xn_nucleus, thread_delete, "thread %p thread_name %s",
 		   thread, xnthread_name(thread));
 
+	xnvfile_rmlog_add(&nkpod->threadlist_rmlog,
+			  &nkpod->threadq, &thread->glink);
 	removeq(&nkpod->threadq, &thread->glink);
 	xnvfile_touch_tag(&nkpod->threadlist_tag);
+	xnstat_shm_detach(thread);
 
 	if (xnthread_test_state(thread, XNREADY)) {
 		XENO_BUGON(NUCLEUS, xnthread_test_state(thread, XNTHREAD_BLOCK_BITS));
@@ -2176,6 +2225,8 @@ reschedule:
 
 	xnstat_exectime_switch(sched, &next->stat.account);
 	xnstat_counter_inc(&next->stat.csw);
+	xnpod_publish_stat(sched, prev, 0);
+	xnpod_publish_stat(sched, next, XNSTAT_SHM_RUNNING);
 
 	xnpod_switch_to(sched, prev, next);
 
@@ -2631,11 +2682,11 @@ int xnpod_enable_timesource(void)
 #endif /* CONFIG_XENO_OPT_STATS */
 
 	nktbase.status = XNTBRUN;
-
-	xnlock_put_irqrestore(&nklock, s);
-
 	nktbase.wallclock_offset =
 		xnarch_get_host_time() - xnarch_get_cpu_time();
+	xnvdso_update_wallclock(nktbase.wallclock_offset);
+
+	xnlock_put_irqrestore(&nklock, s);
 
 	for (cpu = 0; cpu < xnarch_num_online_cpus(); cpu++) {
 
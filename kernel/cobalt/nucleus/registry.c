@@ -59,6 +59,15 @@ static struct xnobject **registry_hash_table;
 
 static int registry_hash_entries;
 
+static int registry_hash_count;	/* Named objects. */
+
+/*
+ * The name table starts small and doubles each time the number of
+ * named objects exceeds its bucket count, until it can hold every
+ * registry slot at a load factor of one.
+ */
+#define REGISTRY_HASH_MIN	32
+
 static struct xnsynch registry_hash_synch;
 
 #ifdef CONFIG_XENO_OPT_VFILE
@@ -104,15 +113,6 @@ static struct xnvfile_regular usage_vfile = {
 
 int xnregistry_init(void)
 {
-	static const int primes[] = {
-		101, 211, 307, 401, 503, 601,
-		701, 809, 907, 1009, 1103
-	};
-
-#define obj_hash_max(n)			 \
-((n) < sizeof(primes) / sizeof(int) ? \
- (n) : sizeof(primes) / sizeof(int) - 1)
-
 	int n, ret;
 
 	registry_obj_slots =
@@ -150,15 +150,17 @@ int xnregistry_init(void)
 	for (n = 0; n < CONFIG_XENO_OPT_REGISTRY_NRSLOTS; n++) {
 		inith(&registry_obj_slots[n].link);
 		registry_obj_slots[n].objaddr = NULL;
+		registry_obj_slots[n].handle = n;
+		xnarch_atomic_set(&registry_obj_slots[n].safelock, 0);
 		appendq(&registry_obj_freeq, &registry_obj_slots[n].link);
 	}
 
 	getq(&registry_obj_freeq);	/* Slot #0 is reserved/invalid. */
 
-	registry_hash_entries =
-	    primes[obj_hash_max(CONFIG_XENO_OPT_REGISTRY_NRSLOTS / 100)];
-	registry_hash_table = xnarch_alloc_host_mem(sizeof(struct xnobject *) *
-						    registry_hash_entries);
+	registry_hash_entries = REGISTRY_HASH_MIN;
+	registry_hash_count = 0;
+	registry_hash_table = xnmalloc(sizeof(struct xnobject *) *
+				       registry_hash_entries);
 
 	if (registry_hash_table == NULL) {
 #ifdef CONFIG_XENO_OPT_VFILE
@@ -205,8 +207,7 @@ void xnregistry_cleanup(void)
 	}
 #endif /* CONFIG_XENO_OPT_VFILE */
 
-	xnarch_free_host_mem(registry_hash_table,
-		       sizeof(struct xnobject *) * registry_hash_entries);
+	xnfree(registry_hash_table);
 
 	xnsynch_destroy(&registry_hash_synch);
 
@@ -362,6 +363,7 @@ static int registry_export_vfsnap(struct xnobject *object,
 	p = container_of(pnode, struct xnpnode_snapshot, node);
 	object->vfile_u.vfsnap.file.datasz = p->vfile.datasz;
 	object->vfile_u.vfsnap.file.privsz = p->vfile.privsz;
+	object->vfile_u.vfsnap.file.chunksz = p->vfile.chunksz;
 	/*
 	 * Make the vfile refer to the provided tag struct if any,
 	 * otherwise use our default tag space. In the latter case,
@@ -511,7 +513,7 @@ static inline void registry_unexport_pnode(struct xnobject *object)
 
 #endif /* CONFIG_XENO_OPT_VFILE */
 
-static unsigned registry_hash_crunch(const char *key)
+static unsigned __registry_hash_crunch(const char *key)
 {
 	unsigned int h = 0, g;
 
@@ -524,7 +526,69 @@ static unsigned registry_hash_crunch(const char *key)
 			h = (h ^ (g >> HQON)) ^ g;
 	}
 
-	return h % registry_hash_entries;
+	return h;
+}
+
+static inline unsigned registry_hash_crunch(const char *key)
+{
+	return __registry_hash_crunch(key) % registry_hash_entries;
+}
+
+/*
+ * Grow the name table if it became too crowded. The new table is
+ * obtained from the system heap without holding nklock, then the
+ * entries are moved over with the lock held; this costs at most
+ * CONFIG_XENO_OPT_REGISTRY_NRSLOTS chain insertions, once per size
+ * doubling. If memory is short, we keep going with longer chains.
+ */
+static void registry_hash_grow(void)
+{
+	struct xnobject **table, **oldtable, *ecurr, *enext;
+	int entries, oldentries, n;
+	unsigned h;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+	oldentries = registry_hash_entries;
+	entries = registry_hash_count > oldentries &&
+		oldentries < CONFIG_XENO_OPT_REGISTRY_NRSLOTS ?
+		oldentries * 2 : oldentries;
+	xnlock_put_irqrestore(&nklock, s);
+
+	if (entries == oldentries)
+		return;
+
+	table = xnmalloc(sizeof(struct xnobject *) * entries);
+	if (table == NULL)
+		return;
+
+	for (n = 0; n < entries; n++)
+		table[n] = NULL;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	/* Someone may have raced us for growing the table. */
+	if (registry_hash_entries != oldentries) {
+		xnlock_put_irqrestore(&nklock, s);
+		xnfree(table);
+		return;
+	}
+
+	for (n = 0; n < oldentries; n++)
+		for (ecurr = registry_hash_table[n]; ecurr; ecurr = enext) {
+			enext = ecurr->hnext;
+			h = __registry_hash_crunch(ecurr->key) % entries;
+			ecurr->hnext = table[h];
+			table[h] = ecurr;
+		}
+
+	oldtable = registry_hash_table;
+	registry_hash_table = table;
+	registry_hash_entries = entries;
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	xnfree(oldtable);
 }
 
 static inline int registry_hash_enter(const char *key, struct xnobject *object)
@@ -542,6 +606,7 @@ static inline int registry_hash_enter(const char *key, struct xnobject *object)
 
 	object->hnext = registry_hash_table[s];
 	registry_hash_table[s] = object;
+	registry_hash_count++;
 
 	return 0;
 }
@@ -559,6 +624,8 @@ static inline int registry_hash_remove(struct xnobject *object)
 			else
 				registry_hash_table[s] = ecurr->hnext;
 
+			registry_hash_count--;
+
 			return 0;
 		}
 	}
@@ -675,15 +742,15 @@ int xnregistry_enter(const char *key, void *objaddr,
 
 	object = link2xnobj(holder);
 	xnsynch_init(&object->safesynch, XNSYNCH_FIFO, NULL);
-	object->objaddr = objaddr;
 	object->cstamp = ++registry_obj_stamp;
-	object->safelock = 0;
 #ifdef CONFIG_XENO_OPT_VFILE
 	object->pnode = NULL;
 #endif
 	if (*key == '\0') {
 		object->key = NULL;
-		*phandle = object - registry_obj_slots;
+		xnarch_write_memory_barrier();
+		object->objaddr = objaddr;
+		*phandle = object->handle;
 		ret = 0;
 		goto unlock_and_exit;
 	}
@@ -694,13 +761,16 @@ int xnregistry_enter(const char *key, void *objaddr,
 		goto unlock_and_exit;
 	}
 
+	xnarch_write_memory_barrier();
+	object->objaddr = objaddr;
+
 	appendq(&registry_obj_busyq, holder);
 
 	/*
 	 * <!> Make sure the handle is written back before the
 	 * rescheduling takes place.
 	 */
-	*phandle = object - registry_obj_slots;
+	*phandle = object->handle;
 
 #ifdef CONFIG_XENO_OPT_VFILE
 	if (pnode)
@@ -714,6 +784,9 @@ unlock_and_exit:
 
 	xnlock_put_irqrestore(&nklock, s);
 
+	if (ret == 0 && *key)
+		registry_hash_grow();
+
 #if XENO_DEBUG(REGISTRY)
 	if (ret)
 		xnlogerr("FAILED to register object %s (%s), status %d\n",
@@ -821,7 +894,7 @@ int xnregistry_bind(const char *key, xnticks_t timeout, int timeout_mode,
 		object = registry_hash_find(key);
 
 		if (object) {
-			*phandle = object - registry_obj_slots;
+			*phandle = object->handle;
 			goto unlock_and_exit;
 		}
 
@@ -902,6 +975,22 @@ int xnregistry_remove(xnhandle_t handle)
 			  object->pnode->dirname);
 #endif
 
+	/*
+	 * Retire the handle before clearing the address: lockless
+	 * lookups and xnregistry_get() check the handle again after
+	 * sampling the slot, so they back off once this is visible.
+	 */
+	object->handle = xnobject_slot(handle) |
+		((handle + (1 << XNOBJECT_SLOT_BITS)) & XNOBJECT_GEN_MASK);
+	/*
+	 * Moving the lock word to the next generation drops the
+	 * locks held on the former incarnation at once; their
+	 * owners fail to release them instead of underflowing the
+	 * count of the next one.
+	 */
+	xnarch_atomic_set(&object->safelock,
+			  xnobject_lock_gen(object->handle));
+	xnarch_write_memory_barrier();
 	object->objaddr = NULL;
 	object->cstamp = 0;
 
@@ -985,6 +1074,24 @@ EXPORT_SYMBOL_GPL(xnregistry_remove);
  * xnpod_init_thread), or nanoseconds otherwise.
  */
 
+/*
+ * Move the lock word of an unlocked object to the next generation,
+ * which xnregistry_remove() would do anyway. Unlike checking the
+ * count then removing the object, this cannot race with a lockless
+ * xnregistry_get(): either the latter gets in first and the
+ * cmpxchg fails, or it fails to lock the retired incarnation.
+ */
+static int registry_retire_lock(struct xnobject *object, xnhandle_t handle)
+{
+	u_long oldlock, newlock;
+
+	oldlock = xnobject_lock_gen(handle);
+	newlock = xnobject_lock_gen(handle + (1 << XNOBJECT_SLOT_BITS));
+
+	return xnarch_atomic_cmpxchg(&object->safelock,
+				     oldlock, newlock) == oldlock;
+}
+
 int xnregistry_remove_safe(xnhandle_t handle, xnticks_t timeout)
 {
 	struct xnobject *object;
@@ -1000,7 +1107,7 @@ int xnregistry_remove_safe(xnhandle_t handle, xnticks_t timeout)
 		goto unlock_and_exit;
 	}
 
-	if (object->safelock == 0)
+	if (registry_retire_lock(object, handle))
 		goto remove;
 
 	if (timeout == XN_NONBLOCK) {
@@ -1043,14 +1150,18 @@ int xnregistry_remove_safe(xnhandle_t handle, xnticks_t timeout)
 			err = -ETIMEDOUT;
 			goto unlock_and_exit;
 		}
-	}
-	while (object->safelock > 0);
 
-	if (object->cstamp != cstamp) {
-		/* The caller should silently abort the removal process. */
-		err = -ESRCH;
-		goto unlock_and_exit;
+		if (object->cstamp != cstamp) {
+			/* The caller should silently abort the removal process. */
+			err = -ESRCH;
+			goto unlock_and_exit;
+		}
+		/*
+		 * Someone may have locked the object again since it
+		 * was unlocked; wait for the next release then.
+		 */
 	}
+	while (!registry_retire_lock(object, handle));
 
       remove:
 
@@ -1094,11 +1205,50 @@ EXPORT_SYMBOL_GPL(xnregistry_remove_safe);
  * Rescheduling: never.
  */
 
+/*
+ * Drop a lock taken on @a object through @a handle. This is a no-op
+ * if the incarnation @a handle refers to was removed meanwhile,
+ * since the lock word moved to the next generation then. nklock is
+ * only grabbed when the count drops to zero, to serialize with
+ * xnregistry_remove_safe() which checks the count then sleeps with
+ * the lock held.
+ */
+static u_long registry_unlock(struct xnobject *object, xnhandle_t handle,
+			      int resched)
+{
+	u_long oldlock, count;
+	spl_t s;
+
+	do {
+		oldlock = xnarch_atomic_get(&object->safelock);
+		count = xnobject_lock_count(oldlock);
+		if (xnobject_lock_gen(oldlock) != (handle & XNOBJECT_GEN_MASK) ||
+		    count == 0)
+			return 0;
+	} while (xnarch_atomic_cmpxchg(&object->safelock,
+				       oldlock, oldlock - 1) != oldlock);
+
+	if (count > 1)
+		return count - 1;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if (xnsynch_nsleepers(&object->safesynch) > 0) {
+		xnsynch_flush(&object->safesynch, 0);
+		if (resched)
+			xnpod_schedule();
+	}
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	return 0;
+}
+
 void *xnregistry_get(xnhandle_t handle)
 {
 	struct xnobject *object;
+	u_long oldlock;
 	void *objaddr;
-	spl_t s;
 
 	if (handle == XNOBJECT_SELF) {
 		if (!xnpod_primary_p())
@@ -1106,16 +1256,23 @@ void *xnregistry_get(xnhandle_t handle)
 		handle = xnpod_current_thread()->registry.handle;
 	}
 
-	xnlock_get_irqsave(&nklock, s);
-
-	object = xnregistry_validate(handle);
-	if (likely(object != NULL)) {
-		++object->safelock;
-		objaddr = object->objaddr;
-	} else
-		objaddr = NULL;
+	objaddr = __xnregistry_resolve(handle, &object);
+	if (unlikely(objaddr == NULL))
+		return NULL;
 
-	xnlock_put_irqrestore(&nklock, s);
+	/*
+	 * The lock only sticks if the slot still holds the
+	 * incarnation we resolved: once released, the lock word
+	 * carries the next generation and the cmpxchg cannot
+	 * succeed anymore.
+	 */
+	do {
+		oldlock = xnarch_atomic_get(&object->safelock);
+		if (xnobject_lock_gen(oldlock) != (handle & XNOBJECT_GEN_MASK) ||
+		    xnobject_lock_count(oldlock) == XNOBJECT_LOCK_MASK)
+			return NULL;
+	} while (xnarch_atomic_cmpxchg(&object->safelock,
+				       oldlock, oldlock + 1) != oldlock);
 
 	return objaddr;
 }
@@ -1156,8 +1313,6 @@ EXPORT_SYMBOL_GPL(xnregistry_get);
 u_long xnregistry_put(xnhandle_t handle)
 {
 	struct xnobject *object;
-	u_long newlock;
-	spl_t s;
 
 	if (handle == XNOBJECT_SELF) {
 		if (!xnpod_primary_p())
@@ -1165,26 +1320,11 @@ u_long xnregistry_put(xnhandle_t handle)
 		handle = xnpod_current_thread()->registry.handle;
 	}
 
-	xnlock_get_irqsave(&nklock, s);
-
 	object = xnregistry_validate(handle);
-	if (object == NULL) {
-		newlock = 0;
-		goto unlock_and_exit;
-	}
-
-	if ((newlock = object->safelock) > 0 &&
-	    (newlock = --object->safelock) == 0 &&
-	    xnsynch_nsleepers(&object->safesynch) > 0) {
-		xnsynch_flush(&object->safesynch, 0);
-		xnpod_schedule();
-	}
-
-      unlock_and_exit:
-
-	xnlock_put_irqrestore(&nklock, s);
+	if (object == NULL)
+		return 0;
 
-	return newlock;
+	return registry_unlock(object, handle, 1);
 }
 EXPORT_SYMBOL_GPL(xnregistry_put);
 
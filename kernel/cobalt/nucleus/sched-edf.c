@@ -0,0 +1,527 @@
+/*!\file sched-edf.c
+ * \brief Earliest-deadline-first scheduling class.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * \ingroup sched
+ */
+
+#include <nucleus/pod.h>
+
+/*
+ * Threads from the EDF class are picked by increasing absolute
+ * deadline, which is moved one period ahead each time the periodic
+ * timer of the thread releases a new job (see
+ * xnpod_set_thread_periodic()). The priority only breaks ties between
+ * equal deadlines, and drives the priority inheritance protocol; a
+ * boost from an EDF thread also conveys the deadline of the booster.
+ *
+ * EDF threads run above the RT class. Optionally, a thread may be
+ * given a budget of CPU time per period, enforced as a constant
+ * bandwidth server: a job exhausting its budget gets its deadline
+ * postponed by one period and its budget refilled, so that an
+ * overrunning thread may not steal more than its reserved bandwidth
+ * from the others.
+ *
+ * Until it is made periodic, an EDF thread runs with a deadline far
+ * in the future, i.e. after all periodic EDF threads.
+ */
+
+/*
+ * Heap keys are compared as signed differences, so this must remain
+ * well below 2^63.
+ */
+#define EDF_FAR_DEADLINE	(1ULL << 62)
+
+/* Period of @thread in nanoseconds, zero if not periodic. */
+static xnticks_t edf_period(struct xnthread *thread)
+{
+	if (!xntimer_running_p(&thread->ptimer))
+		return 0;
+
+	return xntbase_ticks2ns(xnthread_time_base(thread),
+				xntimer_get_interval(&thread->ptimer));
+}
+
+/*
+ * Threads linked to an EDF runqueue may belong to another base
+ * class, when boosted by an EDF thread. Each of them stands for at
+ * least one EDF thread which is blocked, so sizing the runqueues
+ * after the EDF thread count is enough for inserting to never fail.
+ */
+static int edf_reserve(int nr)
+{
+	struct xnsched *sched;
+	bheap_t *heap;
+	int cpu, ret;
+
+	for (cpu = 0; cpu < xnarch_num_online_cpus(); cpu++) {
+		if (!xnarch_cpu_supported(cpu))
+			continue;
+		sched = xnpod_sched_slot(cpu);
+		heap = &sched->edf.runnable.bheap;
+		while (heap->sz < nr) {
+			ret = __internal_bheap_grow(heap);
+			if (ret)
+				return -ret;
+		}
+	}
+
+	return 0;
+}
+
+static void edf_budget_handler(struct xntimer *timer)
+{
+	struct xnsched_edf_data *d;
+	struct xnthread *thread;
+	struct xnsched_edf *es;
+	struct xnsched *sched;
+	xnticks_t now;
+
+	es = container_of(timer, struct xnsched_edf, budget_timer);
+	d = es->curr;
+	if (d == NULL)
+		return;
+
+	sched = container_of(es, struct xnsched, edf);
+	thread = d->thread;
+	now = xnpod_get_cpu_time();
+
+	/*
+	 * Postpone the deadline of the running job, and grant it a
+	 * fresh budget: its bandwidth remains capped at
+	 * budget / period, whatever it does.
+	 */
+	d->deadline += edf_period(thread);
+	d->run_budget = d->budget;
+	d->postponed++;
+	if (thread->sched_class == &xnsched_class_edf)
+		bheaph_key(&thread->edf_link) = d->deadline;
+
+	es->run_start = now;
+	xntimer_start(&es->budget_timer, now + d->run_budget,
+		      XN_INFINITE, XN_ABSOLUTE);
+
+	xnsched_set_resched(sched);
+}
+
+/* Charge the running thread, then start charging @d. */
+static void edf_charge(struct xnsched_edf *es, struct xnsched_edf_data *d)
+{
+	struct xnsched_edf_data *curr = es->curr;
+	xnticks_t now, elapsed;
+
+	now = xnpod_get_cpu_time();
+
+	if (curr) {
+		xntimer_stop(&es->budget_timer);
+		elapsed = now - es->run_start;
+		curr->run_budget = elapsed < curr->run_budget ?
+			curr->run_budget - elapsed : 0;
+	}
+
+	es->curr = d;
+
+	if (d) {
+		es->run_start = now;
+		if (xntimer_start(&es->budget_timer, now + d->run_budget,
+				  XN_INFINITE, XN_ABSOLUTE) == -ETIMEDOUT)
+			edf_budget_handler(&es->budget_timer);
+	}
+}
+
+/* Must be called with nklock locked, interrupts off. */
+void xnsched_edf_switch(struct xnsched *sched, struct xnthread *next)
+{
+	struct xnsched_edf_data *d = NULL;
+
+	/* The budget is only enforced for periodic threads. */
+	if (next->sched_class == &xnsched_class_edf &&
+	    next->edf && next->edf->budget &&
+	    xntimer_running_p(&next->ptimer))
+		d = next->edf;
+
+	if (d != sched->edf.curr)
+		edf_charge(&sched->edf, d);
+}
+
+/*
+ * Ideal release date of the current job of @thread, i.e. the latest
+ * release point of its periodic timer not past @now, so that the
+ * timer latency does not leak into the deadline. Jiffy-based time
+ * bases fire right on their release points, we take @now then.
+ */
+static xnticks_t edf_release_date(struct xnthread *thread,
+				  xnticks_t now, xnticks_t period)
+{
+	xnticks_t release;
+
+	if (xntbase_periodic_p(xnthread_time_base(thread)))
+		return now;
+
+	/*
+	 * The expected date lags behind when the thread did not
+	 * wait for its past release points.
+	 */
+	release = xnarch_tsc_to_ns(xntimer_pexpect(&thread->ptimer));
+	if ((xnsticks_t)(now - release) > 0)
+		release = now - xnarch_mod64(now - release, period);
+
+	return release;
+}
+
+/*
+ * Called from the periodic timer handler of @thread, on behalf of
+ * its CPU, before the thread is resumed for the new job.
+ *
+ * Must be called with nklock locked, interrupts off.
+ */
+void xnsched_edf_release(struct xnthread *thread)
+{
+	struct xnsched *sched = thread->sched;
+	struct xnsched_edf_data *d = thread->edf;
+	xnticks_t now = xnpod_get_cpu_time();
+	xnticks_t period = edf_period(thread);
+
+	/*
+	 * A thread which has not gone back waiting for its next
+	 * period by now has missed the deadline of its current job.
+	 */
+	if (xnthread_test_state(thread, XNDELAY|XNPEND) != XNDELAY)
+		d->overruns++;
+
+	d->deadline = edf_release_date(thread, now, period) + period;
+	d->run_budget = d->budget;
+
+	if (sched->edf.curr == d) {
+		xntimer_stop(&sched->edf.budget_timer);
+		sched->edf.run_start = now;
+		xntimer_start(&sched->edf.budget_timer, now + d->run_budget,
+			      XN_INFINITE, XN_ABSOLUTE);
+	}
+
+	/* A boosted thread keeps the deadline it inherited. */
+	if (thread->sched_class != &xnsched_class_edf)
+		return;
+
+	if (xnthread_test_state(thread, XNREADY))
+		bheap_rekey(&sched->edf.runnable, &thread->edf_link,
+			    d->deadline);
+	else {
+		bheaph_key(&thread->edf_link) = d->deadline;
+		if (thread == sched->curr)
+			xnsched_set_resched(sched);
+	}
+}
+EXPORT_SYMBOL_GPL(xnsched_edf_release);
+
+static void xnsched_edf_init(struct xnsched *sched)
+{
+	struct xnsched_edf *es = &sched->edf;
+
+	bheap_init(&es->runnable, CONFIG_XENO_OPT_SCHED_EDF_CAPACITY);
+	es->curr = NULL;
+	es->run_start = 0;
+	xntimer_init_noblock(&es->budget_timer, &nktbase, edf_budget_handler);
+	xntimer_set_name(&es->budget_timer, "edf-budget");
+	xntimer_set_sched(&es->budget_timer, sched);
+}
+
+static void xnsched_edf_setparam(struct xnthread *thread,
+				 const union xnsched_policy_param *p)
+{
+	struct xnsched_edf_data *d = thread->edf;
+	struct xnsched *sched = thread->sched;
+	xnticks_t period = edf_period(thread);
+
+	/*
+	 * Parameter changes restart the current job; charging
+	 * resumes with the fresh budget next time the thread is
+	 * picked.
+	 */
+	if (sched->edf.curr == d)
+		edf_charge(&sched->edf, NULL);
+
+	d->budget = p->edf.budget;
+	d->run_budget = d->budget;
+	d->deadline = xnpod_get_cpu_time() + (period ?: EDF_FAR_DEADLINE);
+	bheaph_key(&thread->edf_link) = d->deadline;
+
+	if (xnthread_test_state(thread, XNSHADOW))
+		xnthread_clear_state(thread, XNOTHER);
+	thread->cprio = p->edf.prio;
+}
+
+static void xnsched_edf_getparam(struct xnthread *thread,
+				 union xnsched_policy_param *p)
+{
+	p->edf.prio = thread->cprio;
+	p->edf.budget = thread->edf ? thread->edf->budget : 0;
+	p->edf.deadline = bheaph_key(&thread->edf_link);
+}
+
+static void xnsched_edf_trackprio(struct xnthread *thread,
+				  const union xnsched_policy_param *p)
+{
+	struct xnsched_edf_data *d = thread->edf;
+
+	if (p == NULL) {
+		thread->cprio = thread->bprio;
+		bheaph_key(&thread->edf_link) = d->deadline;
+		return;
+	}
+
+	/*
+	 * An EDF owner never gets a later deadline than its own
+	 * through a boost, which is driven by priorities.
+	 */
+	thread->cprio = p->edf.prio;
+	if (d && (long long)(d->deadline - p->edf.deadline) < 0)
+		bheaph_key(&thread->edf_link) = d->deadline;
+	else
+		bheaph_key(&thread->edf_link) = p->edf.deadline;
+}
+
+static int xnsched_edf_declare(struct xnthread *thread,
+			       const union xnsched_policy_param *p)
+{
+	struct xnsched_edf_data *d;
+	int ret;
+
+	if (p->edf.prio < XNSCHED_RT_MIN_PRIO ||
+	    p->edf.prio > XNSCHED_RT_MAX_PRIO)
+		return -EINVAL;
+
+	ret = edf_reserve(xnsched_class_edf.nthreads + 1);
+	if (ret)
+		return ret;
+
+	d = xnmalloc(sizeof(*d));
+	if (d == NULL)
+		return -ENOMEM;
+
+	d->overruns = 0;
+	d->postponed = 0;
+	d->thread = thread;
+	thread->edf = d;
+
+	return 0;
+}
+
+static void xnsched_edf_forget(struct xnthread *thread)
+{
+	struct xnsched *sched = thread->sched;
+
+	if (sched->edf.curr == thread->edf)
+		edf_charge(&sched->edf, NULL);
+
+	xnfree(thread->edf);
+	thread->edf = NULL;
+}
+
+static void xnsched_edf_enqueue(struct xnthread *thread)
+{
+	int ret;
+
+	bheaph_prio(&thread->edf_link) = thread->cprio;
+	ret = bheap_insert(&thread->sched->edf.runnable, &thread->edf_link);
+	XENO_BUGON(NUCLEUS, ret != 0);
+}
+
+static void xnsched_edf_dequeue(struct xnthread *thread)
+{
+	bheap_delete(&thread->sched->edf.runnable, &thread->edf_link);
+}
+
+/*
+ * The heap does not keep insertion order among equal keys, so
+ * requeuing is the same as enqueuing.
+ */
+static void xnsched_edf_requeue(struct xnthread *thread)
+{
+	xnsched_edf_enqueue(thread);
+}
+
+static struct xnthread *xnsched_edf_pick(struct xnsched *sched)
+{
+	bheaph_t *h = bheap_get(&sched->edf.runnable);
+
+	return h ? container_of(h, struct xnthread, edf_link) : NULL;
+}
+
+static void xnsched_edf_migrate(struct xnthread *thread, struct xnsched *sched)
+{
+	struct xnsched *oldsched = thread->sched;
+
+	/*
+	 * Deadlines are absolute dates, which remain valid on the
+	 * destination CPU. Only stop charging the budget here, the
+	 * destination CPU will restart it when the thread runs.
+	 */
+	if (thread->edf && oldsched->edf.curr == thread->edf)
+		edf_charge(&oldsched->edf, NULL);
+}
+
+#ifdef CONFIG_XENO_OPT_VFILE
+
+struct xnvfile_directory sched_edf_vfroot;
+
+struct vfile_sched_edf_priv {
+	struct xnholder *curr;
+	xnticks_t now;
+};
+
+struct vfile_sched_edf_data {
+	int cpu;
+	pid_t pid;
+	char name[XNOBJECT_NAME_LEN];
+	int prio;
+	xnticks_t deadline;
+	xnticks_t budget;
+	unsigned long overruns;
+	unsigned long postponed;
+};
+
+static struct xnvfile_snapshot_ops vfile_sched_edf_ops;
+
+static struct xnvfile_snapshot vfile_sched_edf = {
+	.privsz = sizeof(struct vfile_sched_edf_priv),
+	.datasz = sizeof(struct vfile_sched_edf_data),
+	.tag = &nkpod_struct.threadlist_tag,
+	.ops = &vfile_sched_edf_ops,
+};
+
+static int vfile_sched_edf_rewind(struct xnvfile_snapshot_iterator *it)
+{
+	struct vfile_sched_edf_priv *priv = xnvfile_iterator_priv(it);
+	int nrthreads = xnsched_class_edf.nthreads;
+
+	priv->curr = getheadq(&nkpod->threadq);
+	priv->now = xnpod_get_cpu_time();
+
+	return nrthreads;
+}
+
+static int vfile_sched_edf_next(struct xnvfile_snapshot_iterator *it,
+				void *data)
+{
+	struct vfile_sched_edf_priv *priv = xnvfile_iterator_priv(it);
+	struct vfile_sched_edf_data *p = data;
+	struct xnthread *thread;
+
+	if (priv->curr == NULL)
+		return 0;	/* All done. */
+
+	thread = link2thread(priv->curr, glink);
+	priv->curr = nextq(&nkpod->threadq, priv->curr);
+
+	if (thread->base_class != &xnsched_class_edf)
+		return VFILE_SEQ_SKIP;
+
+	p->cpu = xnsched_cpu(thread->sched);
+	p->pid = xnthread_user_pid(thread);
+	memcpy(p->name, thread->name, sizeof(p->name));
+	p->prio = thread->cprio;
+	/* Report the time left until the deadline, zero if missed. */
+	p->deadline = (long long)(thread->edf->deadline - priv->now) > 0 ?
+		thread->edf->deadline - priv->now : 0;
+	p->budget = thread->edf->budget;
+	p->overruns = thread->edf->overruns;
+	p->postponed = thread->edf->postponed;
+
+	return 1;
+}
+
+static int vfile_sched_edf_show(struct xnvfile_snapshot_iterator *it,
+				void *data)
+{
+	struct vfile_sched_edf_data *p = data;
+	char dlbuf[16], btbuf[16];
+
+	if (p == NULL)
+		xnvfile_printf(it, "%-3s  %-6s %-4s %-10s %-10s %-8s %-8s %s\n",
+			       "CPU", "PID", "PRI", "DEADLINE", "BUDGET",
+			       "OVERRUN", "POSTPONE", "NAME");
+	else {
+		if (p->deadline >= EDF_FAR_DEADLINE / 2)
+			strcpy(dlbuf, "-");
+		else
+			xntimer_format_time(p->deadline, 0,
+					    dlbuf, sizeof(dlbuf));
+		xntimer_format_time(p->budget, 0, btbuf, sizeof(btbuf));
+		xnvfile_printf(it, "%3u  %-6d %-4d %-10s %-10s %-8lu %-8lu %s\n",
+			       p->cpu,
+			       p->pid,
+			       p->prio,
+			       dlbuf,
+			       p->budget ? btbuf : "-",
+			       p->overruns,
+			       p->postponed,
+			       p->name);
+	}
+
+	return 0;
+}
+
+static struct xnvfile_snapshot_ops vfile_sched_edf_ops = {
+	.rewind = vfile_sched_edf_rewind,
+	.next = vfile_sched_edf_next,
+	.show = vfile_sched_edf_show,
+};
+
+static int xnsched_edf_init_vfile(struct xnsched_class *schedclass,
+				  struct xnvfile_directory *vfroot)
+{
+	int ret;
+
+	ret = xnvfile_init_dir(schedclass->name, &sched_edf_vfroot, vfroot);
+	if (ret)
+		return ret;
+
+	return xnvfile_init_snapshot("threads", &vfile_sched_edf,
+				     &sched_edf_vfroot);
+}
+
+static void xnsched_edf_cleanup_vfile(struct xnsched_class *schedclass)
+{
+	xnvfile_destroy_snapshot(&vfile_sched_edf);
+	xnvfile_destroy_dir(&sched_edf_vfroot);
+}
+
+#endif /* CONFIG_XENO_OPT_VFILE */
+
+struct xnsched_class xnsched_class_edf = {
+	.sched_init		=	xnsched_edf_init,
+	.sched_enqueue		=	xnsched_edf_enqueue,
+	.sched_dequeue		=	xnsched_edf_dequeue,
+	.sched_requeue		=	xnsched_edf_requeue,
+	.sched_pick		=	xnsched_edf_pick,
+	.sched_tick		=	NULL,
+	.sched_rotate		=	NULL,
+	.sched_migrate		=	xnsched_edf_migrate,
+	.sched_setparam		=	xnsched_edf_setparam,
+	.sched_getparam		=	xnsched_edf_getparam,
+	.sched_trackprio	=	xnsched_edf_trackprio,
+	.sched_declare		=	xnsched_edf_declare,
+	.sched_forget		=	xnsched_edf_forget,
+#ifdef CONFIG_XENO_OPT_VFILE
+	.sched_init_vfile	=	xnsched_edf_init_vfile,
+	.sched_cleanup_vfile	=	xnsched_edf_cleanup_vfile,
+#endif
+	.weight			=	XNSCHED_CLASS_WEIGHT(2),
+	.name			=	"edf"
+};
+EXPORT_SYMBOL_GPL(xnsched_class_edf);
@@ -0,0 +1,667 @@
+/*!\file sched-quota.c
+ * \brief Thread groups with a CPU time quota.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License,
+ * or (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA
+ * 02111-1307, USA.
+ *
+ * \ingroup sched
+ */
+
+#include <nucleus/pod.h>
+
+/*
+ * Threads from the quota class belong to groups defined on a
+ * per-CPU basis. Each group may consume up to its budget of CPU time
+ * within each replenishment period, which is enforced by a single
+ * limit timer per CPU, armed on behalf of the group currently
+ * running. Once the budget is exhausted, the runnable threads of the
+ * group are parked on its expired queue, until the refill timer of
+ * that group fires at the beginning of the next period.
+ *
+ * Quota threads share the RT priority scale among themselves, but
+ * always run below the threads from the RT class, so that a runaway
+ * group may not delay them.
+ */
+
+#ifdef CONFIG_XENO_OPT_VFILE
+static struct xnvfile_rev_tag quota_group_tag;
+#endif
+
+static int quota_nr_groups;
+
+static inline xnsched_queue_t *
+quota_runqueue(struct xnthread *thread)
+{
+	struct xnsched_quota_group *tg = thread->quota;
+
+	return tg->run_budget > 0 ? &tg->sched->quota.runnable : &tg->expired;
+}
+
+/*
+ * The runnable threads of a group are linked to the class runqueue
+ * while the group has some budget left, to its expired queue
+ * otherwise: any change to the run budget crossing zero must move
+ * them accordingly.
+ */
+static void quota_throttle(struct xnsched_quota_group *tg)
+{
+	struct xnsched_quota *qs = &tg->sched->quota;
+	struct xnthread *thread;
+	struct xnholder *h;
+
+	tg->run_budget = 0;
+	tg->throttled++;
+
+	for (h = getheadq(&tg->members); h; h = nextq(&tg->members, h)) {
+		thread = link2thread(h, quota_link);
+		/*
+		 * Threads boosted to a higher class by PIP are queued
+		 * there, and keep running until they drop the boost.
+		 */
+		if (thread->sched_class != &xnsched_class_quota ||
+		    !xnthread_test_state(thread, XNREADY))
+			continue;
+		sched_removepq(&qs->runnable, &thread->rlink);
+		sched_insertpql(&tg->expired, &thread->rlink, thread->cprio);
+	}
+}
+
+static void quota_unthrottle(struct xnsched_quota_group *tg)
+{
+	struct xnsched_quota *qs = &tg->sched->quota;
+	struct xnthread *thread;
+	struct xnpholder *h;
+
+	/* Dequeuing by priority order keeps FIFO ordering within levels. */
+	while ((h = sched_getpq(&tg->expired)) != NULL) {
+		thread = link2thread(h, rlink);
+		sched_insertpql(&qs->runnable, &thread->rlink, thread->cprio);
+	}
+}
+
+static void quota_limit_handler(struct xntimer *timer)
+{
+	struct xnsched_quota_group *tg;
+	struct xnsched_quota *qs;
+	struct xnsched *sched;
+
+	qs = container_of(timer, struct xnsched_quota, limit_timer);
+	tg = qs->curr_group;
+	if (tg == NULL)
+		return;
+
+	if (tg->run_budget > 0)
+		quota_throttle(tg);
+
+	sched = container_of(qs, struct xnsched, quota);
+	xnsched_set_resched(sched);
+}
+
+static void quota_start_limit(struct xnsched_quota *qs, xnticks_t now)
+{
+	int ret;
+
+	qs->run_start = now;
+	ret = xntimer_start(&qs->limit_timer, now + qs->curr_group->run_budget,
+			    XN_INFINITE, XN_ABSOLUTE);
+	if (ret == -ETIMEDOUT)
+		quota_limit_handler(&qs->limit_timer);
+}
+
+/* Charge the running group, then start charging @tg. */
+static void quota_charge(struct xnsched_quota *qs,
+			 struct xnsched_quota_group *tg)
+{
+	struct xnsched_quota_group *curr = qs->curr_group;
+	xnticks_t now, elapsed;
+
+	now = xnpod_get_cpu_time();
+
+	if (curr) {
+		xntimer_stop(&qs->limit_timer);
+		elapsed = now - qs->run_start;
+		if (elapsed < curr->run_budget)
+			curr->run_budget -= elapsed;
+		else if (curr->run_budget > 0)
+			quota_throttle(curr);
+	}
+
+	qs->curr_group = tg;
+
+	if (tg)
+		quota_start_limit(qs, now);
+}
+
+static void quota_refill_handler(struct xntimer *timer)
+{
+	struct xnsched_quota_group *tg;
+	struct xnsched_quota *qs;
+	int expired;
+
+	tg = container_of(timer, struct xnsched_quota_group, refill_timer);
+	qs = &tg->sched->quota;
+	expired = tg->run_budget == 0;
+	tg->run_budget = tg->budget;
+
+	if (expired) {
+		quota_unthrottle(tg);
+		xnsched_set_resched(tg->sched);
+	}
+
+	/* Unused budget is lost, we don't carry it over. */
+	if (qs->curr_group == tg) {
+		xntimer_stop(&qs->limit_timer);
+		quota_start_limit(qs, xnpod_get_cpu_time());
+	}
+}
+
+/* Must be called with nklock locked, interrupts off. */
+void xnsched_quota_switch(struct xnsched *sched, struct xnthread *next)
+{
+	struct xnsched_quota_group *tg = NULL;
+
+	if (next->sched_class == &xnsched_class_quota)
+		tg = next->quota;
+
+	if (tg != sched->quota.curr_group)
+		quota_charge(&sched->quota, tg);
+}
+
+static struct xnsched_quota_group *
+quota_find_group(struct xnsched *sched, int tgid)
+{
+	struct xnsched_quota_group *tg;
+	struct xnholder *h;
+
+	for (h = getheadq(&sched->quota.groups);
+	     h; h = nextq(&sched->quota.groups, h)) {
+		tg = container_of(h, struct xnsched_quota_group, next);
+		if (tg->tgid == tgid)
+			return tg;
+	}
+
+	return NULL;
+}
+
+static void quota_start_refill(struct xnsched_quota_group *tg)
+{
+	xntimer_start(&tg->refill_timer, tg->period, tg->period, XN_RELATIVE);
+}
+
+/*
+ * Create the group @tgid on @sched, or update its budget if it
+ * exists already. A null budget only checks for existence.
+ *
+ * Must be called with nklock locked, interrupts off.
+ */
+int xnsched_quota_set_group(struct xnsched *sched, int tgid,
+			    xnticks_t budget, xnticks_t period)
+{
+	struct xnsched_quota *qs = &sched->quota;
+	struct xnsched_quota_group *tg;
+	int expired = 0;
+
+	if (tgid < 0)
+		return -EINVAL;
+
+	tg = quota_find_group(sched, tgid);
+	if (budget == 0)
+		return tg ? 0 : -ESRCH;
+
+	if (period == 0 || budget > period)
+		return -EINVAL;
+
+	if (tg == NULL) {
+		tg = xnmalloc(sizeof(*tg));
+		if (tg == NULL)
+			return -ENOMEM;
+		if (xntimer_init_noblock(&tg->refill_timer, &nktbase,
+					 quota_refill_handler)) {
+			xnfree(tg);
+			return -ENOMEM;
+		}
+		tg->sched = sched;
+		tg->tgid = tgid;
+		tg->throttled = 0;
+		sched_initpq(&tg->expired,
+			     XNSCHED_RT_MIN_PRIO, XNSCHED_RT_MAX_PRIO);
+		initq(&tg->members);
+		inith(&tg->next);
+		xntimer_set_name(&tg->refill_timer, "quota-refill");
+		xntimer_set_sched(&tg->refill_timer, sched);
+		appendq(&qs->groups, &tg->next);
+		quota_nr_groups++;
+	} else
+		expired = tg->run_budget == 0;
+
+	/* Changes take effect from a fresh period. */
+	tg->budget = budget;
+	tg->period = period;
+	tg->run_budget = budget;
+	quota_start_refill(tg);
+
+	if (expired) {
+		quota_unthrottle(tg);
+		xnsched_set_resched(sched);
+	}
+
+	if (qs->curr_group == tg) {
+		xntimer_stop(&qs->limit_timer);
+		quota_start_limit(qs, xnpod_get_cpu_time());
+	}
+
+	xnvfile_touch_tag(&quota_group_tag);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(xnsched_quota_set_group);
+
+static void quota_put_group(struct xnsched_quota_group *tg)
+{
+	struct xnsched_quota *qs = &tg->sched->quota;
+
+	if (qs->curr_group == tg) {
+		xntimer_stop(&qs->limit_timer);
+		qs->curr_group = NULL;
+	}
+
+	removeq(&qs->groups, &tg->next);
+	xntimer_destroy(&tg->refill_timer);
+	xnfree(tg);
+	quota_nr_groups--;
+
+	xnvfile_touch_tag(&quota_group_tag);
+}
+
+/*
+ * Groups go away with their last member; this call only reclaims
+ * a group which has never been joined.
+ *
+ * Must be called with nklock locked, interrupts off.
+ */
+int xnsched_quota_destroy_group(struct xnsched *sched, int tgid)
+{
+	struct xnsched_quota_group *tg;
+
+	tg = quota_find_group(sched, tgid);
+	if (tg == NULL)
+		return -ESRCH;
+
+	if (!emptyq_p(&tg->members))
+		return -EBUSY;
+
+	quota_put_group(tg);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(xnsched_quota_destroy_group);
+
+static void quota_leave_group(struct xnthread *thread)
+{
+	struct xnsched_quota_group *tg = thread->quota;
+
+	removeq(&tg->members, &thread->quota_link);
+	thread->quota = NULL;
+
+	if (emptyq_p(&tg->members))
+		quota_put_group(tg);
+}
+
+static void xnsched_quota_init(struct xnsched *sched)
+{
+	struct xnsched_quota *qs = &sched->quota;
+
+	sched_initpq(&qs->runnable, XNSCHED_RT_MIN_PRIO, XNSCHED_RT_MAX_PRIO);
+	initq(&qs->groups);
+	qs->curr_group = NULL;
+	qs->run_start = 0;
+	xntimer_init_noblock(&qs->limit_timer, &nktbase, quota_limit_handler);
+	xntimer_set_name(&qs->limit_timer, "quota-limit");
+	xntimer_set_sched(&qs->limit_timer, sched);
+}
+
+static void xnsched_quota_setparam(struct xnthread *thread,
+				   const union xnsched_policy_param *p)
+{
+	struct xnsched_quota_group *tg;
+	struct xnsched *sched = thread->sched;
+
+	tg = quota_find_group(sched, p->quota.tgid);
+	XENO_BUGON(NUCLEUS, tg == NULL);
+
+	if (thread->quota != tg) {
+		if (thread->quota)
+			quota_leave_group(thread);
+		thread->quota = tg;
+		appendq(&tg->members, &thread->quota_link);
+		if (thread == sched->curr &&
+		    thread->sched_class == &xnsched_class_quota)
+			quota_charge(&sched->quota, tg);
+	}
+
+	if (xnthread_test_state(thread, XNSHADOW))
+		xnthread_clear_state(thread, XNOTHER);
+	thread->cprio = p->quota.prio;
+}
+
+static void xnsched_quota_getparam(struct xnthread *thread,
+				   union xnsched_policy_param *p)
+{
+	p->quota.prio = thread->cprio;
+	p->quota.tgid = thread->quota->tgid;
+}
+
+static void xnsched_quota_trackprio(struct xnthread *thread,
+				    const union xnsched_policy_param *p)
+{
+	/*
+	 * A PIP boost from another quota thread never moves the
+	 * owner to the booster's group: it keeps consuming the budget
+	 * of its own group.
+	 */
+	if (p)
+		thread->cprio = p->quota.prio;
+	else
+		thread->cprio = thread->bprio;
+}
+
+static int xnsched_quota_declare(struct xnthread *thread,
+				 const union xnsched_policy_param *p)
+{
+	if (p->quota.prio < XNSCHED_RT_MIN_PRIO ||
+	    p->quota.prio > XNSCHED_RT_MAX_PRIO)
+		return -EINVAL;
+
+	if (quota_find_group(thread->sched, p->quota.tgid) == NULL)
+		return -ESRCH;
+
+	return 0;
+}
+
+static void xnsched_quota_forget(struct xnthread *thread)
+{
+	struct xnsched *sched = thread->sched;
+
+	if (sched->quota.curr_group == thread->quota &&
+	    thread == sched->curr)
+		quota_charge(&sched->quota, NULL);
+
+	quota_leave_group(thread);
+}
+
+static void xnsched_quota_enqueue(struct xnthread *thread)
+{
+	sched_insertpqf(quota_runqueue(thread), &thread->rlink, thread->cprio);
+}
+
+static void xnsched_quota_dequeue(struct xnthread *thread)
+{
+	sched_removepq(quota_runqueue(thread), &thread->rlink);
+}
+
+static void xnsched_quota_requeue(struct xnthread *thread)
+{
+	sched_insertpql(quota_runqueue(thread), &thread->rlink, thread->cprio);
+}
+
+static struct xnthread *xnsched_quota_pick(struct xnsched *sched)
+{
+	struct xnpholder *h = sched_getpq(&sched->quota.runnable);
+
+	return h ? link2thread(h, rlink) : NULL;
+}
+
+static void xnsched_quota_migrate(struct xnthread *thread, struct xnsched *sched)
+{
+	union xnsched_policy_param param;
+	/*
+	 * Groups are per-CPU, so a thread moving to another CPU
+	 * leaves its group and is downgraded to the RT class, until
+	 * xnsched_set_policy() is called again for it.
+	 */
+	param.rt.prio = thread->cprio;
+	xnsched_set_policy(thread, &xnsched_class_rt, &param);
+}
+
+#ifdef CONFIG_XENO_OPT_VFILE
+
+struct xnvfile_directory sched_quota_vfroot;
+
+struct vfile_sched_quota_priv {
+	struct xnholder *curr;
+};
+
+struct vfile_sched_quota_data {
+	int cpu;
+	pid_t pid;
+	char name[XNOBJECT_NAME_LEN];
+	int prio;
+	int tgid;
+};
+
+static struct xnvfile_snapshot_ops vfile_sched_quota_ops;
+
+static struct xnvfile_snapshot vfile_sched_quota = {
+	.privsz = sizeof(struct vfile_sched_quota_priv),
+	.datasz = sizeof(struct vfile_sched_quota_data),
+	.tag = &nkpod_struct.threadlist_tag,
+	.ops = &vfile_sched_quota_ops,
+};
+
+static int vfile_sched_quota_rewind(struct xnvfile_snapshot_iterator *it)
+{
+	struct vfile_sched_quota_priv *priv = xnvfile_iterator_priv(it);
+	int nrthreads = xnsched_class_quota.nthreads;
+
+	priv->curr = getheadq(&nkpod->threadq);
+
+	return nrthreads;
+}
+
+static int vfile_sched_quota_next(struct xnvfile_snapshot_iterator *it,
+				  void *data)
+{
+	struct vfile_sched_quota_priv *priv = xnvfile_iterator_priv(it);
+	struct vfile_sched_quota_data *p = data;
+	struct xnthread *thread;
+
+	if (priv->curr == NULL)
+		return 0;	/* All done. */
+
+	thread = link2thread(priv->curr, glink);
+	priv->curr = nextq(&nkpod->threadq, priv->curr);
+
+	if (thread->base_class != &xnsched_class_quota)
+		return VFILE_SEQ_SKIP;
+
+	p->cpu = xnsched_cpu(thread->sched);
+	p->pid = xnthread_user_pid(thread);
+	memcpy(p->name, thread->name, sizeof(p->name));
+	p->tgid = thread->quota->tgid;
+	p->prio = thread->cprio;
+
+	return 1;
+}
+
+static int vfile_sched_quota_show(struct xnvfile_snapshot_iterator *it,
+				  void *data)
+{
+	struct vfile_sched_quota_data *p = data;
+
+	if (p == NULL)
+		xnvfile_printf(it, "%-3s  %-6s %-4s %-4s  %s\n",
+			       "CPU", "PID", "TGID", "PRI", "NAME");
+	else
+		xnvfile_printf(it, "%3u  %-6d %-4d %-4d  %s\n",
+			       p->cpu,
+			       p->pid,
+			       p->tgid,
+			       p->prio,
+			       p->name);
+
+	return 0;
+}
+
+static struct xnvfile_snapshot_ops vfile_sched_quota_ops = {
+	.rewind = vfile_sched_quota_rewind,
+	.next = vfile_sched_quota_next,
+	.show = vfile_sched_quota_show,
+};
+
+struct vfile_sched_quota_group_priv {
+	int cpu;
+	struct xnholder *curr;
+};
+
+struct vfile_sched_quota_group_data {
+	int cpu;
+	int tgid;
+	int nrthreads;
+	xnticks_t budget;
+	xnticks_t period;
+	xnticks_t run_budget;
+	unsigned long throttled;
+};
+
+static struct xnvfile_snapshot_ops vfile_sched_quota_group_ops;
+
+static struct xnvfile_snapshot vfile_sched_quota_group = {
+	.privsz = sizeof(struct vfile_sched_quota_group_priv),
+	.datasz = sizeof(struct vfile_sched_quota_group_data),
+	.tag = &quota_group_tag,
+	.ops = &vfile_sched_quota_group_ops,
+};
+
+static int vfile_sched_quota_group_rewind(struct xnvfile_snapshot_iterator *it)
+{
+	struct vfile_sched_quota_group_priv *priv = xnvfile_iterator_priv(it);
+
+	priv->cpu = 0;
+	priv->curr = getheadq(&xnpod_sched_slot(0)->quota.groups);
+
+	return quota_nr_groups;
+}
+
+static int vfile_sched_quota_group_next(struct xnvfile_snapshot_iterator *it,
+					void *data)
+{
+	struct vfile_sched_quota_group_priv *priv = xnvfile_iterator_priv(it);
+	struct vfile_sched_quota_group_data *p = data;
+	struct xnsched_quota_group *tg;
+	struct xnsched *sched;
+
+	while (priv->curr == NULL) {
+		if (++priv->cpu >= xnarch_num_online_cpus())
+			return 0;	/* All done. */
+		sched = xnpod_sched_slot(priv->cpu);
+		priv->curr = getheadq(&sched->quota.groups);
+	}
+
+	tg = container_of(priv->curr, struct xnsched_quota_group, next);
+	priv->curr = nextq(&tg->sched->quota.groups, priv->curr);
+
+	p->cpu = xnsched_cpu(tg->sched);
+	p->tgid = tg->tgid;
+	p->nrthreads = countq(&tg->members);
+	p->budget = tg->budget;
+	p->period = tg->period;
+	p->run_budget = tg->run_budget;
+	p->throttled = tg->throttled;
+
+	return 1;
+}
+
+static int vfile_sched_quota_group_show(struct xnvfile_snapshot_iterator *it,
+					void *data)
+{
+	struct vfile_sched_quota_group_data *p = data;
+	char btbuf[16], ptbuf[16], rtbuf[16];
+
+	if (p == NULL)
+		xnvfile_printf(it, "%-3s  %-4s %-5s %-10s %-10s %-10s %s\n",
+			       "CPU", "TGID", "NTHR", "BUDGET", "PERIOD",
+			       "LEFT", "THROTTLED");
+	else {
+		xntimer_format_time(p->budget, 0, btbuf, sizeof(btbuf));
+		xntimer_format_time(p->period, 0, ptbuf, sizeof(ptbuf));
+		xntimer_format_time(p->run_budget, 0, rtbuf, sizeof(rtbuf));
+		xnvfile_printf(it, "%3u  %-4d %-5d %-10s %-10s %-10s %lu\n",
+			       p->cpu,
+			       p->tgid,
+			       p->nrthreads,
+			       btbuf,
+			       ptbuf,
+			       rtbuf,
+			       p->throttled);
+	}
+
+	return 0;
+}
+
+static struct xnvfile_snapshot_ops vfile_sched_quota_group_ops = {
+	.rewind = vfile_sched_quota_group_rewind,
+	.next = vfile_sched_quota_group_next,
+	.show = vfile_sched_quota_group_show,
+};
+
+static int xnsched_quota_init_vfile(struct xnsched_class *schedclass,
+				    struct xnvfile_directory *vfroot)
+{
+	int ret;
+
+	ret = xnvfile_init_dir(schedclass->name, &sched_quota_vfroot, vfroot);
+	if (ret)
+		return ret;
+
+	ret = xnvfile_init_snapshot("threads", &vfile_sched_quota,
+				    &sched_quota_vfroot);
+	if (ret)
+		return ret;
+
+	return xnvfile_init_snapshot("groups", &vfile_sched_quota_group,
+				     &sched_quota_vfroot);
+}
+
+static void xnsched_quota_cleanup_vfile(struct xnsched_class *schedclass)
+{
+	xnvfile_destroy_snapshot(&vfile_sched_quota_group);
+	xnvfile_destroy_snapshot(&vfile_sched_quota);
+	xnvfile_destroy_dir(&sched_quota_vfroot);
+}
+
+#endif /* CONFIG_XENO_OPT_VFILE */
+
+struct xnsched_class xnsched_class_quota = {
+	.sched_init		=	xnsched_quota_init,
+	.sched_enqueue		=	xnsched_quota_enqueue,
+	.sched_dequeue		=	xnsched_quota_dequeue,
+	.sched_requeue		=	xnsched_quota_requeue,
+	.sched_pick		=	xnsched_quota_pick,
+	.sched_tick		=	NULL,
+	.sched_rotate		=	NULL,
+	.sched_migrate		=	xnsched_quota_migrate,
+	.sched_setparam		=	xnsched_quota_setparam,
+	.sched_getparam		=	xnsched_quota_getparam,
+	.sched_trackprio	=	xnsched_quota_trackprio,
+	.sched_declare		=	xnsched_quota_declare,
+	.sched_forget		=	xnsched_quota_forget,
+#ifdef CONFIG_XENO_OPT_VFILE
+	.sched_init_vfile	=	xnsched_quota_init_vfile,
+	.sched_cleanup_vfile	=	xnsched_quota_cleanup_vfile,
+#endif
+	.weight			=	XNSCHED_CLASS_WEIGHT(0),
+	.name			=	"quota"
+};
+EXPORT_SYMBOL_GPL(xnsched_class_quota);
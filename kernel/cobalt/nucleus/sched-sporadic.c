@@ -284,6 +284,7 @@ static int xnsched_sporadic_declare(struct xnthread *thread,
 {
 	struct xnsched_sporadic_data *pss;
 	struct xntbase *tbase;
+	int ret;
 
 	if (p->pss.low_prio < -1 ||
 	    p->pss.low_prio > XNSCHED_RT_MAX_PRIO)
@@ -313,9 +314,17 @@ static int xnsched_sporadic_declare(struct xnthread *thread,
 		return -ENOMEM;
 
 	tbase = xnthread_time_base(thread);
-	xntimer_init(&pss->repl_timer, tbase, sporadic_replenish_handler);
+	ret = xntimer_init(&pss->repl_timer, tbase, sporadic_replenish_handler);
+	if (ret)
+		goto fail;
 	xntimer_set_name(&pss->repl_timer, "pss-replenish");
-	xntimer_init(&pss->drop_timer, tbase, sporadic_drop_handler);
+	ret = xntimer_init(&pss->drop_timer, tbase, sporadic_drop_handler);
+	if (ret) {
+		xntimer_destroy(&pss->repl_timer);
+	fail:
+		xnfree(pss);
+		return ret;
+	}
 	xntimer_set_name(&pss->drop_timer, "pss-drop");
 
 	thread->pss = pss;
@@ -395,7 +395,7 @@ struct xnsched_class xnsched_class_tp = {
 	.sched_init_vfile	=	xnsched_tp_init_vfile,
 	.sched_cleanup_vfile	=	xnsched_tp_cleanup_vfile,
 #endif
-	.weight			=	XNSCHED_CLASS_WEIGHT(2),
+	.weight			=	XNSCHED_CLASS_WEIGHT(3),
 	.name			=	"tp"
 };
 EXPORT_SYMBOL_GPL(xnsched_class_tp);
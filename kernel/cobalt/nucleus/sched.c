@@ -51,10 +51,16 @@ static void xnsched_register_class(struct xnsched_class *sched_class)
 void xnsched_register_classes(void)
 {
 	xnsched_register_class(&xnsched_class_idle);
+#ifdef CONFIG_XENO_OPT_SCHED_QUOTA
+	xnsched_register_class(&xnsched_class_quota);
+#endif
 	xnsched_register_class(&xnsched_class_rt);
 #ifdef CONFIG_XENO_OPT_SCHED_SPORADIC
 	xnsched_register_class(&xnsched_class_sporadic);
 #endif
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	xnsched_register_class(&xnsched_class_edf);
+#endif
 #ifdef CONFIG_XENO_OPT_SCHED_TP
 	xnsched_register_class(&xnsched_class_tp);
 #endif
@@ -138,6 +144,7 @@ void xnsched_init(struct xnsched *sched, int cpu)
 	sched->lflags = 0;
 	sched->inesting = 0;
 	sched->curr = &sched->rootcb;
+	xnstat_counter_set(&sched->tslack_saved, 0);
 	/*
 	 * No direct handler here since the host timer processing is
 	 * postponed to xnintr_irq_handler(), as part of the interrupt
@@ -150,6 +157,10 @@ void xnsched_init(struct xnsched *sched, int cpu)
 	sched->zombie = NULL;
 #ifdef CONFIG_SMP
 	xnarch_cpus_clear(sched->resched);
+	xnarch_cpus_clear(sched->rshots);
+	sched->tbatch = 0;
+	xnstat_counter_set(&sched->rshot_reqs, 0);
+	xnstat_counter_set(&sched->rshot_ipis, 0);
 #endif
 
 	attr.flags = XNROOT | XNSTARTED | XNFPU;
@@ -233,6 +244,14 @@ struct xnthread *xnsched_pick_next(struct xnsched *sched)
 		thread = p->sched_pick(sched);
 		if (thread) {
 			xnthread_clear_state(thread, XNREADY);
+#ifdef CONFIG_XENO_OPT_SCHED_QUOTA
+			/* Charge the outgoing group, if any. */
+			xnsched_quota_switch(sched, thread);
+#endif
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+			/* Same for the CBS budget of EDF threads. */
+			xnsched_edf_switch(sched, thread);
+#endif
 			return thread;
 		}
 	}
@@ -630,8 +649,34 @@ struct xnpholder *nextmlq(struct xnsched_mlq *q, struct xnpholder *h)
 
 static struct xnvfile_directory sched_vfroot;
 
+/*
+ * Thread lists may be long, so the thread vfiles are collected by
+ * chunks, and resumed after the last thread reported when the thread
+ * list changed between two chunks. Threads are always added at the
+ * tail of the list, so replaying the removals logged meanwhile is
+ * enough to find the resume point.
+ */
+#define VFILE_THREAD_CHUNKSZ  16
+
+static int vfile_thread_resume(struct xnholder **curr,
+			       struct xnholder **last, unsigned long *rmseq)
+{
+	int ret;
+
+	ret = xnvfile_rmlog_resume(&nkpod->threadlist_rmlog, rmseq, last);
+	if (ret)
+		return ret;
+
+	*curr = *last ? nextq(&nkpod->threadq, *last) :
+		getheadq(&nkpod->threadq);
+
+	return 0;
+}
+
 struct vfile_schedlist_priv {
 	struct xnholder *curr;
+	struct xnholder *last;
+	unsigned long rmseq;
 	xnticks_t start_time;
 };
 
@@ -653,6 +698,7 @@ static struct xnvfile_snapshot_ops vfile_schedlist_ops;
 static struct xnvfile_snapshot schedlist_vfile = {
 	.privsz = sizeof(struct vfile_schedlist_priv),
 	.datasz = sizeof(struct vfile_schedlist_data),
+	.chunksz = VFILE_THREAD_CHUNKSZ,
 	.tag = &nkpod_struct.threadlist_tag,
 	.ops = &vfile_schedlist_ops,
 };
@@ -662,11 +708,20 @@ static int vfile_schedlist_rewind(struct xnvfile_snapshot_iterator *it)
 	struct vfile_schedlist_priv *priv = xnvfile_iterator_priv(it);
 
 	priv->curr = getheadq(&nkpod->threadq);
+	priv->last = NULL;
+	priv->rmseq = nkpod->threadlist_rmlog.seq;
 	priv->start_time = xntbase_get_jiffies(&nktbase);
 
 	return countq(&nkpod->threadq);
 }
 
+static int vfile_schedlist_resume(struct xnvfile_snapshot_iterator *it)
+{
+	struct vfile_schedlist_priv *priv = xnvfile_iterator_priv(it);
+
+	return vfile_thread_resume(&priv->curr, &priv->last, &priv->rmseq);
+}
+
 static int vfile_schedlist_next(struct xnvfile_snapshot_iterator *it,
 				void *data)
 {
@@ -679,6 +734,7 @@ static int vfile_schedlist_next(struct xnvfile_snapshot_iterator *it,
 		return 0;	/* All done. */
 
 	thread = link2thread(priv->curr, glink);
+	priv->last = priv->curr;
 	priv->curr = nextq(&nkpod->threadq, priv->curr);
 
 	p->cpu = xnsched_cpu(thread->sched);
@@ -751,6 +807,7 @@ static int vfile_schedlist_show(struct xnvfile_snapshot_iterator *it,
 static struct xnvfile_snapshot_ops vfile_schedlist_ops = {
 	.rewind = vfile_schedlist_rewind,
 	.next = vfile_schedlist_next,
+	.resume = vfile_schedlist_resume,
 	.show = vfile_schedlist_show,
 };
 
@@ -759,6 +816,8 @@ static struct xnvfile_snapshot_ops vfile_schedlist_ops = {
 struct vfile_schedstat_priv {
 	int irq;
 	struct xnholder *curr;
+	struct xnholder *last;
+	unsigned long rmseq;
 	struct xnintr_iterator intr_it;
 };
 
@@ -780,6 +839,7 @@ static struct xnvfile_snapshot_ops vfile_schedstat_ops;
 static struct xnvfile_snapshot schedstat_vfile = {
 	.privsz = sizeof(struct vfile_schedstat_priv),
 	.datasz = sizeof(struct vfile_schedstat_data),
+	.chunksz = VFILE_THREAD_CHUNKSZ,
 	.tag = &nkpod_struct.threadlist_tag,
 	.ops = &vfile_schedstat_ops,
 };
@@ -794,12 +854,29 @@ static int vfile_schedstat_rewind(struct xnvfile_snapshot_iterator *it)
 	 * grouped under a pseudo-thread.
 	 */
 	priv->curr = getheadq(&nkpod->threadq);
+	priv->last = NULL;
+	priv->rmseq = nkpod->threadlist_rmlog.seq;
 	priv->irq = 0;
 	irqnr = xnintr_query_init(&priv->intr_it) * XNARCH_NR_CPUS;
 
 	return irqnr + countq(&nkpod->threadq);
 }
 
+static int vfile_schedstat_resume(struct xnvfile_snapshot_iterator *it)
+{
+	struct vfile_schedstat_priv *priv = xnvfile_iterator_priv(it);
+
+	/*
+	 * Once we started scanning the interrupt descriptors, the
+	 * revision may only change because the IRQ iterator went
+	 * stale, in which case we have to start over.
+	 */
+	if (priv->curr == NULL && priv->last)
+		return -ESTALE;
+
+	return vfile_thread_resume(&priv->curr, &priv->last, &priv->rmseq);
+}
+
 static int vfile_schedstat_next(struct xnvfile_snapshot_iterator *it,
 				void *data)
 {
@@ -818,6 +895,7 @@ static int vfile_schedstat_next(struct xnvfile_snapshot_iterator *it,
 		goto scan_irqs;
 
 	thread = link2thread(priv->curr, glink);
+	priv->last = priv->curr;
 	priv->curr = nextq(&nkpod->threadq, priv->curr);
 
 	sched = thread->sched;
@@ -924,6 +1002,7 @@ static int vfile_schedacct_show(struct xnvfile_snapshot_iterator *it,
 static struct xnvfile_snapshot_ops vfile_schedstat_ops = {
 	.rewind = vfile_schedstat_rewind,
 	.next = vfile_schedstat_next,
+	.resume = vfile_schedstat_resume,
 	.show = vfile_schedstat_show,
 };
 
@@ -936,6 +1015,7 @@ static struct xnvfile_snapshot_ops vfile_schedacct_ops;
 static struct xnvfile_snapshot schedacct_vfile = {
 	.privsz = sizeof(struct vfile_schedstat_priv),
 	.datasz = sizeof(struct vfile_schedstat_data),
+	.chunksz = VFILE_THREAD_CHUNKSZ,
 	.tag = &nkpod_struct.threadlist_tag,
 	.ops = &vfile_schedacct_ops,
 };
@@ -943,6 +1023,7 @@ static struct xnvfile_snapshot schedacct_vfile = {
 static struct xnvfile_snapshot_ops vfile_schedacct_ops = {
 	.rewind = vfile_schedstat_rewind,
 	.next = vfile_schedstat_next,
+	.resume = vfile_schedstat_resume,
 	.show = vfile_schedacct_show,
 };
 
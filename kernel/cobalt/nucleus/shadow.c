@@ -284,6 +284,81 @@ static void detach_ppd(xnshadow_ppd_t * ppd)
 struct xnvdso *nkvdso;
 EXPORT_SYMBOL_GPL(nkvdso);
 
+#if XNSTAT_SHM_NR > 0
+
+static struct xnvdso_thread_stat *thread_stats;
+
+static int thread_stats_hint;
+
+static void __init init_thread_stats(void)
+{
+	struct xnheap *heap = &__xnsys_global_ppd.sem_heap;
+
+	thread_stats = xnheap_alloc(heap, XNSTAT_SHM_NR * sizeof(*thread_stats));
+	if (thread_stats == NULL) {
+		xnlogwarn("cannot allocate shared thread statistics\n");
+		return;
+	}
+
+	memset(thread_stats, 0, XNSTAT_SHM_NR * sizeof(*thread_stats));
+	nkvdso->thread_stats.offset = xnheap_mapped_offset(heap, thread_stats);
+	nkvdso->thread_stats.nr = XNSTAT_SHM_NR;
+	__setbits(nkvdso->features, XNVDSO_FEAT_THREAD_STATS);
+}
+
+/* nklock held, irqs off. */
+void xnstat_shm_attach(struct xnthread *thread)
+{
+	struct xnvdso_thread_stat *p;
+	int n, slot;
+
+	if (thread_stats == NULL || thread->stat.shm)
+		return;
+
+	for (n = 0, slot = thread_stats_hint; n < XNSTAT_SHM_NR; n++) {
+		p = thread_stats + slot;
+		if (++slot >= XNSTAT_SHM_NR)
+			slot = 0;
+		if (p->flags & XNSTAT_SHM_USED)
+			continue;
+		xnwrite_seqcount_begin(&p->seqcount);
+		p->flags = XNSTAT_SHM_USED;
+		p->cpu = xnsched_cpu(thread->sched);
+		p->pid = xnthread_user_pid(thread);
+		p->state = xnthread_state_flags(thread);
+		p->ssw = p->csw = p->pf = 0;
+		p->exectime = 0;
+		p->lastswitch = 0;
+		memcpy(p->name, thread->name, sizeof(p->name));
+		xnwrite_seqcount_end(&p->seqcount);
+		thread->stat.shm = p;
+		thread_stats_hint = slot;
+		return;
+	}
+
+	/* Table is full, this thread is only visible from /proc. */
+}
+
+/* nklock held, irqs off. */
+void xnstat_shm_detach(struct xnthread *thread)
+{
+	struct xnvdso_thread_stat *p = thread->stat.shm;
+
+	if (p == NULL)
+		return;
+
+	xnwrite_seqcount_begin(&p->seqcount);
+	p->flags = 0;
+	xnwrite_seqcount_end(&p->seqcount);
+	thread->stat.shm = NULL;
+}
+
+#else /* XNSTAT_SHM_NR == 0 */
+
+static inline void init_thread_stats(void) { }
+
+#endif /* XNSTAT_SHM_NR == 0 */
+
 /*
  * We re-use the global semaphore heap to provide a multi-purpose shared
  * memory area between Xenomai and Linux - for both kernel and userland
@@ -296,6 +371,7 @@ void __init xnheap_init_vdso(void)
 		xnpod_fatal("Xenomai: cannot allocate memory for xnvdso!\n");
 
 	nkvdso->features = XNVDSO_FEATURES;
+	init_thread_stats();
 }
 
 static inline void request_syscall_restart(xnthread_t *thread,
@@ -40,6 +40,11 @@ static void xnthread_periodic_handler(xntimer_t *timer)
 	 * Prevent unwanted round-robin, and do not wake up threads
 	 * blocked on a resource.
 	 */
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	/* Move the deadline ahead, for the job being released. */
+	if (thread->base_class == &xnsched_class_edf)
+		xnsched_edf_release(thread);
+#endif
 	if (xnthread_test_state(thread, XNDELAY|XNPEND) == XNDELAY)
 		xnpod_resume_thread(thread, XNDELAY);
 }
@@ -104,10 +109,14 @@ int xnthread_init(struct xnthread *thread,
 	else
 		snprintf(thread->name, sizeof(thread->name), "%p", thread);
 
-	xntimer_init(&thread->rtimer, attr->tbase, xnthread_timeout_handler);
+	ret = xntimer_init(&thread->rtimer, attr->tbase, xnthread_timeout_handler);
+	if (ret)
+		goto fail;
 	xntimer_set_name(&thread->rtimer, thread->name);
 	xntimer_set_priority(&thread->rtimer, XNTIMER_HIPRIO);
-	xntimer_init(&thread->ptimer, attr->tbase, xnthread_periodic_handler);
+	ret = xntimer_init(&thread->ptimer, attr->tbase, xnthread_periodic_handler);
+	if (ret)
+		goto fail_rtimer;
 	xntimer_set_name(&thread->ptimer, thread->name);
 	xntimer_set_priority(&thread->ptimer, XNTIMER_HIPRIO);
 
@@ -152,7 +161,7 @@ int xnthread_init(struct xnthread *thread,
 	thread->init_schedparam = *sched_param;
 	ret = xnsched_init_tcb(thread);
 	if (ret)
-		goto fail;
+		goto fail_ptimer;
 
 	/*
 	 * We must set the scheduling policy last; the scheduling
@@ -161,12 +170,16 @@ int xnthread_init(struct xnthread *thread,
 	 */
 	ret = xnsched_set_policy(thread, sched_class, sched_param);
 	if (ret)
-		goto fail;
+		goto fail_ptimer;
 
 	xnarch_init_display_context(thread);
 
 	return 0;
 
+fail_ptimer:
+	xntimer_destroy(&thread->ptimer);
+fail_rtimer:
+	xntimer_destroy(&thread->rtimer);
 fail:
 #if CONFIG_XENO_OPT_SYS_STACKPOOLSZ > 0
 	xnarch_free_stack(tcb);
@@ -54,6 +54,7 @@
 #include <nucleus/pod.h>
 #include <nucleus/timer.h>
 #include <nucleus/module.h>
+#include <nucleus/vdso.h>
 
 DEFINE_XNQUEUE(nktimebaseq);
 
@@ -106,7 +107,7 @@ DEFINE_XNQUEUE(nktimebaseq);
  * @return 0 is returned on success. Otherwise:
  *
  * - -ENOMEM is returned if no system memory is available to allocate
- * a new time base descriptor.
+ * a new time base descriptor, or to make room for its timers.
  *
  * Environments:
  *
@@ -127,6 +128,7 @@ int xntbase_alloc(const char *name, u_long period, u_long flags,
 {
 	xntslave_t *slave;
 	xntbase_t *base;
+	int ret;
 	spl_t s;
 
 	if (flags & ~XNTBISO)
@@ -152,7 +154,11 @@ int xntbase_alloc(const char *name, u_long period, u_long flags,
 	base->ops = &nktimer_ops_periodic;
 	base->name = name;
 	inith(&base->link);
-	xntslave_init(slave);
+	ret = xntslave_init(slave);
+	if (ret) {
+		xnarch_free_host_mem(slave, sizeof(*slave));
+		return ret;
+	}
 
 	/* Set initial status:
 	   Not running, no time set, unlocked, isolated if requested. */
@@ -599,6 +605,7 @@ void xntbase_adjust_time(xntbase_t *base, xnsticks_t delta)
 #endif /* CONFIG_XENO_OPT_TIMING_PERIODIC */
 		/* Update all non-isolated bases in the system. */
 		nktbase.wallclock_offset += xntbase_ticks2ns(base, delta);
+		xnvdso_update_wallclock(nktbase.wallclock_offset);
 		now = xnarch_get_cpu_time() + nktbase.wallclock_offset;
 		xntimer_adjust_all_aperiodic(xntbase_ticks2ns(base, delta));
 
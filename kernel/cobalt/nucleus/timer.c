@@ -41,17 +41,85 @@
 #include <nucleus/timer.h>
 #include <asm/xenomai/bits/timer.h>
 
-static inline void xntimer_enqueue_aperiodic(xntimer_t *timer)
+/* Maximum number of timers popped at once by the tick handler. */
+#define XNTIMER_EXPIRY_BATCH 16
+
+/*
+ * Count of the existing timers. Every per-CPU timer queue is kept
+ * large enough to hold all of them, since timers may migrate, so that
+ * queuing a timer never needs to allocate memory. Protected by
+ * nklock.
+ */
+static unsigned long nktimers;
+
+static int xntimer_reserve(unsigned long nr)
+{
+	int nr_cpus, cpu;
+
+	for (cpu = 0, nr_cpus = xnarch_num_online_cpus(); cpu < nr_cpus; cpu++)
+		if (xntimerq_reserve(&xnpod_sched_slot(cpu)->timerqueue, nr))
+			return -ENOMEM;
+
+	return 0;
+}
+
+/*
+ * Make room for the timers initialized while the pod was starting
+ * up, once all the timer queues exist.
+ */
+int xntimer_reserve_queues(void)
+{
+	spl_t s;
+	int ret;
+
+	xnlock_get_irqsave(&nklock, s);
+	ret = xntimer_reserve(nktimers);
+	xnlock_put_irqrestore(&nklock, s);
+
+	return ret;
+}
+
+static inline int xntimer_enqueue_aperiodic(xntimer_t *timer)
 {
 	xntimerq_t *q = &timer->sched->timerqueue;
-	xntimerq_insert(q, &timer->aplink);
+
+	if (xntimerq_insert(q, &timer->aplink))
+		return -ENOMEM;
+
 	__clrbits(timer->status, XNTIMER_DEQUEUED);
 	xnstat_counter_inc(&timer->scheduled);
+
+	return 0;
+}
+
+/*
+ * Requeue an expired timer for its next shot. Room for it was
+ * reserved by xntimer_init(), so this cannot fail.
+ */
+static inline void xntimer_reload_aperiodic(xntimer_t *timer,
+					    xnticks_t interval, xnticks_t now)
+{
+	xnticks_t date = xntimerh_date(&timer->aplink);
+
+	do
+		date += interval;
+	while (date < now + nklatency);
+
+	xntimerh_date(&timer->aplink) = date;
+	xntimer_enqueue_aperiodic(timer);
 }
 
 static inline void xntimer_dequeue_aperiodic(xntimer_t *timer)
 {
-	xntimerq_remove(&timer->sched->timerqueue, &timer->aplink);
+	/*
+	 * A timer the tick handler popped but did not process yet is
+	 * out of the queue already; clearing XNTIMER_EXPIRING tells
+	 * the handler to skip it.
+	 */
+	if (testbits(timer->status, XNTIMER_EXPIRING))
+		__clrbits(timer->status, XNTIMER_EXPIRING);
+	else
+		xntimerq_remove(&timer->sched->timerqueue, &timer->aplink);
 	__setbits(timer->status, XNTIMER_DEQUEUED);
 }
 
@@ -139,16 +207,96 @@ static inline int xntimer_heading_p(struct xntimer *timer)
 	return 0;
 }
 
+#ifdef CONFIG_SMP
+
 static inline void xntimer_next_remote_shot(xnsched_t *sched)
 {
+	struct xnsched *curr = xnpod_current_sched();
+
+	xnstat_counter_inc(&sched->rshot_reqs);
+
+	/*
+	 * Within a batch, only record the target CPU: the IPIs are
+	 * sent by xntimer_batch_end(), once per CPU at most.
+	 */
+	if (curr->tbatch > 0) {
+		xnarch_cpu_set(xnsched_cpu(sched), curr->rshots);
+		return;
+	}
+
+	xnstat_counter_inc(&sched->rshot_ipis);
 	xnarch_send_timer_ipi(xnarch_cpumask_of_cpu(xnsched_cpu(sched)));
 }
 
+/**
+ * Start batching remote timer shots.
+ *
+ * Until the matching call to xntimer_batch_end(), requests for
+ * reprogramming the hardware timer of remote CPUs, which are issued
+ * when the heading timer of their queue changes, are coalesced
+ * instead of triggering one IPI each. Batches may nest.
+ *
+ * Environments:
+ *
+ * This service can be called from:
+ *
+ * - Any context, nklock locked, interrupts off. The lock must be
+ * held until xntimer_batch_end() is called.
+ *
+ * Rescheduling: never.
+ */
+void xntimer_batch_begin(void)
+{
+	xnpod_current_sched()->tbatch++;
+}
+EXPORT_SYMBOL_GPL(xntimer_batch_begin);
+
+/**
+ * Stop batching remote timer shots.
+ *
+ * Ends the batch started by the matching call to
+ * xntimer_batch_begin(). When the outermost batch ends, a single
+ * timer IPI is sent to all CPUs which had a remote shot requested in
+ * the meantime.
+ *
+ * Environments:
+ *
+ * This service can be called from:
+ *
+ * - Any context, nklock locked, interrupts off.
+ *
+ * Rescheduling: never.
+ */
+void xntimer_batch_end(void)
+{
+	struct xnsched *curr = xnpod_current_sched();
+	int cpu, nr_cpus;
+
+	if (--curr->tbatch > 0 || xnarch_cpus_empty(curr->rshots))
+		return;
+
+	for (cpu = 0, nr_cpus = xnarch_num_online_cpus(); cpu < nr_cpus; cpu++)
+		if (xnarch_cpu_isset(cpu, curr->rshots))
+			xnstat_counter_inc(&xnpod_sched_slot(cpu)->rshot_ipis);
+
+	xnarch_send_timer_ipi(curr->rshots);
+	xnarch_cpus_clear(curr->rshots);
+}
+EXPORT_SYMBOL_GPL(xntimer_batch_end);
+
+#else /* !CONFIG_SMP */
+
+static inline void xntimer_next_remote_shot(xnsched_t *sched)
+{
+	xnarch_send_timer_ipi(xnarch_cpumask_of_cpu(xnsched_cpu(sched)));
+}
+
+#endif /* !CONFIG_SMP */
+
 static void
 xntimer_adjust_aperiodic(xntimer_t *timer, xnsticks_t delta)
 {
-
-	xntimerh_date(&timer->aplink) -= delta;
+	xnticks_t date = xntimerh_date(&timer->aplink) - delta;
 
 	if (testbits(timer->status, XNTIMER_PERIODIC)) {
 		xnticks_t period = xntimer_interval(timer);
@@ -156,7 +304,7 @@ xntimer_adjust_aperiodic(xntimer_t *timer, xnsticks_t delta)
 		xnticks_t mod;
 
 		timer->pexpect -= delta;
-		diff = xnarch_get_cpu_tsc() - xntimerh_date(&timer->aplink);
+		diff = xnarch_get_cpu_tsc() - date;
 
 		if ((xnsticks_t) (diff - period) >= 0) {
 			/* timer should tick several times before now, instead
@@ -165,7 +313,7 @@ xntimer_adjust_aperiodic(xntimer_t *timer, xnsticks_t delta)
 			 timer will tick only once and the lost ticks will be
 			 counted as overruns. */
 			mod = xnarch_mod64(diff, period);
-			xntimerh_date(&timer->aplink) += diff - mod;
+			date += diff - mod;
 		} else if (delta < 0
 			   && testbits(timer->status, XNTIMER_FIRED)
 			   && (xnsticks_t) (diff + period) <= 0) {
@@ -175,12 +323,16 @@ xntimer_adjust_aperiodic(xntimer_t *timer, xnsticks_t delta)
 			   sooner date, real-time periodic timers do not tick
 			   until the original date has passed. */
 			mod = xnarch_mod64(-diff, period);
-			xntimerh_date(&timer->aplink) += diff + mod;
+			date += diff + mod;
 			timer->pexpect += diff + mod;
 		}
 	}
 
-	xntimer_enqueue_aperiodic(timer);
+	/*
+	 * The timer is moved within its queue, so that adjusting
+	 * the clock never has to grow it.
+	 */
+	xntimerq_rekey(&timer->sched->timerqueue, &timer->aplink, date);
 }
 
 void xntimer_adjust_all_aperiodic(xnsticks_t delta)
@@ -190,6 +342,7 @@ void xntimer_adjust_all_aperiodic(xnsticks_t delta)
 
 	initq(&adjq);
 	delta = xnarch_ns_to_tsc(delta);
+	xntimer_batch_begin();
 	for (cpu = 0, nr_cpus = xnarch_num_online_cpus(); cpu < nr_cpus; cpu++) {
 		xnsched_t *sched = xnpod_sched_slot(cpu);
 		xntimerq_t *q = &sched->timerqueue;
@@ -208,7 +361,6 @@ void xntimer_adjust_all_aperiodic(xnsticks_t delta)
 
 		while ((adjholder = getq(&adjq))) {
 			xntimer_t *timer = adjlink2timer(adjholder);
-			xntimer_dequeue_aperiodic(timer);
 			xntimer_adjust_aperiodic(timer, delta);
 		}
 
@@ -217,6 +369,37 @@ void xntimer_adjust_all_aperiodic(xnsticks_t delta)
 		else
 			xntimer_next_local_shot(sched);
 	}
+	xntimer_batch_end();
+}
+
+/*
+ * Pick the expiry date of a one-shot timer tolerating some slack:
+ * ride the shot already programmed for the heading timer if it
+ * falls within the slack window, otherwise round the date up to a
+ * power-of-two boundary, so that sloppy timers started at close
+ * dates end up sharing a single shot.
+ */
+static inline xnticks_t xntimer_coalesce_aperiodic(xntimer_t *timer,
+						   xnticks_t date)
+{
+	xntimerh_t *holder = xntimerq_head(&timer->sched->timerqueue);
+	xnticks_t shot;
+
+	if (holder && holder != &timer->aplink) {
+		shot = xntimerh_date(holder);
+		if (shot >= date && shot - date <= timer->slack)
+			goto coalesced;
+	}
+
+	shot = (date + timer->slack_mask) & ~timer->slack_mask;
+	if (shot == date) {
+		__clrbits(timer->status, XNTIMER_COALESCED);
+		return date;
+	}
+
+coalesced:
+	__setbits(timer->status, XNTIMER_COALESCED);
+	return shot;
 }
 
 int xntimer_start_aperiodic(xntimer_t *timer,
@@ -224,22 +407,21 @@ int xntimer_start_aperiodic(xntimer_t *timer,
 			    xntmode_t mode)
 {
 	xnticks_t date, now;
+	int ret;
 
 	trace_mark(xn_nucleus, timer_start,
 		   "timer %p base %s value %Lu interval %Lu mode %u",
 		   timer, xntimer_base(timer)->name, value, interval, mode);
 
-	if (!testbits(timer->status, XNTIMER_DEQUEUED))
-		xntimer_dequeue_aperiodic(timer);
-
 	now = xnarch_get_cpu_tsc();
 
 	__clrbits(timer->status,
-		  XNTIMER_REALTIME | XNTIMER_FIRED | XNTIMER_PERIODIC);
+		  XNTIMER_REALTIME | XNTIMER_FIRED | XNTIMER_PERIODIC |
+		  XNTIMER_COALESCED);
 	switch (mode) {
 	case XN_RELATIVE:
 		if ((xnsticks_t)value < 0)
-			return -ETIMEDOUT;
+			goto timedout;
 		date = xnarch_ns_to_tsc(value) + now;
 		break;
 	case XN_REALTIME:
@@ -249,20 +431,34 @@ int xntimer_start_aperiodic(xntimer_t *timer,
 	default: /* XN_ABSOLUTE || XN_REALTIME */
 		date = xnarch_ns_to_tsc(value);
 		if ((xnsticks_t)(date - now) <= 0)
-			return -ETIMEDOUT;
+			goto timedout;
 		break;
 	}
 
-	xntimerh_date(&timer->aplink) = date;
-
 	timer->interval = XN_INFINITE;
 	if (interval != XN_INFINITE) {
 		timer->interval = xnarch_ns_to_tsc(interval);
 		timer->pexpect = date;
 		__setbits(timer->status, XNTIMER_PERIODIC);
+	} else if (timer->slack)
+		date = xntimer_coalesce_aperiodic(timer, date);
+
+	/*
+	 * Restarting a running timer only moves it within the queue,
+	 * which is cheaper than dequeuing then enqueuing it anew. A
+	 * timer pending expiry is out of the queue though.
+	 */
+	if (!testbits(timer->status, XNTIMER_DEQUEUED | XNTIMER_EXPIRING)) {
+		xntimerq_rekey(&timer->sched->timerqueue, &timer->aplink, date);
+		xnstat_counter_inc(&timer->scheduled);
+	} else {
+		__clrbits(timer->status, XNTIMER_EXPIRING);
+		xntimerh_date(&timer->aplink) = date;
+		ret = xntimer_enqueue_aperiodic(timer);
+		if (ret)
+			return ret;
 	}
 
-	xntimer_enqueue_aperiodic(timer);
 	if (xntimer_heading_p(timer)) {
 		if (xntimer_sched(timer) != xnpod_current_sched())
 			xntimer_next_remote_shot(xntimer_sched(timer));
@@ -271,6 +467,12 @@ int xntimer_start_aperiodic(xntimer_t *timer,
 	}
 
 	return 0;
+
+timedout:
+	if (!testbits(timer->status, XNTIMER_DEQUEUED))
+		xntimer_dequeue_aperiodic(timer);
+
+	return -ETIMEDOUT;
 }
 EXPORT_SYMBOL_GPL(xntimer_start_aperiodic);
 
@@ -342,51 +544,75 @@ void xntimer_tick_aperiodic(void)
 {
 	xnsched_t *sched = xnpod_current_sched();
 	xntimerq_t *timerq = &sched->timerqueue;
+	xntimerh_t *expired[XNTIMER_EXPIRY_BATCH];
+	int nfired = 0, ncoalesced = 0;
 	xnticks_t now, interval;
-	xntimerh_t *holder;
+	unsigned n = 0, nr = 0;
 	xntimer_t *timer;
-	xnsticks_t delta;
 
 	/*
 	 * Optimisation: any local timer reprogramming triggered by
 	 * invoked timer handlers can wait until we leave the tick
 	 * handler. Use this status flag as hint to
-	 * xntimer_start_aperiodic.
+	 * xntimer_start_aperiodic. Likewise, remote shots are sent
+	 * in a single batch on exit.
 	 */
 	__setbits(sched->status, XNINTCK);
+	xntimer_batch_begin();
 
 	now = xnarch_get_cpu_tsc();
-	while ((holder = xntimerq_head(timerq)) != NULL) {
-		timer = aplink2timer(holder);
-		/*
-		 * If the delay to the next shot is greater than the
-		 * intrinsic latency value, we may stop scanning the
-		 * timer queue there, since timeout dates are ordered
-		 * by increasing values.
-		 */
-		delta = (xnsticks_t)(xntimerh_date(&timer->aplink) - now);
-		if (delta > (xnsticks_t)(nklatency + nktimerlat))
-			break;
+	for (;;) {
+		if (n == nr) {
+			/*
+			 * Pop the next batch of timers which are due
+			 * within the intrinsic latency. Handlers may
+			 * stop or restart the pending ones, which then
+			 * lose XNTIMER_EXPIRING, and are skipped.
+			 */
+			nr = xntimerq_pop_due(timerq,
+					      now + nklatency + nktimerlat,
+					      expired, XNTIMER_EXPIRY_BATCH);
+			if (nr == 0)
+				break;
+			for (n = 0; n < nr; n++)
+				__setbits(aplink2timer(expired[n])->status,
+					  XNTIMER_EXPIRING);
+			n = 0;
+		}
+
+		timer = aplink2timer(expired[n++]);
+		if (!testbits(timer->status, XNTIMER_EXPIRING))
+			continue;
+
+		__clrbits(timer->status, XNTIMER_EXPIRING);
 
 		trace_mark(xn_nucleus, timer_expire, "timer %p", timer);
 
-		xntimer_dequeue_aperiodic(timer);
 		xnstat_counter_inc(&timer->fired);
+		nfired++;
+		if (testbits(timer->status, XNTIMER_COALESCED)) {
+			__clrbits(timer->status, XNTIMER_COALESCED);
+			ncoalesced++;
+		}
 
 		if (likely(timer != &sched->htimer)) {
 			if (likely(!testbits(nktbase.status, XNTBLCK)
 				   || testbits(timer->status, XNTIMER_NOBLCK))) {
-				timer->handler(timer);
-				now = xnarch_get_cpu_tsc();
 				/*
-				 * If the elapsed timer has no reload
-				 * value, or was re-enqueued or killed
-				 * by the timeout handler: don't not
-				 * re-enqueue it for the next shot.
+				 * Periodic timers are reloaded before
+				 * the handler runs, which may still
+				 * stop, restart or kill them.
 				 */
-				if (!xntimer_reload_p(timer))
-					continue;
-				__setbits(timer->status, XNTIMER_FIRED);
+				if (testbits(timer->status, XNTIMER_PERIODIC)) {
+					__setbits(timer->status, XNTIMER_FIRED);
+					xntimer_reload_aperiodic(timer,
+								 timer->interval,
+								 now);
+				} else
+					__setbits(timer->status, XNTIMER_DEQUEUED);
+				timer->handler(timer);
+				now = xnarch_get_cpu_tsc();
+				continue;
 			} else if (likely(!testbits(timer->status, XNTIMER_PERIODIC))) {
 				/*
 				 * Make the blocked timer elapse again
@@ -412,29 +638,45 @@ void xntimer_tick_aperiodic(void)
 			 */
 			__setbits(sched->lflags, XNHTICK);
 			__clrbits(sched->lflags, XNHDEFER);
-			if (!testbits(timer->status, XNTIMER_PERIODIC))
+			if (!testbits(timer->status, XNTIMER_PERIODIC)) {
+				__setbits(timer->status, XNTIMER_DEQUEUED);
 				continue;
+			}
 		}
 
 		interval = timer->interval;
 	requeue:
-		do {
-			xntimerh_date(&timer->aplink) += interval;
-		} while (xntimerh_date(&timer->aplink) < now + nklatency);
-		xntimer_enqueue_aperiodic(timer);
+		xntimer_reload_aperiodic(timer, interval, now);
 	}
 
 	__clrbits(sched->status, XNINTCK);
 
+	/*
+	 * Each coalesced timer which fired along with another one
+	 * spared us a separate shot.
+	 */
+	if (ncoalesced > 0)
+		xnstat_counter_set(&sched->tslack_saved,
+				   xnstat_counter_get(&sched->tslack_saved) +
+				   (ncoalesced < nfired ? ncoalesced : nfired - 1));
+
 	xntimer_next_local_shot(sched);
+
+	xntimer_batch_end();
 }
 
-static void xntimer_move_aperiodic(xntimer_t *timer)
+static int xntimer_move_aperiodic(xntimer_t *timer)
 {
-	xntimer_enqueue_aperiodic(timer);
+	int ret;
+
+	ret = xntimer_enqueue_aperiodic(timer);
+	if (ret)
+		return ret;
 
 	if (xntimer_heading_p(timer))
 		xntimer_next_remote_shot(timer->sched);
+
+	return 0;
 }
 
 #ifdef CONFIG_XENO_OPT_TIMING_PERIODIC
@@ -527,9 +769,10 @@ static xnticks_t xntimer_get_raw_expiry_periodic(xntimer_t *timer)
 	return xntlholder_date(&timer->plink);
 }
 
-static void xntimer_move_periodic(xntimer_t *timer)
+static int xntimer_move_periodic(xntimer_t *timer)
 {
 	xntimer_enqueue_periodic(timer);
+	return 0;
 }
 
 /*!
@@ -665,9 +908,9 @@ xntimer_adjust_periodic(xntimer_t *timer, xnsticks_t delta)
 	xntimer_enqueue_periodic(timer);
 }
 
-void xntslave_init(xntslave_t *slave)
+int xntslave_init(xntslave_t *slave)
 {
-	int nr_cpus, cpu, n;
+	int nr_cpus, cpu, n, ret;
 
 	for (cpu = 0, nr_cpus = xnarch_num_online_cpus(); cpu < nr_cpus; cpu++) {
 
@@ -678,11 +921,18 @@ void xntslave_init(xntslave_t *slave)
 
 		/* Slave periodic time bases are cascaded from the
 		 * master aperiodic time base. */
-		xntimer_init(&pc->timer, &nktbase, xntimer_tick_periodic);
+		ret = xntimer_init(&pc->timer, &nktbase, xntimer_tick_periodic);
+		if (ret) {
+			while (--cpu >= 0)
+				xntimer_destroy(&slave->cascade[cpu].timer);
+			return ret;
+		}
 		xntimer_set_name(&pc->timer, slave->base.name);
 		xntimer_set_priority(&pc->timer, XNTIMER_HIPRIO);
 		xntimer_set_sched(&pc->timer, xnpod_sched_slot(cpu));
 	}
+
+	return 0;
 }
 
 void xntslave_destroy(xntslave_t *slave)
@@ -821,7 +1071,14 @@ xntbops_t nktimer_ops_periodic = {
  * @param handler The routine to call upon expiration of the timer.
  *
  * There is no limitation on the number of timers which can be
- * created/active concurrently.
+ * created/active concurrently. Since any timer may be queued on any
+ * CPU, room for the new timer is reserved in every per-CPU timer
+ * queue, so that xntimer_start() never has to allocate memory.
+ *
+ * @return 0 is returned on success. Otherwise, -ENOMEM is returned
+ * if the timer queues could not grow, in which case the timer is left
+ * uninitialized. This never happens to the timers initialized while
+ * the pod starts up, which xnpod_init() accounts for.
  *
  * Environments:
  *
@@ -835,16 +1092,32 @@ xntbops_t nktimer_ops_periodic = {
  * Rescheduling: never.
  */
 #ifdef DOXYGEN_CPP
-void xntimer_init(xntimer_t *timer, xntbase_t *base,
-		  void (*handler)(xntimer_t *timer));
+int xntimer_init(xntimer_t *timer, xntbase_t *base,
+		 void (*handler)(xntimer_t *timer));
 #endif
 
-void __xntimer_init(xntimer_t *timer, xntbase_t *base,
-		    void (*handler) (xntimer_t *timer))
+int __xntimer_init(xntimer_t *timer, xntbase_t *base,
+		   void (*handler) (xntimer_t *timer))
 {
+	spl_t s;
+	int ret;
+
 	/* CAUTION: Setup from xntimer_init() must not depend on the
 	   periodic/aperiodic timing mode. */
 
+	/*
+	 * Timers initialized while the pod starts up are accounted
+	 * for by xnpod_init() at once, when all the timer queues
+	 * exist.
+	 */
+	xnlock_get_irqsave(&nklock, s);
+	ret = xnpod_active_p() ? xntimer_reserve(nktimers + 1) : 0;
+	if (ret == 0)
+		nktimers++;
+	xnlock_put_irqrestore(&nklock, s);
+	if (ret)
+		return ret;
+
 	xntimerh_init(&timer->aplink);
 	xntimerh_date(&timer->aplink) = XN_INFINITE;
 #ifdef CONFIG_XENO_OPT_TIMING_PERIODIC
@@ -856,6 +1129,8 @@ void __xntimer_init(xntimer_t *timer, xntbase_t *base,
 	timer->status = XNTIMER_DEQUEUED;
 	timer->handler = handler;
 	timer->interval = 0;
+	timer->slack = 0;
+	timer->slack_mask = 0;
 	timer->sched = xnpod_current_sched();
 
 #ifdef CONFIG_XENO_OPT_STATS
@@ -881,9 +1156,55 @@ void __xntimer_init(xntimer_t *timer, xntbase_t *base,
 #endif /* CONFIG_XENO_OPT_STATS */
 
 	xnarch_init_display_context(timer);
+
+	return 0;
 }
 EXPORT_SYMBOL_GPL(__xntimer_init);
 
+/*!
+ * \fn void xntimer_set_slack(xntimer_t *timer, xnticks_t ns)
+ *
+ * \brief Set the expiry slack of a timer.
+ *
+ * A one-shot timer with slack may elapse up to @a ns nanoseconds
+ * past its nominal date, which allows the nucleus to fire it along
+ * with other timers instead of programming a separate hardware
+ * shot. Periodic timers ignore the slack. The new setting applies
+ * from the next call to xntimer_start() on.
+ *
+ * @param timer The address of a valid timer descriptor.
+ *
+ * @param ns The tolerated delay in nanoseconds, zero for exact
+ * expiry (default).
+ *
+ * Environments:
+ *
+ * This service can be called from:
+ *
+ * - Kernel module initialization/cleanup code
+ * - Interrupt service routine
+ * - Kernel-based task
+ * - User-space task
+ *
+ * Rescheduling: never.
+ */
+void xntimer_set_slack(xntimer_t *timer, xnticks_t ns)
+{
+	xnticks_t slack = xnarch_ns_to_tsc(ns), mask = 0;
+
+	/*
+	 * Round expiry dates to the largest power-of-two boundary
+	 * which costs at most half the slack, keeping the other half
+	 * for riding the shots of other timers.
+	 */
+	while (mask < slack >> 1)
+		mask = (mask << 1) | 1;
+
+	timer->slack = slack;
+	timer->slack_mask = mask >> 1;
+}
+EXPORT_SYMBOL_GPL(xntimer_set_slack);
+
 /*!
  * \fn void xntimer_destroy(xntimer_t *timer)
  *
@@ -913,6 +1234,10 @@ void xntimer_destroy(xntimer_t *timer)
 
 	xnlock_get_irqsave(&nklock, s);
 	xntimer_stop(timer);
+	if (!testbits(timer->status, XNTIMER_KILLED)) {
+		XENO_BUGON(NUCLEUS, nktimers == 0);
+		nktimers--;
+	}
 	__setbits(timer->status, XNTIMER_KILLED);
 	timer->sched = NULL;
 #ifdef CONFIG_XENO_OPT_STATS
@@ -936,11 +1261,14 @@ EXPORT_SYMBOL_GPL(xntimer_destroy);
  * @param sched The address of the destination CPU xnsched_t structure.
  *
  * @retval -EINVAL if @a timer is queued on another CPU than current ;
+ * @retval -ENOMEM if the timer queue of the destination CPU could not
+ * grow to hold @a timer, which is left running on its current CPU ;
  * @retval 0 otherwise.
  *
  */
 int xntimer_migrate(xntimer_t *timer, xnsched_t *sched)
 {
+	xnsched_t *oldsched;
 	int err = 0;
 	int queued;
 	spl_t s;
@@ -950,7 +1278,8 @@ int xntimer_migrate(xntimer_t *timer, xnsched_t *sched)
 
 	xnlock_get_irqsave(&nklock, s);
 
-	if (sched == timer->sched)
+	oldsched = timer->sched;
+	if (sched == oldsched)
 		goto unlock_and_exit;
 
 	queued = !testbits(timer->status, XNTIMER_DEQUEUED);
@@ -976,12 +1305,26 @@ int xntimer_migrate(xntimer_t *timer, xnsched_t *sched)
 
 	timer->sched = sched;
 
-	if (queued)
+	if (!queued)
+		goto unlock_and_exit;
+
+#ifdef CONFIG_XENO_OPT_TIMING_PERIODIC
+	err = timer->base->ops->move_timer(timer);
+#else /* !CONFIG_XENO_OPT_TIMING_PERIODIC */
+	err = xntimer_move_aperiodic(timer);
+#endif /* !CONFIG_XENO_OPT_TIMING_PERIODIC */
+	if (err) {
+		/*
+		 * Requeuing on the source CPU cannot fail, the timer
+		 * just left that queue.
+		 */
+		timer->sched = oldsched;
 #ifdef CONFIG_XENO_OPT_TIMING_PERIODIC
 		timer->base->ops->move_timer(timer);
 #else /* !CONFIG_XENO_OPT_TIMING_PERIODIC */
 		xntimer_move_aperiodic(timer);
 #endif /* !CONFIG_XENO_OPT_TIMING_PERIODIC */
+	}
 
       unlock_and_exit:
 
@@ -991,6 +1334,54 @@ int xntimer_migrate(xntimer_t *timer, xnsched_t *sched)
 }
 EXPORT_SYMBOL_GPL(xntimer_migrate);
 
+/**
+ * Migrate a set of timers.
+ *
+ * This call migrates @a nr timers to the same CPU at once, sending a
+ * single IPI to the destination CPU at most. The same restriction as
+ * with xntimer_migrate() applies to each timer; timers which are
+ * queued on another CPU than the current one are left untouched.
+ *
+ * Callers migrating timers to several CPUs may get the same IPI
+ * coalescing by issuing xntimer_migrate() calls between
+ * xntimer_batch_begin() and xntimer_batch_end().
+ *
+ * @param timers An array of timer addresses.
+ *
+ * @param nr The number of timers in @a timers.
+ *
+ * @param sched The address of the destination CPU xnsched_t structure.
+ *
+ * @retval -EINVAL if any timer was queued on another CPU than
+ * current ;
+ * @retval -ENOMEM if the timer queue of the destination CPU could not
+ * grow to hold some timer ;
+ * @retval 0 otherwise.
+ *
+ */
+int xntimer_migrate_batch(xntimer_t **timers, int nr, xnsched_t *sched)
+{
+	int n, ret, err = 0;
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	xntimer_batch_begin();
+
+	for (n = 0; n < nr; n++) {
+		ret = xntimer_migrate(timers[n], sched);
+		if (ret)
+			err = ret;
+	}
+
+	xntimer_batch_end();
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(xntimer_migrate_batch);
+
 #endif /* CONFIG_SMP */
 
 /**
@@ -1137,6 +1528,27 @@ static int timer_vfile_show(struct xnvfile_regular_iterator *it, void *data)
 		       tm_status, wd_status, xnarch_tsc_to_ns(nktimerlat),
 		       xntbase_get_rawclock(&nktbase),
 		       XNARCH_TIMER_DEVICE, XNARCH_CLOCK_DEVICE);
+#ifdef CONFIG_XENO_OPT_STATS
+	{
+		struct xnsched *sched;
+		int cpu;
+
+		for (cpu = 0; cpu < xnarch_num_online_cpus(); cpu++) {
+			if (!xnarch_cpu_supported(cpu))
+				continue;
+			sched = xnpod_sched_slot(cpu);
+#ifdef CONFIG_SMP
+			xnvfile_printf(it, "cpu=%d:slack_saved=%lu:rshots=%lu:ipis=%lu\n",
+				       cpu, xnstat_counter_get(&sched->tslack_saved),
+				       xnstat_counter_get(&sched->rshot_reqs),
+				       xnstat_counter_get(&sched->rshot_ipis));
+#else /* !CONFIG_SMP */
+			xnvfile_printf(it, "cpu=%d:slack_saved=%lu\n",
+				       cpu, xnstat_counter_get(&sched->tslack_saved));
+#endif /* !CONFIG_SMP */
+		}
+	}
+#endif /* CONFIG_XENO_OPT_STATS */
 	return 0;
 }
 
@@ -150,7 +150,7 @@ static int vfile_snapshot_open(struct inode *inode, struct file *file)
 	struct xnvfile_snapshot *vfile = pde->data;
 	struct xnvfile_snapshot_ops *ops = vfile->ops;
 	struct xnvfile_snapshot_iterator *it;
-	int revtag, ret, nrdata;
+	int revtag, ret, nrdata, chunk, resumable;
 	struct seq_file *seq;
 	caddr_t data;
 
@@ -218,6 +218,12 @@ redo:
 
 	vfile->entry.lockops->put(&vfile->entry);
 
+	/*
+	 * Resuming a collection requires an auto-allocated buffer,
+	 * so that we can tell when the data set outgrew it.
+	 */
+	resumable = ops->resume && ops->begin == NULL && nrdata > 0;
+
 	/* Release the data buffer, in case we had to restart. */
 	if (it->databuf) {
 		it->endfn(it, it->databuf);
@@ -243,8 +249,13 @@ redo:
 			it->endfn = ops->end;
 		}
 	} else if (nrdata > 0 && vfile->datasz > 0) {
-		/* We have a hint for auto-allocation. */
-		data = kmalloc(vfile->datasz * nrdata, GFP_KERNEL);
+		/*
+		 * We have a hint for auto-allocation. A resumable
+		 * collection gets a spare record, which tells us when
+		 * the data set grew past the hint meanwhile.
+		 */
+		data = kmalloc(vfile->datasz * (nrdata + resumable),
+			       GFP_KERNEL);
 		if (data == NULL) {
 			kfree(it);
 			return -ENOMEM;
@@ -263,24 +274,48 @@ redo:
 		goto finish;
 
 	/*
-	 * Take a snapshot of the vfile contents, redo if the revision
-	 * tag of the scanned data set changed concurrently.
+	 * Take a snapshot of the vfile contents, collecting at most
+	 * vfile->chunksz records per lock hold. If the revision tag
+	 * of the scanned data set changed concurrently between two
+	 * chunks, either resume from the current cursor if the vfile
+	 * knows how to, or redo.
 	 */
-	for (;;) {
+	do {
 		ret = vfile->entry.lockops->get(&vfile->entry);
 		if (ret)
 			break;
-		if (vfile->tag->rev != revtag)
-			goto redo;
-		ret = ops->next(it, data);
-		vfile->entry.lockops->put(&vfile->entry);
-		if (ret <= 0)
-			break;
-		if (ret != VFILE_SEQ_SKIP) {
-			data += vfile->datasz;
-			it->nrdata++;
+		if (vfile->tag->rev != revtag) {
+			if (!resumable)
+				goto redo;
+			ret = ops->resume(it);
+			if (ret == -ESTALE)
+				goto redo;
+			if (ret) {
+				vfile->entry.lockops->put(&vfile->entry);
+				break;
+			}
+			revtag = vfile->tag->rev;
 		}
-	}
+		chunk = vfile->chunksz ?: 1;
+		do {
+			ret = ops->next(it, data);
+			if (ret <= 0)
+				break;
+			if (ret != VFILE_SEQ_SKIP) {
+				data += vfile->datasz;
+				it->nrdata++;
+			}
+			/*
+			 * A resumed collection filled the spare
+			 * record, i.e. more records showed up than
+			 * the rewind hint announced: redo, so that
+			 * we get a larger buffer.
+			 */
+			if (resumable && it->nrdata > nrdata)
+				goto redo;
+		} while (--chunk > 0);
+		vfile->entry.lockops->put(&vfile->entry);
+	} while (ret > 0);
 
 	if (ret < 0) {
 		seq_release(inode, file);
@@ -379,9 +414,17 @@ static struct file_operations vfile_snapshot_fops = {
  * (struct xnvfile_rev_tag). This tag will be monitored for changes by
  * the vfile core while collecting data to output, so that any update
  * detected will cause the current snapshot data to be dropped, and
- * the collection to restart from the beginning. To this end, any
- * change to the data which may be part of the collected records,
- * should also invoke xnvfile_touch() on the associated tag.
+ * the collection to restart from the beginning, unless the @ref
+ * snapshot_resume "resume() handler" can pick it up where it
+ * stopped. To this end, any change to the data which may be part of
+ * the collected records, should also invoke xnvfile_touch() on the
+ * associated tag.
+ *
+ * - .chunksz is the maximum number of records the @ref snapshot_next
+ * "next() handler" may collect while holding the vfile lock. A zero
+ * value collects one record per lock hold. Larger values reduce the
+ * locking overhead for large object populations, at the expense of
+ * longer critical sections.
  *
  * - entry.lockops is a pointer to a @ref vfile_lockops "locking
  * descriptor", defining the lock and unlock operations for the
@@ -23,7 +23,8 @@
  * Thread scheduling services.
  *
  * Xenomai POSIX skin supports the scheduling policies SCHED_FIFO,
- * SCHED_RR, SCHED_SPORADIC, SCHED_OTHER and SCHED_COBALT.
+ * SCHED_RR, SCHED_SPORADIC, SCHED_QUOTA, SCHED_EDF, SCHED_OTHER and
+ * SCHED_COBALT.
  *
  * The SCHED_OTHER policy is mainly useful for user-space non-realtime
  * activities that need to synchronize with real-time activities.
@@ -38,6 +39,18 @@
  * The SCHED_SPORADIC policy provides a mean to schedule aperiodic or
  * sporadic threads in periodic-based systems.
  *
+ * The SCHED_QUOTA policy caps the CPU time a group of threads may
+ * consume over a period, on a per-CPU basis. Threads from a group
+ * which exhausted its budget are throttled until the next
+ * replenishment. SCHED_QUOTA threads run below SCHED_FIFO and SCHED_RR
+ * threads.
+ *
+ * The SCHED_EDF policy schedules periodic threads by earliest
+ * deadline first, the deadline of each job being its release date
+ * plus the period of the thread (see pthread_make_periodic_np()). The
+ * priority only breaks ties between equal deadlines. SCHED_EDF threads
+ * run above SCHED_FIFO and SCHED_RR threads.
+ *
  * The scheduling policy and priority of a thread is set when creating a thread,
  * by using thread creation attributes (see pthread_attr_setinheritsched(),
  * pthread_attr_setschedpolicy() and pthread_attr_setschedparam()), or when the
@@ -75,6 +88,8 @@ int sched_get_priority_min(int policy)
 	case SCHED_FIFO:
 	case SCHED_RR:
 	case SCHED_SPORADIC:
+	case SCHED_QUOTA:
+	case SCHED_EDF:
 	case SCHED_COBALT:
 		return PSE51_MIN_PRIORITY;
 
@@ -111,6 +126,8 @@ int sched_get_priority_max(int policy)
 	case SCHED_FIFO:
 	case SCHED_RR:
 	case SCHED_SPORADIC:
+	case SCHED_QUOTA:
+	case SCHED_EDF:
 		return PSE51_MAX_PRIORITY;
 
 	case SCHED_COBALT:
@@ -217,8 +234,8 @@ int pthread_getschedparam(pthread_t tid, int *pol, struct sched_param *par)
  * that also supports Xenomai-specific or additional POSIX scheduling
  * policies, which are not available with the host Linux environment.
  *
- * Typically, SCHED_SPORADIC parameters can be retrieved from this
- * call.
+ * Typically, SCHED_SPORADIC, SCHED_QUOTA and SCHED_EDF parameters can be
+ * retrieved from this call.
  *
  * @param tid target thread;
  *
@@ -273,6 +290,22 @@ int pthread_getschedparam_ex(pthread_t tid, int *pol, struct sched_param_ex *par
 	}
 #endif
 
+#ifdef CONFIG_XENO_OPT_SCHED_QUOTA
+	if (base_class == &xnsched_class_quota) {
+		par->sched_quota_group = thread->quota->tgid;
+		ns2ts(&par->sched_quota_budget, thread->quota->budget);
+		ns2ts(&par->sched_quota_period, thread->quota->period);
+		goto unlock_and_exit;
+	}
+#endif
+
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	if (base_class == &xnsched_class_edf) {
+		ns2ts(&par->sched_edf_budget, thread->edf->budget);
+		goto unlock_and_exit;
+	}
+#endif
+
 unlock_and_exit:
 
 	xnlock_put_irqrestore(&nklock, s);
@@ -404,6 +437,19 @@ int pthread_setschedparam(pthread_t tid, int pol, const struct sched_param *par)
  * Typically, a Xenomai thread policy can be set to SCHED_SPORADIC
  * using this call.
  *
+ * With SCHED_QUOTA, @a par->sched_quota_group identifies the thread
+ * group to join on the CPU the thread runs on. If @a
+ * par->sched_quota_budget is non-zero, the group is created with this
+ * budget and @a par->sched_quota_period as its replenishment period
+ * if it does not exist yet, otherwise both values are updated.  A
+ * zero budget joins an existing group unchanged. A group is deleted
+ * when its last member leaves it, or migrates to another CPU.
+ *
+ * With SCHED_EDF, a non-zero @a par->sched_edf_budget caps the CPU
+ * time the thread may consume per period: each time it is exhausted,
+ * the deadline of the current job is postponed by one period. The
+ * budget is only enforced while the thread is periodic.
+ *
  * @param tid target thread;
  *
  * @param pol address where the scheduling policy of @a tid is stored on
@@ -416,6 +462,8 @@ int pthread_setschedparam(pthread_t tid, int pol, const struct sched_param *par)
  * @return an error number if:
  * - ESRCH, @a tid is invalid.
  * - EINVAL, @a par contains invalid parameters.
+ * - ESRCH, SCHED_QUOTA was given with a zero budget, for a group which
+ *   does not exist.
  * - ENOMEM, lack of memory to perform the operation.
  *
  * @see
@@ -427,6 +475,10 @@ int pthread_setschedparam_ex(pthread_t tid, int pol, const struct sched_param_ex
 {
 	union xnsched_policy_param param;
 	struct sched_param short_param;
+#ifdef CONFIG_XENO_OPT_SCHED_QUOTA
+	struct xnsched *sched;
+	int tgid;
+#endif
 	xnticks_t tslice;
 	int ret = 0;
 	spl_t s;
@@ -473,12 +525,43 @@ int pthread_setschedparam_ex(pthread_t tid, int pol, const struct sched_param_ex
 		ret = xnpod_set_thread_schedparam(&tid->threadbase,
 						  &xnsched_class_sporadic, &param);
 		break;
-#else
+#endif
+#ifdef CONFIG_XENO_OPT_SCHED_QUOTA
+	case SCHED_QUOTA:
+		xnpod_set_thread_tslice(&tid->threadbase, XN_INFINITE);
+		sched = tid->threadbase.sched;
+		tgid = par->sched_quota_group;
+		ret = xnsched_quota_set_group(sched, tgid,
+					      ts2ns(&par->sched_quota_budget),
+					      ts2ns(&par->sched_quota_period));
+		if (ret)
+			break;
+		param.quota.prio = par->sched_priority;
+		param.quota.tgid = tgid;
+		ret = xnpod_set_thread_schedparam(&tid->threadbase,
+						  &xnsched_class_quota, &param);
+		if (ret)
+			xnsched_quota_destroy_group(sched, tgid);
+		break;
+#endif
+#ifdef CONFIG_XENO_OPT_SCHED_EDF
+	case SCHED_EDF:
+		xnpod_set_thread_tslice(&tid->threadbase, XN_INFINITE);
+		param.edf.prio = par->sched_priority;
+		param.edf.budget = ts2ns(&par->sched_edf_budget);
+		ret = xnpod_set_thread_schedparam(&tid->threadbase,
+						  &xnsched_class_edf, &param);
+		break;
+#endif
+#if !defined(CONFIG_XENO_OPT_SCHED_SPORADIC) && \
+    !defined(CONFIG_XENO_OPT_SCHED_QUOTA) && \
+    !defined(CONFIG_XENO_OPT_SCHED_EDF)
 		(void)param;
 #endif
 	}
 
-	tid->sched_policy = pol;
+	if (ret == 0)
+		tid->sched_policy = pol;
 
 	xnpod_schedule();
 
@@ -29,11 +29,19 @@
  * Semaphores have a maximum value past which they cannot be incremented.  The
  * macro @a SEM_VALUE_MAX is defined to be this maximum value.
  *
+ * When the architecture supports fast synchronization, the count of a
+ * semaphore is stored in the semaphore heap, where user-space reaches
+ * it directly: sem_post(), sem_wait() and sem_trywait() only issue a
+ * system call when the caller has to block, or a waiter has to be
+ * woken up.
+ *
  *@{*/
 
 #include <stddef.h>
 #include <stdarg.h>
 
+#include <nucleus/sys_ppd.h>
+
 #include "registry.h"	/* For named semaphores. */
 #include "thread.h"
 #include "sem.h"
@@ -46,7 +54,16 @@ typedef struct pse51_sem {
 #define link2sem(laddr)                                                 \
     ((pse51_sem_t *)(((char *)(laddr)) - offsetof(pse51_sem_t, link)))
 
-	int value;
+	/*
+	 * Count word, atomically updated from both kernel and
+	 * user-space. A negative value is minus the number of threads
+	 * waiting on the semaphore.
+	 */
+#ifdef CONFIG_XENO_FASTSYNCH
+	xnarch_atomic_t *value;
+#else /* !CONFIG_XENO_FASTSYNCH */
+	xnarch_atomic_t value[1];
+#endif /* !CONFIG_XENO_FASTSYNCH */
 	unsigned pshared;
 	unsigned is_named;
 	pse51_kqueues_t *owningq;
@@ -76,6 +93,63 @@ typedef struct pse51_uptr {
 } pse51_uptr_t;
 #endif /* !__XENO_SIM__ */
 
+#ifdef CONFIG_XENO_FASTSYNCH
+static int sem_alloc_value(pse51_sem_t *sem, int pshared)
+{
+	sem->pshared = pshared;
+	sem->value = (xnarch_atomic_t *)
+		xnheap_alloc(&xnsys_ppd_get(pshared)->sem_heap,
+			     sizeof(xnarch_atomic_t));
+
+	return sem->value ? 0 : EAGAIN;
+}
+
+static void sem_free_value(pse51_sem_t *sem)
+{
+	xnheap_free(&xnsys_ppd_get(sem->pshared)->sem_heap, sem->value);
+}
+
+static void sem_export_value(pse51_sem_t *sem, struct __shadow_sem *shadow)
+{
+	shadow->value_offset =
+		xnheap_mapped_offset(&xnsys_ppd_get(sem->pshared)->sem_heap,
+				     sem->value);
+	shadow->pshared = sem->pshared;
+}
+#else /* !CONFIG_XENO_FASTSYNCH */
+#define sem_alloc_value(sem, pshared)		({ (sem)->pshared = (pshared); 0; })
+#define sem_free_value(sem)			do { } while (0)
+#define sem_export_value(sem, shadow)		do { } while (0)
+#endif /* !CONFIG_XENO_FASTSYNCH */
+
+/* Take one unit, registering as a waiter if none is available. */
+static inline long sem_fetch_dec(pse51_sem_t *sem)
+{
+	long old;
+
+	do
+		old = (long)xnarch_atomic_get(sem->value);
+	while (xnarch_atomic_cmpxchg(sem->value, old, old - 1) != old);
+
+	return old;
+}
+
+/* Release one unit, or unregister a waiter. */
+static inline int sem_fetch_inc(pse51_sem_t *sem, long *oldp)
+{
+	long old;
+
+	do {
+		old = (long)xnarch_atomic_get(sem->value);
+		if (old == SEM_VALUE_MAX)
+			return EAGAIN;
+	} while (xnarch_atomic_cmpxchg(sem->value, old, old + 1) != old);
+
+	*oldp = old;
+
+	return 0;
+}
+
 static void sem_destroy_inner(pse51_sem_t * sem, pse51_kqueues_t *q)
 {
 	spl_t s;
@@ -86,6 +160,8 @@ static void sem_destroy_inner(pse51_sem_t * sem, pse51_kqueues_t *q)
 		xnpod_schedule();
 	xnlock_put_irqrestore(&nklock, s);
 
+	sem_free_value(sem);
+
 	if (sem->is_named)
 		xnfree(sem2named_sem(sem));
 	else
@@ -102,7 +178,7 @@ static int pse51_sem_init_inner(pse51_sem_t * sem, int pshared, unsigned value)
 	inith(&sem->link);
 	appendq(&pse51_kqueues(pshared)->semq, &sem->link);
 	xnsynch_init(&sem->synchbase, XNSYNCH_PRIO, NULL);
-	sem->value = value;
+	xnarch_atomic_set(sem->value, value);
 	sem->pshared = pshared;
 	sem->is_named = 0;
 	sem->owningq = pse51_kqueues(pshared);
@@ -131,6 +207,9 @@ static int pse51_sem_init_inner(pse51_sem_t * sem, int pshared, unsigned value)
  * - EBUSY, the semaphore @a sm was already initialized;
  * - ENOSPC, insufficient memory exists in the system heap to initialize the
  *   semaphore, increase CONFIG_XENO_OPT_SYS_HEAPSZ;
+ * - EAGAIN, insufficient memory exists in the semaphore heap to initialize the
+ *   semaphore, increase CONFIG_XENO_OPT_GLOBAL_SEM_HEAPSZ for a process-shared
+ *   semaphore, or CONFIG_XENO_OPT_SEM_HEAPSZ for a process-private semaphore;
  * - EINVAL, the @a value argument exceeds @a SEM_VALUE_MAX.
  *
  * @see
@@ -152,6 +231,12 @@ int sem_init(sem_t * sm, int pshared, unsigned value)
 		goto error;
 	}
 
+	err = sem_alloc_value(sem, pshared);
+	if (err) {
+		xnfree(sem);
+		goto error;
+	}
+
 	xnlock_get_irqsave(&nklock, s);
 
 	semq = &pse51_kqueues(pshared)->semq;
@@ -175,12 +260,14 @@ int sem_init(sem_t * sm, int pshared, unsigned value)
 
 	shadow->magic = PSE51_SEM_MAGIC;
 	shadow->sem = sem;
+	sem_export_value(sem, shadow);
 	xnlock_put_irqrestore(&nklock, s);
 
 	return 0;
 
   err_lock_put:
 	xnlock_put_irqrestore(&nklock, s);
+	sem_free_value(sem);
 	xnfree(sem);
   error:
 	thread_set_errno(err);
@@ -316,6 +403,12 @@ sem_t *sem_open(const char *name, int oflags, ...)
 	named_sem->sembase.is_named = 1;
 	named_sem->descriptor.shadow_sem.sem = &named_sem->sembase;
 
+	err = sem_alloc_value(&named_sem->sembase, 1);
+	if (err) {
+		xnfree(named_sem);
+		goto error;
+	}
+
 	va_start(ap, oflags);
 	mode = va_arg(ap, int);	/* unused */
 	value = va_arg(ap, unsigned);
@@ -325,9 +418,12 @@ sem_t *sem_open(const char *name, int oflags, ...)
 	err = pse51_sem_init_inner(&named_sem->sembase, 1, value);
 	if (err) {
 		xnlock_put_irqrestore(&nklock, s);
+		sem_free_value(&named_sem->sembase);
 		xnfree(named_sem);
 		goto error;
 	}
+	sem_export_value(&named_sem->sembase,
+			 &named_sem->descriptor.shadow_sem);
 
 	err = pse51_node_add(&named_sem->nodebase, name, PSE51_NAMED_SEM_MAGIC);
 	if (err && err != EEXIST)
@@ -489,7 +585,7 @@ int sem_unlink(const char *name)
 	return -1;
 }
 
-static inline int sem_trywait_internal(struct __shadow_sem *shadow)
+static inline int sem_check(struct __shadow_sem *shadow)
 {
 	pse51_sem_t *sem;
 
@@ -505,10 +601,24 @@ static inline int sem_trywait_internal(struct __shadow_sem *shadow)
 		return EPERM;
 #endif /* XENO_DEBUG(POSIX) */
 
-	if (sem->value == 0)
-		return EAGAIN;
+	return 0;
+}
+
+static inline int sem_trywait_internal(struct __shadow_sem *shadow)
+{
+	pse51_sem_t *sem = shadow->sem;
+	long old;
+	int err;
+
+	err = sem_check(shadow);
+	if (err)
+		return err;
 
-	--sem->value;
+	do {
+		old = (long)xnarch_atomic_get(sem->value);
+		if (old <= 0)
+			return EAGAIN;
+	} while (xnarch_atomic_cmpxchg(sem->value, old, old - 1) != old);
 
 	return 0;
 }
@@ -559,6 +669,7 @@ static inline int sem_timedwait_internal(struct __shadow_sem *shadow,
 {
 	pse51_sem_t *sem = shadow->sem;
 	xnthread_t *cur;
+	long old;
 	int err;
 
 	if (xnpod_unblockable_p())
@@ -566,22 +677,34 @@ static inline int sem_timedwait_internal(struct __shadow_sem *shadow,
 
 	cur = xnpod_current_thread();
 
-	if ((err = sem_trywait_internal(shadow)) != EAGAIN)
+	err = sem_check(shadow);
+	if (err)
 		return err;
 
 	thread_cancellation_point(cur);
 
+	/*
+	 * Once the count went negative, sem_post() hands over its unit
+	 * to the thread it wakes up, instead of incrementing the count.
+	 */
+	if (sem_fetch_dec(sem) > 0)
+		return 0;
+
 	if (timed)
 		xnsynch_sleep_on(&sem->synchbase, to, XN_REALTIME);
 	else
 		xnsynch_sleep_on(&sem->synchbase, XN_INFINITE, XN_RELATIVE);
 
-	/* Handle cancellation requests. */
-	thread_cancellation_point(cur);
-
 	if (xnthread_test_info(cur, XNRMID))
 		return EINVAL;
 
+	/* Not granted the semaphore, unregister from the waiters. */
+	if (xnthread_test_info(cur, XNBREAK | XNTIMEO))
+		sem_fetch_inc(sem, &old);
+
+	/* Handle cancellation requests. */
+	thread_cancellation_point(cur);
+
 	if (xnthread_test_info(cur, XNBREAK))
 		return EINTR;
 
@@ -700,6 +823,8 @@ int sem_timedwait(sem_t * sm, const struct timespec *abs_timeout)
 
 int sem_post_inner(struct pse51_sem *sem, pse51_kqueues_t *ownq)
 {
+	long old;
+
 	if (sem->magic != PSE51_SEM_MAGIC) {
 		thread_set_errno(EINVAL);
 		return -1;
@@ -712,15 +837,18 @@ int sem_post_inner(struct pse51_sem *sem, pse51_kqueues_t *ownq)
 	}
 #endif /* XENO_DEBUG(POSIX) */
 
-	if (sem->value == SEM_VALUE_MAX) {
+	if (sem_fetch_inc(sem, &old)) {
 		thread_set_errno(EAGAIN);
 		return -1;
 	}
 
-	if (xnsynch_wakeup_one_sleeper(&sem->synchbase) != NULL)
+	/*
+	 * A waiter which timed out or was interrupted may not have
+	 * unregistered yet, in which case there is nobody to wake up;
+	 * the count will be right once it did.
+	 */
+	if (old < 0 && xnsynch_wakeup_one_sleeper(&sem->synchbase) != NULL)
 		xnpod_schedule();
-	else
-		++sem->value;
 
 	return 0;
 }
@@ -816,7 +944,9 @@ int sem_getvalue(sem_t * sm, int *value)
 		return -1;
 	}
 
-	*value = sem->value;
+	*value = (long)xnarch_atomic_get(sem->value);
+	if (*value < 0)
+		*value = 0;
 
 	xnlock_put_irqrestore(&nklock, s);
 
@@ -226,6 +226,7 @@ int pthread_create(pthread_t *tid,
 	}
 
 	thread->attr.name = xnthread_name(&thread->threadbase);
+	xnthread_set_slack(&thread->threadbase, ts2ns(&thread->attr.slack));
 
 	inith(&thread->link);
 
@@ -36,7 +36,9 @@
  * - scheduling priority to the minimum,
  * - floating-point hardware enabled (only available in kernel-space),
  * - processor affinity set to all available processors (only available as a
- *   thread attribute in kernel-space).
+ *   thread attribute in kernel-space),
+ * - timer slack set to zero, i.e. exact timeouts (only available as a thread
+ *   attribute in kernel-space).
  *
  * In user-space, the attributes and their defaults values are those documented
  * by the underlying threading library (LinuxThreads or NPTL).
@@ -57,6 +59,7 @@ static const pthread_attr_t default_thread_attr = {
       name:NULL,
       fp:1,
       affinity:XNPOD_ALL_CPUS,
+      slack:{tv_sec:0, tv_nsec:0},
 };
 
 /**
@@ -1062,6 +1065,99 @@ int pthread_attr_setaffinity_np(pthread_attr_t * attr, xnarch_cpumask_t mask)
 	return 0;
 }
 
+/**
+ * Get the timer slack attribute.
+ *
+ * This service stores, at the address @a slack, the value of the @a slack
+ * attribute in the attribute object @a attr.
+ *
+ * The @a slack attribute is the delay by which the timeouts of a thread
+ * created with the attribute @a attr may elapse late, so that the nucleus may
+ * fire them along with other timers instead of programming a separate
+ * hardware shot.
+ *
+ * This service is a non-portable extension of the POSIX interface.
+ *
+ * @param attr attribute object;
+ *
+ * @param slack address where the value of the @a slack attribute will be
+ * stored on success.
+ *
+ * @return 0 on success;
+ * @return an error number if:
+ * - EINVAL, @a attr is invalid.
+ *
+ * @par Valid contexts:
+ * - kernel module initialization or cleanup routine;
+ * - Xenomai kernel-space thread.
+ */
+int pthread_attr_getslack_np(const pthread_attr_t * attr,
+			     struct timespec *slack)
+{
+	spl_t s;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if (!pse51_obj_active(attr, PSE51_THREAD_ATTR_MAGIC, pthread_attr_t)) {
+		xnlock_put_irqrestore(&nklock, s);
+		return EINVAL;
+	}
+
+	*slack = attr->slack;
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	return 0;
+}
+
+/**
+ * Set the timer slack attribute.
+ *
+ * This service sets to @a slack, the value of the @a slack attribute in the
+ * attribute object @a attr.
+ *
+ * Sleeps and timed waits of a thread created with the attribute @a attr may
+ * elapse up to @a slack late, which allows the nucleus to merge them with
+ * nearby shots of other timers. A null slack, the default, requests exact
+ * timeouts. Periodic timers are never delayed.
+ *
+ * This service is a non-portable extension of the POSIX interface.
+ *
+ * @param attr attribute object;
+ *
+ * @param slack value of the @a slack attribute.
+ *
+ * @return 0 on success;
+ * @return an error number if:
+ * - EINVAL, @a attr is invalid, or @a slack is not a valid time
+ *   specification.
+ *
+ * @par Valid contexts:
+ * - kernel module initialization or cleanup routine;
+ * - Xenomai kernel-space thread.
+ */
+int pthread_attr_setslack_np(pthread_attr_t * attr,
+			     const struct timespec *slack)
+{
+	spl_t s;
+
+	if ((unsigned long)slack->tv_nsec >= ONE_BILLION || slack->tv_sec < 0)
+		return EINVAL;
+
+	xnlock_get_irqsave(&nklock, s);
+
+	if (!pse51_obj_active(attr, PSE51_THREAD_ATTR_MAGIC, pthread_attr_t)) {
+		xnlock_put_irqrestore(&nklock, s);
+		return EINVAL;
+	}
+
+	attr->slack = *slack;
+
+	xnlock_put_irqrestore(&nklock, s);
+
+	return 0;
+}
+
 /*@}*/
 
 EXPORT_SYMBOL_GPL(pthread_attr_init);
@@ -1086,3 +1182,5 @@ EXPORT_SYMBOL_GPL(pthread_attr_getfp_np);
 EXPORT_SYMBOL_GPL(pthread_attr_setfp_np);
 EXPORT_SYMBOL_GPL(pthread_attr_getaffinity_np);
 EXPORT_SYMBOL_GPL(pthread_attr_setaffinity_np);
+EXPORT_SYMBOL_GPL(pthread_attr_getslack_np);
+EXPORT_SYMBOL_GPL(pthread_attr_setslack_np);
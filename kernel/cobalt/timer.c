@@ -139,6 +139,7 @@ void pse51_timer_notified(pse51_siginfo_t * si)
  *   invalid signal number;
  * - EAGAIN, the maximum number of timers was exceeded, recompile with a larger
  *   value.
+ * - EAGAIN, the nucleus timer queues could not grow.
  *
  * @see
  * <a href="http://www.opengroup.org/onlinepubs/000095399/functions/timer_create.html">
@@ -213,8 +214,12 @@ int timer_create(clockid_t clockid,
 	} else
 		timer->si.info.si_value.sival_int = (timer - timer_pool);
 
-	xntimer_init(&timer->timerbase, pse51_tbase,
-		     pse51_base_timer_handler);
+	if (xntimer_init(&timer->timerbase, pse51_tbase,
+			 pse51_base_timer_handler)) {
+		prependq(&timer_freeq, &timer->link);
+		err = EAGAIN;
+		goto unlock_and_error;
+	}
 
 	timer->overruns = 0;
 	timer->owner = NULL;
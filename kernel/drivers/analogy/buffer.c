@@ -332,6 +332,23 @@ int a4l_buf_put(a4l_subd_t *subd, void *bufdata, unsigned long count)
 	return err;
 }
 
+int a4l_buf_prepare_sgput(a4l_subd_t *subd, unsigned long count,
+			  a4l_bufsg_t *sg, int nr_sg)
+{
+	a4l_buf_t *buf = subd->buf;
+
+	if (!buf || !test_bit(A4L_SUBD_BUSY_NR, &subd->status))
+		return -ENOENT;
+
+	if (!a4l_subd_is_input(subd))
+		return -EINVAL;
+
+	if (__count_to_put(buf) < count)
+		return -EAGAIN;
+
+	return __sg_window(buf, buf->prd_count, count, sg, nr_sg);
+}
+
 int a4l_buf_prepare_absget(a4l_subd_t *subd, unsigned long count)
 {
 	a4l_buf_t *buf = subd->buf;
@@ -413,6 +430,23 @@ int a4l_buf_get(a4l_subd_t *subd, void *bufdata, unsigned long count)
 	return err;
 }
 
+int a4l_buf_prepare_sgget(a4l_subd_t *subd, unsigned long count,
+			  a4l_bufsg_t *sg, int nr_sg)
+{
+	a4l_buf_t *buf = subd->buf;
+
+	if (!buf || !test_bit(A4L_SUBD_BUSY_NR, &subd->status))
+		return -ENOENT;
+
+	if (!a4l_subd_is_output(subd))
+		return -EINVAL;
+
+	if (__count_to_get(buf) < count)
+		return -EAGAIN;
+
+	return __sg_window(buf, buf->cns_count, count, sg, nr_sg);
+}
+
 int a4l_buf_evt(a4l_subd_t *subd, unsigned long evts)
 {
 	a4l_buf_t *buf = subd->buf;
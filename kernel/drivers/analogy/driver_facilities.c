@@ -229,6 +229,7 @@ EXPORT_SYMBOL_GPL(a4l_get_subd);
  * - a4l_buf_prepare_(abs)get() and a4l_buf_commit_(abs)get()
  * - a4l_buf_put()
  * - a4l_buf_get()
+ * - a4l_buf_prepare_sgput() and a4l_buf_prepare_sgget()
  * - a4l_buf_evt().
  *
  * The functions count might seem high; however, the developer needs a
@@ -247,6 +248,11 @@ EXPORT_SYMBOL_GPL(a4l_get_subd);
  *   copy between the hardware component and the asynchronous
  *   buffer. In such cases, the functions a4l_buf_get() and
  *   a4l_buf_put() are useful.
+ * - If the driver (or a scatter-gather capable DMA controller) can
+ *   produce / consume data in place, the functions
+ *   a4l_buf_prepare_sg*() describe the next window of the buffer as
+ *   a list of segments, which saves the intermediate copy; the
+ *   transfer is then completed with a4l_buf_commit_*().
  *
  * @{
  */
@@ -362,6 +368,36 @@ EXPORT_SYMBOL_GPL(a4l_buf_commit_put);
 int a4l_buf_put(a4l_subd_t *subd, void *bufdata, unsigned long count);
 EXPORT_SYMBOL_GPL(a4l_buf_put);
 
+/**
+ * @brief Describe the next buffer window to be filled by the device
+ * as a scatter-gather list
+ *
+ * The function a4l_buf_prepare_sgput() fills the segment table with
+ * the kernel virtual and physical addresses of the next count bytes
+ * to be produced into the Analogy buffer. The driver (or its DMA
+ * controller) may then write the acquired data directly into these
+ * pages, which are the ones mapped into the user-space program. Once
+ * done, a4l_buf_commit_put() must be called with the same count.
+ *
+ * Segments are split at page boundaries, unless the underlying pages
+ * are physically adjacent, and at the end of the ring. A table of
+ * A4L_BUF_SG_MAXNR(count) entries is always large enough.
+ *
+ * @param[in] subd Subdevice descriptor structure
+ * @param[in] count The amount of data to be produced
+ * @param[out] sg The segment table to fill
+ * @param[in] nr_sg The number of entries in the segment table
+ *
+ * @return the number of segments filled on success, otherwise:
+ * - -EAGAIN if there is not enough room in the buffer
+ * - -ENOSPC if the segment table is too small
+ * - -ENOENT or -EINVAL on invalid subdevice state
+ *
+ */
+int a4l_buf_prepare_sgput(a4l_subd_t *subd, unsigned long count,
+			  a4l_bufsg_t *sg, int nr_sg);
+EXPORT_SYMBOL_GPL(a4l_buf_prepare_sgput);
+
 /**
  * @brief Update the absolute count of data sent from the buffer to
  * the device since the start of the acquisition and after the next
@@ -475,6 +511,31 @@ EXPORT_SYMBOL_GPL(a4l_buf_commit_get);
 int a4l_buf_get(a4l_subd_t *subd, void *bufdata, unsigned long count);
 EXPORT_SYMBOL_GPL(a4l_buf_get);
 
+/**
+ * @brief Describe the next buffer window to be sent to the device as
+ * a scatter-gather list
+ *
+ * The function a4l_buf_prepare_sgget() is the counterpart of
+ * a4l_buf_prepare_sgput() for output subdevices: it describes the
+ * next count bytes to be consumed from the Analogy buffer, so that
+ * the driver or its DMA controller can read them in place. Once
+ * done, a4l_buf_commit_get() must be called with the same count.
+ *
+ * @param[in] subd Subdevice descriptor structure
+ * @param[in] count The amount of data to be consumed
+ * @param[out] sg The segment table to fill
+ * @param[in] nr_sg The number of entries in the segment table
+ *
+ * @return the number of segments filled on success, otherwise:
+ * - -EAGAIN if not enough data is available in the buffer
+ * - -ENOSPC if the segment table is too small
+ * - -ENOENT or -EINVAL on invalid subdevice state
+ *
+ */
+int a4l_buf_prepare_sgget(a4l_subd_t *subd, unsigned long count,
+			  a4l_bufsg_t *sg, int nr_sg);
+EXPORT_SYMBOL_GPL(a4l_buf_prepare_sgget);
+
 /**
  * @brief Signal some event(s) to a user-space program involved in
  * some read / write operation
@@ -133,11 +133,48 @@ static inline uint16_t ai_value_output(struct ai_priv *priv)
 	return output_tab[idx] / priv->amplitude_div;
 }
 
+/* The samples are synthesized in place, within the pages of the
+   asynchronous buffer, the way a scatter-gather DMA controller
+   would write them */
+static int ai_fill_values(a4l_subd_t *subd, unsigned long count)
+{
+	struct ai_priv *priv = (struct ai_priv *)subd->priv;
+	a4l_bufsg_t sg[A4L_BUF_SG_MAXNR(TRANSFER_SIZE)];
+	int i, nr_sg, err = 0;
+
+	while (count != 0) {
+		unsigned long blk_size = count > TRANSFER_SIZE ?
+			TRANSFER_SIZE : count;
+
+		nr_sg = a4l_buf_prepare_sgput(subd, blk_size,
+					      sg, ARRAY_SIZE(sg));
+		if (nr_sg < 0)
+			return nr_sg;
+
+		for (i = 0; i < nr_sg; i++) {
+			uint16_t *data = (uint16_t *)sg[i].vaddr;
+			unsigned long j;
+
+			for (j = 0; j < sg[i].size / sizeof(uint16_t); j++)
+				data[j] = ai_value_output(priv);
+		}
+
+		err = a4l_buf_commit_put(subd, blk_size);
+		if (err < 0)
+			break;
+
+		count -= blk_size;
+	}
+
+	return err;
+}
+
 int ai_push_values(a4l_subd_t *subd)
 {
 	struct ai_priv *priv = (struct ai_priv *)subd->priv;
 	a4l_cmd_t *cmd = a4l_get_cmd(subd);
 	uint64_t now_ns, elapsed_ns = 0;
+	unsigned long scan_size, count;
 	int i = 0;
 
 	if (!cmd)
@@ -148,17 +185,22 @@ int ai_push_values(a4l_subd_t *subd)
 	priv->last_ns = now_ns;
 
 	while(elapsed_ns >= priv->scan_period_ns) {
-		int j;
-				
-		for(j = 0; j < cmd->nb_chan; j++) {
-			uint16_t value = ai_value_output(priv);
-			a4l_buf_put(subd, &value, sizeof(uint16_t));
-		}
-				
 		elapsed_ns -= priv->scan_period_ns;
 		i++;
 	}		       
 
+	/* If there is no more place in the asynchronous buffer, the
+	   scans which do not fit are dropped; it is just a test
+	   driver so no need to implement trickier mechanism */
+	scan_size = cmd->nb_chan * sizeof(uint16_t);
+	count = i * scan_size;
+	if (count > a4l_buf_count(subd))
+		count = a4l_buf_count(subd) - a4l_buf_count(subd) % scan_size;
+
+	if (count != 0 && ai_fill_values(subd, count) < 0)
+		a4l_err(subd->dev,
+			"ai_push_values: a4l_buf_commit_put failed\n");
+
 	priv->current_ns += i * priv->scan_period_ns;
 	priv->reminder_ns = elapsed_ns;
 
@@ -185,7 +227,7 @@ int ao_pull_values(a4l_subd_t *subd)
 	err = a4l_buf_get(subd, priv->buffer, priv->count);
 	if (err < 0) {
 		priv->count = 0;
-		a4l_err(subd->dev, 
+		a4l_err(subd->dev,
 			"ao_get_values: a4l_buf_get failed (err=%d)\n", err);
 	}
 
@@ -30,6 +30,7 @@
 
 #define IN_BUFFER_SIZE		4096
 #define OUT_BUFFER_SIZE		4096
+#define IN_BURST_RING		256
 
 #define DEFAULT_BAUD_BASE	115200
 #define DEFAULT_TX_FIFO		16
@@ -57,6 +58,7 @@
 #define IIR_RX			0x04
 #define IIR_STAT		0x06
 #define IIR_MASK		0x07
+#define IIR_RX_TIMEOUT		0x08
 
 #define RHR			0	/* Receive Holding Buffer */
 #define THR			0	/* Transmit Holding Buffer */
@@ -70,6 +72,11 @@
 #define LSR			5	/* Line Status Register */
 #define MSR			6	/* Modem Status Register */
 
+struct rt_16550_burst {
+	uint64_t timestamp;		/* reception time of the burst */
+	int len;			/* bytes left from this burst */
+};
+
 struct rt_16550_context {
 	struct rtser_config config;	/* current device configuration */
 
@@ -90,6 +97,14 @@ struct rt_16550_context {
 	char in_buf[IN_BUFFER_SIZE];	/* RX ring buffer */
 	volatile unsigned long in_lock;	/* single-reader lock */
 	uint64_t *in_history;		/* RX timestamp buffer */
+	int in_block_size;		/* block mode wake-up threshold */
+	nanosecs_rel_t in_idle_timeout;	/* block mode inter-char timeout */
+	int in_idle;			/* inter-char timeout elapsed */
+	rtdm_timer_t in_timer;		/* inter-char timer */
+	int in_burst_head;		/* RX burst ring, head index */
+	int in_burst_tail;		/* RX burst ring, tail index */
+	int in_nbursts;			/* pending bursts in RX burst ring */
+	struct rt_16550_burst in_bursts[IN_BURST_RING]; /* RX burst ring */
 
 	int out_head;			/* TX ring buffer, head pointer */
 	int out_tail;			/* TX ring buffer, tail pointer */
@@ -109,6 +124,8 @@ struct rt_16550_context {
 	int saved_errors;		/* error cache for RTIOC_GET_STATUS */
 };
 
+static const int rx_trigger[] = { 1, 4, 8, 14 };
+
 static const struct rtser_config default_config = {
 	0xFFFF, RTSER_DEF_BAUD, RTSER_DEF_PARITY, RTSER_DEF_BITS,
 	RTSER_DEF_STOPB, RTSER_DEF_HAND, RTSER_DEF_FIFO_DEPTH,
@@ -145,27 +162,56 @@ MODULE_AUTHOR("jan.kiszka@web.de");
 #include "16550A_pnp.h"
 #include "16550A_pci.h"
 
+static inline void rt_16550_rx_char(struct rt_16550_context *ctx, int c,
+				    uint64_t *timestamp, int *lsr)
+{
+	ctx->in_buf[ctx->in_tail] = c;
+	if (ctx->in_history && !ctx->in_block_size)
+		ctx->in_history[ctx->in_tail] = *timestamp;
+	ctx->in_tail = (ctx->in_tail + 1) & (IN_BUFFER_SIZE - 1);
+
+	if (++ctx->in_npend > IN_BUFFER_SIZE) {
+		*lsr |= RTSER_SOFT_OVERRUN_ERR;
+		ctx->in_npend--;
+	}
+}
+
 static inline int rt_16550_rx_interrupt(struct rt_16550_context *ctx,
-					uint64_t * timestamp)
+					int iir, uint64_t * timestamp)
 {
 	unsigned long base = ctx->base_addr;
 	int mode = rt_16550_io_mode_from_ctx(ctx);
 	int rbytes = 0;
 	int lsr = 0;
+	int count;
 	int c;
 
+	/*
+	 * In block mode, a trigger level interrupt (as opposed to a
+	 * character timeout) guarantees that at least the trigger level
+	 * worth of bytes sits in the FIFO. Unless the FIFO reports an
+	 * erroneous character, drain them without polling LSR for each
+	 * of them.
+	 */
+	if (ctx->in_block_size > 0 && !testbits(iir, IIR_RX_TIMEOUT)) {
+		lsr = rt_16550_reg_in(mode, base, LSR);
+		if (testbits(lsr, RTSER_LSR_FIFO_ERR))
+			count = 1;
+		else
+			count = rx_trigger[ctx->config.fifo_depth >> 6];
+		/* Keep the errors reported for the head character. */
+		lsr &= (RTSER_LSR_OVERRUN_ERR | RTSER_LSR_PARITY_ERR |
+			RTSER_LSR_FRAMING_ERR | RTSER_LSR_BREAK_IND);
+
+		for (; count > 1; count--, rbytes++) {
+			c = rt_16550_reg_in(mode, base, RHR);
+			rt_16550_rx_char(ctx, c, timestamp, &lsr);
+		}
+	}
+
 	do {
 		c = rt_16550_reg_in(mode, base, RHR);	/* read input char */
-
-		ctx->in_buf[ctx->in_tail] = c;
-		if (ctx->in_history)
-			ctx->in_history[ctx->in_tail] = *timestamp;
-		ctx->in_tail = (ctx->in_tail + 1) & (IN_BUFFER_SIZE - 1);
-
-		if (++ctx->in_npend > IN_BUFFER_SIZE) {
-			lsr |= RTSER_SOFT_OVERRUN_ERR;
-			ctx->in_npend--;
-		}
+		rt_16550_rx_char(ctx, c, timestamp, &lsr);
 
 		rbytes++;
 		lsr &= ~RTSER_LSR_DATA;
@@ -210,6 +256,85 @@ static inline void rt_16550_tx_interrupt(struct rt_16550_context *ctx)
 	}
 }
 
+static void rt_16550_push_burst(struct rt_16550_context *ctx, int len,
+				uint64_t timestamp)
+{
+	struct rt_16550_burst *burst;
+
+	if (ctx->in_nbursts == IN_BURST_RING) {
+		/* Burst ring full, account bytes to the newest burst. */
+		burst = &ctx->in_bursts[(ctx->in_burst_tail - 1) &
+					(IN_BURST_RING - 1)];
+		burst->len += len;
+		return;
+	}
+
+	burst = &ctx->in_bursts[ctx->in_burst_tail];
+	burst->timestamp = timestamp;
+	burst->len = len;
+	ctx->in_burst_tail = (ctx->in_burst_tail + 1) & (IN_BURST_RING - 1);
+	ctx->in_nbursts++;
+}
+
+static void rt_16550_consume_bursts(struct rt_16550_context *ctx, int len)
+{
+	struct rt_16550_burst *burst;
+
+	while (len > 0 && ctx->in_nbursts > 0) {
+		burst = &ctx->in_bursts[ctx->in_burst_head];
+		if (burst->len > len) {
+			burst->len -= len;
+			break;
+		}
+		len -= burst->len;
+		ctx->in_burst_head =
+		    (ctx->in_burst_head + 1) & (IN_BURST_RING - 1);
+		ctx->in_nbursts--;
+	}
+}
+
+static void rt_16550_reset_bursts(struct rt_16550_context *ctx)
+{
+	ctx->in_burst_head = 0;
+	ctx->in_burst_tail = 0;
+	ctx->in_nbursts = 0;
+
+	if (ctx->in_npend > 0)
+		rt_16550_push_burst(ctx, ctx->in_npend, ctx->last_timestamp);
+}
+
+static inline void rt_16550_arm_idle_timer(struct rt_16550_context *ctx)
+{
+	if (ctx->in_idle_timeout <= 0)
+		return;
+
+	ctx->in_idle = 0;
+	rtdm_timer_start(&ctx->in_timer, ctx->in_idle_timeout, 0,
+			 RTDM_TIMERMODE_RELATIVE);
+}
+
+static void rt_16550_idle_timer(rtdm_timer_t *timer)
+{
+	struct rt_16550_context *ctx =
+	    container_of(timer, struct rt_16550_context, in_timer);
+
+	/*
+	 * We run with nklock held and must not grab ctx->lock here, the
+	 * reader re-validates the RX state once it is woken up.
+	 */
+	ctx->in_idle = 1;
+	rtdm_event_signal(&ctx->in_event);
+}
+
+/* Number of bytes a block-mode reader still has to wait for. */
+static inline int rt_16550_block_nwait(struct rt_16550_context *ctx,
+				       size_t nbyte, size_t read)
+{
+	size_t nwait = ctx->in_block_size - read;
+
+	return (nbyte < nwait) ? nbyte : nwait;
+}
+
 static inline void rt_16550_stat_interrupt(struct rt_16550_context *ctx)
 {
 	unsigned long base = ctx->base_addr;
@@ -227,6 +352,7 @@ static int rt_16550_interrupt(rtdm_irq_t * irq_context)
 	int mode;
 	int iir;
 	uint64_t timestamp = rtdm_clock_read();
+	size_t npend;
 	int rbytes = 0;
 	int events = 0;
 	int modem;
@@ -238,19 +364,21 @@ static int rt_16550_interrupt(rtdm_irq_t * irq_context)
 
 	rtdm_lock_get(&ctx->lock);
 
+	npend = ctx->in_npend;
+
 	while (1) {
-		iir = rt_16550_reg_in(mode, base, IIR) & IIR_MASK;
+		iir = rt_16550_reg_in(mode, base, IIR);
 		if (testbits(iir, IIR_PIRQ))
 			break;
 
-		if (iir == IIR_RX) {
-			rbytes += rt_16550_rx_interrupt(ctx, &timestamp);
+		if ((iir & IIR_MASK) == IIR_RX) {
+			rbytes += rt_16550_rx_interrupt(ctx, iir, &timestamp);
 			events |= RTSER_EVENT_RXPEND;
-		} else if (iir == IIR_STAT)
+		} else if ((iir & IIR_MASK) == IIR_STAT)
 			rt_16550_stat_interrupt(ctx);
-		else if (iir == IIR_TX)
+		else if ((iir & IIR_MASK) == IIR_TX)
 			rt_16550_tx_interrupt(ctx);
-		else if (iir == IIR_MODEM) {
+		else if ((iir & IIR_MASK) == IIR_MODEM) {
 			modem = rt_16550_reg_in(mode, base, MSR);
 			if (modem & (modem << 4))
 				events |= RTSER_EVENT_MODEMHI;
@@ -261,12 +389,19 @@ static int rt_16550_interrupt(rtdm_irq_t * irq_context)
 		ret = RTDM_IRQ_HANDLED;
 	}
 
+	/* Block mode timestamps the whole FIFO burst at once. */
+	if (ctx->in_block_size > 0 && ctx->in_npend > npend)
+		rt_16550_push_burst(ctx, ctx->in_npend - npend, timestamp);
+
 	if (ctx->in_nwait > 0) {
 		if ((ctx->in_nwait <= rbytes) || ctx->status) {
 			ctx->in_nwait = 0;
 			rtdm_event_signal(&ctx->in_event);
-		} else
+		} else {
 			ctx->in_nwait -= rbytes;
+			if (rbytes > 0 && ctx->in_block_size > 0)
+				rt_16550_arm_idle_timer(ctx);
+		}
 	}
 
 	if (ctx->status) {
@@ -435,6 +570,7 @@ static int rt_16550_set_config(struct rt_16550_context *ctx,
 
 void rt_16550_cleanup_ctx(struct rt_16550_context *ctx)
 {
+	rtdm_timer_destroy(&ctx->in_timer);
 	rtdm_event_destroy(&ctx->in_event);
 	rtdm_event_destroy(&ctx->out_event);
 	rtdm_event_destroy(&ctx->ioc_event);
@@ -458,6 +594,8 @@ int rt_16550_open(struct rtdm_dev_context *context,
 	rtdm_event_init(&ctx->out_event, 0);
 	rtdm_event_init(&ctx->ioc_event, 0);
 	rtdm_mutex_init(&ctx->out_lock);
+	rtdm_timer_init(&ctx->in_timer, rt_16550_idle_timer,
+			context->device->device_name);
 
 	rt_16550_init_io_ctx(dev_id, ctx);
 
@@ -469,6 +607,12 @@ int rt_16550_open(struct rtdm_dev_context *context,
 	ctx->in_nwait = 0;
 	ctx->in_lock = 0;
 	ctx->in_history = NULL;
+	ctx->in_block_size = RTSER_DEF_RX_BLOCK_SIZE;
+	ctx->in_idle_timeout = RTSER_DEF_RX_IDLE_TIMEOUT;
+	ctx->in_idle = 0;
+	ctx->in_burst_head = 0;
+	ctx->in_burst_tail = 0;
+	ctx->in_nbursts = 0;
 
 	ctx->out_head = 0;
 	ctx->out_tail = 0;
@@ -545,6 +689,185 @@ int rt_16550_close(struct rtdm_dev_context *context,
 	return 0;
 }
 
+static int rt_16550_read_burst(struct rt_16550_context *ctx,
+			       rtdm_user_info_t *user_info, void *arg)
+{
+	struct rt_16550_burst *burst;
+	struct rtser_burst desc;
+	rtdm_lockctx_t lock_ctx;
+	rtdm_toseq_t timeout_seq;
+	size_t pending, len;
+	int in_pos, subblock;
+	int nonblocking;
+	int ret = 0;
+	int n;
+
+	if (user_info) {
+		if (rtdm_safe_copy_from_user(user_info, &desc, arg,
+					     sizeof(desc)))
+			return -EFAULT;
+		if (!rtdm_rw_user_ok(user_info, desc.buf, desc.size))
+			return -EFAULT;
+	} else
+		memcpy(&desc, arg, sizeof(desc));
+
+	if (desc.size == 0)
+		return -EINVAL;
+
+	rtdm_toseq_init(&timeout_seq, ctx->config.rx_timeout);
+
+	nonblocking = (ctx->config.rx_timeout < 0);
+
+	/* only one reader allowed, stop any further attempts here */
+	if (test_and_set_bit(0, &ctx->in_lock))
+		return -EBUSY;
+
+	rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+
+	if (ctx->in_block_size == 0) {
+		ret = -EINVAL;
+		goto unlock_out;
+	}
+
+	ctx->in_idle = 0;
+
+	while (1) {
+		if (!testbits(ctx->ier_status, IER_STAT)) {
+			ctx->ier_status |= IER_STAT;
+			rt_16550_reg_out(rt_16550_io_mode_from_ctx(ctx),
+					 ctx->base_addr, IER,
+					 ctx->ier_status);
+		}
+
+		if (ctx->status) {
+			if (testbits(ctx->status, RTSER_LSR_BREAK_IND))
+				ret = -EPIPE;
+			else
+				ret = -EIO;
+			ctx->saved_errors = ctx->status &
+			    (RTSER_LSR_OVERRUN_ERR | RTSER_LSR_PARITY_ERR |
+			     RTSER_LSR_FRAMING_ERR | RTSER_SOFT_OVERRUN_ERR);
+			ctx->status = 0;
+			goto unlock_out;
+		}
+
+		pending = ctx->in_npend;
+		if (pending > 0 &&
+		    (nonblocking || ctx->in_idle ||
+		     pending >= rt_16550_block_nwait(ctx, desc.size, 0)))
+			break;
+
+		if (nonblocking) {
+			if (ret == 0)
+				ret = -EAGAIN;
+			goto unlock_out;
+		}
+
+		if (pending > 0)
+			rt_16550_arm_idle_timer(ctx);
+		/* Wait for what completes the block, pending bytes count. */
+		ctx->in_nwait =
+			rt_16550_block_nwait(ctx, desc.size, 0) - pending;
+
+		rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+
+		ret = rtdm_event_timedwait(&ctx->in_event,
+					   ctx->config.rx_timeout,
+					   &timeout_seq);
+		if (ret < 0) {
+			if (ret == -EIDRM)
+				/* Device has been closed -
+				   return immediately. */
+				return -EBADF;
+
+			rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+
+			nonblocking = 1;
+			ctx->in_nwait = 0;
+			continue;
+		}
+
+		rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+	}
+
+	/* Collect as many whole bursts as the buffer can hold. */
+	desc.bursts = 0;
+	len = 0;
+	for (n = 0; n < ctx->in_nbursts; n++) {
+		burst = &ctx->in_bursts[(ctx->in_burst_head + n) &
+					(IN_BURST_RING - 1)];
+		if (len + burst->len > desc.size) {
+			if (n == 0) {
+				len = desc.size;
+				desc.timestamp = burst->timestamp;
+				desc.last_timestamp = burst->timestamp;
+				desc.bursts = 1;
+			}
+			break;
+		}
+		if (n == 0)
+			desc.timestamp = burst->timestamp;
+		desc.last_timestamp = burst->timestamp;
+		desc.bursts++;
+		len += burst->len;
+	}
+	in_pos = ctx->in_head;
+	ret = 0;
+
+	rtdm_timer_stop(&ctx->in_timer);
+
+	rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+
+	/* The ISR only moves the tail, copying out unlocked is safe. */
+	subblock = len;
+	if (in_pos + subblock > IN_BUFFER_SIZE)
+		subblock = IN_BUFFER_SIZE - in_pos;
+
+	if (user_info) {
+		if (rtdm_copy_to_user(user_info, desc.buf,
+				      &ctx->in_buf[in_pos], subblock) ||
+		    (len > subblock &&
+		     rtdm_copy_to_user(user_info, desc.buf + subblock,
+				       &ctx->in_buf[0], len - subblock))) {
+			ret = -EFAULT;
+			goto unlocked_out;
+		}
+	} else {
+		memcpy(desc.buf, &ctx->in_buf[in_pos], subblock);
+		if (len > subblock)
+			memcpy(desc.buf + subblock, &ctx->in_buf[0],
+			       len - subblock);
+	}
+
+	rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+
+	ctx->in_head = (ctx->in_head + len) & (IN_BUFFER_SIZE - 1);
+	if ((ctx->in_npend -= len) == 0)
+		ctx->ioc_events &= ~RTSER_EVENT_RXPEND;
+	rt_16550_consume_bursts(ctx, len);
+
+	rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+
+	desc.size = len;
+
+	if (user_info)
+		ret = rtdm_safe_copy_to_user(user_info, arg, &desc,
+					     sizeof(desc));
+	else
+		memcpy(arg, &desc, sizeof(desc));
+
+	goto unlocked_out;
+
+unlock_out:
+	rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+
+unlocked_out:
+	/* Release the simple reader lock. */
+	clear_bit(0, &ctx->in_lock);
+
+	return ret;
+}
+
 int rt_16550_ioctl(struct rtdm_dev_context *context,
 		   rtdm_user_info_t * user_info,
 		   unsigned int request, void *arg)
@@ -724,7 +1047,11 @@ int rt_16550_ioctl(struct rtdm_dev_context *context,
 		ev.last_timestamp = ctx->last_timestamp;
 		ev.rx_pending = ctx->in_npend;
 
-		if (ctx->in_history)
+		if (ctx->in_block_size > 0) {
+			if (ctx->in_nbursts > 0)
+				ev.rxpend_timestamp =
+				    ctx->in_bursts[ctx->in_burst_head].timestamp;
+		} else if (ctx->in_history)
 			ev.rxpend_timestamp = ctx->in_history[ctx->in_head];
 
 		rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
@@ -758,6 +1085,49 @@ int rt_16550_ioctl(struct rtdm_dev_context *context,
 		break;
 	}
 
+	case RTSER_RTIOC_SET_RX_BLOCK: {
+		struct rtser_rx_block *block;
+		struct rtser_rx_block block_buf;
+
+		block = (struct rtser_rx_block *)arg;
+
+		if (user_info) {
+			err =
+			    rtdm_safe_copy_from_user(user_info, &block_buf,
+						     arg,
+						     sizeof(struct
+							    rtser_rx_block));
+			if (err)
+				return err;
+
+			block = &block_buf;
+		}
+
+		if (block->block_size < 0 ||
+		    block->block_size > IN_BUFFER_SIZE ||
+		    block->idle_timeout < 0)
+			return -EINVAL;
+
+		rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
+
+		if (block->block_size > 0 && !ctx->in_block_size) {
+			ctx->in_block_size = block->block_size;
+			rt_16550_reset_bursts(ctx);
+		} else
+			ctx->in_block_size = block->block_size;
+		ctx->in_idle_timeout = block->idle_timeout;
+
+		rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
+		break;
+	}
+
+	case RTSER_RTIOC_READ_BURST:
+		if (!rtdm_in_rt_context())
+			return -ENOSYS;
+
+		err = rt_16550_read_burst(ctx, user_info, arg);
+		break;
+
 	case RTIOC_PURGE: {
 		int fcr = 0;
 
@@ -766,6 +1136,9 @@ int rt_16550_ioctl(struct rtdm_dev_context *context,
 			ctx->in_head = 0;
 			ctx->in_tail = 0;
 			ctx->in_npend = 0;
+			ctx->in_burst_head = 0;
+			ctx->in_burst_tail = 0;
+			ctx->in_nbursts = 0;
 			ctx->status = 0;
 			fcr |= FCR_FIFO | FCR_RESET_RX;
 			rt_16550_reg_in(mode, base, RHR);
@@ -826,6 +1199,8 @@ ssize_t rt_16550_read(struct rtdm_dev_context * context,
 
 	rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
 
+	ctx->in_idle = 0;
+
 	while (1) {
 		/* switch on error interrupt - the user is ready to listen */
 		if (!testbits(ctx->ier_status, IER_STAT)) {
@@ -900,10 +1275,16 @@ ssize_t rt_16550_read(struct rtdm_dev_context * context,
 			    (ctx->in_head + block) & (IN_BUFFER_SIZE - 1);
 			if ((ctx->in_npend -= block) == 0)
 				ctx->ioc_events &= ~RTSER_EVENT_RXPEND;
+			if (ctx->in_block_size > 0)
+				rt_16550_consume_bursts(ctx, block);
 
 			if (nbyte == 0)
 				break; /* All requested bytes read. */
 
+			if (ctx->in_block_size > 0 &&
+			    read >= ctx->in_block_size)
+				break; /* Block completed. */
+
 			continue;
 		}
 
@@ -913,7 +1294,15 @@ ssize_t rt_16550_read(struct rtdm_dev_context * context,
 			   returned by rtdm_event_wait[_until] */
 			break;
 
-		ctx->in_nwait = nbyte;
+		if (ctx->in_block_size > 0) {
+			if (read > 0) {
+				if (ctx->in_idle)
+					break; /* Inter-char timeout. */
+				rt_16550_arm_idle_timer(ctx);
+			}
+			ctx->in_nwait = rt_16550_block_nwait(ctx, nbyte, read);
+		} else
+			ctx->in_nwait = nbyte;
 
 		rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
 
@@ -943,6 +1332,9 @@ ssize_t rt_16550_read(struct rtdm_dev_context * context,
 		rtdm_lock_get_irqsave(&ctx->lock, lock_ctx);
 	}
 
+	if (ctx->in_block_size > 0)
+		rtdm_timer_stop(&ctx->in_timer);
+
 	rtdm_lock_put_irqrestore(&ctx->lock, lock_ctx);
 
 break_unlocked:
@@ -1106,7 +1498,7 @@ static const struct rtdm_device __initdata device_tmpl = {
 	.device_sub_class	= RTDM_SUBCLASS_16550A,
 	.profile_version	= RTSER_PROFILE_VER,
 	.driver_name		= RT_16550_DRIVER_NAME,
-	.driver_version		= RTDM_DRIVER_VER(1, 5, 2),
+	.driver_version		= RTDM_DRIVER_VER(1, 6, 0),
 	.peripheral_name	= "UART 16550A",
 	.provider_name		= "Jan Kiszka",
 };
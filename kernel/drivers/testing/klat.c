@@ -95,7 +95,7 @@ static int __init klat_mod_init(void)
 	pkt.config.priority = priority;
 	pkt.config.period = period * 1000;
 	pkt.config.warmup_loops = 1;
-	pkt.config.histogram_size = 0;
+	pkt.config.histogram_bits = 0;
 	pkt.config.freeze_max = freeze_max;
 
 	for (dev_nr = 0; dev_nr < DEV_NR_MAX; dev_nr++) {
@@ -123,7 +123,11 @@ int SKIN_INIT(sigtest)
 		return err;
 	}
 
-	xntimer_init(&sigtest_timer, tbase, sigtest_timer_handler);
+	err = xntimer_init(&sigtest_timer, tbase, sigtest_timer_handler);
+	if (err) {
+		xnshadow_unregister_interface(muxid);
+		goto fail_shutdown_pod;
+	}
 
 	return 0;
 }
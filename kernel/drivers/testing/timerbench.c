@@ -30,11 +30,18 @@ struct rt_tmbench_context {
 	int freeze_max;
 	int warmup_loops;
 	int samples_per_sec;
-	long *histogram_min;
-	long *histogram_max;
-	long *histogram_avg;
-	int histogram_size;
-	int bucketsize;
+	struct rttst_hist *histogram_min;
+	struct rttst_hist *histogram_max;
+	struct rttst_hist *histogram_avg;
+	int histogram_bits;
+	struct rttst_outlier *outliers;
+	unsigned int outliers_nr;
+	unsigned int outliers_cap;
+	long outlier_floor;
+	long outlier_threshold;
+	unsigned int crossings;
+	struct rttst_outlier last_crossing;
+	uint64_t origin;
 
 	rtdm_task_t timer_task;
 
@@ -58,13 +65,55 @@ MODULE_PARM_DESC(start_index, "First device instance number to be used");
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("jan.kiszka@web.de");
 
-static inline void add_histogram(struct rt_tmbench_context *ctx,
-				 long *histogram, long addval)
+static inline void add_histogram(struct rttst_hist *histogram, long addval)
 {
-	/* bucketsize steps */
-	long inabs = (addval >= 0 ? addval : -addval) / ctx->bucketsize;
-	histogram[inabs < ctx->histogram_size ?
-		  inabs : ctx->histogram_size - 1]++;
+	rttst_hist_add(histogram, addval >= 0 ? addval : -addval);
+}
+
+static void free_histograms(struct rt_tmbench_context *ctx)
+{
+	kfree(ctx->histogram_min);
+	kfree(ctx->histogram_max);
+	kfree(ctx->histogram_avg);
+	ctx->histogram_bits = 0;
+}
+
+static void free_outliers(struct rt_tmbench_context *ctx)
+{
+	struct rttst_outlier *outliers;
+
+	/* Readers may be running in primary mode, detach first. */
+	RTDM_EXECUTE_ATOMICALLY(
+		outliers = ctx->outliers;
+		ctx->outliers = NULL;
+		ctx->outliers_nr = 0;
+		ctx->outliers_cap = 0;
+	);
+
+	kfree(outliers);
+}
+
+static void eval_outlier(struct rt_tmbench_context *ctx, long dt)
+{
+	long long timestamp = ctx->date - ctx->origin;
+
+	if (dt > ctx->outlier_floor)
+		ctx->outlier_floor =
+			rttst_outlier_add(ctx->outliers, &ctx->outliers_nr,
+					  ctx->outliers_cap, timestamp, dt);
+
+	if (dt <= ctx->outlier_threshold)
+		return;
+
+	/* New worst case beyond the threshold: freeze the trace. */
+	ctx->outlier_threshold = dt;
+	ctx->last_crossing.timestamp = timestamp;
+	ctx->last_crossing.latency = dt;
+	ctx->crossings++;
+#ifdef CONFIG_IPIPE_TRACE
+	ipipe_trace_frozen_reset();
+	ipipe_trace_freeze(dt);
+#endif /* CONFIG_IPIPE_TRACE */
 }
 
 static inline long long slldiv(long long s, unsigned d)
@@ -80,8 +129,11 @@ static void eval_inner_loop(struct rt_tmbench_context *ctx, long dt)
 		ctx->curr.min = dt;
 	ctx->curr.avg += dt;
 
+	if (ctx->outliers_cap && !ctx->warmup)
+		eval_outlier(ctx, dt);
 #ifdef CONFIG_IPIPE_TRACE
-	if (ctx->freeze_max && (dt > ctx->result.overall.max) && !ctx->warmup) {
+	else if (ctx->freeze_max && (dt > ctx->result.overall.max) &&
+		 !ctx->warmup) {
 		ipipe_trace_frozen_reset();
 		ipipe_trace_freeze(dt);
 		ctx->result.overall.max = dt;
@@ -90,8 +142,8 @@ static void eval_inner_loop(struct rt_tmbench_context *ctx, long dt)
 
 	ctx->date += ctx->period;
 
-	if (!ctx->warmup && ctx->histogram_size)
-		add_histogram(ctx, ctx->histogram_avg, dt);
+	if (!ctx->warmup && ctx->histogram_bits)
+		add_histogram(ctx->histogram_avg, dt);
 
 	/* Evaluate overruns and adjust next release date.
 	   Beware of signedness! */
@@ -105,9 +157,9 @@ static void eval_inner_loop(struct rt_tmbench_context *ctx, long dt)
 static void eval_outer_loop(struct rt_tmbench_context *ctx)
 {
 	if (!ctx->warmup) {
-		if (ctx->histogram_size) {
-			add_histogram(ctx, ctx->histogram_max, ctx->curr.max);
-			add_histogram(ctx, ctx->histogram_min, ctx->curr.min);
+		if (ctx->histogram_bits) {
+			add_histogram(ctx->histogram_max, ctx->curr.max);
+			add_histogram(ctx->histogram_min, ctx->curr.min);
 		}
 
 		ctx->result.last.min = ctx->curr.min;
@@ -146,6 +198,7 @@ static void timer_task_proc(void *arg)
 
 	/* first event: one millisecond from now. */
 	ctx->date = rtdm_clock_read_monotonic() + 1000000;
+	ctx->origin = ctx->date;
 
 	while (1) {
 		int err;
@@ -198,6 +251,8 @@ static int rt_tmbench_open(struct rtdm_dev_context *context,
 	ctx = (struct rt_tmbench_context *)context->dev_private;
 
 	ctx->mode = RTTST_TMBENCH_INVALID;
+	ctx->outliers = NULL;
+	ctx->outliers_cap = 0;
 	sema_init(&ctx->nrt_mutex, 1);
 
 	return 0;
@@ -220,11 +275,12 @@ static int rt_tmbench_close(struct rtdm_dev_context *context,
 
 		rtdm_event_destroy(&ctx->result_event);
 
-		if (ctx->histogram_size)
-			kfree(ctx->histogram_min);
+		if (ctx->histogram_bits)
+			free_histograms(ctx);
+
+		free_outliers(ctx);
 
 		ctx->mode = RTTST_TMBENCH_INVALID;
-		ctx->histogram_size = 0;
 	}
 
 	up(&ctx->nrt_mutex);
@@ -257,28 +313,60 @@ static int rt_tmbench_start(struct rtdm_dev_context *context,
 	ctx->period = config->period;
 	ctx->warmup_loops = config->warmup_loops;
 	ctx->samples_per_sec = 1000000000 / ctx->period;
-	ctx->histogram_size = config->histogram_size;
+	ctx->histogram_bits = config->histogram_bits;
 	ctx->freeze_max = config->freeze_max;
 
-	if (ctx->histogram_size > 0) {
-		ctx->histogram_min =
-		    kmalloc(3 * ctx->histogram_size * sizeof(long),
-			    GFP_KERNEL);
-		ctx->histogram_max =
-		    ctx->histogram_min + config->histogram_size;
-		ctx->histogram_avg =
-		    ctx->histogram_max + config->histogram_size;
+	if (ctx->histogram_bits > 0) {
+		size_t size;
 
-		if (!ctx->histogram_min) {
+		if (!rttst_hist_valid_p(ctx->histogram_bits,
+					RTTST_HIST_RANGE_BITS)) {
+			ctx->histogram_bits = 0;
+			up(&ctx->nrt_mutex);
+			return -EINVAL;
+		}
+
+		size = rttst_hist_size(ctx->histogram_bits,
+				       RTTST_HIST_RANGE_BITS);
+		ctx->histogram_min = kmalloc(size, GFP_KERNEL);
+		ctx->histogram_max = kmalloc(size, GFP_KERNEL);
+		ctx->histogram_avg = kmalloc(size, GFP_KERNEL);
+
+		if (!ctx->histogram_min || !ctx->histogram_max ||
+		    !ctx->histogram_avg) {
+			free_histograms(ctx);
 			up(&ctx->nrt_mutex);
 			return -ENOMEM;
 		}
 
-		memset(ctx->histogram_min, 0,
-		       3 * ctx->histogram_size * sizeof(long));
-		ctx->bucketsize = config->histogram_bucketsize;
+		rttst_hist_init(ctx->histogram_min, ctx->histogram_bits,
+				RTTST_HIST_RANGE_BITS);
+		rttst_hist_init(ctx->histogram_max, ctx->histogram_bits,
+				RTTST_HIST_RANGE_BITS);
+		rttst_hist_init(ctx->histogram_avg, ctx->histogram_bits,
+				RTTST_HIST_RANGE_BITS);
 	}
 
+	if (config->outliers > 0) {
+		ctx->outliers_cap = min(config->outliers, RTTST_OUTLIERS_MAX);
+		ctx->outliers = kmalloc(ctx->outliers_cap *
+					sizeof(struct rttst_outlier),
+					GFP_KERNEL);
+		if (!ctx->outliers) {
+			ctx->outliers_cap = 0;
+			if (ctx->histogram_bits)
+				free_histograms(ctx);
+			up(&ctx->nrt_mutex);
+			return -ENOMEM;
+		}
+	}
+
+	ctx->outliers_nr = 0;
+	ctx->outlier_floor = LONG_MIN;
+	ctx->outlier_threshold = config->outlier_threshold;
+	ctx->crossings = 0;
+	memset(&ctx->last_crossing, 0, sizeof(ctx->last_crossing));
+
 	ctx->result.overall.min = 10000000;
 	ctx->result.overall.max = -10000000;
 	ctx->result.overall.avg = 0;
@@ -317,6 +405,7 @@ static int rt_tmbench_start(struct rtdm_dev_context *context,
 
 				/* first event: one millisecond from now. */
 				ctx->date = ctx->start_time + 1000000;
+				ctx->origin = ctx->date;
 
 				err =
 				    rtdm_timer_start(&ctx->timer, ctx->date, 0,
@@ -371,8 +460,9 @@ static int rt_tmbench_stop(struct rt_tmbench_context *ctx,
 		       sizeof(struct rttst_bench_res));
 	}
 
-	if (ctx->histogram_size > 0) {
-		int size = ctx->histogram_size * sizeof(long);
+	if (ctx->histogram_bits > 0) {
+		size_t size = rttst_hist_size(ctx->histogram_bits,
+					      RTTST_HIST_RANGE_BITS);
 
 		if (user_info) {
 			struct rttst_overall_bench_res res_buf;
@@ -399,14 +489,70 @@ static int rt_tmbench_stop(struct rt_tmbench_context *ctx,
 			memcpy(res->histogram_avg, ctx->histogram_avg, size);
 		}
 
-		kfree(ctx->histogram_min);
+		free_histograms(ctx);
 	}
 
+	free_outliers(ctx);
+
 	up(&ctx->nrt_mutex);
 
 	return err;
 }
 
+static int rt_tmbench_outliers(struct rt_tmbench_context *ctx,
+			       rtdm_user_info_t *user_info,
+			       struct rttst_tmbench_outliers __user *user_req)
+{
+	struct rttst_tmbench_outliers req;
+	struct rttst_outlier sample;
+	unsigned int n;
+	int valid;
+
+	if (user_info) {
+		if (rtdm_safe_copy_from_user(user_info, &req, user_req,
+					     sizeof(req)) < 0)
+			return -EFAULT;
+	} else
+		memcpy(&req, user_req, sizeof(req));
+
+	/*
+	 * The sampler keeps updating the table, copy it entry by
+	 * entry so that the lock is never held across a user copy.
+	 */
+	RTDM_EXECUTE_ATOMICALLY(
+		if (ctx->mode < 0 || ctx->outliers_cap == 0)
+			req.nr = 0;
+		else if (req.nr > ctx->outliers_nr)
+			req.nr = ctx->outliers_nr;
+		req.crossings = ctx->crossings;
+		req.last = ctx->last_crossing;
+	);
+
+	for (n = 0; n < req.nr; n++) {
+		RTDM_EXECUTE_ATOMICALLY(
+			valid = n < ctx->outliers_nr;
+			if (valid)
+				sample = ctx->outliers[n];
+		);
+		if (!valid) {
+			req.nr = n;
+			break;
+		}
+		if (!user_info)
+			req.buf[n] = sample;
+		else if (rtdm_safe_copy_to_user(user_info, &req.buf[n],
+						&sample, sizeof(sample)) < 0)
+			return -EFAULT;
+	}
+
+	if (!user_info) {
+		memcpy(user_req, &req, sizeof(req));
+		return 0;
+	}
+
+	return rtdm_safe_copy_to_user(user_info, user_req, &req, sizeof(req));
+}
+
 static int rt_tmbench_ioctl_nrt(struct rtdm_dev_context *context,
 				rtdm_user_info_t *user_info,
 				unsigned int request, void __user *arg)
@@ -425,6 +571,10 @@ static int rt_tmbench_ioctl_nrt(struct rtdm_dev_context *context,
 		err = rt_tmbench_stop(ctx, user_info, arg);
 		break;
 
+	case RTTST_RTIOC_TMBENCH_OUTLIERS:
+		err = rt_tmbench_outliers(ctx, user_info, arg);
+		break;
+
 	case RTTST_RTIOC_INTERM_BENCH_RES:
 		err = -ENOSYS;
 		break;
@@ -465,6 +615,10 @@ static int rt_tmbench_ioctl_rt(struct rtdm_dev_context *context,
 
 		break;
 
+	case RTTST_RTIOC_TMBENCH_OUTLIERS:
+		err = rt_tmbench_outliers(ctx, user_info, arg);
+		break;
+
 	case RTTST_RTIOC_TMBENCH_START:
 	case RTTST_RTIOC_TMBENCH_STOP:
 		err = -ENOSYS;
@@ -497,7 +651,7 @@ static struct rtdm_device device = {
 	.device_sub_class	= RTDM_SUBCLASS_TIMERBENCH,
 	.profile_version	= RTTST_PROFILE_VER,
 	.driver_name		= "xeno_timerbench",
-	.driver_version		= RTDM_DRIVER_VER(0, 2, 1),
+	.driver_version		= RTDM_DRIVER_VER(0, 3, 0),
 	.peripheral_name	= "Timer Latency Benchmark",
 	.provider_name		= "Jan Kiszka",
 	.proc_name		= device.device_name,
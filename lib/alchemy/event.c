@@ -67,6 +67,14 @@ static inline void put_alchemy_event(struct alchemy_event *evcb,
 	syncobj_unlock(&evcb->sobj, syns);
 }
 
+static void event_signal_watchers(struct alchemy_event *evcb)
+{
+	struct waitwatch *watch;
+
+	syncobj_for_each_watch(&evcb->sobj, watch)
+		waitwatch_signal(watch, (evcb->value & watch->arg) != 0);
+}
+
 static void event_finalize(struct syncobj *sobj)
 {
 	struct alchemy_event *evcb;
@@ -259,6 +267,8 @@ int rt_event_signal(RT_EVENT *event, unsigned long mask)
 		}
 	}
 
+	event_signal_watchers(evcb);
+
 	put_alchemy_event(evcb, &syns);
 out:
 	COPPERPLATE_UNPROTECT(svc);
@@ -284,6 +294,7 @@ int rt_event_clear(RT_EVENT *event,
 		*mask_r = evcb->value;
 
 	evcb->value &= ~mask;
+	event_signal_watchers(evcb);
 
 	put_alchemy_event(evcb, &syns);
 out:
@@ -315,3 +326,22 @@ out:
 
 	return ret;
 }
+
+int alchemy_event_watch(RT_EVENT *event, struct waitset *wset,
+			unsigned long mask, uintptr_t cookie)
+{
+	struct alchemy_event *evcb;
+	struct syncstate syns;
+	int ret = 0;
+
+	evcb = get_alchemy_event(event, &syns, &ret);
+	if (evcb == NULL)
+		return ret;
+
+	ret = waitset_watch(wset, &evcb->sobj, cookie, mask,
+			    (evcb->value & mask) != 0);
+
+	put_alchemy_event(evcb, &syns);
+
+	return ret;
+}
@@ -21,6 +21,7 @@
 
 #include <copperplate/syncobj.h>
 #include <copperplate/cluster.h>
+#include <copperplate/waitset.h>
 #include <alchemy/event.h>
 
 struct alchemy_event {
@@ -41,4 +42,7 @@ struct alchemy_event_wait {
 
 extern struct cluster alchemy_event_table;
 
+int alchemy_event_watch(RT_EVENT *event, struct waitset *wset,
+			unsigned long mask, uintptr_t cookie);
+
 #endif /* _ALCHEMY_EVENT_H */
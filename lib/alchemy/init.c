@@ -27,6 +27,9 @@
 #include "task.h"
 #include "sem.h"
 #include "event.h"
+#include "mutex.h"
+#include "cond.h"
+#include "waitset.h"
 
 static unsigned int clock_resolution = 1; /* nanosecond. */
 
@@ -66,6 +69,9 @@ static int alchemy_init(int argc, char *const argv[])
 	cluster_init(&alchemy_task_table, "alchemy.task");
 	cluster_init(&alchemy_sem_table, "alchemy.sem");
 	cluster_init(&alchemy_event_table, "alchemy.event");
+	cluster_init(&alchemy_mutex_table, "alchemy.mutex");
+	cluster_init(&alchemy_cond_table, "alchemy.cond");
+	cluster_init(&alchemy_waitset_table, "alchemy.waitset");
 
 	ret = clockobj_init(&alchemy_clock, "alchemy", clock_resolution);
 	if (ret) {
@@ -67,6 +67,14 @@ static inline void put_alchemy_sem(struct alchemy_sem *scb,
 	syncobj_unlock(&scb->sobj, syns);
 }
 
+static void sem_signal_watchers(struct alchemy_sem *scb)
+{
+	struct waitwatch *watch;
+
+	syncobj_for_each_watch(&scb->sobj, watch)
+		waitwatch_signal(watch, scb->value > 0);
+}
+
 static void sem_finalize(struct syncobj *sobj)
 {
 	struct alchemy_sem *scb = container_of(sobj, struct alchemy_sem, sobj);
@@ -158,8 +166,10 @@ int rt_sem_p_until(RT_SEM *sem, RTIME timeout)
 	if (scb == NULL)
 		goto out;
 
-	if (--scb->value >= 0)
+	if (--scb->value >= 0) {
+		sem_signal_watchers(scb);
 		goto done;
+	}
 
 	if (timeout == TM_NONBLOCK) {
 		scb->value++;
@@ -233,6 +243,8 @@ int rt_sem_v(RT_SEM *sem)
 		syncobj_post(&scb->sobj);
 	else if (scb->mode & S_PULSE)
 		scb->value = 0;
+	else
+		sem_signal_watchers(scb);
 
 	put_alchemy_sem(scb, &syns);
 out:
@@ -289,3 +301,20 @@ out:
 
 	return ret;
 }
+
+int alchemy_sem_watch(RT_SEM *sem, struct waitset *wset, uintptr_t cookie)
+{
+	struct alchemy_sem *scb;
+	struct syncstate syns;
+	int ret = 0;
+
+	scb = get_alchemy_sem(sem, &syns, &ret);
+	if (scb == NULL)
+		return ret;
+
+	ret = waitset_watch(wset, &scb->sobj, cookie, 0, scb->value > 0);
+
+	put_alchemy_sem(scb, &syns);
+
+	return ret;
+}
@@ -21,6 +21,7 @@
 
 #include <copperplate/syncobj.h>
 #include <copperplate/cluster.h>
+#include <copperplate/waitset.h>
 #include <alchemy/sem.h>
 
 struct alchemy_sem {
@@ -36,4 +37,6 @@ struct alchemy_sem {
 
 extern struct cluster alchemy_sem_table;
 
+int alchemy_sem_watch(RT_SEM *sem, struct waitset *wset, uintptr_t cookie);
+
 #endif /* _ALCHEMY_SEM_H */
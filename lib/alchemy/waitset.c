@@ -0,0 +1,332 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <copperplate/threadobj.h>
+#include <copperplate/heapobj.h>
+#include "reference.h"
+#include "waitset.h"
+#include "sem.h"
+#include "event.h"
+#include "timer.h"
+
+/*
+ * A waitset lets a task pend on several semaphores and event flag
+ * groups at once, until any of them is ready, i.e. a semaphore has
+ * a positive count, or an event group has any bit of the watched
+ * mask set. rt_waitset_wait() returns the cookies which were given
+ * when adding the ready objects, which may be consumed without
+ * blocking afterwards. Readiness is level-triggered, so a deleted
+ * object remains ready until it is removed from the waitset; the
+ * next call to a service on such object returns -EIDRM.
+ */
+
+struct cluster alchemy_waitset_table;
+
+static struct alchemy_waitset *get_alchemy_waitset(RT_WAITSET *ws,
+						   struct syncstate *syns,
+						   int *err_r)
+{
+	struct alchemy_waitset *wscb;
+
+	if (ws == NULL || ((intptr_t)ws & (sizeof(intptr_t)-1)) != 0)
+		goto bad_handle;
+
+	wscb = mainheap_deref(ws->handle, struct alchemy_waitset);
+	if (wscb == NULL || ((intptr_t)wscb & (sizeof(intptr_t)-1)) != 0)
+		goto bad_handle;
+
+	if (wscb->magic == ~waitset_magic)
+		goto dead_handle;
+
+	if (wscb->magic != waitset_magic)
+		goto bad_handle;
+
+	if (syncobj_lock(&wscb->wset.sobj, syns))
+		goto bad_handle;
+
+	/* Recheck under lock. */
+	if (wscb->magic == waitset_magic)
+		return wscb;
+
+dead_handle:
+	/* Removed under our feet. */
+	*err_r = -EIDRM;
+	return NULL;
+
+bad_handle:
+	*err_r = -EINVAL;
+	return NULL;
+}
+
+static inline void put_alchemy_waitset(struct alchemy_waitset *wscb,
+				       struct syncstate *syns)
+{
+	syncobj_unlock(&wscb->wset.sobj, syns);
+}
+
+static void waitset_finalize(struct syncobj *sobj)
+{
+	struct alchemy_waitset *wscb;
+	wscb = container_of(sobj, struct alchemy_waitset, wset.sobj);
+	xnfree(wscb);
+}
+fnref_register(libalchemy, waitset_finalize);
+
+int rt_waitset_create(RT_WAITSET *ws, const char *name, int mode)
+{
+	struct alchemy_waitset *wscb;
+	struct service svc;
+	int sobj_flags = 0;
+
+	if (threadobj_async_p())
+		return -EPERM;
+
+	COPPERPLATE_PROTECT(svc);
+
+	wscb = xnmalloc(sizeof(*wscb));
+	if (wscb == NULL) {
+		COPPERPLATE_UNPROTECT(svc);
+		return -ENOMEM;
+	}
+
+	strncpy(wscb->name, name, sizeof(wscb->name));
+	wscb->name[sizeof(wscb->name) - 1] = '\0';
+
+	if (cluster_addobj(&alchemy_waitset_table, wscb->name, &wscb->cobj)) {
+		xnfree(wscb);
+		COPPERPLATE_UNPROTECT(svc);
+		return -EEXIST;
+	}
+
+	if (mode & WS_PRIO)
+		sobj_flags = SYNCOBJ_PRIO;
+
+	wscb->magic = waitset_magic;
+	waitset_init(&wscb->wset, sobj_flags,
+		     fnref_put(libalchemy, waitset_finalize));
+	ws->handle = mainheap_ref(wscb, uintptr_t);
+
+	COPPERPLATE_UNPROTECT(svc);
+
+	return 0;
+}
+
+int rt_waitset_delete(RT_WAITSET *ws)
+{
+	struct alchemy_waitset *wscb;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0;
+
+	if (threadobj_async_p())
+		return -EPERM;
+
+	COPPERPLATE_PROTECT(svc);
+
+	wscb = get_alchemy_waitset(ws, &syns, &ret);
+	if (wscb == NULL)
+		goto out;
+
+	cluster_delobj(&alchemy_waitset_table, &wscb->cobj);
+	wscb->magic = ~waitset_magic; /* Prevent further reference. */
+	waitset_destroy(&wscb->wset, &syns);
+out:
+	COPPERPLATE_UNPROTECT(svc);
+
+	return ret;
+}
+
+int rt_waitset_add_sem(RT_WAITSET *ws, RT_SEM *sem, void *cookie)
+{
+	struct alchemy_waitset *wscb;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0, err;
+
+	COPPERPLATE_PROTECT(svc);
+
+	wscb = get_alchemy_waitset(ws, &syns, &ret);
+	if (wscb == NULL)
+		goto out;
+
+	/* The semaphore lock nests outside the waitset lock. */
+	waitset_hold(&wscb->wset, &syns);
+	ret = alchemy_sem_watch(sem, &wscb->wset, (uintptr_t)cookie);
+	err = waitset_release(&wscb->wset, &syns);
+	if (err) {
+		ret = err;
+		goto out;
+	}
+
+	put_alchemy_waitset(wscb, &syns);
+out:
+	COPPERPLATE_UNPROTECT(svc);
+
+	return ret;
+}
+
+int rt_waitset_add_event(RT_WAITSET *ws, RT_EVENT *event,
+			 unsigned long mask, void *cookie)
+{
+	struct alchemy_waitset *wscb;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0, err;
+
+	if (mask == 0)
+		return -EINVAL;
+
+	COPPERPLATE_PROTECT(svc);
+
+	wscb = get_alchemy_waitset(ws, &syns, &ret);
+	if (wscb == NULL)
+		goto out;
+
+	waitset_hold(&wscb->wset, &syns);
+	ret = alchemy_event_watch(event, &wscb->wset, mask, (uintptr_t)cookie);
+	err = waitset_release(&wscb->wset, &syns);
+	if (err) {
+		ret = err;
+		goto out;
+	}
+
+	put_alchemy_waitset(wscb, &syns);
+out:
+	COPPERPLATE_UNPROTECT(svc);
+
+	return ret;
+}
+
+int rt_waitset_remove(RT_WAITSET *ws, void *cookie)
+{
+	struct alchemy_waitset *wscb;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0;
+
+	COPPERPLATE_PROTECT(svc);
+
+	wscb = get_alchemy_waitset(ws, &syns, &ret);
+	if (wscb == NULL)
+		goto out;
+
+	ret = waitset_unwatch(&wscb->wset, (uintptr_t)cookie, &syns);
+	if (ret == -EIDRM)
+		goto out;
+
+	put_alchemy_waitset(wscb, &syns);
+out:
+	COPPERPLATE_UNPROTECT(svc);
+
+	return ret;
+}
+
+int rt_waitset_wait_until(RT_WAITSET *ws, void **cookies, int nr,
+			  RTIME timeout)
+{
+	uintptr_t ready[WAITSET_MAXREADY];
+	struct alchemy_waitset *wscb;
+	struct timespec ts, *timespec;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0, n;
+
+	if (nr <= 0)
+		return -EINVAL;
+
+	if (nr > WAITSET_MAXREADY)
+		nr = WAITSET_MAXREADY;
+
+	COPPERPLATE_PROTECT(svc);
+
+	wscb = get_alchemy_waitset(ws, &syns, &ret);
+	if (wscb == NULL)
+		goto out;
+
+	ret = waitset_poll(&wscb->wset, ready, nr);
+	if (ret > 0)
+		goto done;
+
+	if (timeout == TM_NONBLOCK) {
+		ret = -EWOULDBLOCK;
+		goto done;
+	}
+
+	if (threadobj_async_p()) {
+		ret = -EPERM;
+		goto done;
+	}
+
+	if (timeout != TM_INFINITE) {
+		timespec = &ts;
+		clockobj_ticks_to_timeout(&alchemy_clock, timeout, timespec);
+	} else
+		timespec = NULL;
+
+	ret = waitset_wait(&wscb->wset, ready, nr, timespec, &syns);
+	if (ret == -EIDRM)
+		goto out;
+done:
+	put_alchemy_waitset(wscb, &syns);
+
+	for (n = 0; n < ret; n++)
+		cookies[n] = (void *)ready[n];
+out:
+	COPPERPLATE_UNPROTECT(svc);
+
+	return ret;
+}
+
+int rt_waitset_wait(RT_WAITSET *ws, void **cookies, int nr, RTIME timeout)
+{
+	struct service svc;
+	ticks_t now;
+
+	if (timeout != TM_INFINITE && timeout != TM_NONBLOCK) {
+		COPPERPLATE_PROTECT(svc);
+		clockobj_get_time(&alchemy_clock, &now, NULL);
+		COPPERPLATE_UNPROTECT(svc);
+		timeout += now;
+	}
+
+	return rt_waitset_wait_until(ws, cookies, nr, timeout);
+}
+
+int rt_waitset_inquire(RT_WAITSET *ws, RT_WAITSET_INFO *info)
+{
+	struct alchemy_waitset *wscb;
+	struct syncstate syns;
+	struct service svc;
+	int ret = 0;
+
+	COPPERPLATE_PROTECT(svc);
+
+	wscb = get_alchemy_waitset(ws, &syns, &ret);
+	if (wscb == NULL)
+		goto out;
+
+	info->nwatch = wscb->wset.nwatch;
+	info->nwaiters = syncobj_pend_count(&wscb->wset.sobj);
+	strcpy(info->name, wscb->name);
+
+	put_alchemy_waitset(wscb, &syns);
+out:
+	COPPERPLATE_UNPROTECT(svc);
+
+	return ret;
+}
@@ -0,0 +1,38 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#ifndef _ALCHEMY_WAITSET_H
+#define _ALCHEMY_WAITSET_H
+
+#include <copperplate/waitset.h>
+#include <copperplate/cluster.h>
+#include <alchemy/waitset.h>
+
+struct alchemy_waitset {
+	unsigned int magic;	/* Must be first. */
+	char name[32];
+	struct waitset wset;
+	struct clusterobj cobj;
+};
+
+#define waitset_magic	0x8787ebeb
+
+/* Longest ready set gathered on the stack by rt_waitset_wait(). */
+#define WAITSET_MAXREADY	32
+
+extern struct cluster alchemy_waitset_table;
+
+#endif /* _ALCHEMY_WAITSET_H */
@@ -62,34 +62,33 @@ static int __do_clock_host_realtime(struct timespec *ts, void *tzp)
 	unsigned long long now, base, mask, cycle_delta;
 	unsigned long mult, shift, nsec, rem;
 	struct xnvdso_hostrt_data *hostrt_data;
+	int live;
 
 	if (!xnvdso_test_feature(XNVDSO_FEAT_HOST_REALTIME))
-		return -1;
+		return EINVAL;
 
 	hostrt_data = &nkvdso->hostrt_data;
 
-	if (unlikely(!hostrt_data->live))
-		return -1;
-
 	/*
 	 * The following is essentially a verbatim copy of the
-	 * mechanism in the kernel.
+	 * mechanism in the kernel. The live flag is sampled within
+	 * the read section as well, so that we never mix data from
+	 * distinct updates.
 	 */
-retry:
-	seq = xnread_seqcount_begin(&hostrt_data->seqcount);
-
-	now = __xn_rdtsc();
-	base = hostrt_data->cycle_last;
-	mask = hostrt_data->mask;
-	mult = hostrt_data->mult;
-	shift = hostrt_data->shift;
-	ts->tv_sec = hostrt_data->wall_time_sec;
-	nsec = hostrt_data->wall_time_nsec;
-
-	/* If the data changed during the read, try the
-	   alternative data element */
-	if (xnread_seqcount_retry(&hostrt_data->seqcount, seq))
-		goto retry;
+	do {
+		seq = xnread_seqcount_begin(&hostrt_data->seqcount);
+		live = hostrt_data->live;
+		now = __xn_rdtsc();
+		base = hostrt_data->cycle_last;
+		mask = hostrt_data->mask;
+		mult = hostrt_data->mult;
+		shift = hostrt_data->shift;
+		ts->tv_sec = hostrt_data->wall_time_sec;
+		nsec = hostrt_data->wall_time_nsec;
+	} while (xnread_seqcount_retry(&hostrt_data->seqcount, seq));
+
+	if (unlikely(!live))
+		return EINVAL;
 
 	cycle_delta = (now - base) & mask;
 	nsec += (cycle_delta * mult) >> shift;
@@ -100,6 +99,38 @@ retry:
 	return 0;
 }
 
+/*
+ * CLOCK_REALTIME is the monotonic time plus the nucleus wallclock
+ * offset, which the kernel publishes in the vdso each time it
+ * changes. This only works with an aperiodic time base, otherwise
+ * the clock is tick-based and must be read from the kernel.
+ */
+static int __do_clock_realtime(struct timespec *ts)
+{
+	struct xnvdso_wallclock_data *wallclock;
+	unsigned long long ns, offset;
+	unsigned long rem;
+	unsigned int seq;
+
+	if (__pse51_sysinfo.tickval != 1 ||
+	    !xnvdso_test_feature(XNVDSO_FEAT_WALLCLOCK))
+		return -1;
+
+	wallclock = &nkvdso->wallclock;
+
+	do {
+		seq = xnread_seqcount_begin(&wallclock->seqcount);
+		offset = wallclock->offset;
+		ns = xnarch_tsc_to_ns(__xn_rdtsc());
+	} while (xnread_seqcount_retry(&wallclock->seqcount, seq));
+
+	ns += offset;
+	ts->tv_sec = xnarch_divrem_billion(ns, &rem);
+	ts->tv_nsec = rem;
+
+	return 0;
+}
+
 int __wrap_clock_gettime(clockid_t clock_id, struct timespec *tp)
 {
 	int err;
@@ -108,6 +139,10 @@ int __wrap_clock_gettime(clockid_t clock_id, struct timespec *tp)
 	case CLOCK_HOST_REALTIME:
 		err = __do_clock_host_realtime(tp, NULL);
 		break;
+	case CLOCK_REALTIME:
+		if (__do_clock_realtime(tp) == 0)
+			return 0;
+		goto syscall;
 	case CLOCK_MONOTONIC:
 	case CLOCK_MONOTONIC_RAW:
 		if (__pse51_sysinfo.tickval == 1) {
@@ -121,6 +156,7 @@ int __wrap_clock_gettime(clockid_t clock_id, struct timespec *tp)
 		}
 		/* Falldown wanted */
 	default:
+	syscall:
 		err = -XENOMAI_SKINCALL2(__pse51_muxid,
 					 __pse51_clock_gettime,
 					 clock_id,
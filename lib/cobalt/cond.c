@@ -24,6 +24,31 @@
 
 extern int __pse51_muxid;
 
+#ifdef CONFIG_XENO_FASTSYNCH
+#define PSE51_COND_MAGIC (0x86860505)
+
+extern unsigned long xeno_sem_heap[2];
+
+/*
+ * The kernel counts the threads waiting on the condition variable,
+ * there is no point in issuing a system call for waking up nobody.
+ */
+static int cond_has_waiters(struct __shadow_cond *shadow)
+{
+	xnarch_atomic_t *pendingp;
+
+	if (shadow->magic != PSE51_COND_MAGIC)
+		return 1;	/* Let the kernel complain. */
+
+	pendingp = (xnarch_atomic_t *)
+		(xeno_sem_heap[!!shadow->pshared] + shadow->pending_offset);
+
+	xnarch_memory_barrier();
+
+	return xnarch_atomic_get(pendingp) != 0;
+}
+#endif /* CONFIG_XENO_FASTSYNCH */
+
 int __wrap_pthread_condattr_init(pthread_condattr_t *attr)
 {
 	return -XENOMAI_SKINCALL1(__pse51_muxid, __pse51_condattr_init, attr);
@@ -182,6 +207,11 @@ int __wrap_pthread_cond_signal(pthread_cond_t * cond)
 {
 	union __xeno_cond *_cond = (union __xeno_cond *)cond;
 
+#ifdef CONFIG_XENO_FASTSYNCH
+	if (!cond_has_waiters(&_cond->shadow_cond))
+		return 0;
+#endif /* CONFIG_XENO_FASTSYNCH */
+
 	return -XENOMAI_SKINCALL1(__pse51_muxid,
 				  __pse51_cond_signal, &_cond->shadow_cond);
 }
@@ -190,6 +220,11 @@ int __wrap_pthread_cond_broadcast(pthread_cond_t * cond)
 {
 	union __xeno_cond *_cond = (union __xeno_cond *)cond;
 
+#ifdef CONFIG_XENO_FASTSYNCH
+	if (!cond_has_waiters(&_cond->shadow_cond))
+		return 0;
+#endif /* CONFIG_XENO_FASTSYNCH */
+
 	return -XENOMAI_SKINCALL1(__pse51_muxid,
 				  __pse51_cond_broadcast, &_cond->shadow_cond);
 }
@@ -23,9 +23,60 @@
 #include <pthread.h>		/* For pthread_setcanceltype. */
 #include <cobalt/syscall.h>
 #include <semaphore.h>
+#include <asm/xenomai/atomic.h>
 
 extern int __pse51_muxid;
 
+#ifdef CONFIG_XENO_FASTSYNCH
+#define PSE51_SEM_MAGIC		(0x86860606)
+#define PSE51_NAMED_SEM_MAGIC	(0x86860C0C)
+
+extern unsigned long xeno_sem_heap[2];
+
+/*
+ * The count word is shared with the kernel, a negative value is minus
+ * the number of waiters. We may only update it here as long as no
+ * thread is waiting, otherwise the kernel has to wake one up.
+ */
+static xnarch_atomic_t *sem_get_valuep(struct __shadow_sem *shadow)
+{
+	if (shadow->magic != PSE51_SEM_MAGIC
+	    && shadow->magic != PSE51_NAMED_SEM_MAGIC)
+		return NULL;
+
+	return (xnarch_atomic_t *)
+		(xeno_sem_heap[!!shadow->pshared] + shadow->value_offset);
+}
+
+static int sem_fast_trywait(xnarch_atomic_t *valuep)
+{
+	long old;
+
+	do {
+		old = (long)xnarch_atomic_get(valuep);
+		if (old <= 0)
+			return EAGAIN;
+	} while (xnarch_atomic_cmpxchg(valuep, old, old - 1) != old);
+
+	return 0;
+}
+
+static int sem_fast_post(xnarch_atomic_t *valuep)
+{
+	long old;
+
+	do {
+		old = (long)xnarch_atomic_get(valuep);
+		if (old < 0)
+			return EWOULDBLOCK;
+		if (old == SEM_VALUE_MAX)
+			return EAGAIN;
+	} while (xnarch_atomic_cmpxchg(valuep, old, old + 1) != old);
+
+	return 0;
+}
+#endif /* CONFIG_XENO_FASTSYNCH */
+
 int __wrap_sem_init(sem_t * sem, int pshared, unsigned value)
 {
 	union __xeno_sem *_sem = (union __xeno_sem *)sem;
@@ -62,8 +113,21 @@ int __wrap_sem_post(sem_t * sem)
 	union __xeno_sem *_sem = (union __xeno_sem *)sem;
 	int err;
 
+#ifdef CONFIG_XENO_FASTSYNCH
+	xnarch_atomic_t *valuep = sem_get_valuep(&_sem->shadow_sem);
+
+	if (valuep) {
+		err = sem_fast_post(valuep);
+		if (err != EWOULDBLOCK)
+			goto done;
+	}
+#endif /* CONFIG_XENO_FASTSYNCH */
+
 	err = -XENOMAI_SKINCALL1(__pse51_muxid,
 				 __pse51_sem_post, &_sem->shadow_sem);
+#ifdef CONFIG_XENO_FASTSYNCH
+  done:
+#endif /* CONFIG_XENO_FASTSYNCH */
 	if (!err)
 		return 0;
 
@@ -77,6 +141,13 @@ int __wrap_sem_wait(sem_t * sem)
 	union __xeno_sem *_sem = (union __xeno_sem *)sem;
 	int err, oldtype;
 
+#ifdef CONFIG_XENO_FASTSYNCH
+	xnarch_atomic_t *valuep = sem_get_valuep(&_sem->shadow_sem);
+
+	if (valuep && sem_fast_trywait(valuep) == 0)
+		return 0;
+#endif /* CONFIG_XENO_FASTSYNCH */
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = -XENOMAI_SKINCALL1(__pse51_muxid,
@@ -97,6 +168,13 @@ int __wrap_sem_timedwait(sem_t * sem, const struct timespec *ts)
 	union __xeno_sem *_sem = (union __xeno_sem *)sem;
 	int err, oldtype;
 
+#ifdef CONFIG_XENO_FASTSYNCH
+	xnarch_atomic_t *valuep = sem_get_valuep(&_sem->shadow_sem);
+
+	if (valuep && sem_fast_trywait(valuep) == 0)
+		return 0;
+#endif /* CONFIG_XENO_FASTSYNCH */
+
 	pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &oldtype);
 
 	err = -XENOMAI_SKINCALL2(__pse51_muxid,
@@ -117,8 +195,20 @@ int __wrap_sem_trywait(sem_t * sem)
 	union __xeno_sem *_sem = (union __xeno_sem *)sem;
 	int err;
 
+#ifdef CONFIG_XENO_FASTSYNCH
+	xnarch_atomic_t *valuep = sem_get_valuep(&_sem->shadow_sem);
+
+	if (valuep) {
+		err = sem_fast_trywait(valuep);
+		goto done;
+	}
+#endif /* CONFIG_XENO_FASTSYNCH */
+
 	err = -XENOMAI_SKINCALL1(__pse51_muxid,
 				 __pse51_sem_trywait, &_sem->shadow_sem);
+#ifdef CONFIG_XENO_FASTSYNCH
+  done:
+#endif /* CONFIG_XENO_FASTSYNCH */
 	if (!err)
 		return 0;
 
@@ -132,6 +222,17 @@ int __wrap_sem_getvalue(sem_t * sem, int *sval)
 	union __xeno_sem *_sem = (union __xeno_sem *)sem;
 	int err;
 
+#ifdef CONFIG_XENO_FASTSYNCH
+	xnarch_atomic_t *valuep = sem_get_valuep(&_sem->shadow_sem);
+
+	if (valuep) {
+		*sval = (long)xnarch_atomic_get(valuep);
+		if (*sval < 0)
+			*sval = 0;
+		return 0;
+	}
+#endif /* CONFIG_XENO_FASTSYNCH */
+
 	err = -XENOMAI_SKINCALL2(__pse51_muxid,
 				 __pse51_sem_getvalue, &_sem->shadow_sem, sval);
 	if (!err)
@@ -80,6 +80,43 @@ void timespec_adds(struct timespec *r,
 	}
 }
 
+static inline unsigned int read_seqbegin(struct clockobj *clkobj)
+{
+	unsigned int seq;
+
+	for (;;) {
+		seq = __atomic_load_n(&clkobj->seq, __ATOMIC_ACQUIRE);
+		if ((seq & 1) == 0)
+			return seq;
+		/*
+		 * Update in progress: spinning might starve a
+		 * preempted updater, so wait on the clock lock
+		 * instead, which boosts it.
+		 */
+		read_lock_nocancel(&clkobj->lock);
+		read_unlock(&clkobj->lock);
+	}
+}
+
+static inline int read_seqretry(struct clockobj *clkobj, unsigned int seq)
+{
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+	return __atomic_load_n(&clkobj->seq, __ATOMIC_RELAXED) != seq;
+}
+
+/* clkobj->lock held. */
+static inline void write_seqbegin(struct clockobj *clkobj)
+{
+	__atomic_store_n(&clkobj->seq, clkobj->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void write_seqend(struct clockobj *clkobj)
+{
+	__atomic_store_n(&clkobj->seq, clkobj->seq + 1, __ATOMIC_RELEASE);
+}
+
 static void ticks_to_timespec(struct clockobj *clkobj,
 			      ticks_t ticks,
 			      struct timespec *ts)
@@ -226,12 +263,19 @@ void clockobj_set_date(struct clockobj *clkobj,
 
 	__RT(clock_gettime(CLOCK_COPPERPLATE, &now));
 
+	write_seqbegin(clkobj);
+
 	/* Change the resolution on-the-fly if given. */
-	if (resolution_ns)
+	if (resolution_ns) {
 		__clockobj_set_resolution(clkobj, resolution_ns);
+		__clockobj_init_scaling(clkobj);
+	}
 
 	ticks_to_timespec(clkobj, ticks, &clkobj->epoch);
 	timespec_sub(&clkobj->offset, &clkobj->epoch, &now);
+	clkobj->offset_ns = timespec_scalar(&clkobj->offset);
+
+	write_seqend(clkobj);
 
 	read_unlock(&clkobj->lock);
 }
@@ -261,36 +305,32 @@ void clockobj_get_time(struct clockobj *clkobj,
 		       ticks_t *pticks, ticks_t *ptsc)
 {
 	unsigned long long ns, tsc;
-
-	read_lock_nocancel(&clkobj->lock);
+	unsigned int seq;
 
 	tsc = __xn_rdtsc();
 	ns = xnarch_tsc_to_ns(tsc);
-	if (clockobj_get_resolution(clkobj) > 1)
-		ns /= clockobj_get_resolution(clkobj);
-	*pticks = ns;
+
+	do {
+		seq = read_seqbegin(clkobj);
+		*pticks = __clockobj_ns_to_ticks(clkobj, ns);
+	} while (read_seqretry(clkobj, seq));
 
 	if (ptsc)
 		*ptsc = tsc;
-
-	read_unlock(&clkobj->lock);
 }
 
 void clockobj_get_date(struct clockobj *clkobj, ticks_t *pticks)
 {
 	unsigned long long ns;
-
-	read_lock_nocancel(&clkobj->lock);
+	unsigned int seq;
 
 	ns = xnarch_tsc_to_ns(__xn_rdtsc());
-	/* Add offset to epoch. */
-	ns += (unsigned long long)clkobj->offset.tv_sec * 1000000000ULL;
-	ns += clkobj->offset.tv_nsec;
-	if (clockobj_get_resolution(clkobj) > 1)
-		ns /= clockobj_get_resolution(clkobj);
-	*pticks = ns;
 
-	read_unlock(&clkobj->lock);
+	do {
+		seq = read_seqbegin(clkobj);
+		/* Add offset to epoch. */
+		*pticks = __clockobj_ns_to_ticks(clkobj, ns + clkobj->offset_ns);
+	} while (read_seqretry(clkobj, seq));
 }
 
 #else /* CONFIG_XENO_MERCURY */
@@ -304,17 +344,17 @@ void clockobj_get_time(struct clockobj *clkobj, ticks_t *pticks,
 		       ticks_t *ptsc)
 {
 	struct timespec now;
+	unsigned int seq;
+	ticks_t ns;
 
 	__RT(clock_gettime(CLOCK_COPPERPLATE, &now));
-
-	read_lock_nocancel(&clkobj->lock);
+	ns = timespec_scalar(&now);
 
 	/* Convert the time value to ticks, with no offset. */
-	if (clockobj_get_resolution(clkobj) > 1)
-		*pticks = (ticks_t)now.tv_sec * clockobj_get_frequency(clkobj)
-			+ (ticks_t)now.tv_nsec / clockobj_get_resolution(clkobj);
-	else
-		*pticks = timespec_scalar(&now);
+	do {
+		seq = read_seqbegin(clkobj);
+		*pticks = __clockobj_ns_to_ticks(clkobj, ns);
+	} while (read_seqretry(clkobj, seq));
 
 	/*
 	 * Mercury has a single time source, with TSC == monotonic
@@ -322,26 +362,22 @@ void clockobj_get_time(struct clockobj *clkobj, ticks_t *pticks,
 	 */
 	if (ptsc)
 		*ptsc = *pticks;
-
-	read_unlock(&clkobj->lock);
 }
 
 void clockobj_get_date(struct clockobj *clkobj, ticks_t *pticks)
 {
-	struct timespec now, date;
-
-	read_lock_nocancel(&clkobj->lock);
+	struct timespec now;
+	unsigned int seq;
+	ticks_t ns;
 
 	__RT(clock_gettime(CLOCK_COPPERPLATE, &now));
+	ns = timespec_scalar(&now);
 
 	/* Add offset from epoch to current system time. */
-	timespec_add(&date, &clkobj->offset, &now);
-
-	/* Convert the time value to ticks,. */
-	*pticks = (ticks_t)date.tv_sec * clockobj_get_frequency(clkobj)
-		+ (ticks_t)date.tv_nsec / clockobj_get_resolution(clkobj);
-
-	read_unlock(&clkobj->lock);
+	do {
+		seq = read_seqbegin(clkobj);
+		*pticks = __clockobj_ns_to_ticks(clkobj, ns + clkobj->offset_ns);
+	} while (read_seqretry(clkobj, seq));
 }
 
 #endif /* CONFIG_XENO_MERCURY */
@@ -361,6 +397,8 @@ int clockobj_init(struct clockobj *clkobj,
 	if (ret)
 		return __bt(ret);
 
+	__clockobj_init_scaling(clkobj);
+
 	__RT(pthread_mutexattr_init(&mattr));
 	__RT(pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT));
 	__RT(pthread_mutexattr_setpshared(&mattr, PTHREAD_PROCESS_PRIVATE));
@@ -368,6 +406,8 @@ int clockobj_init(struct clockobj *clkobj,
 	__RT(pthread_mutexattr_destroy(&mattr));
 	__RT(clock_gettime(CLOCK_COPPERPLATE, &now));
 	timespec_sub(&clkobj->offset, &clkobj->epoch, &now);
+	clkobj->offset_ns = timespec_scalar(&clkobj->offset);
+	clkobj->seq = 0;
 	clkobj->name = name;
 
 	return 0;
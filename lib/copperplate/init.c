@@ -33,6 +33,7 @@
 #include "copperplate/init.h"
 #include "copperplate/threadobj.h"
 #include "copperplate/heapobj.h"
+#include "copperplate/syncobj.h"
 #include "copperplate/clockobj.h"
 #include "copperplate/registry.h"
 #include "copperplate/timerobj.h"
@@ -109,6 +110,13 @@ static const struct option base_options[] = {
 		.flag = NULL,
 		.val = 0
 	},
+	{
+#define lock_spin_opt	8
+		.name = "lock-spin",
+		.has_arg = 1,
+		.flag = NULL,
+		.val = 0
+	},
 	{
 		.name = NULL,
 		.has_arg = 0,
@@ -127,6 +135,28 @@ static void usage(void)
 	fprintf(stderr, "--session=<label>		label of shared multi-processing session\n");
 	fprintf(stderr, "--reset			remove any older session\n");
 	fprintf(stderr, "--cpu-affinity=<cpu[,cpu]...>	set CPU affinity of threads\n");
+	fprintf(stderr, "--lock-spin=<loops>		spin on contended locks (SMP)\n");
+}
+
+/*
+ * getopt_long_only() accepts any unique prefix of a long option name,
+ * which an application short option such as -l may well be. Tell
+ * whether the option we just parsed was spelled out in full instead.
+ */
+static int option_spelled_out(char *const argv[], const char *name)
+{
+	const char *arg;
+	size_t len;
+
+	/* "--name=value" takes one slot, "--name value" takes two. */
+	arg = argv[optarg == argv[optind - 1] ? optind - 2 : optind - 1];
+	while (*arg == '-')
+		arg++;
+
+	len = strlen(name);
+
+	return strncmp(arg, name, len) == 0 &&
+		(arg[len] == '\0' || arg[len] == '=');
 }
 
 static void do_cleanup(void)
@@ -269,6 +299,10 @@ void copperplate_init(int argc, char *const argv[])
 			if (ret)
 				goto fail;
 			break;
+		case lock_spin_opt:
+			if (option_spelled_out(argv, base_options[lindex].name))
+				__this_node.lock_spin = atoi(optarg);
+			break;
 		case no_mlock_opt:
 		case no_registry_opt:
 		case reset_session_opt:
@@ -306,6 +340,12 @@ void copperplate_init(int argc, char *const argv[])
 
 	atexit(do_cleanup);
 	threadobj_pkg_init();
+	ret = syncobj_pkg_init();
+	if (ret) {
+		warning("failed to initialize synchronization support");
+		goto fail;
+	}
+
 	ret = timerobj_pkg_init();
 	if (ret) {
 		warning("failed to initialize timer support");
@@ -175,11 +175,11 @@ int registry_add_file(struct fsobj *fsobj, int mode, const char *fmt, ...)
 	dir = path;
 	hobj = pvhash_search(&regfs_dirtable, dir);
 	if (hobj == NULL) {
-	fail:
 		pvhash_remove(&regfs_objtable, &fsobj->hobj);
-		xnfree(path);
-		fsobj->path = NULL;
 		ret = -ENOENT;
+	fail:
+		xnfree(fsobj->path);
+		fsobj->path = NULL;
 		goto done;
 	}
 
@@ -18,9 +18,14 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "copperplate/lock.h"
 #include "copperplate/threadobj.h"
 #include "copperplate/syncobj.h"
+#include "copperplate/waitset.h"
+#include "copperplate/registry.h"
 
 /*
  * XXX: The POSIX spec states that "Synchronization primitives that
@@ -55,6 +60,13 @@
  * normal runtime conditions.
  */
 
+/* Spin budget on contended locks, zero unless SMP and enabled. */
+unsigned int syncobj_spin;
+
+struct syncobj_stats syncobj_stats;
+
+static struct fsobj stats_fsobj;
+
 void syncobj_init(struct syncobj *sobj, int flags,
 		  fnref_type(void (*)(struct syncobj *sobj)) finalizer)
 {
@@ -64,9 +76,11 @@ void syncobj_init(struct syncobj *sobj, int flags,
 	sobj->flags = flags;
 	list_init(&sobj->pend_list);
 	list_init(&sobj->drain_list);
+	list_init(&sobj->watch_list);
 	sobj->pend_count = 0;
 	sobj->drain_count = 0;
 	sobj->release_count = 0;
+	sobj->owner_cpu = -1;
 	sobj->finalizer = finalizer;
 
 	__RT(pthread_mutexattr_init(&mattr));
@@ -82,6 +96,57 @@ void syncobj_init(struct syncobj *sobj, int flags,
 	__RT(pthread_condattr_destroy(&cattr));
 }
 
+/*
+ * Adaptive locking: the critical sections protected by syncobj locks
+ * are short, so when the owner runs on another CPU, it is likely to
+ * release the lock before we would be done going to sleep. Retry for
+ * syncobj_spin loops in this case, then block on the PI mutex as
+ * usual.
+ */
+int __syncobj_lock_contended(struct syncobj *sobj,
+			     struct syncstate *syns)
+{
+	unsigned int spins = syncobj_spin;
+	int ret, cpu, owner;
+
+	__sync_fetch_and_add(&syncobj_stats.contended, 1);
+
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &syns->state);
+
+	if (spins > 0) {
+		cpu = sched_getcpu();
+		do {
+			barrier();
+			owner = sobj->owner_cpu;
+			if (owner == cpu)
+				break;
+			/* Only hit the mutex when it looks free. */
+			if (owner < 0) {
+				ret = -__RT(pthread_mutex_trylock(&sobj->lock));
+				if (ret == 0)
+					goto spun;
+				if (ret != -EBUSY)
+					goto fail;
+			}
+			cpu_relax();
+		} while (--spins > 0);
+	}
+
+	__sync_fetch_and_add(&syncobj_stats.blocked, 1);
+
+	ret = -__RT(pthread_mutex_lock(&sobj->lock));
+	if (ret == 0)
+		return 0;
+fail:
+	pthread_setcancelstate(syns->state, NULL);
+
+	return ret;
+spun:
+	__sync_fetch_and_add(&syncobj_stats.spun, 1);
+
+	return 0;
+}
+
 static void syncobj_test_finalize(struct syncobj *sobj,
 				  struct syncstate *syns)
 {
@@ -89,6 +154,7 @@ static void syncobj_test_finalize(struct syncobj *sobj,
 	int relcount;
 
 	relcount = --sobj->release_count;
+	__syncobj_untag_owner(sobj);
 	__RT(pthread_mutex_unlock(&sobj->lock));
 
 	if (relcount == 0) {
@@ -160,6 +226,7 @@ void __syncobj_cleanup_wait(struct syncobj *sobj,
 		if (thobj->wait_status & SYNCOBJ_DRAINING)
 			sobj->drain_count--;
 	}
+	__syncobj_untag_owner(sobj);
 	__RT(pthread_mutex_unlock(&sobj->lock));
 }
 
@@ -185,6 +252,8 @@ int syncobj_pend(struct syncobj *sobj, struct timespec *timeout,
 	 */
 	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &state);
 
+	__syncobj_untag_owner(sobj);
+
 	do {
 		if (timeout)
 			ret = __RT(pthread_cond_timedwait(&current->wait_sync,
@@ -195,6 +264,8 @@ int syncobj_pend(struct syncobj *sobj, struct timespec *timeout,
 		/* Check for spurious wake up. */
 	} while (ret == 0 && holder_linked(&current->wait_link));
 
+	__syncobj_tag_owner(sobj);
+
 	pthread_setcancelstate(state, NULL);
 
 	if (current->wait_hook)
@@ -276,12 +347,15 @@ int syncobj_wait_drain(struct syncobj *sobj, struct timespec *timeout,
 	if (current->wait_hook)
 		current->wait_hook(current, SYNCOBJ_BLOCK);
 
+	__syncobj_untag_owner(sobj);
+
 	if (timeout)
 		ret = __RT(pthread_cond_timedwait(&sobj->post_sync,
 						  &sobj->lock, timeout));
 	else
 		ret = __RT(pthread_cond_wait(&sobj->post_sync, &sobj->lock));
 
+	__syncobj_tag_owner(sobj);
 	pthread_setcancelstate(state, NULL);
 
 	current->wait_status &= ~SYNCOBJ_DRAINING;
@@ -341,12 +415,91 @@ int syncobj_destroy(struct syncobj *sobj, struct syncstate *syns)
 	int ret;
 
 	ret = syncobj_flush(sobj, SYNCOBJ_DELETED);
-	if (ret == 0) {
+
+	/*
+	 * Waitsets still watching the object collectively hold a
+	 * single reference on it, which is dropped with the last
+	 * watch.
+	 */
+	if (syncobj_watched_p(sobj)) {
+		__waitset_flush_watches(sobj);
+		sobj->release_count++;
+	}
+
+	if (sobj->release_count == 0) {
 		/* No thread awaken - we may dispose immediately. */
 		sobj->release_count = 1;
 		syncobj_test_finalize(sobj, syns);
-	} else
+	} else {
+		sobj->flags |= SYNCOBJ_DEFUNCT;
 		syncobj_unlock(sobj, syns);
+	}
 
 	return ret;
 }
+
+int syncobj_unpin(struct syncobj *sobj, struct syncstate *syns)
+{
+	if (sobj->flags & SYNCOBJ_DEFUNCT) {
+		syncobj_test_finalize(sobj, syns);
+		return -EIDRM;
+	}
+
+	--sobj->release_count;
+	assert(sobj->release_count >= 0);
+
+	return 0;
+}
+
+void syncobj_drop_watch(struct syncobj *sobj, struct holder *link,
+			struct syncstate *syns)
+{
+	list_remove(link);
+
+	if ((sobj->flags & SYNCOBJ_DEFUNCT) && !syncobj_watched_p(sobj))
+		syncobj_test_finalize(sobj, syns);
+	else
+		syncobj_unlock(sobj, syns);
+}
+
+#ifdef CONFIG_XENO_REGISTRY
+
+static size_t stats_registry_read(struct fsobj *fsobj,
+				  char *buf, size_t size, off_t offset)
+{
+	size_t len;
+
+	len = sprintf(buf, "spin      = %u\n", syncobj_spin);
+	len += sprintf(buf + len, "contended = %lu\n", syncobj_stats.contended);
+	len += sprintf(buf + len, "spun      = %lu\n", syncobj_stats.spun);
+	len += sprintf(buf + len, "blocked   = %lu\n", syncobj_stats.blocked);
+
+	return len;
+}
+
+static struct registry_operations registry_ops = {
+	.read	= stats_registry_read
+};
+
+#else
+
+static struct registry_operations registry_ops;
+
+#endif /* CONFIG_XENO_REGISTRY */
+
+int syncobj_pkg_init(void)
+{
+	int ret;
+
+	/* Spinning only makes sense if the owner may run in parallel. */
+	if (sysconf(_SC_NPROCESSORS_ONLN) > 1)
+		syncobj_spin = __this_node.lock_spin;
+
+	registry_init_file(&stats_fsobj, &registry_ops);
+
+	ret = registry_add_dir("/copperplate");
+	if (ret)
+		return ret;
+
+	return registry_add_file(&stats_fsobj, O_RDONLY, "/copperplate/syncobj");
+}
@@ -54,6 +54,11 @@
 
 pthread_key_t threadobj_tskey;
 
+#ifdef HAVE___THREAD
+__thread __attribute__ ((tls_model ("initial-exec")))
+struct threadobj *__threadobj_current;
+#endif
+
 int threadobj_high_prio;
 
 int threadobj_irq_prio;
@@ -770,7 +775,11 @@ int threadobj_prologue(struct threadobj *thobj, const char *name)
 	write_unlock(&list_lock);
 
 	thobj->errno_pointer = &errno;
+	threadobj_set_current(thobj);
+#ifdef HAVE___THREAD
+	/* Only for running threadobj_finalize() upon thread exit. */
 	pthread_setspecific(threadobj_tskey, thobj);
+#endif
 
 	if (global_rr)
 		threadobj_set_rr(thobj, &global_quantum);
@@ -806,6 +815,12 @@ void threadobj_finalize(void *p) /* thobj->lock free */
 	if (thobj == NULL || thobj == THREADOBJ_IRQCONTEXT)
 		return;
 
+	/*
+	 * The finalizer may release thobj, don't leave the TLS
+	 * pointer dangling.
+	 */
+	threadobj_set_current(NULL);
+
 	pthread_setcanceltype(PTHREAD_CANCEL_DEFERRED, NULL);
 
 	if (thobj->wait_sobj)
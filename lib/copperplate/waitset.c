@@ -0,0 +1,261 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include "copperplate/heapobj.h"
+#include "copperplate/threadobj.h"
+#include "copperplate/waitset.h"
+
+/*
+ * A waitset allows a thread to pend on several sync objects at once,
+ * until any of them becomes ready. Readiness is level-triggered: the
+ * owner of each watched object reports it to the watch whenever the
+ * object state changes, so that waiters only need the waitset lock
+ * to scan the watch list.
+ *
+ * The locking order is object lock first, then waitset lock. Paths
+ * starting from the waitset side which need the object lock (i.e.
+ * removing a watch) pin the waitset, drop its lock, then grab both
+ * locks in the proper order. A watched object is kept alive until
+ * all watches referring to it are gone, even if it is destroyed
+ * meanwhile, so that such paths may always lock it safely.
+ */
+
+static struct waitwatch *find_watch(struct waitset *wset, uintptr_t cookie)
+{
+	struct waitwatch *watch;
+
+	list_for_each_entry(watch, &wset->watch_list, wset_link) {
+		if (watch->cookie == cookie)
+			return watch;
+	}
+
+	return NULL;
+}
+
+static void wakeup_waiters(struct waitset *wset)
+{
+	/* Level-triggered: every waiter gets a chance to scan. */
+	while (syncobj_post(&wset->sobj))
+		;
+}
+
+void waitset_init(struct waitset *wset, int flags,
+		  fnref_type(void (*)(struct syncobj *sobj)) finalizer)
+{
+	syncobj_init(&wset->sobj, flags, finalizer);
+	list_init(&wset->watch_list);
+	wset->nwatch = 0;
+	wset->dead = 0;
+}
+
+void waitset_hold(struct waitset *wset, struct syncstate *syns)
+{				/* wset->sobj.lock held, dropped */
+	syncobj_pin(&wset->sobj);
+	syncobj_unlock(&wset->sobj, syns);
+}
+
+int waitset_release(struct waitset *wset, struct syncstate *syns)
+{
+	int ret;
+
+	ret = syncobj_lock(&wset->sobj, syns);
+	if (ret)
+		return ret;
+
+	return syncobj_unpin(&wset->sobj, syns);
+}
+
+int waitset_watch(struct waitset *wset, struct syncobj *sobj,
+		  uintptr_t cookie, unsigned long arg, int ready)
+{				/* sobj->lock held, wset held */
+	struct waitwatch *watch;
+	struct syncstate syns;
+	int ret;
+
+	watch = xnmalloc(sizeof(*watch));
+	if (watch == NULL)
+		return -ENOMEM;
+
+	ret = syncobj_lock(&wset->sobj, &syns);
+	if (ret) {
+		xnfree(watch);
+		return ret;
+	}
+
+	if (wset->dead || (sobj->flags & SYNCOBJ_DEFUNCT)) {
+		ret = -EIDRM;
+		goto fail;
+	}
+
+	if (find_watch(wset, cookie)) {
+		ret = -EEXIST;
+		goto fail;
+	}
+
+	watch->wset = wset;
+	watch->sobj = sobj;
+	watch->status = ready ? WAITWATCH_READY : 0;
+	watch->arg = arg;
+	watch->cookie = cookie;
+	list_append(&watch->wset_link, &wset->watch_list);
+	list_append(&watch->sobj_link, &sobj->watch_list);
+	wset->nwatch++;
+
+	if (ready)
+		wakeup_waiters(wset);
+
+	syncobj_unlock(&wset->sobj, &syns);
+
+	return 0;
+fail:
+	syncobj_unlock(&wset->sobj, &syns);
+	xnfree(watch);
+
+	return ret;
+}
+
+void waitwatch_signal(struct waitwatch *watch, int ready)
+{				/* watch->sobj->lock held */
+	struct waitset *wset = watch->wset;
+	int status = ready ? WAITWATCH_READY : 0;
+	struct syncstate syns;
+
+	/*
+	 * The status only changes under the object lock, so we may
+	 * test it locklessly and skip the waitset when unchanged.
+	 */
+	if ((watch->status & WAITWATCH_READY) == status)
+		return;
+
+	/* A waitset outlives its watches, locking it cannot fail. */
+	syncobj_lock(&wset->sobj, &syns);
+
+	watch->status = (watch->status & ~WAITWATCH_READY) | status;
+	if (ready)
+		wakeup_waiters(wset);
+
+	syncobj_unlock(&wset->sobj, &syns);
+}
+
+void __waitset_flush_watches(struct syncobj *sobj) /* sobj->lock held */
+{
+	struct waitwatch *watch;
+	struct syncstate syns;
+	struct waitset *wset;
+
+	/*
+	 * Deleted objects read as ready, until their watch is
+	 * removed from the waitset.
+	 */
+	syncobj_for_each_watch(sobj, watch) {
+		wset = watch->wset;
+		syncobj_lock(&wset->sobj, &syns);
+		watch->status = WAITWATCH_READY|WAITWATCH_DELETED;
+		wakeup_waiters(wset);
+		syncobj_unlock(&wset->sobj, &syns);
+	}
+}
+
+static int release_watch(struct waitset *wset, struct waitwatch *watch,
+			 struct syncstate *syns)
+{				/* wset->sobj.lock held */
+	struct syncobj *sobj = watch->sobj;
+	struct syncstate osyns;
+
+	list_remove(&watch->wset_link);
+	wset->nwatch--;
+
+	waitset_hold(wset, syns);
+	syncobj_lock(sobj, &osyns);
+	syncobj_drop_watch(sobj, &watch->sobj_link, &osyns);
+	xnfree(watch);
+
+	return waitset_release(wset, syns);
+}
+
+int waitset_unwatch(struct waitset *wset, uintptr_t cookie,
+		    struct syncstate *syns)
+{				/* wset->sobj.lock held */
+	struct waitwatch *watch;
+
+	watch = find_watch(wset, cookie);
+	if (watch == NULL)
+		return -EINVAL;
+
+	return release_watch(wset, watch, syns);
+}
+
+int waitset_poll(struct waitset *wset, uintptr_t *cookies, int nr)
+{				/* wset->sobj.lock held */
+	int count = wset->nwatch, n = 0;
+	struct waitwatch *watch, *tmp;
+
+	/*
+	 * Reported watches move to the tail, so that ready objects
+	 * are eventually all reported, whatever the size of the
+	 * caller's array.
+	 */
+	list_for_each_entry_safe(watch, tmp, &wset->watch_list, wset_link) {
+		if (count-- == 0 || n >= nr)
+			break;
+		if ((watch->status & WAITWATCH_READY) == 0)
+			continue;
+		cookies[n++] = watch->cookie;
+		list_remove(&watch->wset_link);
+		list_append(&watch->wset_link, &wset->watch_list);
+	}
+
+	return n;
+}
+
+int waitset_wait(struct waitset *wset, uintptr_t *cookies, int nr,
+		 struct timespec *timeout, struct syncstate *syns)
+{				/* wset->sobj.lock held */
+	int ret;
+
+	for (;;) {
+		ret = waitset_poll(wset, cookies, nr);
+		if (ret > 0)
+			return ret;
+		/*
+		 * -EIDRM means that the waitset has been deleted,
+		 * which we must not touch anymore.
+		 */
+		ret = syncobj_pend(&wset->sobj, timeout, syns);
+		if (ret)
+			return ret;
+	}
+}
+
+int waitset_destroy(struct waitset *wset, struct syncstate *syns)
+{				/* wset->sobj.lock held, dropped */
+	struct waitwatch *watch;
+	int ret;
+
+	wset->dead = 1;
+
+	while (!list_empty(&wset->watch_list)) {
+		watch = list_first_entry(&wset->watch_list,
+					 struct waitwatch, wset_link);
+		ret = release_watch(wset, watch, syns);
+		if (ret)
+			return ret;
+	}
+
+	return syncobj_destroy(&wset->sobj, syns);
+}
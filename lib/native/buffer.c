@@ -16,31 +16,191 @@
  * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA.
  */
 
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <string.h>
 #include <native/syscall.h>
 #include <native/buffer.h>
+#include <asm-generic/xenomai/sem_heap.h>
 
 extern int __native_muxid;
 
+static int __map_buffer_memory(RT_BUFFER *bf, RT_BUFFER_PLACEHOLDER *php)
+{
+	struct xnheap_desc hd;
+
+	if (php->mapsize) {
+		hd.handle = (unsigned long)php->opaque2;
+		hd.size = php->mapsize;
+		hd.area = php->area;
+		php->mapbase = xeno_map_heap(&hd);
+		if (php->mapbase == MAP_FAILED)
+			return -errno;
+	}
+
+	*bf = *php;
+
+	return 0;
+}
+
 int rt_buffer_create(RT_BUFFER *bf, const char *name, size_t bufsz, int mode)
 {
-	return XENOMAI_SKINCALL4(__native_muxid,
-				 __native_buffer_create, bf, name, bufsz,
-				 mode);
+	RT_BUFFER_PLACEHOLDER ph;
+	int err;
+
+	err = XENOMAI_SKINCALL4(__native_muxid,
+				__native_buffer_create, &ph, name, bufsz,
+				mode);
+	if (err)
+		return err;
+
+	err = __map_buffer_memory(bf, &ph);
+	if (err)
+		/* Do not leave a dangling buffer in kernel space. */
+		XENOMAI_SKINCALL1(__native_muxid, __native_buffer_delete, &ph);
+
+	return err;
 }
 
 int rt_buffer_bind(RT_BUFFER *bf, const char *name, RTIME timeout)
 {
-	return XENOMAI_SKINCALL3(__native_muxid,
-				 __native_buffer_bind, bf, name, &timeout);
+	RT_BUFFER_PLACEHOLDER ph;
+	int err;
+
+	err = XENOMAI_SKINCALL3(__native_muxid,
+				__native_buffer_bind, &ph, name, &timeout);
+
+	return err ? : __map_buffer_memory(bf, &ph);
+}
+
+int rt_buffer_unbind(RT_BUFFER *bf)
+{
+	if (bf->mapbase && __real_munmap(bf->mapbase, bf->mapsize))
+		return -EINVAL;
+
+	bf->opaque = XN_NO_HANDLE;
+	bf->mapbase = NULL;
+	bf->mapsize = 0;
+
+	return 0;
 }
 
-int rt_buffer_delete(RT_BUFFER *buffer)
+int rt_buffer_delete(RT_BUFFER *bf)
 {
-	return XENOMAI_SKINCALL1(__native_muxid, __native_buffer_delete, buffer);
+	int err;
+
+	err = XENOMAI_SKINCALL1(__native_muxid, __native_buffer_delete, bf);
+	if (err)
+		return err;
+
+	bf->opaque = XN_NO_HANDLE;
+	bf->mapbase = NULL;
+	bf->mapsize = 0;
+
+	return 0;
 }
 
+#ifdef CONFIG_XENO_FASTSYNCH
+
+/*
+ * Mapped buffers may be read from and written to locally, provided
+ * the ring already holds the data, or has room for it. Otherwise, or
+ * for any unusual request, we let the kernel deal with the caller.
+ * Once done, we have to wake up any peer waiting in the kernel.
+ */
+static ssize_t __buffer_fast_write(RT_BUFFER *bf, const void *buf, size_t size)
+{
+	struct rt_buffer_ring *ring;
+	unsigned long wrcount, rdcount, off, n;
+	caddr_t data;
+
+	if (bf->mapbase == NULL || size == 0)
+		return -EINVAL;
+
+	ring = (struct rt_buffer_ring *)(bf->mapbase + bf->ringoff);
+	data = (caddr_t)(ring + 1);
+
+	wrcount = xnarch_atomic_get(&ring->wrcount);
+	rdcount = xnarch_atomic_get(&ring->rdcount);
+	xnarch_memory_barrier();
+
+	if (rt_buffer_ring_fill(wrcount, rdcount, ring->size) + size > ring->size)
+		return -EWOULDBLOCK;
+
+	off = rt_buffer_ring_offset(wrcount, ring->size);
+	n = ring->size - off;
+	if (n >= size)
+		memcpy(data + off, buf, size);
+	else {
+		memcpy(data + off, buf, n);
+		memcpy(data, (const char *)buf + n, size - n);
+	}
+
+	xnarch_memory_barrier();
+	xnarch_atomic_set(&ring->wrcount,
+			  rt_buffer_ring_advance(wrcount, size, ring->size));
+	xnarch_memory_barrier();
+
+	if (xnarch_atomic_get(&ring->iwaiters))
+		XENOMAI_SKINCALL1(__native_muxid, __native_buffer_wakeup, bf);
+
+	return size;
+}
+
+static ssize_t __buffer_fast_read(RT_BUFFER *bf, void *buf, size_t size)
+{
+	struct rt_buffer_ring *ring;
+	unsigned long wrcount, rdcount, off, n;
+	caddr_t data;
+
+	if (bf->mapbase == NULL || size == 0)
+		return -EINVAL;
+
+	ring = (struct rt_buffer_ring *)(bf->mapbase + bf->ringoff);
+	data = (caddr_t)(ring + 1);
+
+	wrcount = xnarch_atomic_get(&ring->wrcount);
+	rdcount = xnarch_atomic_get(&ring->rdcount);
+	xnarch_memory_barrier();
+
+	if (rt_buffer_ring_fill(wrcount, rdcount, ring->size) < size)
+		return -EWOULDBLOCK;
+
+	off = rt_buffer_ring_offset(rdcount, ring->size);
+	n = ring->size - off;
+	if (n >= size)
+		memcpy(buf, data + off, size);
+	else {
+		memcpy(buf, data + off, n);
+		memcpy((char *)buf + n, data, size - n);
+	}
+
+	xnarch_memory_barrier();
+	xnarch_atomic_set(&ring->rdcount,
+			  rt_buffer_ring_advance(rdcount, size, ring->size));
+	xnarch_memory_barrier();
+
+	if (xnarch_atomic_get(&ring->owaiters))
+		XENOMAI_SKINCALL1(__native_muxid, __native_buffer_wakeup, bf);
+
+	return size;
+}
+
+#else /* !CONFIG_XENO_FASTSYNCH */
+
+#define __buffer_fast_write(bf, buf, size)	(-EINVAL)
+#define __buffer_fast_read(bf, buf, size)	(-EINVAL)
+
+#endif /* !CONFIG_XENO_FASTSYNCH */
+
 ssize_t rt_buffer_read(RT_BUFFER *bf, void *buf, size_t size, RTIME timeout)
 {
+	ssize_t ret = __buffer_fast_read(bf, buf, size);
+
+	if (ret >= 0)
+		return ret;
+
 	return XENOMAI_SKINCALL5(__native_muxid,
 				 __native_buffer_read, bf, buf, size,
 				 XN_RELATIVE, &timeout);
@@ -48,6 +208,11 @@ ssize_t rt_buffer_read(RT_BUFFER *bf, void *buf, size_t size, RTIME timeout)
 
 ssize_t rt_buffer_read_until(RT_BUFFER *bf, void *buf, size_t size, RTIME timeout)
 {
+	ssize_t ret = __buffer_fast_read(bf, buf, size);
+
+	if (ret >= 0)
+		return ret;
+
 	return XENOMAI_SKINCALL5(__native_muxid,
 				 __native_buffer_read, bf, buf, size,
 				 XN_REALTIME, &timeout);
@@ -55,6 +220,11 @@ ssize_t rt_buffer_read_until(RT_BUFFER *bf, void *buf, size_t size, RTIME timeou
 
 ssize_t rt_buffer_write(RT_BUFFER *bf, const void *buf, size_t size, RTIME timeout)
 {
+	ssize_t ret = __buffer_fast_write(bf, buf, size);
+
+	if (ret >= 0)
+		return ret;
+
 	return XENOMAI_SKINCALL5(__native_muxid,
 				 __native_buffer_write, bf, buf, size,
 				 XN_RELATIVE, &timeout);
@@ -62,6 +232,11 @@ ssize_t rt_buffer_write(RT_BUFFER *bf, const void *buf, size_t size, RTIME timeo
 
 ssize_t rt_buffer_write_until(RT_BUFFER *bf, const void *buf, size_t size, RTIME timeout)
 {
+	ssize_t ret = __buffer_fast_write(bf, buf, size);
+
+	if (ret >= 0)
+		return ret;
+
 	return XENOMAI_SKINCALL5(__native_muxid,
 				 __native_buffer_write, bf, buf, size,
 				 XN_REALTIME, &timeout);
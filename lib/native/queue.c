@@ -107,10 +107,97 @@ int rt_queue_delete(RT_QUEUE *q)
 	return 0;
 }
 
+#ifdef CONFIG_XENO_FASTSYNCH
+
+/*
+ * Shared queues export a cache of free message blocks in their pool
+ * memory, which we may draw from and release to without entering
+ * the kernel, see rt_queue_cache_class().
+ */
+static void *__queue_cache_get(RT_QUEUE *q, size_t size)
+{
+	struct rt_queue_cache *cache;
+	rt_queue_msg_t *msg;
+	xnarch_atomic_t *slot;
+	unsigned long off;
+	int cclass, n;
+
+	if (q->cacheoff == 0)
+		return NULL;
+
+	cclass = rt_queue_cache_class(size);
+	if (cclass < 0)
+		return NULL;
+
+	cache = (struct rt_queue_cache *)(q->mapbase + q->cacheoff);
+
+	for (n = 0; n < Q_CACHE_DEPTH; n++) {
+		slot = &cache->slots[cclass][n];
+		off = xnarch_atomic_get(slot);
+		if (off == 0 || xnarch_atomic_cmpxchg(slot, off, 0) != off)
+			continue;
+		msg = (rt_queue_msg_t *)(q->mapbase + off);
+		msg->size = size;
+		msg->refcount = 1;
+		return msg + 1;
+	}
+
+	return NULL;
+}
+
+static int __queue_cache_put(RT_QUEUE *q, void *buf)
+{
+	rt_queue_msg_t *msg = (rt_queue_msg_t *)buf - 1;
+	struct rt_queue_cache *cache;
+	xnarch_atomic_t *slot;
+	unsigned long off;
+	int n;
+
+	if (q->cacheoff == 0 ||
+	    (caddr_t)msg <= q->mapbase ||
+	    (caddr_t)buf > q->mapbase + q->mapsize)
+		return -EINVAL;
+
+	/*
+	 * Only recycle blocks we are the sole owner of, the kernel
+	 * deals with shared ones (i.e. broadcast messages).
+	 */
+	if (msg->bclass == 0 || msg->bclass > Q_CACHE_CLASSES ||
+	    msg->refcount != 1)
+		return -EINVAL;
+
+	cache = (struct rt_queue_cache *)(q->mapbase + q->cacheoff);
+	off = (caddr_t)msg - q->mapbase;
+	/* Have rt_queue_send() reject the block while it is cached. */
+	msg->refcount = 0;
+
+	for (n = 0; n < Q_CACHE_DEPTH; n++) {
+		slot = &cache->slots[msg->bclass - 1][n];
+		if (xnarch_atomic_get(slot) == 0 &&
+		    xnarch_atomic_cmpxchg(slot, 0, off) == 0)
+			return 0;
+	}
+
+	msg->refcount = 1;
+
+	return -ENOSPC;
+}
+
+#else /* !CONFIG_XENO_FASTSYNCH */
+
+#define __queue_cache_get(q, size)	NULL
+#define __queue_cache_put(q, buf)	(-EINVAL)
+
+#endif /* !CONFIG_XENO_FASTSYNCH */
+
 void *rt_queue_alloc(RT_QUEUE *q, size_t size)
 {
 	void *buf;
 
+	buf = __queue_cache_get(q, size);
+	if (buf)
+		return buf;
+
 	return XENOMAI_SKINCALL3(__native_muxid,
 				 __native_queue_alloc, q, size,
 				 &buf) ? NULL : buf;
@@ -118,6 +205,9 @@ void *rt_queue_alloc(RT_QUEUE *q, size_t size)
 
 int rt_queue_free(RT_QUEUE *q, void *buf)
 {
+	if (buf && __queue_cache_put(q, buf) == 0)
+		return 0;
+
 	return XENOMAI_SKINCALL2(__native_muxid, __native_queue_free, q, buf);
 }
 
@@ -400,6 +400,12 @@ int rt_task_slice(RT_TASK *task, RTIME quantum)
 				 __native_task_slice, task, &quantum);
 }
 
+int rt_task_set_slack(RT_TASK *task, RTIME slack)
+{
+	return XENOMAI_SKINCALL2(__native_muxid,
+				 __native_task_set_slack, task, &slack);
+}
+
 int rt_task_join(RT_TASK *task)
 {
 	if (!task->opaque2)
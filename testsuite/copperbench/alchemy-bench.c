@@ -0,0 +1,247 @@
+/*
+ * Copperplate micro-benchmarks, Alchemy services.
+ *
+ * Released under the terms of GPLv2.
+ */
+
+#include <stdio.h>
+#include <alchemy/task.h>
+#include <alchemy/sem.h>
+#include <alchemy/event.h>
+#include <alchemy/mutex.h>
+#include "copperbench.h"
+
+static RT_SEM ping_sem, pong_sem;
+
+static RT_EVENT ping_ev, pong_ev;
+
+static RT_MUTEX handoff_mutex;
+
+static volatile unsigned long long handoff_date;
+
+static volatile int handoff_waiting;
+
+static void check(const char *service, int ret)
+{
+	if (ret)
+		bench_fail(service, ret);
+}
+
+static int peer_cpu(struct bench_run *run)
+{
+	return run->cross ? run->peer_cpu : run->this_cpu;
+}
+
+static void spawn_peer(struct bench_run *run, int prio,
+		       void (*entry)(void *arg))
+{
+	RT_TASK peer;
+
+	check("rt_task_create",
+	      rt_task_create(&peer, NULL, 0, prio, 0));
+	check("rt_task_start", rt_task_start(&peer, entry, run));
+}
+
+void alchemy_bench_sem(struct bench_run *run)
+{
+	unsigned long long t0;
+	unsigned int n;
+	RT_SEM sem;
+
+	check("rt_sem_create", rt_sem_create(&sem, "bench-sem", 0, S_FIFO));
+
+	bench_start(run);
+
+	for (n = 0; n < run->loops; n++) {
+		t0 = bench_now();
+		rt_sem_v(&sem);
+		rt_sem_p(&sem, TM_INFINITE);
+		bench_record(run, bench_now() - t0);
+	}
+
+	bench_stop(run);
+
+	check("rt_sem_delete", rt_sem_delete(&sem));
+}
+
+static void sem_peer(void *arg)
+{
+	struct bench_run *run = arg;
+	unsigned int n;
+
+	bench_pin(peer_cpu(run));
+
+	for (n = 0; n < run->loops; n++) {
+		check("rt_sem_p", rt_sem_p(&ping_sem, TM_INFINITE));
+		check("rt_sem_v", rt_sem_v(&pong_sem));
+	}
+
+	bench_signal_done();
+}
+
+void alchemy_bench_sem_pingpong(struct bench_run *run)
+{
+	unsigned long long t0;
+	unsigned int n;
+
+	check("rt_sem_create",
+	      rt_sem_create(&ping_sem, "bench-ping", 0, S_FIFO));
+	check("rt_sem_create",
+	      rt_sem_create(&pong_sem, "bench-pong", 0, S_FIFO));
+	spawn_peer(run, BENCH_PRIO, sem_peer);
+
+	bench_start(run);
+
+	for (n = 0; n < run->loops; n++) {
+		t0 = bench_now();
+		rt_sem_v(&ping_sem);
+		rt_sem_p(&pong_sem, TM_INFINITE);
+		bench_record(run, bench_now() - t0);
+	}
+
+	bench_stop(run);
+	bench_wait_done();
+
+	check("rt_sem_delete", rt_sem_delete(&ping_sem));
+	check("rt_sem_delete", rt_sem_delete(&pong_sem));
+}
+
+static void event_peer(void *arg)
+{
+	struct bench_run *run = arg;
+	unsigned long mask;
+	unsigned int n;
+
+	bench_pin(peer_cpu(run));
+
+	for (n = 0; n < run->loops; n++) {
+		check("rt_event_wait",
+		      rt_event_wait(&ping_ev, 1, &mask, EV_ANY, TM_INFINITE));
+		rt_event_clear(&ping_ev, 1, NULL);
+		check("rt_event_signal", rt_event_signal(&pong_ev, 1));
+	}
+
+	bench_signal_done();
+}
+
+void alchemy_bench_event_pingpong(struct bench_run *run)
+{
+	unsigned long long t0;
+	unsigned long mask;
+	unsigned int n;
+
+	check("rt_event_create",
+	      rt_event_create(&ping_ev, "bench-ping", 0, EV_FIFO));
+	check("rt_event_create",
+	      rt_event_create(&pong_ev, "bench-pong", 0, EV_FIFO));
+	spawn_peer(run, BENCH_PRIO, event_peer);
+
+	bench_start(run);
+
+	for (n = 0; n < run->loops; n++) {
+		t0 = bench_now();
+		rt_event_signal(&ping_ev, 1);
+		rt_event_wait(&pong_ev, 1, &mask, EV_ANY, TM_INFINITE);
+		rt_event_clear(&pong_ev, 1, NULL);
+		bench_record(run, bench_now() - t0);
+	}
+
+	bench_stop(run);
+	bench_wait_done();
+
+	check("rt_event_delete", rt_event_delete(&ping_ev));
+	check("rt_event_delete", rt_event_delete(&pong_ev));
+}
+
+/*
+ * The peer has a higher priority, so that it blocks on the mutex as
+ * soon as it is kicked when both tasks share a CPU. In the cross-CPU
+ * case, we wait for the peer to announce itself before releasing the
+ * lock, so samples may also include part of the acquisition path.
+ */
+static void mutex_peer(void *arg)
+{
+	struct bench_run *run = arg;
+	unsigned int n;
+
+	bench_pin(peer_cpu(run));
+
+	for (n = 0; n < run->loops; n++) {
+		check("rt_sem_p", rt_sem_p(&ping_sem, TM_INFINITE));
+		handoff_waiting = 1;
+		check("rt_mutex_acquire",
+		      rt_mutex_acquire(&handoff_mutex, TM_INFINITE));
+		handoff_date = bench_now();
+		check("rt_mutex_release", rt_mutex_release(&handoff_mutex));
+		check("rt_sem_v", rt_sem_v(&pong_sem));
+	}
+
+	bench_signal_done();
+}
+
+void alchemy_bench_mutex_handoff(struct bench_run *run)
+{
+	unsigned long long t0;
+	unsigned int n;
+
+	check("rt_mutex_create",
+	      rt_mutex_create(&handoff_mutex, "bench-mutex"));
+	check("rt_sem_create",
+	      rt_sem_create(&ping_sem, "bench-ping", 0, S_FIFO));
+	check("rt_sem_create",
+	      rt_sem_create(&pong_sem, "bench-pong", 0, S_FIFO));
+	check("rt_mutex_acquire",
+	      rt_mutex_acquire(&handoff_mutex, TM_INFINITE));
+	spawn_peer(run, BENCH_PRIO + 1, mutex_peer);
+
+	bench_start(run);
+
+	for (n = 0; n < run->loops; n++) {
+		handoff_waiting = 0;
+		rt_sem_v(&ping_sem);
+		while (!handoff_waiting)
+			;
+		t0 = bench_now();
+		rt_mutex_release(&handoff_mutex);
+		rt_sem_p(&pong_sem, TM_INFINITE);
+		bench_record(run, handoff_date - t0);
+		rt_mutex_acquire(&handoff_mutex, TM_INFINITE);
+	}
+
+	bench_stop(run);
+	bench_wait_done();
+
+	check("rt_mutex_release", rt_mutex_release(&handoff_mutex));
+	check("rt_mutex_delete", rt_mutex_delete(&handoff_mutex));
+	check("rt_sem_delete", rt_sem_delete(&ping_sem));
+	check("rt_sem_delete", rt_sem_delete(&pong_sem));
+}
+
+static void task_body(void *arg)
+{
+	bench_signal_done();
+}
+
+/*
+ * Samples cover the full life cycle of a short-lived task, from
+ * creation to completion.
+ */
+void alchemy_bench_task(struct bench_run *run)
+{
+	unsigned long long t0;
+	unsigned int n;
+	RT_TASK task;
+
+	bench_start(run);
+
+	for (n = 0; n < run->loops; n++) {
+		t0 = bench_now();
+		check("rt_task_create",
+		      rt_task_create(&task, NULL, 0, BENCH_PRIO + 1, 0));
+		check("rt_task_start", rt_task_start(&task, task_body, NULL));
+		bench_wait_done();
+		bench_record(run, bench_now() - t0);
+	}
+
+	bench_stop(run);
+}
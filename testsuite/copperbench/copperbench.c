@@ -0,0 +1,461 @@
+/*
+ * Copperplate micro-benchmarks.
+ *
+ * Measures the latency distribution and throughput of the basic
+ * services every skin is built on, either with all tasks running on
+ * a single CPU, or with the peer task running on another CPU.
+ *
+ * Released under the terms of GPLv2.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <copperplate/init.h>
+#include <copperplate/clockobj.h>
+#include <copperplate/heapobj.h>
+#include <copperplate/timerobj.h>
+#include <copperplate/threadobj.h>
+#include <alchemy/task.h>
+#include <alchemy/sem.h>
+#include "copperbench.h"
+
+#define BENCH_HEAPSZ	(256 * 1024)
+
+#define BENCH_BATCH	1000
+
+enum {
+	OUTPUT_TEXT,
+	OUTPUT_CSV,
+	OUTPUT_JSON,
+};
+
+struct bench {
+	const char *name;
+	void (*run)(struct bench_run *run);
+	int has_peer;
+};
+
+static RT_TASK main_task;
+
+static RT_SEM done_sem;
+
+static unsigned int loops = 10000;
+
+static int this_cpu, peer_cpu = 1;
+
+static int output = OUTPUT_TEXT;
+
+static const char *filter;
+
+static int nr_results;
+
+static const struct option no_options[] = {
+	{ NULL, 0, NULL, 0 }
+};
+
+unsigned long long bench_now(void)
+{
+	struct timespec ts;
+
+	__RT(clock_gettime(CLOCK_COPPERPLATE, &ts));
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void bench_pin(int cpu)
+{
+	cpu_set_t cpuset;
+	int ret;
+
+	if (cpu < 0)
+		return;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+	if (ret)
+		bench_fail("pthread_setaffinity_np", -ret);
+}
+
+void bench_fail(const char *service, int ret)
+{
+	fprintf(stderr, "copperbench: %s failed, %s\n",
+		service, strerror(ret < 0 ? -ret : ret));
+	exit(EXIT_FAILURE);
+}
+
+void bench_start(struct bench_run *run)
+{
+	run->nr_samples = 0;
+	run->start = bench_now();
+}
+
+void bench_stop(struct bench_run *run)
+{
+	run->stop = bench_now();
+}
+
+void bench_signal_done(void)
+{
+	rt_sem_v(&done_sem);
+}
+
+void bench_wait_done(void)
+{
+	int ret;
+
+	ret = rt_sem_p(&done_sem, TM_INFINITE);
+	if (ret)
+		bench_fail("rt_sem_p", ret);
+}
+
+static void heapobj_bench(struct bench_run *run)
+{
+	static const size_t sizes[] = { 16, 64, 256, 1024 };
+	struct heapobj heap;
+	unsigned long long t0;
+	unsigned int n;
+	void *p;
+	int ret;
+
+	ret = heapobj_init(&heap, "copperbench", BENCH_HEAPSZ, NULL);
+	if (ret)
+		bench_fail("heapobj_init", ret);
+
+	bench_start(run);
+
+	for (n = 0; n < run->loops; n++) {
+		t0 = bench_now();
+		p = heapobj_alloc(&heap, sizes[n % 4]);
+		if (p == NULL)
+			bench_fail("heapobj_alloc", -ENOMEM);
+		heapobj_free(&heap, p);
+		bench_record(run, bench_now() - t0);
+	}
+
+	bench_stop(run);
+
+	heapobj_destroy(&heap);
+}
+
+static void xnmalloc_bench(struct bench_run *run)
+{
+	unsigned long long t0;
+	unsigned int n;
+	void *p;
+
+	bench_start(run);
+
+	for (n = 0; n < run->loops; n++) {
+		t0 = bench_now();
+		p = xnmalloc(64);
+		if (p == NULL)
+			bench_fail("xnmalloc", -ENOMEM);
+		xnfree(p);
+		bench_record(run, bench_now() - t0);
+	}
+
+	bench_stop(run);
+}
+
+/*
+ * A single threadobj_current() call is way below the clock
+ * resolution, so each sample is the time spent in BENCH_BATCH calls,
+ * i.e. the cost of one call in picoseconds.
+ */
+static void current_bench(struct bench_run *run)
+{
+	struct threadobj *volatile thobj;
+	unsigned long long t0;
+	unsigned int n, m;
+
+	bench_start(run);
+
+	for (n = 0; n < run->loops; n++) {
+		t0 = bench_now();
+		for (m = 0; m < BENCH_BATCH; m++) {
+			thobj = threadobj_current();
+			barrier();
+		}
+		bench_record(run, bench_now() - t0);
+	}
+
+	bench_stop(run);
+
+	(void)thobj;
+}
+
+static struct bench_run *timer_run;
+
+static unsigned long long timer_date;
+
+static RT_SEM timer_sem;
+
+static void timer_handler(struct timerobj *tmobj)
+{
+	bench_record(timer_run, bench_now() - timer_date);
+	rt_sem_v(&timer_sem);
+}
+
+/*
+ * Samples are the lateness of a one-shot timer, from its expiry date
+ * to the entry of the handler, on behalf of the timer server.
+ */
+static void timerobj_bench(struct bench_run *run)
+{
+	struct itimerspec its;
+	struct timerobj tmobj;
+	unsigned int n;
+	int ret;
+
+	ret = timerobj_init(&tmobj);
+	if (ret)
+		bench_fail("timerobj_init", ret);
+
+	ret = rt_sem_create(&timer_sem, "copperbench-timer", 0, S_FIFO);
+	if (ret)
+		bench_fail("rt_sem_create", ret);
+
+	timer_run = run;
+	memset(&its, 0, sizeof(its));
+
+	bench_start(run);
+
+	for (n = 0; n < run->loops; n++) {
+		timer_date = bench_now() + 100000;
+		its.it_value.tv_sec = timer_date / 1000000000ULL;
+		its.it_value.tv_nsec = timer_date % 1000000000ULL;
+		ret = timerobj_start(&tmobj, timer_handler, &its);
+		if (ret)
+			bench_fail("timerobj_start", ret);
+		ret = rt_sem_p(&timer_sem, TM_INFINITE);
+		if (ret)
+			bench_fail("rt_sem_p", ret);
+	}
+
+	bench_stop(run);
+
+	timerobj_destroy(&tmobj);
+	rt_sem_delete(&timer_sem);
+}
+
+static const struct bench bench_table[] = {
+	{ "sem",		alchemy_bench_sem,		0 },
+	{ "sem-pingpong",	alchemy_bench_sem_pingpong,	1 },
+	{ "event-pingpong",	alchemy_bench_event_pingpong,	1 },
+	{ "mutex-handoff",	alchemy_bench_mutex_handoff,	1 },
+	{ "task-create",	alchemy_bench_task,		0 },
+	{ "queue-pingpong",	psos_bench_queue_pingpong,	1 },
+	{ "heapobj",		heapobj_bench,			0 },
+	{ "xnmalloc",		xnmalloc_bench,			0 },
+	{ "current-x1000",	current_bench,			0 },
+	{ "timer-arm",		psos_bench_timer_arm,		0 },
+	{ "timer-tick",		psos_bench_timer,		0 },
+	{ "timer-fire",		timerobj_bench,			0 },
+	{ NULL, NULL, 0 }
+};
+
+static int compare_samples(const void *a, const void *b)
+{
+	const unsigned long long *sa = a, *sb = b;
+
+	if (*sa < *sb)
+		return -1;
+
+	return *sa > *sb;
+}
+
+static unsigned long long percentile(struct bench_run *run, int permil)
+{
+	unsigned int n = (unsigned int)
+		(((unsigned long long)run->nr_samples * permil) / 1000);
+
+	if (n >= run->nr_samples)
+		n = run->nr_samples - 1;
+
+	return run->samples[n];
+}
+
+static void report(struct bench_run *run)
+{
+	unsigned long long sum = 0, elapsed;
+	const char *mode;
+	double ops;
+	unsigned int n;
+
+	if (run->nr_samples == 0)
+		return;
+
+	qsort(run->samples, run->nr_samples,
+	      sizeof(run->samples[0]), compare_samples);
+
+	for (n = 0; n < run->nr_samples; n++)
+		sum += run->samples[n];
+
+	elapsed = run->stop - run->start;
+	ops = elapsed ? (double)run->nr_samples * 1e9 / elapsed : 0.0;
+	mode = run->cross ? "cross" : "local";
+
+	switch (output) {
+	case OUTPUT_CSV:
+		if (nr_results == 0)
+			printf("bench,mode,samples,min_ns,avg_ns,p50_ns,"
+			       "p99_ns,p999_ns,max_ns,ops_per_sec\n");
+		printf("%s,%s,%u,%llu,%llu,%llu,%llu,%llu,%llu,%.0f\n",
+		       run->name, mode, run->nr_samples, run->samples[0],
+		       sum / run->nr_samples, percentile(run, 500),
+		       percentile(run, 990), percentile(run, 999),
+		       run->samples[run->nr_samples - 1], ops);
+		break;
+	case OUTPUT_JSON:
+		printf("%s\n  { \"bench\": \"%s\", \"mode\": \"%s\", "
+		       "\"samples\": %u, \"min_ns\": %llu, \"avg_ns\": %llu, "
+		       "\"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu, "
+		       "\"max_ns\": %llu, \"ops_per_sec\": %.0f }",
+		       nr_results ? "," : "[",
+		       run->name, mode, run->nr_samples, run->samples[0],
+		       sum / run->nr_samples, percentile(run, 500),
+		       percentile(run, 990), percentile(run, 999),
+		       run->samples[run->nr_samples - 1], ops);
+		break;
+	default:
+		if (nr_results == 0)
+			printf("%-16s %-5s %8s %8s %8s %8s %8s %8s %9s %11s\n",
+			       "bench", "mode", "samples", "min", "avg",
+			       "p50", "p99", "p99.9", "max", "ops/s");
+		printf("%-16s %-5s %8u %8llu %8llu %8llu %8llu %8llu %9llu %11.0f\n",
+		       run->name, mode, run->nr_samples, run->samples[0],
+		       sum / run->nr_samples, percentile(run, 500),
+		       percentile(run, 990), percentile(run, 999),
+		       run->samples[run->nr_samples - 1], ops);
+	}
+
+	nr_results++;
+}
+
+static void run_bench(const struct bench *b, int cross)
+{
+	struct bench_run run;
+
+	memset(&run, 0, sizeof(run));
+	run.name = b->name;
+	run.cross = cross;
+	run.this_cpu = this_cpu;
+	run.peer_cpu = peer_cpu;
+	run.loops = loops;
+	run.samples = malloc(sizeof(run.samples[0]) * loops);
+	if (run.samples == NULL)
+		bench_fail("malloc", -ENOMEM);
+
+	b->run(&run);
+	report(&run);
+	free(run.samples);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: copperbench [options]\n"
+		"  -l <loops>        samples per benchmark (default 10000)\n"
+		"  -c <cpu>          CPU running the benchmark (default 0)\n"
+		"  -C <cpu>          CPU running the peer task in cross mode\n"
+		"                    (default 1, -1 disables)\n"
+		"  -o text|csv|json  output format\n"
+		"  -f <name>         only run benchmarks matching <name>\n");
+}
+
+int main(int argc, char *const argv[])
+{
+	const struct bench *b;
+	int c, ret, cross_p;
+
+	/*
+	 * Parse our options first, and in order: copperplate_init()
+	 * permutes argv, which would separate our options from their
+	 * arguments. Long options belong to copperplate, so skip them
+	 * along with anything which is not an option.
+	 */
+	opterr = 0;
+
+	while ((c = getopt_long(argc, argv, "-l:c:C:o:f:h",
+				no_options, NULL)) != EOF)
+		switch (c) {
+		case 1:
+			break;
+		case 'l':
+			loops = atoi(optarg);
+			break;
+		case 'c':
+			this_cpu = atoi(optarg);
+			break;
+		case 'C':
+			peer_cpu = atoi(optarg);
+			break;
+		case 'o':
+			if (strcmp(optarg, "csv") == 0)
+				output = OUTPUT_CSV;
+			else if (strcmp(optarg, "json") == 0)
+				output = OUTPUT_JSON;
+			else if (strcmp(optarg, "text") == 0)
+				output = OUTPUT_TEXT;
+			else {
+				usage();
+				exit(EXIT_FAILURE);
+			}
+			break;
+		case 'f':
+			filter = optarg;
+			break;
+		case '?':
+			if (optopt == 0)
+				break;
+			/* Fall through. */
+		default:
+			usage();
+			exit(c == 'h' ? EXIT_SUCCESS : EXIT_FAILURE);
+		}
+
+	if (loops == 0) {
+		usage();
+		exit(EXIT_FAILURE);
+	}
+
+	optind = 0;
+	copperplate_init(argc, argv);
+
+	mlockall(MCL_CURRENT|MCL_FUTURE);
+
+	bench_pin(this_cpu);
+
+	ret = rt_task_shadow(&main_task, "copperbench", BENCH_PRIO, 0);
+	if (ret)
+		bench_fail("rt_task_shadow", ret);
+
+	ret = rt_sem_create(&done_sem, "copperbench-done", 0, S_FIFO);
+	if (ret)
+		bench_fail("rt_sem_create", ret);
+
+	cross_p = peer_cpu >= 0 && peer_cpu != this_cpu &&
+		sysconf(_SC_NPROCESSORS_ONLN) > 1;
+
+	for (b = bench_table; b->name; b++) {
+		if (filter && strstr(b->name, filter) == NULL)
+			continue;
+		run_bench(b, 0);
+		if (b->has_peer && cross_p)
+			run_bench(b, 1);
+	}
+
+	if (output == OUTPUT_JSON)
+		printf("%s]\n", nr_results ? "\n" : "[");
+
+	rt_sem_delete(&done_sem);
+
+	return 0;
+}
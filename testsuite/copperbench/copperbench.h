@@ -0,0 +1,76 @@
+/*
+ * Copperplate micro-benchmarks, common definitions.
+ *
+ * Released under the terms of GPLv2.
+ */
+
+#ifndef _COPPERBENCH_H
+#define _COPPERBENCH_H
+
+/*
+ * Each benchmark collects one sample per iteration, in nanoseconds,
+ * between bench_start() and bench_stop(). The skin-specific units
+ * only depend on this header, since the Alchemy and pSOS APIs may
+ * not be mixed in a single translation unit.
+ */
+
+struct bench_run {
+	const char *name;
+	int cross;		/* Peer task runs on peer_cpu. */
+	int this_cpu;
+	int peer_cpu;
+	unsigned int loops;
+	unsigned long long *samples;
+	unsigned int nr_samples;
+	unsigned long long start, stop;
+};
+
+#define BENCH_PRIO	50
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+unsigned long long bench_now(void);
+
+void bench_pin(int cpu);
+
+void bench_fail(const char *service, int ret);
+
+void bench_start(struct bench_run *run);
+
+void bench_stop(struct bench_run *run);
+
+static inline void bench_record(struct bench_run *run,
+				unsigned long long ns)
+{
+	if (run->nr_samples < run->loops)
+		run->samples[run->nr_samples++] = ns;
+}
+
+/* Completion of tasks created by the skin units. */
+void bench_signal_done(void);
+
+void bench_wait_done(void);
+
+void alchemy_bench_sem(struct bench_run *run);
+
+void alchemy_bench_sem_pingpong(struct bench_run *run);
+
+void alchemy_bench_event_pingpong(struct bench_run *run);
+
+void alchemy_bench_mutex_handoff(struct bench_run *run);
+
+void alchemy_bench_task(struct bench_run *run);
+
+void psos_bench_queue_pingpong(struct bench_run *run);
+
+void psos_bench_timer(struct bench_run *run);
+
+void psos_bench_timer_arm(struct bench_run *run);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _COPPERBENCH_H */
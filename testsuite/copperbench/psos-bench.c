@@ -0,0 +1,143 @@
+/*
+ * Copperplate micro-benchmarks, pSOS services.
+ *
+ * Released under the terms of GPLv2.
+ */
+
+#include <stdio.h>
+#include <psos/psos.h>
+#include "copperbench.h"
+
+#define EV_BENCH_TIMER	0x1
+
+static u_long ping_qid, pong_qid;
+
+static void check(const char *service, u_long ret)
+{
+	if (ret != SUCCESS)
+		bench_fail(service, (int)ret);
+}
+
+static u_long spawn_task(const char *name, int prio,
+			 void (*entry)(u_long a0, u_long a1,
+				       u_long a2, u_long a3),
+			 struct bench_run *run)
+{
+	u_long args[4] = { (u_long)run, 0, 0, 0 }, tid;
+
+	check("t_create", t_create(name, prio, 0, 0, 0, &tid));
+	check("t_start", t_start(tid, 0, entry, args));
+
+	return tid;
+}
+
+static void queue_peer(u_long a0, u_long a1, u_long a2, u_long a3)
+{
+	struct bench_run *run = (struct bench_run *)a0;
+	u_long msg[4];
+	unsigned int n;
+
+	bench_pin(run->cross ? run->peer_cpu : run->this_cpu);
+
+	for (n = 0; n < run->loops; n++) {
+		check("q_receive", q_receive(ping_qid, Q_WAIT, 0, msg));
+		check("q_send", q_send(pong_qid, msg));
+	}
+}
+
+static void queue_driver(u_long a0, u_long a1, u_long a2, u_long a3)
+{
+	struct bench_run *run = (struct bench_run *)a0;
+	u_long msg[4] = { 0, 1, 2, 3 };
+	unsigned long long t0;
+	unsigned int n;
+
+	bench_pin(run->this_cpu);
+	spawn_task("QPER", BENCH_PRIO, queue_peer, run);
+
+	bench_start(run);
+
+	for (n = 0; n < run->loops; n++) {
+		t0 = bench_now();
+		q_send(ping_qid, msg);
+		q_receive(pong_qid, Q_WAIT, 0, msg);
+		bench_record(run, bench_now() - t0);
+	}
+
+	bench_stop(run);
+	bench_signal_done();
+}
+
+void psos_bench_queue_pingpong(struct bench_run *run)
+{
+	check("q_create", q_create("QPNG", 0, Q_FIFO, &ping_qid));
+	check("q_create", q_create("QPOG", 0, Q_FIFO, &pong_qid));
+
+	spawn_task("QDRV", BENCH_PRIO, queue_driver, run);
+	bench_wait_done();
+
+	check("q_delete", q_delete(ping_qid));
+	check("q_delete", q_delete(pong_qid));
+}
+
+/*
+ * Each iteration arms a one-tick timer sending an event to the
+ * driver, then waits for it: samples include the clock tick, so the
+ * spread of the distribution is what matters here.
+ */
+static void timer_driver(u_long a0, u_long a1, u_long a2, u_long a3)
+{
+	struct bench_run *run = (struct bench_run *)a0;
+	unsigned long long t0;
+	u_long tmid, events;
+	unsigned int n;
+
+	bench_pin(run->this_cpu);
+
+	bench_start(run);
+
+	for (n = 0; n < run->loops; n++) {
+		t0 = bench_now();
+		check("tm_evafter", tm_evafter(1, EV_BENCH_TIMER, &tmid));
+		check("ev_receive", ev_receive(EV_BENCH_TIMER,
+					       EV_WAIT|EV_ALL, 0, &events));
+		bench_record(run, bench_now() - t0);
+	}
+
+	bench_stop(run);
+	bench_signal_done();
+}
+
+void psos_bench_timer(struct bench_run *run)
+{
+	spawn_task("TDRV", BENCH_PRIO, timer_driver, run);
+	bench_wait_done();
+}
+
+static void arm_driver(u_long a0, u_long a1, u_long a2, u_long a3)
+{
+	struct bench_run *run = (struct bench_run *)a0;
+	unsigned long long t0;
+	unsigned int n;
+	u_long tmid;
+
+	bench_pin(run->this_cpu);
+
+	bench_start(run);
+
+	for (n = 0; n < run->loops; n++) {
+		t0 = bench_now();
+		check("tm_evafter", tm_evafter(1000, EV_BENCH_TIMER, &tmid));
+		check("tm_cancel", tm_cancel(tmid));
+		bench_record(run, bench_now() - t0);
+	}
+
+	bench_stop(run);
+	bench_signal_done();
+}
+
+void psos_bench_timer_arm(struct bench_run *run)
+{
+	spawn_task("TARM", BENCH_PRIO, arm_driver, run);
+	bench_wait_done();
+}
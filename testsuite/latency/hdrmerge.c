@@ -0,0 +1,145 @@
+/*
+ * Merge latency histograms dumped by "latency -g", and report the
+ * overall percentiles.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <rtdm/rthist.h>
+
+static struct rttst_hist *merged;
+
+static unsigned long records;
+
+static int merge_file(const char *path)
+{
+	struct rttst_hist *h;
+	FILE *fp;
+	int err;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "hdrmerge: cannot open %s: %s\n",
+			path, strerror(errno));
+		return -errno;
+	}
+
+	while ((err = rttst_hist_load(fp, &h)) == 0) {
+		if (merged == NULL) {
+			merged = h;
+			records++;
+			continue;
+		}
+		err = rttst_hist_merge(merged, h);
+		free(h);
+		if (err) {
+			fprintf(stderr,
+				"hdrmerge: %s: histogram precision mismatch\n",
+				path);
+			goto out;
+		}
+		records++;
+	}
+
+	if (err == -ENODATA)
+		err = 0;
+	else if (err == -EINVAL)
+		fprintf(stderr, "hdrmerge: %s: malformed record\n", path);
+	else
+		fprintf(stderr, "hdrmerge: %s: %s\n", path, strerror(-err));
+out:
+	fclose(fp);
+
+	return err;
+}
+
+static void print_percentile(const char *label, unsigned long ppm)
+{
+	printf("%-8s %12.3f us\n", label,
+	       rttst_hist_percentile(merged, ppm) / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+	const char *output = NULL;
+	FILE *fp;
+	int c, err;
+
+	while ((c = getopt(argc, argv, "o:")) != EOF)
+		switch (c) {
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			goto usage;
+		}
+
+	if (optind >= argc)
+		goto usage;
+
+	for (; optind < argc; optind++)
+		if (merge_file(argv[optind]))
+			return 1;
+
+	if (merged == NULL) {
+		fprintf(stderr, "hdrmerge: no histogram found\n");
+		return 1;
+	}
+
+	printf("records  %12lu\n", records);
+	printf("samples  %12Lu\n", merged->count);
+	printf("overflow %12Lu\n", merged->overflows);
+	if (merged->count) {
+		printf("%-8s %12.3f us\n", "min", merged->min / 1000.0);
+		printf("%-8s %12.3f us\n", "avg",
+		       (double)merged->sum / merged->count / 1000);
+		print_percentile("p50", 500000);
+		print_percentile("p99", 990000);
+		print_percentile("p99.9", 999000);
+		print_percentile("p99.99", 999900);
+		printf("%-8s %12.3f us\n", "max", merged->max / 1000.0);
+	}
+
+	if (output) {
+		fp = fopen(output, "w");
+		if (fp == NULL) {
+			fprintf(stderr, "hdrmerge: cannot open %s: %s\n",
+				output, strerror(errno));
+			return 1;
+		}
+		err = rttst_hist_dump(merged, fp);
+		if (fclose(fp) && err == 0)
+			err = -errno;
+		if (err) {
+			fprintf(stderr, "hdrmerge: cannot write %s: %s\n",
+				output, strerror(-err));
+			return 1;
+		}
+	}
+
+	free(merged);
+
+	return 0;
+
+usage:
+	fprintf(stderr,
+		"usage: hdrmerge [-o <merged-file>] <histogram-file>...\n");
+
+	return 2;
+}
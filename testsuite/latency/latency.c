@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <limits.h>
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
@@ -9,6 +10,7 @@
 #include <sys/mman.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #ifndef __UCLIBC__
 #include <execinfo.h>
@@ -19,6 +21,7 @@
 #include <alchemy/timer.h>
 #include <alchemy/sem.h>
 #include <rtdm/rttesting.h>
+#include "outliers.h"
 
 RT_TASK latency_task, display_task;
 
@@ -42,6 +45,7 @@ int freeze_max = 0;
 int priority = T_HIPRIO;
 int stop_upon_switch = 0;
 sig_atomic_t sampling_relaxed = 0;
+int edf_load = 0;		/* EDF load tasks, via -E <count> */
 
 #define USER_TASK       0
 #define KERNEL_TASK     1
@@ -62,25 +66,119 @@ int test_loops = 0;		/* outer loop count */
 
 /* Warmup time : in order to avoid spurious cache effects on low-end machines. */
 #define WARMUP_TIME 1
-#define HISTOGRAM_CELLS 100
-int histogram_size = HISTOGRAM_CELLS;
-long *histogram_avg = NULL, *histogram_max = NULL, *histogram_min = NULL;
+int histogram_bits = RTTST_HIST_SUB_BITS; /* -H <bits> to override */
+struct rttst_hist *histogram_avg = NULL, *histogram_max = NULL,
+	*histogram_min = NULL;
 
 int do_histogram = 0, do_stats = 0, finished = 0;
-int bucketsize = 1000;		/* default = 1000ns, -B <size> to override */
+const char *histogram_file = NULL;	/* -g <file> to dump raw samples */
 
-static inline void add_histogram(long *histogram, long addval)
+static inline void add_histogram(struct rttst_hist *histogram, long addval)
 {
-	/* bucketsize steps */
-	long inabs =
-	    rt_timer_tsc2ns(addval >= 0 ? addval : -addval) / bucketsize;
-	histogram[inabs < histogram_size ? inabs : histogram_size - 1]++;
+	rttst_hist_add(histogram,
+		       rt_timer_tsc2ns(addval >= 0 ? addval : -addval));
 }
 
+const char *outlier_file = NULL;	/* -O <file> to log outliers */
+FILE *outlier_fp;
+unsigned int outlier_cap = 16;		/* -N <count> to override */
+int outlier_threshold = 0;		/* -W <us> to override, in ns */
+unsigned int captured_crossings;
+
+/*
+ * User task mode only, all in TSC units. The display task snapshots
+ * last_crossing and crossings under crossing_seq, which the sampler
+ * bumps around each update.
+ */
+struct rttst_outlier *outlier_tab, last_crossing;
+unsigned int outlier_nr, crossings, crossing_seq;
+long outlier_floor = LONG_MIN, outlier_limit;
+
+static inline void add_outlier(long long date, long dt)
+{
+	if (dt > outlier_floor)
+		outlier_floor = rttst_outlier_add(outlier_tab, &outlier_nr,
+						  outlier_cap, date, dt);
+	if (dt <= outlier_limit)
+		return;
+
+	/* New worst case beyond the threshold: freeze the trace. */
+	outlier_limit = dt;
+	xntrace_user_freeze(rt_timer_tsc2ns(dt), 0);
+	__atomic_store_n(&crossing_seq, crossing_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	last_crossing.timestamp = date;
+	last_crossing.latency = dt;
+	crossings++;
+	__atomic_store_n(&crossing_seq, crossing_seq + 1, __ATOMIC_RELEASE);
+}
+
+#ifdef SCHED_EDF
+
+RT_TASK *edf_tasks;
+
+unsigned long edf_overruns;
+
+static int set_edf_policy(int prio)
+{
+	struct sched_param_ex param;
+	int err;
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = prio;
+	err = pthread_setschedparam_ex(pthread_self(), SCHED_EDF, &param);
+	if (err)
+		fprintf(stderr, "latency: cannot switch to SCHED_EDF, code %d\n",
+			err);
+
+	return err;
+}
+
+/*
+ * Load task #n runs every (n + 2) sampling periods, and consumes its
+ * share of half the CPU bandwidth on each job.
+ */
+void edf_load_task(void *cookie)
+{
+	long n = (long)cookie;
+	RTIME load_period, burn, start;
+	unsigned long ov;
+	int err;
+
+	load_period = period_ns * (n + 2);
+	burn = rt_timer_ns2ticks(load_period / (2 * edf_load));
+
+	err = rt_task_set_periodic(NULL, TM_NOW,
+				   rt_timer_ns2ticks(load_period));
+	if (err) {
+		fprintf(stderr, "latency: failed to set periodic, code %d\n",
+			err);
+		return;
+	}
+
+	/* Deadlines derive from the period, so set it first. */
+	if (set_edf_policy(priority - 1))
+		return;
+
+	for (;;) {
+		err = rt_task_wait_period(&ov);
+		if (err == -ETIMEDOUT)
+			edf_overruns += ov;
+		else if (err)
+			return;
+		start = rt_timer_read();
+		while (rt_timer_read() - start < burn)
+			;
+	}
+}
+
+#endif /* SCHED_EDF */
+
 void latency(void *cookie)
 {
 	int err, count, nsamples, warmup = 1;
 	RTIME expected_tsc, period_tsc, start_ticks, fault_threshold;
+	RTIME origin_tsc;
 	RT_TIMER_INFO timer_info;
 	unsigned old_relaxed = 0;
 
@@ -97,6 +195,7 @@ void latency(void *cookie)
 	/* start time: one millisecond from now. */
 	start_ticks = timer_info.date + rt_timer_ns2ticks(1000000);
 	expected_tsc = timer_info.tsc + rt_timer_ns2tsc(1000000);
+	origin_tsc = expected_tsc;
 
 	err = rt_task_set_periodic(NULL, start_ticks,
 				   rt_timer_ns2ticks(period_ns));
@@ -106,6 +205,13 @@ void latency(void *cookie)
 		return;
 	}
 
+#ifdef SCHED_EDF
+	if (edf_load && set_edf_policy(priority)) {
+		kill(getpid(), SIGTERM);
+		return;
+	}
+#endif
+
 	for (;;) {
 		long minj = TEN_MILLION, maxj = -TEN_MILLION, dt;
 		long overrun = 0;
@@ -145,18 +251,22 @@ void latency(void *cookie)
 				expected_tsc += period_tsc * ov;
 			}
 
-			if (freeze_max && (dt > gmaxjitter)
-			    && !(finished || warmup)) {
+			if (outlier_tab && !(finished || warmup))
+				add_outlier(expected_tsc - origin_tsc, dt);
+			else if (freeze_max && (dt > gmaxjitter)
+				 && !(finished || warmup)) {
 				xntrace_user_freeze(rt_timer_tsc2ns(dt), 0);
 				gmaxjitter = dt;
 			}
 
-			if (!(finished || warmup) && (do_histogram || do_stats))
+			if (!(finished || warmup) &&
+			    (do_histogram || do_stats || histogram_file))
 				add_histogram(histogram_avg, dt);
 		}
 
 		if (!warmup) {
-			if (!finished && (do_histogram || do_stats)) {
+			if (!finished &&
+			    (do_histogram || do_stats || histogram_file)) {
 				add_histogram(histogram_max, maxj);
 				add_histogram(histogram_min, minj);
 			}
@@ -182,6 +292,126 @@ void latency(void *cookie)
 	}
 }
 
+static void capture_file(int type, const char *path)
+{
+	size_t len = 0, size = 0, n;
+	char *buf = NULL, *p;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return;
+
+	for (;;) {
+		if (len == size) {
+			size = size ? size * 2 : 4096;
+			p = realloc(buf, size);
+			if (p == NULL)
+				break;
+			buf = p;
+		}
+		n = fread(buf + len, 1, size - len, fp);
+		if (n == 0)
+			break;
+		len += n;
+	}
+
+	fclose(fp);
+
+	if (olog_put_record(outlier_fp, type, len) == 0 && len > 0)
+		fwrite(buf, len, 1, outlier_fp);
+
+	free(buf);
+}
+
+/*
+ * Snapshot the frozen trace and the nucleus statistics once the
+ * sampler reports a new threshold crossing. The trace was frozen at
+ * the time of the crossing; the statistics are at most one second
+ * late.
+ */
+void check_outliers(void)
+{
+	struct rttst_outlier last;
+	unsigned int n, seq;
+
+	if (test_mode == USER_TASK) {
+		/*
+		 * The sampler outranks us and never sleeps while
+		 * updating, so retrying until we get a stable
+		 * snapshot is short.
+		 */
+		do {
+			seq = __atomic_load_n(&crossing_seq, __ATOMIC_ACQUIRE);
+			n = crossings;
+			last = last_crossing;
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		} while ((seq & 1) ||
+			 __atomic_load_n(&crossing_seq, __ATOMIC_RELAXED) != seq);
+		last.timestamp = rt_timer_tsc2ns(last.timestamp);
+		last.latency = rt_timer_tsc2ns(last.latency);
+	} else {
+		struct rttst_tmbench_outliers req;
+
+		memset(&req, 0, sizeof(req));
+		if (rt_dev_ioctl(benchdev, RTTST_RTIOC_TMBENCH_OUTLIERS, &req))
+			return;
+		n = req.crossings;
+		last = req.last;
+	}
+
+	if (n == captured_crossings)
+		return;
+
+	captured_crossings = n;
+
+	if (olog_put_record(outlier_fp, OLOG_CAPTURE, OLOG_CAPTURE_SIZE) ||
+	    olog_put(outlier_fp, n, 4) ||
+	    olog_put(outlier_fp, last.timestamp, 8) ||
+	    olog_put(outlier_fp, last.latency, 8))
+		return;
+
+	capture_file(OLOG_TRACE, "/proc/ipipe/trace/frozen");
+	capture_file(OLOG_STAT, "/proc/xenomai/stat");
+	capture_file(OLOG_IRQ, "/proc/xenomai/irq");
+	fflush(outlier_fp);
+}
+
+void save_outliers(void)
+{
+	struct rttst_outlier *tab = outlier_tab;
+	unsigned int n, nr = outlier_nr;
+
+	if (test_mode != USER_TASK) {
+		struct rttst_tmbench_outliers req;
+
+		tab = calloc(outlier_cap, sizeof(*tab));
+		if (tab == NULL)
+			return;
+
+		memset(&req, 0, sizeof(req));
+		req.nr = outlier_cap;
+		req.buf = tab;
+		nr = rt_dev_ioctl(benchdev, RTTST_RTIOC_TMBENCH_OUTLIERS,
+				  &req) ? 0 : req.nr;
+	} else
+		for (n = 0; n < nr; n++) {
+			tab[n].timestamp = rt_timer_tsc2ns(tab[n].timestamp);
+			tab[n].latency = rt_timer_tsc2ns(tab[n].latency);
+		}
+
+	if (olog_put_record(outlier_fp, OLOG_WORST,
+			    4 + nr * OLOG_SAMPLE_SIZE) == 0 &&
+	    olog_put(outlier_fp, nr, 4) == 0)
+		for (n = 0; n < nr; n++)
+			if (olog_put(outlier_fp, tab[n].timestamp, 8) ||
+			    olog_put(outlier_fp, tab[n].latency, 8))
+				break;
+
+	if (tab != outlier_tab)
+		free(tab);
+}
+
 void display(void *cookie)
 {
 	int err, n = 0;
@@ -210,10 +440,11 @@ void display(void *cookie)
 		config.period = period_ns;
 		config.priority = priority;
 		config.warmup_loops = WARMUP_TIME;
-		config.histogram_size = (do_histogram
-					 || do_stats) ? histogram_size : 0;
-		config.histogram_bucketsize = bucketsize;
+		config.histogram_bits = (do_histogram || do_stats ||
+					 histogram_file) ? histogram_bits : 0;
 		config.freeze_max = freeze_max;
+		config.outliers = outlier_file ? outlier_cap : 0;
+		config.outlier_threshold = outlier_threshold;
 
 		err =
 		    rt_dev_ioctl(benchdev, RTTST_RTIOC_TMBENCH_START, &config);
@@ -281,6 +512,9 @@ void display(void *cookie)
 			goverrun = result.overall.overruns;
 		}
 
+		if (outlier_fp)
+			check_outliers();
+
 		if (!quiet) {
 			if (data_lines && (n++ % data_lines) == 0) {
 				time_t now, dt;
@@ -308,42 +542,50 @@ void display(void *cookie)
 	}
 }
 
-double dump_histogram(long *histogram, char *kind)
+/* Bucket midpoint, in microseconds. */
+static inline double bucket_value(struct rttst_hist *histogram, unsigned n)
 {
-	int n, total_hits = 0;
-	double avg = 0;		/* used to sum hits 1st */
+	return (rttst_hist_lowest(histogram, n) +
+		rttst_hist_highest(histogram, n)) / 2000.0;
+}
 
-	if (do_histogram)
-		printf("---|--param|----range-|--samples\n");
+void dump_histogram(struct rttst_hist *histogram, char *kind)
+{
+	unsigned n;
 
-	for (n = 0; n < histogram_size; n++) {
-		long hits = histogram[n];
+	printf("---|--param|--------------range-|--samples\n");
 
-		if (hits) {
-			total_hits += hits;
-			avg += n * hits;
-			if (do_histogram)
-				printf("HSD|    %s| %3d -%3d | %8ld\n",
-				       kind, n, n + 1, hits);
-		}
-	}
+	for (n = 0; n < histogram->nr_buckets; n++) {
+		unsigned long long hits = histogram->buckets[n];
 
-	avg /= total_hits;	/* compute avg, reuse variable */
+		if (hits)
+			printf("HSD|    %s| %9.3f -%9.3f | %8Lu\n", kind,
+			       rttst_hist_lowest(histogram, n) / 1000.0,
+			       (rttst_hist_highest(histogram, n) + 1) / 1000.0,
+			       hits);
+	}
 
-	return avg;
+	if (histogram->overflows)
+		printf("HSD|    %s| %9.3f -      inf | %8Lu\n", kind,
+		       (double)(1ULL << histogram->range_bits) / 1000,
+		       histogram->overflows);
 }
 
-void dump_stats(long *histogram, char *kind, double avg)
+void dump_stats(struct rttst_hist *histogram, char *kind)
 {
-	int n, total_hits = 0;
-	double variance = 0;
+	double avg = 0, variance = 0, v;
+	unsigned long long total_hits = histogram->count;
+	unsigned n;
+
+	if (total_hits)
+		avg = (double)histogram->sum / total_hits / 1000;
 
-	for (n = 0; n < histogram_size; n++) {
-		long hits = histogram[n];
+	for (n = 0; n < histogram->nr_buckets; n++) {
+		unsigned long long hits = histogram->buckets[n];
 
 		if (hits) {
-			total_hits += hits;
-			variance += hits * (n - avg) * (n - avg);
+			v = bucket_value(histogram, n);
+			variance += hits * (v - avg) * (v - avg);
 		}
 	}
 
@@ -354,24 +596,61 @@ void dump_stats(long *histogram, char *kind, double avg)
 	} else
 		variance = 0;
 
-	printf("HSS|    %s| %9d| %10.3f| %10.3f\n",
+	printf("HSS|    %s| %9Lu| %10.3f| %10.3f\n",
 	       kind, total_hits, avg, variance);
 }
 
-void dump_hist_stats(void)
+void dump_percentiles(struct rttst_hist *histogram, char *kind)
 {
-	double minavg, maxavg, avgavg;
+	printf("HSP|    %s| %10.3f| %10.3f| %10.3f| %10.3f| %10.3f\n", kind,
+	       rttst_hist_percentile(histogram, 500000) / 1000.0,
+	       rttst_hist_percentile(histogram, 990000) / 1000.0,
+	       rttst_hist_percentile(histogram, 999000) / 1000.0,
+	       rttst_hist_percentile(histogram, 999900) / 1000.0,
+	       histogram->count ? histogram->max / 1000.0 : 0.0);
+}
 
+void dump_hist_stats(void)
+{
 	/* max is last, where its visible w/o scrolling */
-	minavg = dump_histogram(histogram_min, "min");
-	avgavg = dump_histogram(histogram_avg, "avg");
-	maxavg = dump_histogram(histogram_max, "max");
+	if (do_histogram) {
+		dump_histogram(histogram_min, "min");
+		dump_histogram(histogram_avg, "avg");
+		dump_histogram(histogram_max, "max");
+	}
 
 	printf("HSH|--param|--samples-|--average--|---stddev--\n");
 
-	dump_stats(histogram_min, "min", minavg);
-	dump_stats(histogram_avg, "avg", avgavg);
-	dump_stats(histogram_max, "max", maxavg);
+	dump_stats(histogram_min, "min");
+	dump_stats(histogram_avg, "avg");
+	dump_stats(histogram_max, "max");
+
+	printf("HSH|--param|--------p50|--------p99|------p99.9|-----p99.99"
+	       "|--------max\n");
+
+	dump_percentiles(histogram_min, "min");
+	dump_percentiles(histogram_avg, "avg");
+	dump_percentiles(histogram_max, "max");
+}
+
+void save_histogram(void)
+{
+	FILE *fp;
+	int err;
+
+	fp = fopen(histogram_file, "a");
+	if (fp == NULL) {
+		fprintf(stderr, "latency: cannot open %s: %s\n",
+			histogram_file, strerror(errno));
+		return;
+	}
+
+	err = rttst_hist_dump(histogram_avg, fp);
+	if (fclose(fp) && err == 0)
+		err = -errno;
+	if (err)
+		fprintf(stderr, "latency: cannot write %s: %s\n",
+			histogram_file, strerror(-err));
 }
 
 void cleanup(void)
@@ -390,6 +669,10 @@ void cleanup(void)
 	} else {
 		struct rttst_overall_bench_res overall;
 
+		/* Fetch the outliers before the driver drops them. */
+		if (outlier_fp)
+			save_outliers();
+
 		overall.histogram_min = histogram_min;
 		overall.histogram_max = histogram_max;
 		overall.histogram_avg = histogram_avg;
@@ -408,6 +691,17 @@ void cleanup(void)
 	if (do_histogram || do_stats)
 		dump_hist_stats();
 
+	if (histogram_file)
+		save_histogram();
+
+	if (outlier_fp) {
+		if (test_mode == USER_TASK)
+			save_outliers();
+		if (fclose(outlier_fp))
+			fprintf(stderr, "latency: cannot write %s: %s\n",
+				outlier_file, strerror(errno));
+	}
+
 	time(&test_end);
 	actual_duration = test_end - test_start - WARMUP_TIME;
 	if (!test_duration)
@@ -420,6 +714,11 @@ void cleanup(void)
 	     goverrun, max_relaxed, actual_duration / 3600, (actual_duration / 60) % 60,
 	     actual_duration % 60, test_duration / 3600,
 	     (test_duration / 60) % 60, test_duration % 60);
+#ifdef SCHED_EDF
+	if (edf_load)
+		printf("EDF load: %d tasks, %lu overruns\n",
+		       edf_load, edf_overruns);
+#endif
 	if (max_relaxed > 0)
 		printf(
 "Warning! some latency maxima may have been due to involuntary mode switches.\n"
@@ -431,6 +730,8 @@ void cleanup(void)
 		free(histogram_max);
 	if (histogram_min)
 		free(histogram_min);
+	if (outlier_tab)
+		free(outlier_tab);
 
 	exit(0);
 }
@@ -476,7 +777,7 @@ int main(int argc, char **argv)
 
 	copperplate_init(argc, argv);
 
-	while ((c = getopt(argc, argv, "hp:l:T:qH:B:sD:t:fc:P:b")) != EOF)
+	while ((c = getopt(argc, argv, "hp:l:T:qH:B:g:sD:t:fc:P:bE:O:N:W:")) != EOF)
 		switch (c) {
 		case 'h':
 
@@ -490,12 +791,34 @@ int main(int argc, char **argv)
 
 		case 'H':
 
-			histogram_size = atoi(optarg);
+			histogram_bits = atoi(optarg);
 			break;
 
 		case 'B':
 
-			bucketsize = atoi(optarg);
+			fprintf(stderr,
+				"latency: -B is obsolete, buckets now scale "
+				"with latency, see -H\n");
+			break;
+
+		case 'g':
+
+			histogram_file = optarg;
+			break;
+
+		case 'O':
+
+			outlier_file = optarg;
+			break;
+
+		case 'N':
+
+			outlier_cap = atoi(optarg);
+			break;
+
+		case 'W':
+
+			outlier_threshold = atoi(optarg) * 1000;
 			break;
 
 		case 'p':
@@ -546,14 +869,20 @@ int main(int argc, char **argv)
 			stop_upon_switch = 1;
 			break;
 
+#ifdef SCHED_EDF
+		case 'E':
+			edf_load = atoi(optarg);
+			break;
+#endif
+
 		default:
 
 			fprintf(stderr,
 "usage: latency [options]\n"
 "  [-h]                         # print histograms of min, avg, max latencies\n"
 "  [-s]                         # print statistics of min, avg, max latencies\n"
-"  [-H <histogram-size>]        # default = 200, increase if your last bucket is full\n"
-"  [-B <bucket-size>]           # default = 1000ns, decrease for more resolution\n"
+"  [-H <histogram-bits>]        # default = 7, up to 14 for more resolution\n"
+"  [-g <file>]                  # append binary histogram of all samples to <file>\n"
 "  [-p <period_us>]             # sampling period\n"
 "  [-l <data-lines per header>] # default=21, 0 to supress headers\n"
 "  [-T <test_duration_seconds>] # default=0, so ^C to end\n"
@@ -564,6 +893,12 @@ int main(int argc, char **argv)
 "  [-c <cpu>]                   # pin measuring task down to given CPU\n"
 "  [-P <priority>]              # task priority (test mode 0 and 1 only)\n"
 "  [-b]                         # break upon mode switch\n"
+"  [-O <file>]                  # log worst samples and traces to <file>\n"
+"  [-N <count>]                 # worst samples to log, default = 16\n"
+"  [-W <threshold_us>]          # capture traces above, default = 0\n"
+#ifdef SCHED_EDF
+"  [-E <count>]                 # sample under SCHED_EDF, with <count> load tasks\n"
+#endif
 );
 			exit(2);
 		}
@@ -579,11 +914,47 @@ int main(int argc, char **argv)
 		exit(2);
 	}
 
+	if (edf_load < 0 || (edf_load && test_mode != USER_TASK)) {
+		fprintf(stderr, "latency: -E only works in user task mode.\n");
+		exit(2);
+	}
+
+	if (!rttst_hist_valid_p(histogram_bits, RTTST_HIST_RANGE_BITS)) {
+		fprintf(stderr, "latency: -H must be within 1 and %d.\n",
+			RTTST_HIST_MAX_SUB_BITS);
+		exit(2);
+	}
+
+	if (outlier_cap < 1 || outlier_cap > RTTST_OUTLIERS_MAX) {
+		fprintf(stderr, "latency: -N must be within 1 and %d.\n",
+			RTTST_OUTLIERS_MAX);
+		exit(2);
+	}
+
+	if (outlier_threshold < 0) {
+		fprintf(stderr, "latency: invalid -W threshold.\n");
+		exit(2);
+	}
+
 	time(&test_start);
 
-	histogram_avg = calloc(histogram_size, sizeof(long));
-	histogram_max = calloc(histogram_size, sizeof(long));
-	histogram_min = calloc(histogram_size, sizeof(long));
+	if (outlier_file) {
+		outlier_fp = fopen(outlier_file, "w");
+		if (outlier_fp == NULL) {
+			fprintf(stderr, "latency: cannot open %s: %s\n",
+				outlier_file, strerror(errno));
+			exit(2);
+		}
+		if (test_mode == USER_TASK) {
+			outlier_tab = calloc(outlier_cap, sizeof(*outlier_tab));
+			if (outlier_tab == NULL)
+				cleanup();
+		}
+	}
+
+	histogram_avg = rttst_hist_alloc(histogram_bits, RTTST_HIST_RANGE_BITS);
+	histogram_max = rttst_hist_alloc(histogram_bits, RTTST_HIST_RANGE_BITS);
+	histogram_min = rttst_hist_alloc(histogram_bits, RTTST_HIST_RANGE_BITS);
 
 	if (!(histogram_avg && histogram_max && histogram_min))
 		cleanup();
@@ -591,6 +962,19 @@ int main(int argc, char **argv)
 	if (period_ns == 0)
 		period_ns = CONFIG_XENO_DEFAULT_PERIOD;	/* ns */
 
+	if (outlier_fp) {
+		outlier_limit = rt_timer_ns2tsc(outlier_threshold);
+		if (olog_put(outlier_fp, OLOG_MAGIC, 4) ||
+		    olog_put(outlier_fp, test_mode, 4) ||
+		    olog_put(outlier_fp, period_ns, 4) ||
+		    olog_put(outlier_fp, outlier_threshold, 4) ||
+		    olog_put(outlier_fp, test_start, 8)) {
+			fprintf(stderr, "latency: cannot write %s\n",
+				outlier_file);
+			exit(2);
+		}
+	}
+
 	if (priority <= T_LOPRIO)
 		priority = T_LOPRIO + 1;
 	else if (priority > T_HIPRIO)
@@ -618,6 +1002,9 @@ int main(int argc, char **argv)
 	       "== Test mode: %s\n"
 	       "== All results in microseconds\n",
 	       period_ns / 1000, test_mode_names[test_mode]);
+	if (edf_load)
+		printf("== EDF scheduling, %d mixed-rate load tasks\n",
+		       edf_load);
 
 	mlockall(MCL_CURRENT | MCL_FUTURE);
 
@@ -678,6 +1065,32 @@ int main(int argc, char **argv)
 		}
 	}
 
+#ifdef SCHED_EDF
+	if (edf_load) {
+		long n;
+
+		edf_tasks = calloc(edf_load, sizeof(RT_TASK));
+		if (edf_tasks == NULL)
+			cleanup();
+
+		for (n = 0; n < edf_load; n++) {
+			snprintf(task_name, sizeof(task_name), "edf%ld-%d",
+				 n, getpid());
+			err = rt_task_create(&edf_tasks[n], task_name, 0,
+					     priority - 1, T_FPU | cpu);
+			if (err == 0)
+				err = rt_task_start(&edf_tasks[n],
+						    &edf_load_task, (void *)n);
+			if (err) {
+				fprintf(stderr,
+					"latency: failed to start EDF load task, code %d\n",
+					err);
+				return 0;
+			}
+		}
+	}
+#endif
+
 	sigwait(&mask, &sig);
 	finished = 1;
 
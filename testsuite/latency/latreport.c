@@ -0,0 +1,237 @@
+/*
+ * Summarize an outlier log recorded by "latency -O".
+ *
+ * Xenomai is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include "outliers.h"
+
+static const char *test_mode_names[] = {
+	"periodic user-mode task",
+	"in-kernel periodic task",
+	"in-kernel timer handler"
+};
+
+static const char *snapshot_names[] = {
+	[OLOG_TRACE] = "trace",
+	[OLOG_STAT] = "stat",
+	[OLOG_IRQ] = "irq",
+};
+
+struct sample {
+	unsigned long long date;
+	long long latency;
+};
+
+static int verbose;
+
+static void print_date(unsigned long long date)
+{
+	unsigned long long secs = date / 1000000000;
+
+	printf("%.2Lu:%.2Lu:%.2Lu.%.6Lu", secs / 3600, (secs / 60) % 60,
+	       secs % 60, (date % 1000000000) / 1000);
+}
+
+static int cmp_samples(const void *a, const void *b)
+{
+	const struct sample *l = a, *r = b;
+
+	if (l->latency == r->latency)
+		return l->date < r->date ? -1 : l->date > r->date;
+
+	return l->latency > r->latency ? -1 : 1;
+}
+
+static int print_worst(FILE *fp, unsigned long long len)
+{
+	unsigned long long nr, n, v;
+	struct sample *tab;
+	int ret;
+
+	ret = olog_get(fp, &nr, 4);
+	if (ret)
+		return ret;
+
+	if (len != 4 + nr * OLOG_SAMPLE_SIZE)
+		return -EINVAL;
+
+	tab = calloc(nr ?: 1, sizeof(*tab));
+	if (tab == NULL)
+		return -ENOMEM;
+
+	for (n = 0; n < nr; n++) {
+		ret = olog_get(fp, &tab[n].date, 8);
+		ret = ret ?: olog_get(fp, &v, 8);
+		if (ret)
+			goto out;
+		tab[n].latency = (long long)v;
+	}
+
+	qsort(tab, nr, sizeof(*tab), cmp_samples);
+
+	printf("---|-rank|-----------date|----latency\n");
+	for (n = 0; n < nr; n++) {
+		printf("WST| %4Lu| ", n + 1);
+		print_date(tab[n].date);
+		printf("| %10.3f\n", tab[n].latency / 1000.0);
+	}
+out:
+	free(tab);
+
+	return ret;
+}
+
+static int print_snapshot(FILE *fp, int type, unsigned long long len)
+{
+	char buf[4096];
+	size_t n;
+
+	if (!verbose) {
+		printf("SNP|     %-5s| %Lu bytes\n", snapshot_names[type], len);
+		return fseek(fp, len, SEEK_CUR) ? -errno : 0;
+	}
+
+	printf("--- %s snapshot ---\n", snapshot_names[type]);
+	while (len > 0) {
+		n = fread(buf, 1, len < sizeof(buf) ? len : sizeof(buf), fp);
+		if (n == 0)
+			return -EINVAL;
+		fwrite(buf, n, 1, stdout);
+		len -= n;
+	}
+
+	return 0;
+}
+
+static int report(FILE *fp)
+{
+	unsigned long long magic, mode, period, threshold, start;
+	unsigned long long type, len, crossing, date, latency;
+	unsigned long captures = 0;
+	time_t start_date;
+	int ret;
+
+	ret = olog_get(fp, &magic, 4);
+	ret = ret ?: olog_get(fp, &mode, 4);
+	ret = ret ?: olog_get(fp, &period, 4);
+	ret = ret ?: olog_get(fp, &threshold, 4);
+	ret = ret ?: olog_get(fp, &start, 8);
+	if (ret || magic != OLOG_MAGIC)
+		return -EINVAL;
+
+	start_date = start;
+	printf("== Test mode: %s\n"
+	       "== Sampling period: %Lu us\n"
+	       "== Capture threshold: %Lu us\n"
+	       "== Started: %s",
+	       mode < 3 ? test_mode_names[mode] : "unknown",
+	       period / 1000, threshold / 1000, ctime(&start_date));
+
+	for (;;) {
+		ret = olog_get(fp, &type, 2);
+		if (ret == -ENODATA)
+			break;
+		ret = ret ?: olog_get(fp, &len, 4);
+		if (ret)
+			return ret == -ENODATA ? -EINVAL : ret;
+
+		switch (type) {
+		case OLOG_CAPTURE:
+			if (len != OLOG_CAPTURE_SIZE)
+				return -EINVAL;
+			ret = olog_get(fp, &crossing, 4);
+			ret = ret ?: olog_get(fp, &date, 8);
+			ret = ret ?: olog_get(fp, &latency, 8);
+			if (ret)
+				break;
+			if (captures++ == 0)
+				printf("---|--crossing|-----------date|----latency\n");
+			printf("CAP| %9Lu| ", crossing);
+			print_date(date);
+			printf("| %10.3f\n", (long long)latency / 1000.0);
+			break;
+		case OLOG_TRACE:
+		case OLOG_STAT:
+		case OLOG_IRQ:
+			ret = print_snapshot(fp, type, len);
+			break;
+		case OLOG_WORST:
+			ret = print_worst(fp, len);
+			break;
+		default:
+			/* Skip records from later versions. */
+			ret = fseek(fp, len, SEEK_CUR) ? -errno : 0;
+		}
+
+		if (ret)
+			return ret == -ENODATA ? -EINVAL : ret;
+	}
+
+	printf("== %lu trace capture(s)\n", captures);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	FILE *fp;
+	int c, ret;
+
+	while ((c = getopt(argc, argv, "v")) != EOF)
+		switch (c) {
+		case 'v':
+			verbose = 1;
+			break;
+		default:
+			goto usage;
+		}
+
+	if (optind != argc - 1)
+		goto usage;
+
+	fp = fopen(argv[optind], "r");
+	if (fp == NULL) {
+		fprintf(stderr, "latreport: cannot open %s: %s\n",
+			argv[optind], strerror(errno));
+		return 1;
+	}
+
+	ret = report(fp);
+	fclose(fp);
+
+	if (ret == -EINVAL) {
+		fprintf(stderr, "latreport: %s: malformed log\n", argv[optind]);
+		return 1;
+	}
+	if (ret) {
+		fprintf(stderr, "latreport: %s: %s\n",
+			argv[optind], strerror(-ret));
+		return 1;
+	}
+
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: latreport [-v] <outlier-log>\n"
+		"  [-v]                         # dump captured snapshots\n");
+
+	return 2;
+}
@@ -0,0 +1,70 @@
+/*
+ * Outlier log format, written by "latency -O" and read back by
+ * latreport.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+
+#ifndef _LATENCY_OUTLIERS_H
+#define _LATENCY_OUTLIERS_H
+
+#include <rtdm/rthist.h>
+
+/*
+ * The log starts with a header:
+ *
+ *   magic u32, test mode u32, period u32 (ns), threshold u32 (ns),
+ *   start date u64 (seconds since the Epoch)
+ *
+ * followed by a stream of records, each one made of a type u16, a
+ * payload length u32 and the payload. All fields are little-endian,
+ * sample dates are relative to the first release in nanoseconds.
+ *
+ *   OLOG_CAPTURE  crossing u32, date u64, latency s64: a sample
+ *                 crossed the capture threshold, the snapshots
+ *                 which follow belong to it.
+ *   OLOG_TRACE    frozen I-pipe trace, as text.
+ *   OLOG_STAT     contents of /proc/xenomai/stat.
+ *   OLOG_IRQ      contents of /proc/xenomai/irq.
+ *   OLOG_WORST    count u32, then (date u64, latency s64) pairs: the
+ *                 worst samples of the whole run, unordered.
+ */
+
+#define OLOG_MAGIC	0x314f4c58	/* "XLO1" */
+
+#define OLOG_CAPTURE	1
+#define OLOG_TRACE	2
+#define OLOG_STAT	3
+#define OLOG_IRQ	4
+#define OLOG_WORST	5
+
+#define OLOG_HEADER_SIZE	24
+#define OLOG_CAPTURE_SIZE	20
+#define OLOG_SAMPLE_SIZE	16
+
+/* Same little-endian encoding as the histogram dumps. */
+#define olog_put(fp, v, len)	__rttst_hist_put(fp, v, len)
+#define olog_get(fp, v, len)	__rttst_hist_get(fp, v, len)
+
+static inline int olog_put_record(FILE *fp, int type, unsigned long len)
+{
+	int ret;
+
+	ret = olog_put(fp, type, 2);
+
+	return ret ?: olog_put(fp, len, 4);
+}
+
+#endif /* !_LATENCY_OUTLIERS_H */
@@ -0,0 +1,108 @@
+/*
+ * Check the multiply-shift conversion from nanoseconds to clock
+ * ticks of copperplate clocks against plain divisions, for a range
+ * of resolutions and dates.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <copperplate/clockobj.h>
+
+#ifndef CONFIG_XENO_LORES_CLOCK_DISABLED
+
+static const unsigned int resolutions[] = {
+	2, 3, 7, 10, 1000, 4096, 10007, 1000000,
+	16666667, 999999937, 1000000000,
+};
+
+static unsigned long nr_failed;
+
+static void check_one(struct clockobj *clkobj, ticks_t ns)
+{
+	ticks_t ticks, expected;
+
+	expected = ns / clkobj->resolution;
+	ticks = __clockobj_ns_to_ticks(clkobj, ns);
+	if (ticks == expected)
+		return;
+
+	if (nr_failed++ < 10)
+		fprintf(stderr, "resolution %u: %llu ns -> %llu ticks, "
+			"expected %llu\n", clkobj->resolution,
+			ns, ticks, expected);
+}
+
+static ticks_t random_date(void)
+{
+	ticks_t ns;
+
+	ns = ((ticks_t)random() << 33) ^ ((ticks_t)random() << 2) ^ random();
+
+	/* Vary the magnitude, down to a few ticks. */
+	return ns >> (random() % 64);
+}
+
+int main(int argc, char *const argv[])
+{
+	unsigned long nr_loops = 1000000, n;
+	struct clockobj clkobj;
+	unsigned int res;
+	ticks_t k;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "n:")) != EOF)
+		switch (c) {
+		case 'n':
+			nr_loops = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "usage: clockobj-scale [-n loops]\n");
+			exit(EXIT_FAILURE);
+		}
+
+	for (i = 0; i < sizeof(resolutions) / sizeof(resolutions[0]); i++) {
+		res = resolutions[i];
+		memset(&clkobj, 0, sizeof(clkobj));
+		clkobj.resolution = res;
+		__clockobj_init_scaling(&clkobj);
+
+		/* Values around multiples of the resolution. */
+		for (k = 0; k < 1000; k++) {
+			check_one(&clkobj, k * res);
+			check_one(&clkobj, k * res + res - 1);
+		}
+
+		check_one(&clkobj, ~0ULL);
+		check_one(&clkobj, ~0ULL >> 1);
+		check_one(&clkobj, 0xffffffffULL);
+		check_one(&clkobj, 0x100000000ULL);
+		check_one(&clkobj, (~0ULL / res) * res);
+		check_one(&clkobj, (~0ULL / res) * res - 1);
+
+		srandom(res);
+		for (n = 0; n < nr_loops; n++)
+			check_one(&clkobj, random_date());
+	}
+
+	if (nr_failed) {
+		fprintf(stderr, "%lu conversions failed\n", nr_failed);
+		exit(EXIT_FAILURE);
+	}
+
+	printf("%u resolutions checked, %lu random dates each\n",
+	       i, nr_loops);
+
+	exit(EXIT_SUCCESS);
+}
+
+#else /* CONFIG_XENO_LORES_CLOCK_DISABLED */
+
+int main(int argc, char *const argv[])
+{
+	printf("low resolution clock support disabled, nothing to check\n");
+
+	exit(EXIT_SUCCESS);
+}
+
+#endif /* CONFIG_XENO_LORES_CLOCK_DISABLED */
@@ -0,0 +1,170 @@
+/*
+ * Performance and sanity test of the Cobalt POSIX semaphores:
+ * measures uncontended post/wait/trywait cycles, which complete in
+ * user-space when fast synchronization is available, then ping-pong
+ * round trips between two threads, which require the kernel.
+ *
+ * Released under the terms of GPLv2.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+static sem_t ping, pong;
+
+static unsigned int loops = 100000;
+
+static void check(const char *service, int status, int expected)
+{
+	if (status == expected)
+		return;
+
+	fprintf(stderr, "FAILURE: %s: %d (%s), expected %d\n",
+		service, status, status ? strerror(errno) : "",
+		expected);
+	exit(EXIT_FAILURE);
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void check_value(sem_t *sem, int expected)
+{
+	int value;
+
+	check("sem_getvalue", sem_getvalue(sem, &value), 0);
+	if (value != expected) {
+		fprintf(stderr, "FAILURE: sem_getvalue: %d, expected %d\n",
+			value, expected);
+		exit(EXIT_FAILURE);
+	}
+}
+
+static void uncontended(void)
+{
+	unsigned long long start, end;
+	unsigned int n;
+	sem_t sem;
+
+	check("sem_init", sem_init(&sem, 0, 0), 0);
+
+	check("sem_trywait", sem_trywait(&sem), -1);
+	check("sem_trywait", errno, EAGAIN);
+
+	start = now_ns();
+	for (n = 0; n < loops; n++) {
+		sem_post(&sem);
+		sem_wait(&sem);
+	}
+	end = now_ns();
+	printf("uncontended post/wait: %Lu ns/cycle\n",
+	       (end - start) / loops);
+
+	start = now_ns();
+	for (n = 0; n < loops; n++) {
+		sem_post(&sem);
+		sem_trywait(&sem);
+	}
+	end = now_ns();
+	printf("uncontended post/trywait: %Lu ns/cycle\n",
+	       (end - start) / loops);
+
+	for (n = 0; n < 3; n++)
+		check("sem_post", sem_post(&sem), 0);
+	check_value(&sem, 3);
+	check("sem_trywait", sem_trywait(&sem), 0);
+	check_value(&sem, 2);
+
+	check("sem_destroy", sem_destroy(&sem), 0);
+	check("sem_post", sem_post(&sem), -1);
+	check("sem_post", errno, EINVAL);
+}
+
+static void *pong_thread(void *arg)
+{
+	unsigned int n;
+
+	for (n = 0; n < loops; n++) {
+		check("sem_wait", sem_wait(&ping), 0);
+		check("sem_post", sem_post(&pong), 0);
+	}
+
+	return NULL;
+}
+
+static void ping_pong(void)
+{
+	unsigned long long start, end;
+	struct sched_param param;
+	pthread_attr_t attr;
+	pthread_t tid;
+	unsigned int n;
+
+	check("sem_init", sem_init(&ping, 0, 0), 0);
+	check("sem_init", sem_init(&pong, 0, 0), 0);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	param.sched_priority = 10;
+	pthread_attr_setschedparam(&attr, &param);
+	check("pthread_create",
+	      pthread_create(&tid, &attr, pong_thread, NULL), 0);
+	pthread_attr_destroy(&attr);
+
+	start = now_ns();
+	for (n = 0; n < loops; n++) {
+		check("sem_post", sem_post(&ping), 0);
+		check("sem_wait", sem_wait(&pong), 0);
+	}
+	end = now_ns();
+	printf("ping-pong: %Lu ns/round trip\n", (end - start) / loops);
+
+	pthread_join(tid, NULL);
+	check_value(&ping, 0);
+	check_value(&pong, 0);
+
+	check("sem_destroy", sem_destroy(&ping), 0);
+	check("sem_destroy", sem_destroy(&pong), 0);
+}
+
+int main(int argc, char *const argv[])
+{
+	struct sched_param param;
+	int c;
+
+	while ((c = getopt(argc, argv, "l:")) != EOF)
+		switch (c) {
+		case 'l':
+			loops = atoi(optarg);
+			break;
+		default:
+			fprintf(stderr, "usage: sem-bench [-l loops]\n");
+			exit(EXIT_FAILURE);
+		}
+
+	mlockall(MCL_CURRENT | MCL_FUTURE);
+
+	param.sched_priority = 20;
+	pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+
+	uncontended();
+	ping_pong();
+
+	fprintf(stderr, "Test OK\n");
+
+	return 0;
+}
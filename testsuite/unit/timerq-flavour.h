@@ -0,0 +1,151 @@
+/*
+ * Checks and benchmarks one flavour of the nucleus timer queues,
+ * selected by the CONFIG_XENO_OPT_TIMER_* option the includer
+ * defines, along with TIMERQ_FLAVOUR naming the entry points.
+ */
+#include "timerq-torture.h"
+#include <nucleus/timerq.h>
+
+#define __timerq_fn(name, flavour)	name ## _ ## flavour
+#define timerq_fn(name, flavour)	__timerq_fn(name, flavour)
+#define __timerq_str(flavour)		#flavour
+#define timerq_str(flavour)		__timerq_str(flavour)
+
+struct timer {
+	xntimerh_t link;
+	xnticks_t period;
+};
+
+static struct timer *init_timers(void)
+{
+	struct timer *timers;
+	unsigned int n;
+
+	timers = calloc(nr_timers, sizeof(*timers));
+	if (timers == NULL)
+		fatal("no memory");
+
+	srandom(nr_timers);
+	for (n = 0; n < nr_timers; n++) {
+		xntimerh_init(&timers[n].link);
+		timers[n].period = 1000 + random() % 100000;
+		xntimerh_date(&timers[n].link) = timers[n].period;
+		xntimerh_prio(&timers[n].link) = 0;
+	}
+
+	return timers;
+}
+
+static xntimerq_t *init_timerq(void)
+{
+	xntimerq_t *q;
+
+	q = malloc(sizeof(*q));
+	if (q == NULL)
+		fatal("no memory");
+
+	xntimerq_init(q);
+
+	return q;
+}
+
+void timerq_fn(check_timerq, TIMERQ_FLAVOUR)(void)
+{
+	unsigned int n, nr, count, expected;
+	xntimerh_t *h, *due[8];
+	struct timer *timers;
+	xnticks_t last;
+	xntimerq_t *q;
+
+	timers = init_timers();
+	q = init_timerq();
+
+	for (n = 0; n < nr_timers; n++)
+		if (xntimerq_insert(q, &timers[n].link))
+			fatal("%s: insertion failed at #%u",
+			      timerq_str(TIMERQ_FLAVOUR), n);
+
+	/* Remove every third timer, re-key every fifth remaining one. */
+	for (n = 0, expected = nr_timers; n < nr_timers; n += 3, expected--)
+		xntimerq_remove(q, &timers[n].link);
+	for (n = 1; n < nr_timers; n += 5)
+		if (n % 3)
+			xntimerq_rekey(q, &timers[n].link, random() % 200000);
+
+#ifdef CONFIG_XENO_OPT_TIMER_HEAP
+	if (!bheap_ordered(&q->bheap))
+		fatal("heap disordered after removal/rekey");
+#endif
+
+	/* Expire the first half of the date range in small batches. */
+	count = 0;
+	last = 0;
+	while ((nr = xntimerq_pop_due(q, 100000, due, 8)) > 0)
+		for (n = 0; n < nr; n++, count++) {
+			if (xntimerh_date(due[n]) < last ||
+			    xntimerh_date(due[n]) > 100000)
+				fatal("%s: wrong timer expired",
+				      timerq_str(TIMERQ_FLAVOUR));
+			last = xntimerh_date(due[n]);
+		}
+
+	h = xntimerq_head(q);
+	if (h && xntimerh_date(h) <= 100000)
+		fatal("%s: due timer left queued",
+		      timerq_str(TIMERQ_FLAVOUR));
+
+	for (; (h = xntimerq_head(q)) != NULL; count++) {
+		if (xntimerh_date(h) < last)
+			fatal("%s: out of order timer",
+			      timerq_str(TIMERQ_FLAVOUR));
+		last = xntimerh_date(h);
+		xntimerq_remove(q, h);
+	}
+
+	if (count != expected)
+		fatal("%s: %u timers queued, %u expected",
+		      timerq_str(TIMERQ_FLAVOUR), count, expected);
+
+	xntimerq_destroy(q);
+	free(q);
+	free(timers);
+}
+
+/*
+ * Each tick expires the earliest timer, then reloads it for its next
+ * period, as the nucleus tick handler does with periodic timers.
+ */
+void timerq_fn(bench_timerq, TIMERQ_FLAVOUR)(void)
+{
+	unsigned long long start, end;
+	struct timer *timers, *t;
+	xntimerh_t *h;
+	xntimerq_t *q;
+	unsigned int n;
+
+	timers = init_timers();
+	q = init_timerq();
+
+	start = now_ns();
+	for (n = 0; n < nr_timers; n++)
+		xntimerq_insert(q, &timers[n].link);
+	end = now_ns();
+	printf("%s: %u insertions: %Lu ns/op\n",
+	       timerq_str(TIMERQ_FLAVOUR), nr_timers,
+	       (end - start) / nr_timers);
+
+	start = now_ns();
+	for (n = 0; n < nr_ticks; n++) {
+		h = xntimerq_head(q);
+		t = container_of(h, struct timer, link);
+		xntimerq_rekey(q, h, xntimerh_date(h) + t->period);
+	}
+	end = now_ns();
+	printf("%s: %u periodic reloads: %Lu ns/op\n",
+	       timerq_str(TIMERQ_FLAVOUR), nr_ticks,
+	       (end - start) / nr_ticks);
+
+	xntimerq_destroy(q);
+	free(q);
+	free(timers);
+}
@@ -0,0 +1,5 @@
+#define CONFIG_XENO_OPT_TIMER_HEAP		1
+#define CONFIG_XENO_OPT_TIMER_HEAP_CAPACITY	256
+#define TIMERQ_FLAVOUR				heap
+
+#include "timerq-flavour.h"
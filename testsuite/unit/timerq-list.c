@@ -0,0 +1,4 @@
+#define CONFIG_XENO_OPT_TIMER_LIST		1
+#define TIMERQ_FLAVOUR				list
+
+#include "timerq-flavour.h"
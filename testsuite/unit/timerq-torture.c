@@ -0,0 +1,70 @@
+/*
+ * Functional and performance test of the nucleus timer queues, run
+ * from user-space: each flavour of <nucleus/timerq.h> is built in a
+ * separate object (timerq-{heap,wheel,list}.c), checked for
+ * consistency, then benchmarked.
+ */
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include "timerq-torture.h"
+
+unsigned int nr_timers = 10000, nr_ticks = 100000;
+
+void xnpod_fatal_helper(const char *format, ...)
+{
+	va_list ap;
+
+	va_start(ap, format);
+	vfprintf(stderr, format, ap);
+	va_end(ap);
+	fputc('\n', stderr);
+}
+
+unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char *const argv[])
+{
+	int c, quick = 0;
+
+	while ((c = getopt(argc, argv, "n:t:q")) != EOF)
+		switch (c) {
+		case 'n':
+			nr_timers = atoi(optarg);
+			break;
+		case 't':
+			nr_ticks = atoi(optarg);
+			break;
+		case 'q':
+			quick = 1;
+			break;
+		default:
+			fprintf(stderr, "usage: timerq-torture [-n timers] [-t ticks] [-q]\n");
+			exit(EXIT_FAILURE);
+		}
+
+	if (nr_timers == 0)
+		nr_timers = 1;
+
+	check_timerq_heap();
+	check_timerq_wheel();
+	check_timerq_list();
+	printf("timer queue consistency checks passed (%u timers)\n",
+	       nr_timers);
+
+	if (quick)
+		exit(EXIT_SUCCESS);
+
+	bench_timerq_heap();
+	bench_timerq_wheel();
+	bench_timerq_list();
+
+	exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,45 @@
+#ifndef TIMERQ_TORTURE_H
+#define TIMERQ_TORTURE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+/* Minimal environment for the nucleus timer queue code. */
+#define bheap_alloc(size)	malloc(size)
+#define bheap_free(ptr)		free(ptr)
+#define ERR_PTR(err)		((void *)(long)(err))
+#define xnarch_begin_panic()	do { } while (0)
+#define xnarch_halt()		abort()
+#define xnarch_ns_to_tsc(ns)	(ns)
+
+#ifndef container_of
+#define container_of(ptr, type, member)				\
+	((type *)((char *)(ptr) - offsetof(type, member)))
+#endif
+
+#define fatal(fmt, args...)					\
+	do {							\
+		fprintf(stderr, fmt "\n", ##args);		\
+		exit(EXIT_FAILURE);				\
+	} while (0)
+
+extern unsigned int nr_timers, nr_ticks;
+
+unsigned long long now_ns(void);
+
+void check_timerq_heap(void);
+
+void bench_timerq_heap(void);
+
+void check_timerq_wheel(void);
+
+void bench_timerq_wheel(void);
+
+void check_timerq_list(void);
+
+void bench_timerq_list(void);
+
+#endif /* !TIMERQ_TORTURE_H */
@@ -0,0 +1,5 @@
+#define CONFIG_XENO_OPT_TIMER_WHEEL		1
+#define CONFIG_XENO_OPT_TIMER_WHEEL_STEP	1024
+#define TIMERQ_FLAVOUR				wheel
+
+#include "timerq-flavour.h"
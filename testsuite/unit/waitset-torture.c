@@ -0,0 +1,253 @@
+/*
+ * Functional testing of Alchemy waitsets: readiness reporting,
+ * wakeups, fairness among ready objects, and deletion of watched
+ * objects and of the waitset itself.
+ *
+ * Released under the terms of GPLv2.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <copperplate/init.h>
+#include <alchemy/task.h>
+#include <alchemy/sem.h>
+#include <alchemy/event.h>
+#include <alchemy/waitset.h>
+
+#define NR_SEMS		3
+#define EVENT_MASK	0x4
+
+static RT_TASK main_task;
+
+static RT_WAITSET wset;
+
+static RT_SEM sems[NR_SEMS], done_sem;
+
+static RT_EVENT event;
+
+static int waiter_ret;
+
+static void check_inner(const char *fn, const char *msg,
+			int status, int expected)
+{
+	if (status == expected)
+		return;
+
+	fprintf(stderr, "FAILED %s %s: returned %d instead of %d - %s\n",
+		fn, msg, status, expected, strerror(-status));
+	exit(EXIT_FAILURE);
+}
+#define check(msg, status, expected) \
+	check_inner(__FUNCTION__, msg, status, expected)
+
+static void check_cookie(const char *fn, void *cookie, void *expected)
+{
+	if (cookie == expected)
+		return;
+
+	fprintf(stderr, "FAILED %s: got cookie %p instead of %p\n",
+		fn, cookie, expected);
+	exit(EXIT_FAILURE);
+}
+
+static void spawn(RT_TASK *task, const char *name,
+		  void (*entry)(void *arg), void *arg)
+{
+	check("rt_task_create", rt_task_create(task, name, 0, 10, 0), 0);
+	check("rt_task_start", rt_task_start(task, entry, arg), 0);
+}
+
+static void setup(void)
+{
+	char name[32];
+	int n;
+
+	check("rt_waitset_create", rt_waitset_create(&wset, "wset", WS_FIFO), 0);
+
+	for (n = 0; n < NR_SEMS; n++) {
+		sprintf(name, "sem%d", n);
+		check("rt_sem_create", rt_sem_create(&sems[n], name, 0, S_FIFO), 0);
+		check("rt_waitset_add_sem",
+		      rt_waitset_add_sem(&wset, &sems[n], &sems[n]), 0);
+	}
+
+	check("rt_event_create", rt_event_create(&event, "event", 0, EV_FIFO), 0);
+	check("rt_waitset_add_event",
+	      rt_waitset_add_event(&wset, &event, EVENT_MASK, &event), 0);
+}
+
+static void cleanup(void)
+{
+	int n;
+
+	for (n = 0; n < NR_SEMS; n++)
+		check("rt_sem_delete", rt_sem_delete(&sems[n]), 0);
+
+	check("rt_event_delete", rt_event_delete(&event), 0);
+	check("rt_waitset_delete", rt_waitset_delete(&wset), 0);
+}
+
+static void ready_poll(void)
+{
+	unsigned long mask;
+	void *cookies[4];
+
+	setup();
+
+	check("rt_waitset_wait", rt_waitset_wait(&wset, cookies, 4, TM_NONBLOCK),
+	      -EWOULDBLOCK);
+	check("rt_waitset_add_sem",
+	      rt_waitset_add_sem(&wset, &sems[0], &sems[0]), -EEXIST);
+
+	check("rt_sem_v", rt_sem_v(&sems[1]), 0);
+	check("rt_waitset_wait", rt_waitset_wait(&wset, cookies, 4, TM_NONBLOCK), 1);
+	check_cookie(__FUNCTION__, cookies[0], &sems[1]);
+
+	/* Level-triggered: ready until consumed. */
+	check("rt_waitset_wait", rt_waitset_wait(&wset, cookies, 4, TM_NONBLOCK), 1);
+	check("rt_sem_p", rt_sem_p(&sems[1], TM_NONBLOCK), 0);
+	check("rt_waitset_wait", rt_waitset_wait(&wset, cookies, 4, TM_NONBLOCK),
+	      -EWOULDBLOCK);
+
+	/* Events outside the watched mask are ignored. */
+	check("rt_event_signal", rt_event_signal(&event, ~EVENT_MASK), 0);
+	check("rt_waitset_wait", rt_waitset_wait(&wset, cookies, 4, TM_NONBLOCK),
+	      -EWOULDBLOCK);
+	check("rt_event_signal", rt_event_signal(&event, EVENT_MASK), 0);
+	check("rt_waitset_wait", rt_waitset_wait(&wset, cookies, 4, TM_NONBLOCK), 1);
+	check_cookie(__FUNCTION__, cookies[0], &event);
+	check("rt_event_clear", rt_event_clear(&event, ~0UL, &mask), 0);
+	check("rt_waitset_wait", rt_waitset_wait(&wset, cookies, 4, TM_NONBLOCK),
+	      -EWOULDBLOCK);
+
+	cleanup();
+}
+
+static void fairness(void)
+{
+	void *cookies[1], *seen[NR_SEMS];
+	int n, m;
+
+	setup();
+
+	for (n = 0; n < NR_SEMS; n++)
+		check("rt_sem_v", rt_sem_v(&sems[n]), 0);
+
+	/* Ready objects are all reported, one at a time. */
+	for (n = 0; n < NR_SEMS; n++) {
+		check("rt_waitset_wait",
+		      rt_waitset_wait(&wset, cookies, 1, TM_NONBLOCK), 1);
+		for (m = 0; m < n; m++)
+			if (seen[m] == cookies[0]) {
+				fprintf(stderr, "FAILED %s: cookie %p "
+					"reported twice\n", __FUNCTION__,
+					cookies[0]);
+				exit(EXIT_FAILURE);
+			}
+		seen[n] = cookies[0];
+	}
+
+	cleanup();
+}
+
+static void poster(void *arg)
+{
+	rt_task_sleep(10000000);
+	check("rt_sem_v", rt_sem_v(arg), 0);
+}
+
+static void wakeup(void)
+{
+	void *cookies[4];
+	RT_TASK task;
+
+	setup();
+
+	spawn(&task, "poster", poster, &sems[2]);
+	check("rt_waitset_wait", rt_waitset_wait(&wset, cookies, 4, TM_INFINITE), 1);
+	check_cookie(__FUNCTION__, cookies[0], &sems[2]);
+	check("rt_sem_p", rt_sem_p(&sems[2], TM_NONBLOCK), 0);
+	check("rt_waitset_wait", rt_waitset_wait(&wset, cookies, 4, TM_NONBLOCK),
+	      -EWOULDBLOCK);
+
+	cleanup();
+}
+
+static void delete_watched(void)
+{
+	void *cookies[4];
+	int n;
+
+	setup();
+
+	/* Deleted objects read as ready until removed. */
+	check("rt_sem_delete", rt_sem_delete(&sems[0]), 0);
+	check("rt_waitset_wait", rt_waitset_wait(&wset, cookies, 4, TM_NONBLOCK), 1);
+	check_cookie(__FUNCTION__, cookies[0], &sems[0]);
+	check("rt_sem_p", rt_sem_p(&sems[0], TM_NONBLOCK), -EIDRM);
+	check("rt_waitset_remove", rt_waitset_remove(&wset, &sems[0]), 0);
+	check("rt_waitset_remove", rt_waitset_remove(&wset, &sems[0]), -EINVAL);
+	check("rt_waitset_wait", rt_waitset_wait(&wset, cookies, 4, TM_NONBLOCK),
+	      -EWOULDBLOCK);
+
+	/* Deleting the waitset drops the remaining watches. */
+	check("rt_waitset_delete", rt_waitset_delete(&wset), 0);
+	for (n = 1; n < NR_SEMS; n++)
+		check("rt_sem_delete", rt_sem_delete(&sems[n]), 0);
+	check("rt_event_delete", rt_event_delete(&event), 0);
+}
+
+static void waiter(void *arg)
+{
+	void *cookies[4];
+
+	waiter_ret = rt_waitset_wait(&wset, cookies, 4, TM_INFINITE);
+	check("rt_sem_v", rt_sem_v(&done_sem), 0);
+}
+
+static void delete_whilewait(void)
+{
+	RT_WAITSET_INFO info;
+	RT_TASK task;
+	int n;
+
+	setup();
+
+	check("rt_sem_create", rt_sem_create(&done_sem, "done", 0, S_FIFO), 0);
+	spawn(&task, "waiter", waiter, NULL);
+
+	for (;;) {
+		check("rt_waitset_inquire", rt_waitset_inquire(&wset, &info), 0);
+		if (info.nwaiters > 0)
+			break;
+		rt_task_sleep(1000000);
+	}
+
+	check("rt_waitset_delete", rt_waitset_delete(&wset), 0);
+	check("rt_sem_p", rt_sem_p(&done_sem, TM_INFINITE), 0);
+	check("rt_waitset_wait", waiter_ret, -EIDRM);
+
+	for (n = 0; n < NR_SEMS; n++)
+		check("rt_sem_delete", rt_sem_delete(&sems[n]), 0);
+	check("rt_event_delete", rt_event_delete(&event), 0);
+	check("rt_sem_delete", rt_sem_delete(&done_sem), 0);
+}
+
+int main(int argc, char *const argv[])
+{
+	copperplate_init(argc, argv);
+
+	check("rt_task_shadow",
+	      rt_task_shadow(&main_task, "waitset-torture", 10, 0), 0);
+
+	ready_poll();
+	fairness();
+	wakeup();
+	delete_watched();
+	delete_whilewait();
+	fprintf(stderr, "Test OK\n");
+
+	return 0;
+}
@@ -0,0 +1,704 @@
+/*
+ * Scenario-driven real-time load generator.
+ *
+ * Runs a set of periodic threads at mixed rates on given CPUs,
+ * exchanging data over message queues and RTIPC sockets, and
+ * contending for mutexes, as described by a scenario file. This is
+ * meant to reproduce an application mix while xeno-test measures
+ * latencies; the per-task jitter and overrun statistics are
+ * summarized on exit.
+ *
+ * Xenomai is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * Xenomai is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Xenomai; if not, write to the Free Software Foundation,
+ * Inc., 59 Temple Place - Suite 330, Boston, MA 02111-1307, USA.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <mqueue.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include <xeno_config.h>
+#include <rtdm/rtipc.h>
+#include <rtdm/rthist.h>
+
+#ifndef HAVE_RECENT_SETAFFINITY
+#ifdef HAVE_OLD_SETAFFINITY
+#define sched_setaffinity(pid, len, mask)	sched_setaffinity(pid, mask)
+#else /* !HAVE_OLD_SETAFFINITY */
+#ifndef __cpu_set_t_defined
+typedef unsigned long cpu_set_t;
+#endif
+#define sched_setaffinity(pid, len, mask)	0
+#ifndef CPU_ZERO
+#define CPU_ZERO(set)				memset(set, 0, sizeof(*set))
+#define CPU_SET(n, set)				do { } while (0)
+#endif
+#endif /* !HAVE_OLD_SETAFFINITY */
+#endif /* !HAVE_RECENT_SETAFFINITY */
+
+#define MAX_TASKS	64
+#define MAX_EDGES	256
+#define MAX_TASK_EDGES	32
+#define MAX_MSG_SIZE	1024
+
+#define EDGE_QUEUE	0
+#define EDGE_RTIPC	1
+#define EDGE_MUTEX	2
+
+static const char *edge_types[] = {
+	[EDGE_QUEUE] = "queue",
+	[EDGE_RTIPC] = "rtipc",
+	[EDGE_MUTEX] = "mutex",
+};
+
+struct edge {
+	int type;
+	struct task *from, *to;
+	size_t size;		/* Message size (queue, rtipc) */
+	long hold_ns;		/* Lock hold time (mutex) */
+	mqd_t mq;
+	int txsock, rxsock;
+	struct sockaddr_ipc addr;
+	pthread_mutex_t mutex;
+	/* Statistics */
+	unsigned long long sent;
+	unsigned long long received;
+	unsigned long long dropped;
+	long long delay_sum;
+	long delay_max;
+};
+
+struct task {
+	char name[32];
+	int cpu;
+	int prio;
+	long period_ns;
+	long load_ns;
+	pthread_t thread;
+	struct edge *in[MAX_TASK_EDGES];
+	struct edge *out[MAX_TASK_EDGES];
+	struct edge *locks[MAX_TASK_EDGES];
+	int nr_in, nr_out, nr_locks;
+	/* Statistics */
+	unsigned long long samples;
+	unsigned long long overruns;
+	long long jitter_sum;
+	long jitter_min;
+	long jitter_max;
+	unsigned long relaxed;
+	struct rttst_hist *hist;
+};
+
+struct message {
+	struct timespec date;
+	unsigned long long seq;
+};
+
+static struct task tasks[MAX_TASKS];
+static struct edge edges[MAX_EDGES];
+static int nr_tasks, nr_edges;
+
+static struct timespec origin;
+static volatile int stopped;
+static __thread struct task *self;
+
+static int duration;
+static const char *summary_file;
+
+static inline long long ts_diff(const struct timespec *a,
+				const struct timespec *b)
+{
+	return (a->tv_sec - b->tv_sec) * 1000000000LL +
+		a->tv_nsec - b->tv_nsec;
+}
+
+static inline void ts_add(struct timespec *ts, long ns)
+{
+	ts->tv_nsec += ns;
+	while (ts->tv_nsec >= 1000000000) {
+		ts->tv_nsec -= 1000000000;
+		ts->tv_sec++;
+	}
+}
+
+static void burn(long ns)
+{
+	struct timespec start, now;
+
+	if (ns <= 0)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	do
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	while (ts_diff(&now, &start) < ns);
+}
+
+static void edge_receive(struct edge *e)
+{
+	union {
+		struct message msg;
+		char buf[MAX_MSG_SIZE];
+	} u;
+	struct timespec now;
+	long delay;
+	int ret;
+
+	for (;;) {
+		if (e->type == EDGE_QUEUE)
+			ret = mq_receive(e->mq, u.buf, sizeof(u.buf), NULL);
+		else
+			ret = recvfrom(e->rxsock, u.buf, sizeof(u.buf),
+				       MSG_DONTWAIT, NULL, NULL);
+		if (ret < (int)sizeof(u.msg))
+			return;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		delay = ts_diff(&now, &u.msg.date);
+		e->delay_sum += delay;
+		if (delay > e->delay_max)
+			e->delay_max = delay;
+		e->received++;
+	}
+}
+
+static void edge_send(struct edge *e)
+{
+	union {
+		struct message msg;
+		char buf[MAX_MSG_SIZE];
+	} u;
+	int ret;
+
+	clock_gettime(CLOCK_MONOTONIC, &u.msg.date);
+	u.msg.seq = e->sent;
+
+	if (e->type == EDGE_QUEUE)
+		ret = mq_send(e->mq, u.buf, e->size, 0);
+	else
+		ret = sendto(e->txsock, u.buf, e->size, MSG_DONTWAIT,
+			     (struct sockaddr *)&e->addr, sizeof(e->addr));
+	if (ret < 0)
+		e->dropped++;
+	else
+		e->sent++;
+}
+
+static void *task_body(void *arg)
+{
+	struct timespec next, now;
+	struct task *t = arg;
+	cpu_set_t cpu_set;
+	long jitter;
+	int n, err;
+
+	self = t;
+
+	CPU_ZERO(&cpu_set);
+	CPU_SET(t->cpu, &cpu_set);
+	if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set)) {
+		fprintf(stderr, "xeno-load: %s: cannot move to CPU%d\n",
+			t->name, t->cpu);
+		return NULL;
+	}
+
+	pthread_set_mode_np(0, PTHREAD_WARNSW);
+
+	/* All tasks share the same origin, so that rates interleave. */
+	next = origin;
+
+	while (!stopped) {
+		ts_add(&next, t->period_ns);
+		err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+				      &next, NULL);
+		if (err)
+			break;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		jitter = ts_diff(&now, &next);
+		if (jitter < t->jitter_min)
+			t->jitter_min = jitter;
+		if (jitter > t->jitter_max)
+			t->jitter_max = jitter;
+		t->jitter_sum += jitter;
+		t->samples++;
+		rttst_hist_add(t->hist, jitter >= 0 ? jitter : -jitter);
+
+		for (n = 0; n < t->nr_in; n++)
+			edge_receive(t->in[n]);
+
+		burn(t->load_ns);
+
+		for (n = 0; n < t->nr_locks; n++) {
+			pthread_mutex_lock(&t->locks[n]->mutex);
+			burn(t->locks[n]->hold_ns);
+			pthread_mutex_unlock(&t->locks[n]->mutex);
+		}
+
+		for (n = 0; n < t->nr_out; n++)
+			edge_send(t->out[n]);
+
+		/* Skip the releases we missed. */
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		while (ts_diff(&now, &next) > t->period_ns) {
+			ts_add(&next, t->period_ns);
+			t->overruns++;
+		}
+	}
+
+	return NULL;
+}
+
+static void mode_sw(int sig)
+{
+	if (self)
+		self->relaxed++;
+}
+
+static struct task *find_task(const char *name)
+{
+	int n;
+
+	for (n = 0; n < nr_tasks; n++)
+		if (strcmp(tasks[n].name, name) == 0)
+			return &tasks[n];
+
+	return NULL;
+}
+
+/* Parse "key=value" into *v, in units of @scale. */
+static int parse_attr(const char *tok, const char *key, long *v, long scale)
+{
+	size_t len = strlen(key);
+	char *end;
+
+	if (strncmp(tok, key, len) || tok[len] != '=')
+		return 0;
+
+	*v = strtol(tok + len + 1, &end, 0) * scale;
+
+	return *end ? -1 : 1;
+}
+
+static int parse_task(char **tok, int nr_tok)
+{
+	struct task *t;
+	long v;
+	int n;
+
+	if (nr_tok < 2 || nr_tasks == MAX_TASKS || find_task(tok[1]))
+		return -1;
+
+	t = &tasks[nr_tasks];
+	snprintf(t->name, sizeof(t->name), "%s", tok[1]);
+	t->prio = 50;
+
+	for (n = 2; n < nr_tok; n++) {
+		if (parse_attr(tok[n], "cpu", &v, 1) > 0)
+			t->cpu = v;
+		else if (parse_attr(tok[n], "prio", &v, 1) > 0)
+			t->prio = v;
+		else if (parse_attr(tok[n], "period", &v, 1000) > 0)
+			t->period_ns = v;
+		else if (parse_attr(tok[n], "load", &v, 1000) > 0)
+			t->load_ns = v;
+		else
+			return -1;
+	}
+
+	if (t->period_ns <= 0 || t->load_ns < 0 || t->cpu < 0 ||
+	    t->prio < 1 || t->prio > 99)
+		return -1;
+
+	nr_tasks++;
+
+	return 0;
+}
+
+static int parse_edge(int type, char **tok, int nr_tok)
+{
+	struct edge *e;
+	int n, first;
+	long v;
+
+	if (nr_edges == MAX_EDGES)
+		return -1;
+
+	e = &edges[nr_edges];
+	e->type = type;
+	e->size = sizeof(struct message);
+
+	/* <from> -> <to> for data edges, <task> <task> for mutexes. */
+	if (type == EDGE_MUTEX) {
+		if (nr_tok < 3)
+			return -1;
+		e->from = find_task(tok[1]);
+		e->to = find_task(tok[2]);
+		first = 3;
+	} else {
+		if (nr_tok < 4 || strcmp(tok[2], "->"))
+			return -1;
+		e->from = find_task(tok[1]);
+		e->to = find_task(tok[3]);
+		first = 4;
+	}
+
+	if (e->from == NULL || e->to == NULL || e->from == e->to)
+		return -1;
+
+	for (n = first; n < nr_tok; n++) {
+		if (type != EDGE_MUTEX &&
+		    parse_attr(tok[n], "size", &v, 1) > 0)
+			e->size = v;
+		else if (type == EDGE_MUTEX &&
+			 parse_attr(tok[n], "hold", &v, 1000) > 0)
+			e->hold_ns = v;
+		else
+			return -1;
+	}
+
+	if (e->size < sizeof(struct message) || e->size > MAX_MSG_SIZE ||
+	    e->hold_ns < 0)
+		return -1;
+
+	if (type == EDGE_MUTEX) {
+		if (e->from->nr_locks == MAX_TASK_EDGES ||
+		    e->to->nr_locks == MAX_TASK_EDGES)
+			return -1;
+		e->from->locks[e->from->nr_locks++] = e;
+		e->to->locks[e->to->nr_locks++] = e;
+	} else {
+		if (e->from->nr_out == MAX_TASK_EDGES ||
+		    e->to->nr_in == MAX_TASK_EDGES)
+			return -1;
+		e->from->out[e->from->nr_out++] = e;
+		e->to->in[e->to->nr_in++] = e;
+	}
+
+	nr_edges++;
+
+	return 0;
+}
+
+static int parse_scenario(const char *path)
+{
+	char line[256], *tok[16], *p;
+	int lineno = 0, nr_tok, ret;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		fprintf(stderr, "xeno-load: cannot open %s: %s\n",
+			path, strerror(errno));
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		lineno++;
+		p = strchr(line, '#');
+		if (p)
+			*p = '\0';
+
+		for (nr_tok = 0, p = strtok(line, " \t\n");
+		     p && nr_tok < 16; p = strtok(NULL, " \t\n"))
+			tok[nr_tok++] = p;
+
+		if (nr_tok == 0)
+			continue;
+
+		if (strcmp(tok[0], "task") == 0)
+			ret = parse_task(tok, nr_tok);
+		else if (strcmp(tok[0], "queue") == 0)
+			ret = parse_edge(EDGE_QUEUE, tok, nr_tok);
+		else if (strcmp(tok[0], "rtipc") == 0)
+			ret = parse_edge(EDGE_RTIPC, tok, nr_tok);
+		else if (strcmp(tok[0], "mutex") == 0)
+			ret = parse_edge(EDGE_MUTEX, tok, nr_tok);
+		else
+			ret = -1;
+
+		if (ret) {
+			fprintf(stderr, "xeno-load: %s:%d: syntax error\n",
+				path, lineno);
+			fclose(fp);
+			return -1;
+		}
+	}
+
+	fclose(fp);
+
+	if (nr_tasks == 0) {
+		fprintf(stderr, "xeno-load: %s: no task defined\n", path);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int setup_edge(struct edge *e, int n)
+{
+	pthread_mutexattr_t mattr;
+	struct mq_attr qattr;
+	socklen_t addrlen;
+	char name[64];
+	size_t poolsz;
+	int err;
+
+	switch (e->type) {
+	case EDGE_QUEUE:
+		snprintf(name, sizeof(name), "/xeno-load-%d-%d", getpid(), n);
+		memset(&qattr, 0, sizeof(qattr));
+		qattr.mq_maxmsg = 8;
+		qattr.mq_msgsize = e->size;
+		e->mq = mq_open(name, O_RDWR | O_CREAT | O_EXCL | O_NONBLOCK,
+				0600, &qattr);
+		if (e->mq == (mqd_t)-1)
+			return -errno;
+		mq_unlink(name);
+		break;
+
+	case EDGE_RTIPC:
+		e->rxsock = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP);
+		if (e->rxsock < 0)
+			return -errno;
+		poolsz = 16 * e->size;
+		if (setsockopt(e->rxsock, SOL_IDDP, IDDP_POOLSZ,
+			       &poolsz, sizeof(poolsz)))
+			return -errno;
+		/* Let the core pick a free port, then learn it. */
+		e->addr.sipc_family = AF_RTIPC;
+		e->addr.sipc_port = -1;
+		if (bind(e->rxsock, (struct sockaddr *)&e->addr,
+			 sizeof(e->addr)))
+			return -errno;
+		addrlen = sizeof(e->addr);
+		if (getsockname(e->rxsock, (struct sockaddr *)&e->addr,
+				&addrlen))
+			return -errno;
+		e->txsock = socket(AF_RTIPC, SOCK_DGRAM, IPCPROTO_IDDP);
+		if (e->txsock < 0)
+			return -errno;
+		break;
+
+	case EDGE_MUTEX:
+		pthread_mutexattr_init(&mattr);
+		pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT);
+		err = pthread_mutex_init(&e->mutex, &mattr);
+		pthread_mutexattr_destroy(&mattr);
+		if (err)
+			return -err;
+		break;
+	}
+
+	return 0;
+}
+
+static void cleanup_edge(struct edge *e)
+{
+	switch (e->type) {
+	case EDGE_QUEUE:
+		mq_close(e->mq);
+		break;
+	case EDGE_RTIPC:
+		close(e->txsock);
+		close(e->rxsock);
+		break;
+	case EDGE_MUTEX:
+		pthread_mutex_destroy(&e->mutex);
+		break;
+	}
+}
+
+/*
+ * One line per task and edge, as space-separated key=value pairs;
+ * durations are in nanoseconds.
+ */
+static void print_summary(FILE *fp)
+{
+	struct task *t;
+	struct edge *e;
+	int n;
+
+	for (n = 0; n < nr_tasks; n++) {
+		t = &tasks[n];
+		fprintf(fp, "task name=%s cpu=%d prio=%d period=%ld load=%ld "
+			"samples=%Lu overruns=%Lu relaxed=%lu",
+			t->name, t->cpu, t->prio, t->period_ns, t->load_ns,
+			t->samples, t->overruns, t->relaxed);
+		if (t->samples)
+			fprintf(fp, " jitter_min=%ld jitter_avg=%Ld "
+				"jitter_max=%ld jitter_p99=%Lu "
+				"jitter_p99.9=%Lu jitter_p99.99=%Lu",
+				t->jitter_min, t->jitter_sum / (long long)t->samples,
+				t->jitter_max,
+				rttst_hist_percentile(t->hist, 990000),
+				rttst_hist_percentile(t->hist, 999000),
+				rttst_hist_percentile(t->hist, 999900));
+		fputc('\n', fp);
+	}
+
+	for (n = 0; n < nr_edges; n++) {
+		e = &edges[n];
+		fprintf(fp, "edge type=%s from=%s to=%s",
+			edge_types[e->type], e->from->name, e->to->name);
+		if (e->type == EDGE_MUTEX)
+			fprintf(fp, " hold=%ld\n", e->hold_ns);
+		else
+			fprintf(fp, " size=%zu sent=%Lu received=%Lu "
+				"dropped=%Lu delay_avg=%Ld delay_max=%ld\n",
+				e->size, e->sent, e->received, e->dropped,
+				e->received ?
+				e->delay_sum / (long long)e->received : 0,
+				e->delay_max);
+	}
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+"usage: xeno-load [options] <scenario-file>\n"
+"  [-T <test_duration_seconds>] # default=0, so ^C to end\n"
+"  [-o <summary-file>]          # write the summary there, not to stdout\n"
+"\n"
+"Scenario lines, '#' starts a comment, times are in microseconds:\n"
+"  task <name> period=<us> [cpu=<n>] [prio=<1-99>] [load=<us>]\n"
+"  queue <from> -> <to> [size=<bytes>]   # POSIX message queue\n"
+"  rtipc <from> -> <to> [size=<bytes>]   # RTIPC datagram socket (IDDP)\n"
+"  mutex <task> <task> [hold=<us>]       # shared PI mutex\n"
+"Each task wakes up every period, drains its inbound queues and\n"
+"sockets, busy-waits for load, holds each of its mutexes in turn for\n"
+"the hold time, then posts one message on each outbound edge.\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct sched_param param;
+	pthread_attr_t attr;
+	sigset_t mask;
+	int c, n, err, sig;
+	FILE *fp;
+
+	while ((c = getopt(argc, argv, "hT:o:")) != EOF)
+		switch (c) {
+		case 'T':
+			duration = atoi(optarg);
+			break;
+		case 'o':
+			summary_file = optarg;
+			break;
+		default:
+			usage();
+			exit(c == 'h' ? 0 : 2);
+		}
+
+	if (optind != argc - 1) {
+		usage();
+		exit(2);
+	}
+
+	if (parse_scenario(argv[optind]))
+		exit(2);
+
+	mlockall(MCL_CURRENT | MCL_FUTURE);
+
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigaddset(&mask, SIGHUP);
+	sigaddset(&mask, SIGALRM);
+	pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+	signal(SIGXCPU, mode_sw);
+
+	for (n = 0; n < nr_edges; n++) {
+		err = setup_edge(&edges[n], n);
+		if (err) {
+			fprintf(stderr, "xeno-load: cannot set up %s %s -> %s: "
+				"%s\n", edge_types[edges[n].type],
+				edges[n].from->name, edges[n].to->name,
+				strerror(-err));
+			exit(1);
+		}
+	}
+
+	/* First release 10 ms from now, once all threads are up. */
+	clock_gettime(CLOCK_MONOTONIC, &origin);
+	ts_add(&origin, 10000000);
+
+	for (n = 0; n < nr_tasks; n++) {
+		struct task *t = &tasks[n];
+
+		t->jitter_min = LONG_MAX;
+		t->jitter_max = LONG_MIN;
+		t->hist = rttst_hist_alloc(RTTST_HIST_SUB_BITS,
+					   RTTST_HIST_RANGE_BITS);
+		if (t->hist == NULL) {
+			fprintf(stderr, "xeno-load: out of memory\n");
+			exit(1);
+		}
+
+		pthread_attr_init(&attr);
+		pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+		pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+		param.sched_priority = t->prio;
+		pthread_attr_setschedparam(&attr, &param);
+		err = pthread_create(&t->thread, &attr, task_body, t);
+		pthread_attr_destroy(&attr);
+		if (err) {
+			fprintf(stderr, "xeno-load: cannot create %s: %s\n",
+				t->name, strerror(err));
+			exit(1);
+		}
+	}
+
+	if (duration)
+		alarm(duration);
+
+	sigwait(&mask, &sig);
+	stopped = 1;
+
+	for (n = 0; n < nr_tasks; n++)
+		pthread_join(tasks[n].thread, NULL);
+
+	for (n = 0; n < nr_edges; n++)
+		cleanup_edge(&edges[n]);
+
+	fp = stdout;
+	if (summary_file) {
+		fp = fopen(summary_file, "w");
+		if (fp == NULL) {
+			fprintf(stderr, "xeno-load: cannot open %s: %s\n",
+				summary_file, strerror(errno));
+			exit(1);
+		}
+	}
+
+	print_summary(fp);
+
+	if (fp != stdout && fclose(fp)) {
+		fprintf(stderr, "xeno-load: cannot write %s: %s\n",
+			summary_file, strerror(errno));
+		exit(1);
+	}
+
+	return 0;
+}
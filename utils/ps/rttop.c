@@ -0,0 +1,276 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * rttop samples the per-thread statistics the nucleus exports to the
+ * global semaphore heap, so that no system call nor /proc access is
+ * needed for collecting them.
+ */
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <error.h>
+#include <errno.h>
+#include <nucleus/vdso.h>
+#include <asm/xenomai/syscall.h>
+
+extern unsigned long xeno_sem_heap[2];
+
+struct sample {
+	struct xnvdso_thread_stat stat;
+	unsigned long long exectime;
+	int valid;
+};
+
+struct row {
+	struct xnvdso_thread_stat *stat;
+	unsigned long long exectime;
+	double cpu;
+	unsigned long dcsw;
+	unsigned long dssw;
+};
+
+static struct sample *prev_samples, *samples;
+
+static struct row *rows;
+
+static double clockfreq;
+
+static const struct option options[] = {
+	{
+#define delay_opt	0
+		.name = "delay",
+		.has_arg = 1,
+		.flag = NULL,
+		.val = 0
+	},
+	{
+#define count_opt	1
+		.name = "count",
+		.has_arg = 1,
+		.flag = NULL,
+		.val = 0
+	},
+	{
+#define batch_opt	2
+		.name = "batch",
+		.has_arg = 0,
+		.flag = NULL,
+		.val = 0
+	},
+	{
+#define help_opt	3
+		.name = "help",
+		.has_arg = 0,
+		.flag = NULL,
+		.val = 0
+	},
+	{
+		.name = NULL,
+	}
+};
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: rttop [options]:\n");
+	fprintf(stderr, "--delay=<ms>           sampling period in milliseconds (default 1000)\n");
+	fprintf(stderr, "--count=<num>          exit after <num> samples\n");
+	fprintf(stderr, "--batch                do not clear the screen between samples\n");
+	fprintf(stderr, "--help                 this help\n");
+}
+
+/*
+ * Copy a slot consistently, accounting for the current execution
+ * slice of running threads.
+ */
+static void read_slot(struct xnvdso_thread_stat *slot, struct sample *s)
+{
+	unsigned int seq;
+
+	do {
+		seq = xnread_seqcount_begin(&slot->seqcount);
+		s->stat = *slot;
+		s->exectime = s->stat.exectime;
+		if (s->stat.flags & XNSTAT_SHM_RUNNING)
+			s->exectime += __xn_rdtsc() - s->stat.lastswitch;
+	} while (xnread_seqcount_retry(&slot->seqcount, seq));
+
+	s->valid = (s->stat.flags & XNSTAT_SHM_USED) != 0;
+}
+
+static int same_thread(struct sample *a, struct sample *b)
+{
+	return a->valid && b->valid && a->stat.pid == b->stat.pid &&
+		strncmp(a->stat.name, b->stat.name, sizeof(a->stat.name)) == 0;
+}
+
+static int compare_rows(const void *a, const void *b)
+{
+	const struct row *ra = a, *rb = b;
+
+	if (ra->cpu != rb->cpu)
+		return ra->cpu < rb->cpu ? 1 : -1;
+
+	return ra->stat->pid - rb->stat->pid;
+}
+
+static void format_time(unsigned long long tsc, char *buf, size_t len)
+{
+	unsigned long long v = (unsigned long long)(tsc * 1e9 / clockfreq);
+	unsigned int hr, min, msec;
+	unsigned long sec;
+
+	sec = v / 1000000000LL;
+	v %= 1000000000LL;
+	msec = v / 1000000LL;
+	hr = sec / (60 * 60);
+	sec %= (60 * 60);
+	min = sec / 60;
+	sec %= 60;
+	snprintf(buf, len, "%.3u:%.2u:%.2lu.%.3u", hr, min, sec, msec);
+}
+
+static void display(unsigned int nr, unsigned long long elapsed, int batch)
+{
+	struct sample *s, *p;
+	unsigned int n, nrows;
+	char tbuf[32];
+	double period;
+
+	for (n = 0, nrows = 0; n < nr; n++) {
+		s = samples + n;
+		if (!s->valid)
+			continue;
+		p = prev_samples + n;
+		rows[nrows].stat = &s->stat;
+		rows[nrows].exectime = s->exectime;
+		if (elapsed > 0 && same_thread(s, p)) {
+			rows[nrows].cpu = (s->exectime - p->exectime) * 100.0 / elapsed;
+			rows[nrows].dcsw = s->stat.csw - p->stat.csw;
+			rows[nrows].dssw = s->stat.ssw - p->stat.ssw;
+		} else {
+			rows[nrows].cpu = 0.0;
+			rows[nrows].dcsw = 0;
+			rows[nrows].dssw = 0;
+		}
+		nrows++;
+	}
+
+	qsort(rows, nrows, sizeof(rows[0]), compare_rows);
+
+	if (!batch)
+		printf("\033[H\033[2J");
+
+	period = elapsed / clockfreq;
+	printf("%u threads, sampled over %.3f s\n\n", nrows, period);
+	printf("%-3s  %-6s %6s %8s %8s %8s  %-16s %s\n",
+	       "CPU", "PID", "%CPU", "CSW/s", "MSW/s", "PF", "TIME", "NAME");
+
+	for (n = 0; n < nrows; n++) {
+		format_time(rows[n].exectime, tbuf, sizeof(tbuf));
+		printf("%3d  %-6d %6.1f %8lu %8lu %8lu  %-16s %.*s\n",
+		       rows[n].stat->cpu,
+		       rows[n].stat->pid,
+		       rows[n].cpu,
+		       period > 0 ? (unsigned long)(rows[n].dcsw / period) : 0,
+		       period > 0 ? (unsigned long)(rows[n].dssw / period) : 0,
+		       rows[n].stat->pf,
+		       tbuf,
+		       (int)sizeof(rows[n].stat->name),
+		       rows[n].stat->name);
+	}
+
+	fflush(stdout);
+}
+
+int main(int argc, char *const argv[])
+{
+	unsigned long long now, last = 0;
+	struct xnvdso_thread_stat *table;
+	int c, ret, lindex, batch = 0;
+	unsigned long delay = 1000;
+	long count = -1;
+	struct sample *tmp;
+	xnsysinfo_t sysinfo;
+	unsigned int nr, n;
+
+	for (;;) {
+		c = getopt_long_only(argc, argv, "", options, &lindex);
+		if (c == EOF)
+			break;
+		if (c == '?') {
+			usage();
+			return EINVAL;
+		}
+		if (c > 0)
+			continue;
+
+		switch (lindex) {
+		case delay_opt:
+			delay = strtoul(optarg, NULL, 0);
+			break;
+		case count_opt:
+			count = strtol(optarg, NULL, 0);
+			break;
+		case batch_opt:
+			batch = 1;
+			break;
+		case help_opt:
+			usage();
+			exit(0);
+		default:
+			return EINVAL;
+		}
+	}
+
+	if (!xnvdso_test_feature(XNVDSO_FEAT_THREAD_STATS))
+		error(1, ENOSYS, "thread statistics not exported "
+		      "(CONFIG_XENO_OPT_STATS_SHM)");
+
+	ret = XENOMAI_SYSCALL2(__xn_sys_info, 0, &sysinfo);
+	if (ret < 0)
+		error(1, -ret, "cannot query system information");
+
+	clockfreq = sysinfo.clockfreq;
+	nr = nkvdso->thread_stats.nr;
+	table = (struct xnvdso_thread_stat *)
+		(xeno_sem_heap[1] + nkvdso->thread_stats.offset);
+
+	samples = calloc(nr, sizeof(*samples));
+	prev_samples = calloc(nr, sizeof(*prev_samples));
+	rows = calloc(nr, sizeof(*rows));
+	if (samples == NULL || prev_samples == NULL || rows == NULL)
+		error(1, ENOMEM, "cannot allocate sample buffers");
+
+	for (;;) {
+		now = __xn_rdtsc();
+		for (n = 0; n < nr; n++)
+			read_slot(table + n, samples + n);
+
+		display(nr, last ? now - last : 0, batch);
+		last = now;
+
+		if (count > 0 && --count == 0)
+			break;
+
+		tmp = prev_samples;
+		prev_samples = samples;
+		samples = tmp;
+		usleep(delay * 1000);
+	}
+
+	exit(0);
+}